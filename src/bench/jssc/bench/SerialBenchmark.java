@@ -0,0 +1,424 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ */
+package jssc.bench;
+
+import java.io.BufferedReader;
+import java.io.InputStreamReader;
+import java.lang.management.ManagementFactory;
+import java.lang.management.ThreadMXBean;
+import java.lang.reflect.Method;
+import java.util.Arrays;
+import java.util.HashMap;
+import java.util.Map;
+import java.util.Random;
+import jssc.SerialInputStream;
+import jssc.SerialNativeInterface;
+import jssc.SerialPort;
+import jssc.SerialPortEvent;
+import jssc.SerialPortEventListener;
+import jssc.SerialPortException;
+
+/**
+ * Benchmark suite of jSSC over a loopback line: a pseudo-terminal pair echoed by
+ * "jssc_bench loopback" (see src/cpp/bench/jssc_bench.cpp), or a real port with a TX-RX
+ * loopback plug given with --port. Run by "make bench" in src/cpp.
+ * <br>
+ * Measures the throughput, the round trip latency of small messages through
+ * {@link SerialPort}, {@link SerialInputStream} and framed reads with their allocation
+ * per message, the cost of native calls, and the CPU used by the event thread while the
+ * line is idle. Every measure is repeated over several runs after warm-up runs, the
+ * report is tab separated with the median, minimum and maximum of the runs, in the
+ * format of "jssc_bench baseline" so that both can be compared line by line.
+ * <br>
+ * The payloads and iteration counts are fixed, results only depend on the machine and
+ * the arguments, which are printed in the report header.
+ *
+ * @since 2.9.0
+ */
+public final class SerialBenchmark {
+
+    private static final String USAGE =
+        "usage: SerialBenchmark (--loopback <path of jssc_bench> | --port <name of a looped back port>)\n" +
+        "                       [--baud <rate>] [--runs <count>] [--warmup <count>] [--bytes <count>]\n" +
+        "                       [--roundtrips <count>] [--calls <count>] [--idle <seconds>]";
+
+    private static final int MESSAGE_SIZE = 16;
+    private static final int[] BLOCK_SIZES = {64, 1024, 4096};
+    private static final int TIMEOUT_MILLIS = 5000;
+
+    private String portName = null;
+    private String loopbackCommand = null;
+    private int baudRate = SerialPort.BAUDRATE_115200;
+    private int runs = 5;
+    private int warmupRuns = 1;
+    private int bytes = 1024 * 1024;
+    private int roundTrips = 2000;
+    private int calls = 100000;
+    private int idleSeconds = 2;
+
+    private SerialPort serialPort;
+    private final Map<String, double[]> results = new HashMap<String, double[]>();
+
+    /**
+     * An operation measured by the benchmark
+     */
+    private interface Operation {
+        void run() throws Exception;
+    }
+
+    public static void main(String[] args) throws Exception {
+        SerialBenchmark benchmark = new SerialBenchmark();
+        if(!benchmark.parseArguments(args)){
+            System.err.println(USAGE);
+            System.exit(2);
+        }
+        System.exit(benchmark.execute() ? 0 : 1);
+    }
+
+    private boolean parseArguments(String[] args) {
+        try {
+            for(int i = 0; i < args.length; i += 2){
+                if(i + 1 >= args.length){
+                    return false;
+                }
+                String option = args[i];
+                String value = args[i + 1];
+                if(option.equals("--port")){
+                    portName = value;
+                }
+                else if(option.equals("--loopback")){
+                    loopbackCommand = value;
+                }
+                else if(option.equals("--baud")){
+                    baudRate = Integer.parseInt(value);
+                }
+                else if(option.equals("--runs")){
+                    runs = Integer.parseInt(value);
+                }
+                else if(option.equals("--warmup")){
+                    warmupRuns = Integer.parseInt(value);
+                }
+                else if(option.equals("--bytes")){
+                    bytes = Integer.parseInt(value);
+                }
+                else if(option.equals("--roundtrips")){
+                    roundTrips = Integer.parseInt(value);
+                }
+                else if(option.equals("--calls")){
+                    calls = Integer.parseInt(value);
+                }
+                else if(option.equals("--idle")){
+                    idleSeconds = Integer.parseInt(value);
+                }
+                else {
+                    return false;
+                }
+            }
+        }
+        catch (NumberFormatException ex) {
+            return false;
+        }
+        return (portName == null) != (loopbackCommand == null) && runs > 0 && warmupRuns >= 0 &&
+               bytes >= BLOCK_SIZES[BLOCK_SIZES.length - 1] && roundTrips >= 100 && calls > 0 && idleSeconds > 0;
+    }
+
+    private boolean execute() throws Exception {
+        Process loopback = null;
+        try {
+            if(loopbackCommand != null){
+                loopback = new ProcessBuilder(loopbackCommand, "loopback").start();
+                BufferedReader reader = new BufferedReader(new InputStreamReader(loopback.getInputStream()));
+                portName = reader.readLine();
+                if(portName == null){
+                    System.err.println("No port from " + loopbackCommand);
+                    return false;
+                }
+            }
+            printHeader();
+            serialPort = new SerialPort(portName);
+            serialPort.openPort();
+            try {
+                serialPort.setParams(baudRate, SerialPort.DATABITS_8, SerialPort.STOPBITS_1, SerialPort.PARITY_NONE);
+                serialPort.purgePort(SerialPort.PURGE_RXCLEAR | SerialPort.PURGE_TXCLEAR);
+                runSuite();
+                System.out.println("#" + serialPort.getStatistics());
+            }
+            finally {
+                serialPort.closePort();
+            }
+            return true;
+        }
+        finally {
+            if(loopback != null){
+                //The echo stops when its standard input is closed
+                loopback.getOutputStream().close();
+                loopback.waitFor();
+            }
+        }
+    }
+
+    private void printHeader() {
+        System.out.println("#SerialBenchmark port=" + portName + " baud=" + baudRate + " runs=" + runs + " warmup=" + warmupRuns +
+                           " bytes=" + bytes + " roundtrips=" + roundTrips + " calls=" + calls + " idle=" + idleSeconds + "s");
+        System.out.println("#java=" + System.getProperty("java.version") + " vm=" + System.getProperty("java.vm.name") +
+                           " os=" + System.getProperty("os.name") + " " + System.getProperty("os.version") +
+                           " arch=" + System.getProperty("os.arch") + " native=" + SerialNativeInterface.getNativeLibraryVersion() +
+                           " cpus=" + Runtime.getRuntime().availableProcessors());
+        System.out.println("#name\tunit\tmedian\tmin\tmax");
+    }
+
+    private void runSuite() throws Exception {
+        for(int run = -warmupRuns; run < runs; run++){
+            boolean measured = (run >= 0);
+            for(int blockSize : BLOCK_SIZES){
+                measureThroughput(blockSize, measured);
+            }
+            measureRoundTrips(measured);
+            measureNativeCalls(measured);
+            measureIdleEvents(measured);
+        }
+        for(int blockSize : BLOCK_SIZES){
+            report("throughput." + blockSize, "MB/s");
+        }
+        for(String name : new String[]{"array", "readBytes", "stream", "frame"}){
+            report("roundtrip." + MESSAGE_SIZE + "." + name + ".mean", "us");
+            report("roundtrip." + MESSAGE_SIZE + "." + name + ".p99", "us");
+            report("roundtrip." + MESSAGE_SIZE + "." + name + ".alloc", "bytes/op");
+        }
+        report("jni.getInputBufferBytesCount", "ns/call");
+        report("jni.readAvailable.empty", "ns/call");
+        report("events.idle.cpu", "ms/s");
+    }
+
+    private void record(String name, boolean measured, double value) {
+        if(!measured){
+            return;
+        }
+        double[] values = results.get(name);
+        if(values == null){
+            values = new double[0];
+        }
+        values = Arrays.copyOf(values, values.length + 1);
+        values[values.length - 1] = value;
+        results.put(name, values);
+    }
+
+    private void report(String name, String unit) {
+        double[] values = results.get(name);
+        if(values == null){
+            System.out.println(name + "\t" + unit + "\tn/a\tn/a\tn/a");
+            return;
+        }
+        Arrays.sort(values);
+        System.out.println(String.format("%s\t%s\t%.3f\t%.3f\t%.3f", name, unit, values[values.length / 2], values[0], values[values.length - 1]));
+    }
+
+    /**
+     * Stream bytes through the loopback with blocks of blockSize bytes, written from
+     * another thread
+     */
+    private void measureThroughput(final int blockSize, boolean measured) throws Exception {
+        final byte[] block = new byte[blockSize];
+        new Random(blockSize).nextBytes(block);
+        final int blockCount = bytes / blockSize;
+        final SerialPortException[] failure = new SerialPortException[1];
+        Thread writer = new Thread("SerialBenchmarkWriter") {
+            @Override
+            public void run() {
+                try {
+                    for(int i = 0; i < blockCount; i++){
+                        serialPort.writeBytes(block, 0, blockSize);
+                    }
+                }
+                catch (SerialPortException ex) {
+                    failure[0] = ex;
+                }
+            }
+        };
+        byte[] buffer = new byte[blockSize];
+        long start = System.nanoTime();
+        writer.start();
+        for(int i = 0; i < blockCount; i++){
+            serialPort.readBytesWithTimeout(buffer, 0, blockSize, TIMEOUT_MILLIS, true);
+        }
+        writer.join();
+        long elapsed = System.nanoTime() - start;
+        if(failure[0] != null){
+            throw failure[0];
+        }
+        record("throughput." + blockSize, measured, (double)blockCount * blockSize * 1000 / elapsed);
+    }
+
+    private void measureRoundTrips(boolean measured) throws Exception {
+        final byte[] message = new byte[MESSAGE_SIZE];
+        Arrays.fill(message, (byte)0x55);
+        final byte[] frame = message.clone();
+        frame[MESSAGE_SIZE - 1] = '\n';
+        final byte[] delimiter = {'\n'};
+        final byte[] reply = new byte[64];
+        final SerialInputStream stream = new SerialInputStream(serialPort);
+        measureRoundTrip("array", measured, new Operation() {
+            public void run() throws Exception {
+                serialPort.writeBytes(message, 0, MESSAGE_SIZE);
+                serialPort.readBytesWithTimeout(reply, 0, MESSAGE_SIZE, TIMEOUT_MILLIS, true);
+            }
+        });
+        measureRoundTrip("readBytes", measured, new Operation() {
+            public void run() throws Exception {
+                serialPort.writeBytes(message);
+                serialPort.readBytes(MESSAGE_SIZE, TIMEOUT_MILLIS);
+            }
+        });
+        measureRoundTrip("stream", measured, new Operation() {
+            public void run() throws Exception {
+                serialPort.writeBytes(message, 0, MESSAGE_SIZE);
+                stream.blockingRead(reply, 0, MESSAGE_SIZE, TIMEOUT_MILLIS);
+            }
+        });
+        measureRoundTrip("frame", measured, new Operation() {
+            public void run() throws Exception {
+                serialPort.writeBytes(frame, 0, MESSAGE_SIZE);
+                serialPort.readUntil(delimiter, reply, 0, reply.length, TIMEOUT_MILLIS, true);
+            }
+        });
+    }
+
+    private void measureRoundTrip(String name, boolean measured, Operation operation) throws Exception {
+        long[] samples = new long[roundTrips];
+        long allocated = getAllocatedBytes();
+        for(int i = 0; i < roundTrips; i++){
+            long start = System.nanoTime();
+            operation.run();
+            samples[i] = System.nanoTime() - start;
+        }
+        long allocatedAfter = getAllocatedBytes();
+        long total = 0;
+        for(long sample : samples){
+            total += sample;
+        }
+        Arrays.sort(samples);
+        String prefix = "roundtrip." + MESSAGE_SIZE + "." + name;
+        record(prefix + ".mean", measured, total / 1000.0 / roundTrips);
+        record(prefix + ".p99", measured, samples[roundTrips * 99 / 100] / 1000.0);
+        if(allocated >= 0 && allocatedAfter >= 0){
+            record(prefix + ".alloc", measured, (double)(allocatedAfter - allocated) / roundTrips);
+        }
+    }
+
+    /**
+     * Cost of a native call without transfer, the port being idle
+     */
+    private void measureNativeCalls(boolean measured) throws Exception {
+        serialPort.purgePort(SerialPort.PURGE_RXCLEAR);
+        byte[] buffer = new byte[MESSAGE_SIZE];
+        long start = System.nanoTime();
+        for(int i = 0; i < calls; i++){
+            serialPort.getInputBufferBytesCount();
+        }
+        record("jni.getInputBufferBytesCount", measured, (double)(System.nanoTime() - start) / calls);
+        start = System.nanoTime();
+        for(int i = 0; i < calls; i++){
+            serialPort.readAvailable(buffer, 0, MESSAGE_SIZE);
+        }
+        record("jni.readAvailable.empty", measured, (double)(System.nanoTime() - start) / calls);
+    }
+
+    /**
+     * CPU used by the threads of jSSC while an event listener waits on an idle line
+     */
+    private void measureIdleEvents(boolean measured) throws Exception {
+        ThreadMXBean threads = ManagementFactory.getThreadMXBean();
+        if(!threads.isThreadCpuTimeSupported()){
+            return;
+        }
+        threads.setThreadCpuTimeEnabled(true);
+        long[] before = getThreadCpuTimes(threads);
+        serialPort.addEventListener(new SerialPortEventListener() {
+            public void serialEvent(SerialPortEvent event) {
+            }
+        }, SerialPort.MASK_RXCHAR | SerialPort.MASK_CTS | SerialPort.MASK_DSR | SerialPort.MASK_RLSD);
+        long start = System.nanoTime();
+        Thread.sleep(idleSeconds * 1000L);
+        long[] after = getThreadCpuTimes(threads);
+        long elapsed = System.nanoTime() - start;
+        serialPort.removeEventListener();
+        long cpu = 0;
+        for(int i = 0; i < after.length; i += 2){
+            long previous = 0;
+            for(int j = 0; j < before.length; j += 2){
+                if(before[j] == after[i]){
+                    previous = before[j + 1];
+                    break;
+                }
+            }
+            cpu += after[i + 1] - previous;
+        }
+        record("events.idle.cpu", measured, (double)cpu / 1000000 / (elapsed / 1e9));
+    }
+
+    /**
+     * Pairs of thread id and CPU time of the threads other than the current one
+     */
+    private static long[] getThreadCpuTimes(ThreadMXBean threads) {
+        long[] ids = threads.getAllThreadIds();
+        long[] times = new long[ids.length * 2];
+        int count = 0;
+        long currentId = Thread.currentThread().getId();
+        for(long id : ids){
+            long time = threads.getThreadCpuTime(id);
+            if(id != currentId && time >= 0){
+                times[count++] = id;
+                times[count++] = time;
+            }
+        }
+        return Arrays.copyOf(times, count);
+    }
+
+    private static Method allocatedBytesMethod = null;
+    private static boolean allocatedBytesResolved = false;
+
+    /**
+     * Bytes allocated by the current thread, -1 if the VM can't tell
+     */
+    private static long getAllocatedBytes() {
+        ThreadMXBean threads = ManagementFactory.getThreadMXBean();
+        try {
+            if(!allocatedBytesResolved){
+                allocatedBytesResolved = true;
+                Class<?> sunThreads = Class.forName("com.sun.management.ThreadMXBean");
+                if(sunThreads.isInstance(threads)){
+                    allocatedBytesMethod = sunThreads.getMethod("getThreadAllocatedBytes", long.class);
+                }
+            }
+            if(allocatedBytesMethod != null){
+                return (Long)allocatedBytesMethod.invoke(threads, Thread.currentThread().getId());
+            }
+        }
+        catch (Exception ex) {
+            allocatedBytesMethod = null;
+        }
+        return -1;
+    }
+}
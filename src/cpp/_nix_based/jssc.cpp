@@ -29,29 +29,959 @@
 #include <termios.h>
 #include <time.h>
 #include <errno.h>//-D_TS_ERRNO use for Solaris C++ compiler
+#include <stdint.h>//since 2.9.0 for intptr_t
+#include <sys/uio.h>//since 2.9.0 for writev()
 
 #include <sys/select.h>//since 2.5.0
 #include <sys/time.h>	//For timeouts to select()
 
 #ifdef __linux__
     #include <linux/serial.h>
+    #include <sys/stat.h>//since 2.9.0 for the latency timer of FTDI adapters
+    #include <sys/sysmacros.h>
+    #include <sys/epoll.h>//since 2.9.0 for SerialPortSelector
+    #define JSSC_SELECTOR_EPOLL
+    #include <sys/socket.h>//since 2.9.0 for the hot-plug watcher
+    #include <linux/netlink.h>
+#elif defined __APPLE__ || defined __FreeBSD__ || defined __NetBSD__ || defined __OpenBSD__
+    #include <sys/event.h>//since 2.9.0 for SerialPortSelector
+    #define JSSC_SELECTOR_KQUEUE
 #endif
+#include <poll.h>//since 2.9.0 for SerialPortSelector and the event waiter
+#include <pthread.h>
+#include <signal.h>//since 2.9.0 to interrupt TIOCMIWAIT
+#include <string.h>
+#include <new>//since 2.9.0 for std::nothrow
+#include <dirent.h>//since 2.9.0 for the port enumeration
+#include <sched.h>//since 2.9.0 for sched_yield() and the scheduling of the reader threads
+#include <sys/mman.h>//since 2.9.0 for the memory of the input rings
 #ifdef __SunOS
     #include <sys/filio.h>//Needed for FIONREAD in Solaris
     #include <string.h>//Needed for select() function
 #endif
+#if defined __linux__ && defined TCGETS2 && !defined __powerpc__ && !defined __mips__ && !defined __sparc__ && !defined __alpha__
+    //since 2.9.0 for non standard baud rates. The layout of <asm-generic/termbits.h>, which
+    //can't be included together with <termios.h>
+    struct termios2 {
+        tcflag_t c_iflag;
+        tcflag_t c_oflag;
+        tcflag_t c_cflag;
+        tcflag_t c_lflag;
+        cc_t c_line;
+        cc_t c_cc[19];
+        speed_t c_ispeed;
+        speed_t c_ospeed;
+    };
+    #ifndef BOTHER
+        #define BOTHER 0010000
+    #endif
+    #define JSSC_TERMIOS2
+#endif
 #ifdef __APPLE__
     #include <serial/ioss.h>//Needed for IOSSIOSPEED in Mac OS X (Non standard baudrate)
     #include <mach/clock.h>
     #include <mach/mach.h>
+    #include <CoreFoundation/CoreFoundation.h>//since 2.9.0 for the port enumeration
+    #include <IOKit/IOKitLib.h>
+    #include <IOKit/serial/IOSerialKeys.h>
 #endif
 
 #include <jni.h>
 #include "../jssc_SerialNativeInterface.h"
 #include "../jssc_Common.h"
+#include "../jssc_Checksum.h"
+#include "../jssc_Capture.h"//since 2.9.0
 
 //#include <iostream> //-lCstd use for Solaris linker
 
+/*
+ * Input ring of the buffered mode (since 2.9.0)
+ *
+ * Filled by a reader thread which drains the port continuously (see inputReaderThread())
+ * and emptied by the readBytes* functions. head and tail are free running counters,
+ * head is only written by the reader thread and tail by the reading java thread, so
+ * the data itself is exchanged without locks. A reading thread blocks on notifyPipe,
+ * which holds a byte while dataSignalled is set, the reader thread blocks on
+ * controlPipe while the ring is full.
+ */
+#define INPUT_RING_MIN_CAPACITY 4096
+#define INPUT_RING_MAX_CAPACITY (64 * 1024 * 1024)
+
+#define ringLoad(field) __atomic_load_n(&(field), __ATOMIC_SEQ_CST)
+#define ringStore(field, value) __atomic_store_n(&(field), (value), __ATOMIC_SEQ_CST)
+#define ringExchange(field, value) __atomic_exchange_n(&(field), (value), __ATOMIC_SEQ_CST)
+
+struct InputRing {
+    jbyte *data;
+    unsigned int capacity;          //Power of two
+    unsigned int head;              //Count of bytes stored
+    unsigned int tail;              //Count of bytes consumed, written with consumerLock held
+    int dataSignalled;              //Set while notifyPipe holds a byte
+    int spaceWanted;                //Set while the reader thread waits for free space
+    int stopRequested;
+    int running;                    //Cleared by the reader thread when it exits
+    int notifyPipe[2];
+    int controlPipe[2];
+    pthread_mutex_t consumerLock;   //Taken by the reading threads
+    pthread_t thread;
+    char threadStarted;             //Guarded by inputReadersLock
+    char memoryLocked;              //Guarded by inputReadersLock, see lockInputRing()
+};
+
+//Count of ports having an input ring, the read functions skip the context lookup while it is 0
+static int inputRingsCount = 0;
+
+//Serializes starting and stopping the reader threads
+static pthread_mutex_t inputReadersLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void signalPipe(int fd) {
+    char signal = 0;
+    if(write(fd, &signal, 1) < 0){
+        //The pipe is full, it is readable anyway
+    }
+}
+
+static void drainPipe(int fd) {
+    char drain[16];
+    while(read(fd, drain, sizeof(drain)) > 0){
+        //Drain the pipe
+    }
+}
+
+static int openNonBlockingPipe(int fds[2]) {
+    if(pipe(fds) != 0){
+        return -1;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    return 0;
+}
+
+static void freeInputRing(InputRing *ring) {
+    if(ring->threadStarted){
+        //Only possible for a port whose descriptor has been closed without "_closePort"
+        pthread_detach(ring->thread);
+    }
+    close(ring->notifyPipe[0]);
+    close(ring->notifyPipe[1]);
+    close(ring->controlPipe[0]);
+    close(ring->controlPipe[1]);
+    pthread_mutex_destroy(&ring->consumerLock);
+    munmap(ring->data, ring->capacity);//Unlocks the pages
+    delete ring;
+}
+
+/*
+ * Create a ring of at least capacity bytes (rounded up to a power of two), returns NULL
+ * on failure
+ */
+static InputRing* newInputRing(jint capacity) {
+    unsigned int size = INPUT_RING_MIN_CAPACITY;
+    while(size < (unsigned int)capacity && size < INPUT_RING_MAX_CAPACITY){
+        size <<= 1;
+    }
+    InputRing *ring = new InputRing();
+    //Whole pages of its own, so the ring can be locked in memory without its neighbours
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if(data == MAP_FAILED){
+        delete ring;
+        return NULL;
+    }
+    ring->data = (jbyte*)data;
+    if(openNonBlockingPipe(ring->notifyPipe) != 0){
+        munmap(data, size);
+        delete ring;
+        return NULL;
+    }
+    if(openNonBlockingPipe(ring->controlPipe) != 0){
+        close(ring->notifyPipe[0]);
+        close(ring->notifyPipe[1]);
+        munmap(data, size);
+        delete ring;
+        return NULL;
+    }
+    ring->capacity = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dataSignalled = 0;
+    ring->spaceWanted = 0;
+    ring->stopRequested = 0;
+    ring->running = 0;
+    ring->threadStarted = 0;
+    ring->memoryLocked = 0;
+    pthread_mutex_init(&ring->consumerLock, NULL);
+    return ring;
+}
+
+/*
+ * Statistics of the reads and writes (since 2.9.0)
+ *
+ * Every read and write counts its system calls, wakeups and bytes in its PortIO and adds
+ * them to the statistics of the port context when it ends (see endPortIO()), under the
+ * lock of the context endPortIO() takes anyway. No 64 bit atomics are used: on the 32
+ * bit targets they would need libatomic, which the library isn't linked with. The
+ * indexes are those of the array returned by "_getStatistics", see SerialPortStatistics.
+ * The read latency is the time from the first wakeup of a read with data to its return,
+ * its histogram counts in bucket i the latencies below 2^i micro seconds and above the
+ * previous bucket. The error counters come from TIOCGICOUNT.
+ */
+#define STAT_BYTES_READ         0
+#define STAT_BYTES_WRITTEN      1
+#define STAT_READ_CALLS         2   //read() calls, or reads from the input ring
+#define STAT_WRITE_CALLS        3   //write() and writev() calls
+#define STAT_WAKEUPS            4   //select() returning the port or the ring ready
+#define STAT_TIMEOUTS           5
+#define STAT_PARTIAL_WRITES     6   //Writes accepted only in part by the driver
+#define STATS_IO_COUNTERS       7   //Counted by PortIO
+#define STAT_LATENCY_COUNT      7
+#define STAT_LATENCY_TOTAL      8   //Micro seconds
+#define STAT_LATENCY_MAX        9
+#define STAT_OVERRUNS           10  //Hardware overruns
+#define STAT_BUFFER_OVERRUNS    11  //Overruns of the tty buffer
+#define STAT_FRAMING_ERRORS     12
+#define STAT_PARITY_ERRORS      13
+#define STAT_BREAKS             14
+#define STATS_COUNTERS          15
+#define STATS_LATENCY_BUCKETS   32
+#define STATS_LENGTH (STATS_COUNTERS + STATS_LATENCY_BUCKETS)
+
+struct PortStats {
+    unsigned long long counters[STATS_COUNTERS];    //The error counters are the TIOCGICOUNT base
+    unsigned long long latency[STATS_LATENCY_BUCKETS];
+    unsigned long long frameErrors;                 //Added to the framing errors of TIOCGICOUNT, see readFrameToTarget()
+};
+
+/*
+ * Port contexts (since 2.9.0)
+ *
+ * Native state of an opened port, created by "_openPort" and removed by "_closePort".
+ * Contexts are found by port handle and reference counted, so a context still used by
+ * another thread (the event waiter) stays valid after the port has been closed. Each
+ * context has a lock of its own, the reads and writes of different ports never meet.
+ *
+ * Reads and writes go straight between the port and the java memory (see readToTarget()
+ * and writeFromSource()), so unlike on Windows the context needs no transfer buffers. The
+ * input ring is only created by the first "_bufferedReaderStart" or framed read.
+ */
+struct PortContext {
+    int fd;
+    int refCount;           //Changed with atomics
+    pthread_mutex_t lock;   //Guards the fields below unless said otherwise
+    jint eventsMask;        //Set by "_setEventsMask"
+    int eventsWakeupFd;     //Write end of the wakeup pipe of the event waiter, or -1
+    termios settings;       //Settings of the port, read back after every change
+    InputRing *ring;        //Set once, by "_bufferedReaderStart" or a framed read, or NULL. Also read with atomics
+    int cancelPipe[2];      //Readable while a cancellation is pending (see cancelPortIO()), or -1
+    unsigned int cancelGeneration;  //Incremented by every cancellation
+    int activeIOCount;      //Count of reads and writes in progress
+    int staleIOCount;       //Reads and writes started before the last cancellation and still running
+    char closing;           //Set by "_closePort", the cancelled reads and writes then fail with PORT_NOT_OPENED
+    PortStats stats;
+    char rs485Mode;         //RS485_MODE_*, set by "_setRS485" with the fields below
+    char rs485RtsOnSend;    //Software direction control: RTS level while sending
+    int rs485DelayBefore;   //Milliseconds between raising RTS and the first byte
+    int rs485DelayAfter;    //Milliseconds between the last byte and dropping RTS
+    CaptureRing *capture;   //Set by "_captureStart" or NULL, read with atomics (see capturePortData())
+    int captureUsers;       //Threads writing to capture
+    char lowLatency;        //Last mode applied by "_setLowLatency" or "_configure", -1 before, read with atomics
+    jlong readerCpuMask;    //Set by "_setReaderScheduling" with the fields below, guarded by inputReadersLock
+    jint readerPriority;
+    char readerMemoryLocked;
+    PortContext *next;      //Next context of the same slot of portContextTable, read with atomics
+};
+
+/*
+ * The contexts are kept in a table hashed by port handle, which the lookups walk without
+ * lock. A lookup is counted in its slot while it walks the chain and takes its reference:
+ * a context unlinked by "_closePort" is only released once the lookups of its slot are
+ * done, so no lookup meets a freed context. portContextsLock only serializes the changes
+ * of the table, by "_openPort" and "_closePort". Each slot has a cache line to itself so
+ * the lookups of different ports don't share one.
+ */
+#define PORT_CONTEXT_SLOTS 256
+
+struct PortContextSlot {
+    PortContext *first;     //Read and written with atomics
+    int lookups;            //Lookups walking the chain of the slot
+    char padding[64 - sizeof(PortContext*) - sizeof(int)];
+};
+
+static pthread_mutex_t portContextsLock = PTHREAD_MUTEX_INITIALIZER;
+static PortContextSlot portContextTable[PORT_CONTEXT_SLOTS];
+
+static PortContextSlot* getPortContextSlot(int fd) {
+    return &portContextTable[(unsigned int)fd % PORT_CONTEXT_SLOTS];
+}
+
+/*
+ * Unlink the context of a port from the table, must be called with portContextsLock
+ * held. Returns the unlinked context, which no lookup uses anymore, or NULL.
+ */
+static PortContext* unlinkPortContext(int fd) {
+    PortContextSlot *slot = getPortContextSlot(fd);
+    for(PortContext **link = &slot->first; *link != NULL; link = &(*link)->next){
+        if((*link)->fd == fd){
+            PortContext *context = *link;
+            ringStore(*link, context->next);
+            while(ringLoad(slot->lookups) != 0){
+                sched_yield();//A lookup may be on the context, it only has a few loads to do
+            }
+            context->next = NULL;
+            return context;
+        }
+    }
+    return NULL;
+}
+
+static void releasePortContext(PortContext *context) {
+    if(__atomic_sub_fetch(&context->refCount, 1, __ATOMIC_SEQ_CST) == 0){
+        if(context->ring != NULL){
+            freeInputRing(context->ring);
+            __atomic_sub_fetch(&inputRingsCount, 1, __ATOMIC_SEQ_CST);
+        }
+        if(context->cancelPipe[0] != -1){
+            close(context->cancelPipe[0]);
+            close(context->cancelPipe[1]);
+        }
+        if(context->capture != NULL){
+            captureClose(context->capture);
+        }
+        pthread_mutex_destroy(&context->lock);
+        delete context;
+    }
+}
+
+static void createPortContext(int fd, const termios *settings) {
+    PortContext *context = new PortContext();
+    context->fd = fd;
+    context->settings = *settings;
+    context->refCount = 1;//Owned by the table
+    pthread_mutex_init(&context->lock, NULL);
+    context->eventsMask = 0;
+    context->eventsWakeupFd = -1;
+    context->ring = NULL;
+    if(openNonBlockingPipe(context->cancelPipe) != 0){
+        //The I/O of the port then can't be cancelled, it still times out and checks interruption
+        context->cancelPipe[0] = -1;
+        context->cancelPipe[1] = -1;
+    }
+    context->cancelGeneration = 0;
+    context->activeIOCount = 0;
+    context->staleIOCount = 0;
+    context->closing = 0;
+    memset(&context->stats, 0, sizeof(PortStats));
+    context->rs485Mode = 0;
+    context->rs485RtsOnSend = 1;
+    context->rs485DelayBefore = 0;
+    context->rs485DelayAfter = 0;
+    context->capture = NULL;
+    context->captureUsers = 0;
+    context->lowLatency = -1;
+    context->readerCpuMask = 0;
+    context->readerPriority = 0;
+    context->readerMemoryLocked = 0;
+#ifdef TIOCGICOUNT
+    struct serial_icounter_struct icount;
+    if(ioctl(fd, TIOCGICOUNT, &icount) >= 0){
+        //The driver counts since it was loaded
+        context->stats.counters[STAT_OVERRUNS] = (unsigned int)icount.overrun;
+        context->stats.counters[STAT_BUFFER_OVERRUNS] = (unsigned int)icount.buf_overrun;
+        context->stats.counters[STAT_FRAMING_ERRORS] = (unsigned int)icount.frame;
+        context->stats.counters[STAT_PARITY_ERRORS] = (unsigned int)icount.parity;
+        context->stats.counters[STAT_BREAKS] = (unsigned int)icount.brk;
+    }
+#endif
+    pthread_mutex_lock(&portContextsLock);
+    PortContext *stale = unlinkPortContext(fd);//Left by a descriptor closed without "_closePort"
+    if(stale != NULL){
+        releasePortContext(stale);
+    }
+    PortContextSlot *slot = getPortContextSlot(fd);
+    context->next = slot->first;
+    ringStore(slot->first, context);
+    pthread_mutex_unlock(&portContextsLock);
+}
+
+static void removePortContext(int fd) {
+    pthread_mutex_lock(&portContextsLock);
+    PortContext *context = unlinkPortContext(fd);
+    pthread_mutex_unlock(&portContextsLock);
+    if(context != NULL){
+        releasePortContext(context);
+    }
+}
+
+/*
+ * Find the context of an opened port and take a reference on it, returns NULL if the
+ * port is not opened. The reference must be given back with releasePortContext().
+ */
+static PortContext* acquirePortContext(jlong portHandle) {
+    PortContextSlot *slot = getPortContextSlot((int)portHandle);
+    __atomic_add_fetch(&slot->lookups, 1, __ATOMIC_SEQ_CST);
+    PortContext *context = ringLoad(slot->first);
+    while(context != NULL && context->fd != (int)portHandle){
+        context = ringLoad(context->next);
+    }
+    if(context != NULL){
+        __atomic_add_fetch(&context->refCount, 1, __ATOMIC_SEQ_CST);
+    }
+    __atomic_sub_fetch(&slot->lookups, 1, __ATOMIC_SEQ_CST);
+    return context;
+}
+
+/*
+ * Append the bytes just transferred to the capture of the port, if it has one (since
+ * 2.9.0). Without capture this is a single atomic load. "_captureStop" clears the
+ * pointer, then waits for captureUsers to drop to 0 before closing the capture.
+ */
+static void capturePortData(PortContext *context, int direction, const void *data, jint length) {
+    if(context == NULL || length <= 0 || ringLoad(context->capture) == NULL){
+        return;
+    }
+    __atomic_add_fetch(&context->captureUsers, 1, __ATOMIC_SEQ_CST);
+    CaptureRing *capture = ringLoad(context->capture);
+    if(capture != NULL){
+        captureBytes(capture, direction, data, (size_t)length);
+    }
+    __atomic_sub_fetch(&context->captureUsers, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Get the settings of a port from its context, without a tcgetattr() call if the port
+ * has one. Returns 0 on success.
+ */
+static int getPortSettings(jlong portHandle, termios *settings) {
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return tcgetattr(portHandle, settings);
+    }
+    pthread_mutex_lock(&context->lock);
+    *settings = context->settings;
+    pthread_mutex_unlock(&context->lock);
+    releasePortContext(context);
+    return 0;
+}
+
+/*
+ * Read the settings of a port back into its context, after they have been changed
+ */
+static void refreshPortSettings(jlong portHandle) {
+    termios applied;
+    PortContext *context = acquirePortContext(portHandle);
+    if(context != NULL){
+        if(tcgetattr(portHandle, &applied) == 0){
+            pthread_mutex_lock(&context->lock);
+            context->settings = applied;
+            pthread_mutex_unlock(&context->lock);
+        }
+        releasePortContext(context);
+    }
+}
+
+/*
+ * Apply new settings to a port and update its context. The settings are read back,
+ * since the driver may not support all of them. Returns 0 on success.
+ */
+static int setPortSettings(jlong portHandle, const termios *settings) {
+    if(tcsetattr(portHandle, TCSANOW, settings) != 0){
+        return -1;
+    }
+    refreshPortSettings(portHandle);
+    return 0;
+}
+
+/*
+ * Cancellation of blocking reads and writes (since 2.9.0)
+ *
+ * Every read and write waits in select() on the cancel pipe of its port context besides
+ * the port, so it can block without a timeout and still be stopped at once by "_cancelIO"
+ * or "_closePort". cancelPortIO() increments the generation of the context and leaves a
+ * byte in the pipe, an operation is cancelled when the generation differs from the one
+ * it started with. The pipe is drained by the last of these operations to finish; the
+ * operations started meanwhile don't wait on it, they recheck every CANCEL_RECHECK_MICROS
+ * instead until it is drained.
+ */
+#define CANCEL_RECHECK_MICROS 1000
+
+struct PortIO {
+    PortContext *context;           //NULL if the port has no context
+    unsigned int generation;        //Cancel generation when the operation started
+    unsigned long long counts[STATS_IO_COUNTERS];  //Added to the statistics of the context by endPortIO()
+    jlong readyMicros;              //Time of the first wakeup with data of a read, or 0
+    unsigned int frameErrors;       //Frame headers with a wrong length skipped by a framed read
+};
+
+static void beginPortIO(jlong portHandle, PortIO *io) {
+    io->generation = 0;
+    memset(io->counts, 0, sizeof(io->counts));
+    io->readyMicros = 0;
+    io->frameErrors = 0;
+    io->context = acquirePortContext(portHandle);
+    if(io->context != NULL){
+        //The reads and writes of the port only meet here and in endPortIO()
+        pthread_mutex_lock(&io->context->lock);
+        io->context->activeIOCount++;
+        io->generation = io->context->cancelGeneration;
+        pthread_mutex_unlock(&io->context->lock);
+    }
+}
+
+/*
+ * Note the wakeup of an operation by its port or ring becoming ready
+ */
+static void markPortIOReady(PortIO *io, char withData) {
+    io->counts[STAT_WAKEUPS]++;
+    if(withData && io->readyMicros == 0){
+        io->readyMicros = getTimePreciseMicros();
+    }
+}
+
+/*
+ * Add the counts of an operation ended at endMicros to the statistics of its port, must
+ * be called with the lock of the context held
+ */
+static void addPortIOStatsLocked(PortIO *io, jlong endMicros) {
+    PortStats *stats = &io->context->stats;
+    for(int i = 0; i < STATS_IO_COUNTERS; i++){
+        stats->counters[i] += io->counts[i];
+    }
+    stats->frameErrors += io->frameErrors;
+    if(io->readyMicros != 0 && io->counts[STAT_BYTES_READ] != 0){
+        unsigned long long latency = (unsigned long long)(endMicros - io->readyMicros);
+        int bucket = 0;
+        while(bucket < STATS_LATENCY_BUCKETS - 1 && (latency >> bucket) != 0){
+            bucket++;
+        }
+        stats->latency[bucket]++;
+        stats->counters[STAT_LATENCY_COUNT]++;
+        stats->counters[STAT_LATENCY_TOTAL] += latency;
+        if(latency > stats->counters[STAT_LATENCY_MAX]){
+            stats->counters[STAT_LATENCY_MAX] = latency;
+        }
+    }
+}
+
+static void endPortIO(PortIO *io) {
+    PortContext *context = io->context;
+    if(context == NULL){
+        return;
+    }
+    jlong endMicros = (io->readyMicros != 0 ? getTimePreciseMicros() : 0);//Out of the lock
+    pthread_mutex_lock(&context->lock);
+    addPortIOStatsLocked(io, endMicros);
+    context->activeIOCount--;
+    if(io->generation != context->cancelGeneration && __atomic_sub_fetch(&context->staleIOCount, 1, __ATOMIC_SEQ_CST) == 0){
+        drainPipe(context->cancelPipe[0]);
+    }
+    pthread_mutex_unlock(&context->lock);
+    releasePortContext(context);
+    io->context = NULL;
+}
+
+static char isPortIOCancelled(PortIO *io) {
+    //The operations started while the port is closing are cancelled too
+    return (io->context != NULL &&
+            (ringLoad(io->context->cancelGeneration) != io->generation || ringLoad(io->context->closing)));
+}
+
+/*
+ * Fail the reads and writes in progress on the port of the context. Returns JNI_TRUE if
+ * there was any.
+ */
+static jboolean cancelPortIO(PortContext *context) {
+    jboolean cancelled = JNI_FALSE;
+    pthread_mutex_lock(&context->lock);
+    if(context->activeIOCount > 0 && context->cancelPipe[0] != -1){
+        ringStore(context->cancelGeneration, context->cancelGeneration + 1);
+        //Every operation in progress is now stale, including those of earlier cancellations
+        ringStore(context->staleIOCount, context->activeIOCount);
+        signalPipe(context->cancelPipe[1]);
+        cancelled = JNI_TRUE;
+    }
+    pthread_mutex_unlock(&context->lock);
+    return cancelled;
+}
+
+/*
+ * Wait for the reads and writes of a closing port to return, so its descriptor isn't
+ * closed (and maybe reused by another port) while they still use it. They notice the
+ * cancellation at their next wakeup, which the cancel pipe makes immediate, the wait is
+ * bounded for the calls which can't be woken up (tcdrain() fallback, no cancel pipe).
+ */
+#define CLOSE_IO_WAIT_MICROS 2000000
+
+static void waitPortIODone(PortContext *context) {
+    jlong deadline = getTimePreciseMicros() + CLOSE_IO_WAIT_MICROS;
+    for(;;){
+        pthread_mutex_lock(&context->lock);
+        int activeIOCount = context->activeIOCount;
+        pthread_mutex_unlock(&context->lock);
+        if(activeIOCount == 0 || getTimePreciseMicros() >= deadline){
+            break;
+        }
+        struct timespec pause;
+        pause.tv_sec = 0;
+        pause.tv_nsec = CANCEL_RECHECK_MICROS * 1000L;
+        nanosleep(&pause, NULL);
+    }
+}
+
+static void throwPortIOCancelled(JNIEnv *env, PortIO *io, const char *methodName) {
+    throwSerialException(env, "NoPort", methodName,
+                         (ringLoad(io->context->closing) ? SP_EXCEPTION_TYPE_PORT_NOT_OPENED : SP_EXCEPTION_TYPE_IO_CANCELLED));
+}
+
+/*
+ * select() for fd to become readable (writable if forWrite is set) or the operation to be
+ * cancelled, timeout is NULL to wait indefinitely. fd -1 only waits for the cancellation
+ * or the timeout. Returns as select() without counting the cancel pipe: the caller checks
+ * isPortIOCancelled() first.
+ */
+static int selectPortIO(PortIO *io, int fd, char forWrite, struct timeval *timeout) {
+    fd_set fdSet;
+    fd_set cancelSet;
+    struct timeval recheck;
+    int cancelFd = -1;
+    if(isPortIOCancelled(io)){
+        return 0;
+    }
+    FD_ZERO(&fdSet);
+    if(fd != -1){
+        FD_SET(fd, &fdSet);
+    }
+    FD_ZERO(&cancelSet);
+    if(io->context != NULL && io->context->cancelPipe[0] != -1){
+        if(ringLoad(io->context->staleIOCount) == 0){
+            cancelFd = io->context->cancelPipe[0];
+            FD_SET(cancelFd, (forWrite ? &cancelSet : &fdSet));
+        }
+        else if(timeout == NULL || timeout->tv_sec > 0 || timeout->tv_usec > CANCEL_RECHECK_MICROS){
+            //The pipe still holds the byte of an earlier cancellation
+            recheck.tv_sec = 0;
+            recheck.tv_usec = CANCEL_RECHECK_MICROS;
+            timeout = &recheck;
+        }
+    }
+    int maxFd = (cancelFd > fd ? cancelFd : fd);
+    int result = (forWrite ? select(maxFd + 1, &cancelSet, &fdSet, NULL, timeout) :
+                             select(maxFd + 1, &fdSet, NULL, NULL, timeout));
+    if(result > 0 && cancelFd != -1 && FD_ISSET(cancelFd, (forWrite ? &cancelSet : &fdSet))){
+        result--;
+    }
+    return result;
+}
+
+/*
+ * Find the context of a port in buffered mode and take a reference on it, returns NULL
+ * if the port has no input ring
+ */
+static PortContext* acquireBufferedContext(jlong portHandle) {
+    if(ringLoad(inputRingsCount) == 0){
+        return NULL;
+    }
+    PortContext *context = acquirePortContext(portHandle);
+    if(context != NULL && ringLoad(context->ring) == NULL){
+        releasePortContext(context);
+        context = NULL;
+    }
+    return context;
+}
+
+/*
+ * Count of bytes in the input ring of a port, 0 if it has none
+ */
+static jint getInputRingBytesCount(jlong portHandle) {
+    PortContext *context = acquireBufferedContext(portHandle);
+    if(context == NULL){
+        return 0;
+    }
+    InputRing *ring = context->ring;
+    jint count = (jint)(ringLoad(ring->head) - ringLoad(ring->tail));
+    releasePortContext(context);
+    return count;
+}
+
+/*
+ * Buffered mode (since 2.9.0)
+ *
+ * The reader thread waits for the port to become readable and moves whatever the driver
+ * holds into the input ring, so the kernel buffer is drained even while no java thread is
+ * reading. When the ring is full the port is left alone until a reading thread has made
+ * room, the driver then applies the flow control as without the buffered mode. On
+ * hangup or read error the thread exits, the reading threads then empty the ring and go
+ * back to reading the port directly.
+ */
+static void* inputReaderThread(void *arg) {
+    PortContext *context = (PortContext*)arg;
+    InputRing *ring = context->ring;
+    struct pollfd fds[2];
+    fds[0].fd = ring->controlPipe[0];
+    fds[0].events = POLLIN;
+    fds[1].events = POLLIN;
+    while(!ringLoad(ring->stopRequested)){
+        unsigned int head = ring->head;
+        unsigned int space = ring->capacity - (head - ringLoad(ring->tail));
+        if(space == 0){
+            //Ask for a wakeup before checking again, see readFromRing()
+            ringStore(ring->spaceWanted, 1);
+            space = ring->capacity - (head - ringLoad(ring->tail));
+        }
+        fds[1].fd = (space > 0 ? context->fd : -1);//A negative descriptor is ignored, even on hangup
+        if(poll(fds, 2, -1) == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            break;
+        }
+        if(fds[0].revents & POLLIN){
+            drainPipe(ring->controlPipe[0]);
+        }
+        if(fds[1].revents & POLLNVAL){
+            break;
+        }
+        if(space == 0 || !(fds[1].revents & (POLLIN | POLLERR | POLLHUP))){
+            continue;
+        }
+        unsigned int offset = head & (ring->capacity - 1);
+        unsigned int length = ring->capacity - offset;
+        if(length > space){
+            length = space;
+        }
+        ssize_t result = read(context->fd, ring->data + offset, length);
+        if(result > 0){
+            capturePortData(context, CAPTURE_READ, ring->data + offset, (jint)result);
+            ringStore(ring->head, head + (unsigned int)result);
+            if(ringExchange(ring->dataSignalled, 1) == 0){
+                signalPipe(ring->notifyPipe[1]);
+            }
+            //The event waiter samples the ring, it only has to be woken up if it has seen it empty
+            if(ringLoad(ring->tail) == head){
+                pthread_mutex_lock(&context->lock);
+                if(context->eventsWakeupFd != -1){
+                    signalPipe(context->eventsWakeupFd);
+                }
+                pthread_mutex_unlock(&context->lock);
+            }
+        }
+        else if(result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+            break;
+        }
+    }
+    ringStore(ring->running, 0);
+    //Wake up the reading threads, they go on with the port itself once the ring is empty
+    ringStore(ring->dataSignalled, 1);
+    signalPipe(ring->notifyPipe[1]);
+    releasePortContext(context);
+    return NULL;
+}
+
+/*
+ * Scheduling of the native threads (since 2.9.0)
+ *
+ * A thread can be restricted to the CPUs of a mask (bit n for CPU n, only on Linux), 0
+ * standing for the affinity of the process, and given a realtime priority: 1..99
+ * selects SCHED_FIFO, clamped to the range of the system, 0 the normal time sharing.
+ * Realtime priorities need CAP_SYS_NICE or an RLIMIT_RTPRIO large enough. The reader
+ * thread of a port is created with the scheduling set by "_setReaderScheduling", so it
+ * never runs elsewhere, and its ring can be locked in memory so its pages never fault
+ * while the thread drains the port.
+ */
+#define SCHEDULING_AFFINITY         1
+#define SCHEDULING_PRIORITY         2
+#define SCHEDULING_MEMORY_LOCKED    4
+
+#ifdef __linux__
+/*
+ * The CPUs of a mask, or of the process if the mask is 0. Returns 0 on success.
+ */
+static int getSchedulingCpus(jlong cpuMask, cpu_set_t *cpus) {
+    if(cpuMask == 0){
+        //The main thread has the affinity given to the process, by taskset for instance
+        return sched_getaffinity(getpid(), sizeof(cpu_set_t), cpus);
+    }
+    CPU_ZERO(cpus);
+    for(int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++){
+        if(cpuMask & ((jlong)1 << cpu)){
+            CPU_SET(cpu, cpus);
+        }
+    }
+    return 0;
+}
+#endif
+
+/*
+ * The policy and the parameters of a priority
+ */
+static int getSchedulingPolicy(jint priority, sched_param *param) {
+    memset(param, 0, sizeof(sched_param));
+    if(priority > 0){
+        int minimum = sched_get_priority_min(SCHED_FIFO);
+        int maximum = sched_get_priority_max(SCHED_FIFO);
+        param->sched_priority = (priority < minimum ? minimum : (priority > maximum ? maximum : priority));
+        return SCHED_FIFO;
+    }
+    param->sched_priority = sched_get_priority_min(SCHED_OTHER);
+    return SCHED_OTHER;
+}
+
+/*
+ * Apply a CPU mask and a priority to a running thread, returns the combination of
+ * SCHEDULING_* which could be applied
+ */
+static jint applyThreadScheduling(pthread_t thread, jlong cpuMask, jint priority) {
+    jint applied = 0;
+#ifdef __linux__
+    cpu_set_t cpus;
+    if(getSchedulingCpus(cpuMask, &cpus) == 0 && pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0){
+        applied |= SCHEDULING_AFFINITY;
+    }
+#endif
+    sched_param param;
+    int policy = getSchedulingPolicy(priority, &param);
+    if(pthread_setschedparam(thread, policy, &param) == 0){
+        applied |= SCHEDULING_PRIORITY;
+    }
+    return applied;
+}
+
+/*
+ * Create a thread with a CPU mask and a priority. If the system refuses them, a realtime
+ * priority without the privilege for instance, the thread is created with the scheduling
+ * of the calling thread instead. Returns 0 on success.
+ */
+static int createScheduledThread(pthread_t *thread, void* (*routine)(void*), void *arg, jlong cpuMask, jint priority) {
+    pthread_attr_t attributes;
+    if(pthread_attr_init(&attributes) == 0){
+        char scheduled = 1;
+    #ifdef __linux__
+        cpu_set_t cpus;
+        scheduled = (getSchedulingCpus(cpuMask, &cpus) == 0 && pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus) == 0);
+    #endif
+        sched_param param;
+        int policy = getSchedulingPolicy(priority, &param);
+        scheduled = (scheduled &&
+                     pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED) == 0 &&
+                     pthread_attr_setschedpolicy(&attributes, policy) == 0 &&
+                     pthread_attr_setschedparam(&attributes, &param) == 0);
+        int result = (scheduled ? pthread_create(thread, &attributes, routine, arg) : -1);
+        pthread_attr_destroy(&attributes);
+        if(result == 0){
+            return 0;
+        }
+    }
+    return pthread_create(thread, NULL, routine, arg);
+}
+
+/*
+ * Lock the pages of a ring in memory or unlock them, returns non zero if they are
+ * locked. Must be called with inputReadersLock held.
+ */
+static char lockInputRing(InputRing *ring, char locked) {
+    if(ring->memoryLocked != locked){
+        int result = (locked ? mlock(ring->data, ring->capacity) : munlock(ring->data, ring->capacity));
+        if(result == 0){
+            ring->memoryLocked = locked;
+        }
+    }
+    return ring->memoryLocked;
+}
+
+/*
+ * Returns the ring of a port, creating it with capacity bytes if needed. Returns NULL if
+ * it couldn't be created. Must be called with inputReadersLock held.
+ */
+static InputRing* createInputRing(PortContext *context, jint capacity) {
+    pthread_mutex_lock(&context->lock);
+    InputRing *ring = context->ring;
+    pthread_mutex_unlock(&context->lock);
+    if(ring == NULL){
+        ring = newInputRing(capacity);
+        if(ring == NULL){
+            return NULL;
+        }
+        if(context->readerMemoryLocked){
+            lockInputRing(ring, 1);
+        }
+        pthread_mutex_lock(&context->lock);
+        ringStore(context->ring, ring);
+        pthread_mutex_unlock(&context->lock);
+        __atomic_add_fetch(&inputRingsCount, 1, __ATOMIC_SEQ_CST);
+    }
+    return ring;
+}
+
+/*
+ * Start the reader thread of a port, creating its ring of capacity bytes if needed.
+ * Must be called with inputReadersLock held.
+ */
+static char startInputReader(PortContext *context, jint capacity) {
+    InputRing *ring = createInputRing(context, capacity);
+    if(ring == NULL){
+        return 0;
+    }
+    if(ring->threadStarted){
+        if(ringLoad(ring->running)){
+            return 1;
+        }
+        pthread_join(ring->thread, NULL);//Exited on a read error
+        ring->threadStarted = 0;
+    }
+    ringStore(ring->stopRequested, 0);
+    //A framed read may be filling the ring itself while there is no reader thread
+    pthread_mutex_lock(&ring->consumerLock);
+    ringStore(ring->running, 1);
+    pthread_mutex_unlock(&ring->consumerLock);
+    __atomic_add_fetch(&context->refCount, 1, __ATOMIC_SEQ_CST);//Released by the reader thread
+    int result;
+    if(context->readerCpuMask != 0 || context->readerPriority != 0){
+        result = createScheduledThread(&ring->thread, inputReaderThread, context, context->readerCpuMask, context->readerPriority);
+    }
+    else {
+        result = pthread_create(&ring->thread, NULL, inputReaderThread, context);
+    }
+    if(result != 0){
+        ringStore(ring->running, 0);
+        releasePortContext(context);
+        return 0;
+    }
+    ring->threadStarted = 1;
+    return 1;
+}
+
+/*
+ * Stop the reader thread of a port and wait for it to exit, the data left in the ring
+ * can still be read. Must be called with inputReadersLock held.
+ */
+static void stopInputReader(PortContext *context) {
+    pthread_mutex_lock(&context->lock);
+    InputRing *ring = context->ring;
+    pthread_mutex_unlock(&context->lock);
+    if(ring == NULL || !ring->threadStarted){
+        return;
+    }
+    ringStore(ring->stopRequested, 1);
+    signalPipe(ring->controlPipe[1]);
+    pthread_join(ring->thread, NULL);
+    ring->threadStarted = 0;
+}
+
+/*
+ * Drop the content of the input ring of a port, used by "_purgePort"
+ */
+static void purgeInputRing(jlong portHandle) {
+    PortContext *context = acquireBufferedContext(portHandle);
+    if(context != NULL){
+        InputRing *ring = context->ring;
+        pthread_mutex_lock(&ring->consumerLock);
+        ringStore(ring->tail, ringLoad(ring->head));
+        pthread_mutex_unlock(&ring->consumerLock);
+        if(ringExchange(ring->spaceWanted, 0) == 1){
+            signalPipe(ring->controlPipe[1]);
+        }
+        releasePortContext(context);
+    }
+}
+
 /*
  * Get native library version
  */
@@ -70,22 +1000,25 @@ JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_openPort(JNIEnv *env, jo
     jlong hComm = open(port, O_RDWR | O_NOCTTY | O_NDELAY);
     if(hComm != -1){
         //since 2.2.0 -> (check termios structure for separating real serial devices from others)
-        termios *settings = new termios();
-        if(tcgetattr(hComm, settings) == 0){
+        termios settings;
+        if(tcgetattr(hComm, &settings) == 0){
         #if defined TIOCEXCL //&& !defined __SunOS
             if(useTIOCEXCL == JNI_TRUE){
                 ioctl(hComm, TIOCEXCL);
             }
         #endif
+            //since 2.9.0 -> the port stays in non-blocking mode, reads and writes wait with select()
             int flags = fcntl(hComm, F_GETFL, 0);
             flags &= ~O_NDELAY;
+            flags |= O_NONBLOCK;
             fcntl(hComm, F_SETFL, flags);
+            createPortContext(hComm, &settings);
+            //<- since 2.9.0
         }
         else {
             close(hComm);//since 2.7.0
             hComm = jssc_SerialNativeInterface_ERR_INCORRECT_SERIAL_PORT;//-4;
         }
-        delete settings;
         //<- since 2.2.0
     }
     else {//since 0.9 ->
@@ -106,187 +1039,188 @@ JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_openPort(JNIEnv *env, jo
     return hComm;
 }
 
-/* OK */
 /*
- * Choose baudrate
+ * Baud rates having a Bxxx constant, sorted by rate (since 2.9.0 a table instead of a
+ * switch, searched both ways). It only holds constants, so the compiler lays it out and
+ * no code runs to build it.
  */
-speed_t getBaudRateByNum(jint baudRate) {
-    switch(baudRate){
-        case 0:
-            return B0;
-        case 50:
-            return B50;
-        case 75:
-            return B75;
-        case 110:
-            return B110;
-        case 134:
-            return B134;
-        case 150:
-            return B150;
-        case 200:
-            return B200;
-        case 300:
-            return B300;
-        case 600:
-            return B600;
-        case 1200:
-            return B1200;
-        case 1800:
-            return B1800;
-        case 2400:
-            return B2400;
-        case 4800:
-            return B4800;
-        case 9600:
-            return B9600;
-        case 19200:
-            return B19200;
-        case 38400:
-            return B38400;
-    #ifdef B57600
-        case 57600:
-            return B57600;
-    #endif
-    #ifdef B115200
-        case 115200:
-            return B115200;
-    #endif
-    #ifdef B230400
-        case 230400:
-            return B230400;
-    #endif
-    #ifdef B460800
-        case 460800:
-            return B460800;
-    #endif
+struct BaudRateEntry {
+    jint rate;
+    speed_t speed;
+};
 
-    #ifdef B500000
-        case 500000:
-            return B500000;
-    #endif
-    #ifdef B576000
-        case 576000:
-            return B576000;
-    #endif
-    #ifdef B921600
-        case 921600:
-            return B921600;
-    #endif
-    #ifdef B1000000
-        case 1000000:
-            return B1000000;
-    #endif
+static const BaudRateEntry baudRateTable[] = {
+    {0, B0},
+    {50, B50},
+    {75, B75},
+    {110, B110},
+    {134, B134},
+    {150, B150},
+    {200, B200},
+    {300, B300},
+    {600, B600},
+    {1200, B1200},
+    {1800, B1800},
+    {2400, B2400},
+    {4800, B4800},
+    {9600, B9600},
+    {19200, B19200},
+    {38400, B38400},
+#ifdef B57600
+    {57600, B57600},
+#endif
+#ifdef B115200
+    {115200, B115200},
+#endif
+#ifdef B230400
+    {230400, B230400},
+#endif
+#ifdef B460800
+    {460800, B460800},
+#endif
+#ifdef B500000
+    {500000, B500000},
+#endif
+#ifdef B576000
+    {576000, B576000},
+#endif
+#ifdef B921600
+    {921600, B921600},
+#endif
+#ifdef B1000000
+    {1000000, B1000000},
+#endif
+#ifdef B1152000
+    {1152000, B1152000},
+#endif
+#ifdef B1500000
+    {1500000, B1500000},
+#endif
+#ifdef B2000000
+    {2000000, B2000000},
+#endif
+#ifdef B2500000
+    {2500000, B2500000},
+#endif
+#ifdef B3000000
+    {3000000, B3000000},
+#endif
+#ifdef B3500000
+    {3500000, B3500000},
+#endif
+#ifdef B4000000
+    {4000000, B4000000},
+#endif
+};
 
-    #ifdef B1152000
-        case 1152000:
-            return B1152000;
-    #endif
-    #ifdef B1500000
-        case 1500000:
-            return B1500000;
-    #endif
-    #ifdef B2000000
-        case 2000000:
-            return B2000000;
-    #endif
-    #ifdef B2500000
-        case 2500000:
-            return B2500000;
-    #endif
+#define BAUD_RATE_TABLE_LENGTH (sizeof(baudRateTable) / sizeof(baudRateTable[0]))
 
-    #ifdef B3000000
-        case 3000000:
-            return B3000000;
-    #endif
-    #ifdef B3500000
-        case 3500000:
-            return B3500000;
-    #endif
-    #ifdef B4000000
-        case 4000000:
-            return B4000000;
-    #endif
-        default:
-            return -1;
+/* OK */
+/*
+ * Choose baudrate, -1 if it has no Bxxx constant
+ */
+speed_t getBaudRateByNum(jint baudRate) {
+    size_t low = 0;
+    size_t high = BAUD_RATE_TABLE_LENGTH;
+    while(low < high){
+        size_t middle = (low + high) / 2;
+        if(baudRateTable[middle].rate < baudRate){
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    if(low < BAUD_RATE_TABLE_LENGTH && baudRateTable[low].rate == baudRate){
+        return baudRateTable[low].speed;
     }
+    return -1;
 }
 
+//CSx flags by count of data bits, from 5
+static const int dataBitsTable[] = {CS5, CS6, CS7, CS8};
+
 /* OK */
 /*
  * Choose data bits
  */
 int getDataBitsByNum(jint byteSize) {
-    switch(byteSize){
-        case 5:
-            return CS5;
-        case 6:
-            return CS6;
-        case 7:
-            return CS7;
-        case 8:
-            return CS8;
-        default:
+    if(byteSize < 5 || byteSize > 8){
+        return -1;
+    }
+    return dataBitsTable[byteSize - 5];
+}
+
+#ifdef __linux__
+/*
+ * Set a baud rate which has no Bxxx constant on a port already set to B38400 (since 2.9.0)
+ *
+ * termios2 with BOTHER gives the exact rate with any driver supporting it, USB adapters
+ * included. Kernels without termios2 fall back to ASYNC_SPD_CUST, which maps B38400 to
+ * baud_base / custom_divisor and is only supported by UART drivers. Returns 0 on success.
+ */
+static int setCustomBaudRate(jlong portHandle, jint baudRate) {
+#ifdef JSSC_TERMIOS2
+    termios2 settings2;
+    if(ioctl(portHandle, TCGETS2, &settings2) == 0){
+        settings2.c_cflag &= ~CBAUD;
+        settings2.c_cflag |= BOTHER;
+        settings2.c_ispeed = (speed_t)baudRate;
+        settings2.c_ospeed = (speed_t)baudRate;
+        if(ioctl(portHandle, TCSETS2, &settings2) != 0){
             return -1;
+        }
+        //The cached settings keep BOTHER, so the later tcsetattr() calls keep the rate
+        refreshPortSettings(portHandle);
+        return 0;
+    }
+#endif
+    serial_struct serial_info;
+    if(ioctl(portHandle, TIOCGSERIAL, &serial_info) < 0){
+        return -1;
+    }
+    serial_info.custom_divisor = (serial_info.baud_base + baudRate/2) / baudRate;//Nearest divisor
+    if(serial_info.custom_divisor == 0){
+        return -1;
     }
+    serial_info.flags = (serial_info.flags & ~ASYNC_SPD_MASK) | ASYNC_SPD_CUST;
+    return (ioctl(portHandle, TIOCSSERIAL, &serial_info) < 0 ? -1 : 0);
 }
+#endif
 
 //since 2.6.0 ->
 const jint PARAMS_FLAG_IGNPAR = 1;
 const jint PARAMS_FLAG_PARMRK = 2;
 //<- since 2.6.0
+//since 2.9.0, "_configure" only: change the low latency mode (see "_setLowLatency")
+const jint PARAMS_FLAG_LOW_LATENCY_ON = 4;
+const jint PARAMS_FLAG_LOW_LATENCY_OFF = 8;
 
-/* OK */
 /*
- * Set serial port settings
- *
- * In 2.6.0 added flags parameter
+ * Fill settings with the line parameters of "_setParams" (since 2.9.0 shared with
+ * "_configure"), the flow control is switched off. A rate without Bxxx constant is set
+ * as B38400 on Linux, see applyPortSettings(). Returns 0 on success, -1 if a parameter
+ * isn't supported.
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setParams
-  (JNIEnv *env, jobject object, jlong portHandle, jint baudRate, jint byteSize, jint stopBits, jint parity, jboolean setRTS, jboolean setDTR, jint flags){
-    jboolean returnValue = JNI_FALSE;
-    
+static int buildPortSettings(termios *settings, jint baudRate, jint byteSize, jint stopBits, jint parity, jint flags) {
     speed_t baudRateValue = getBaudRateByNum(baudRate);
     int dataBits = getDataBitsByNum(byteSize);
-    
-    termios *settings = new termios();
-    if(tcgetattr(portHandle, settings) == 0){
-        if(baudRateValue != -1){
-            //Set standart baudrate from "termios.h"
-            if(cfsetispeed(settings, baudRateValue) < 0 || cfsetospeed(settings, baudRateValue) < 0){
-                goto methodEnd;
-            }
+
+    if(baudRateValue != (speed_t)-1){
+        //Set standart baudrate from "termios.h"
+        if(cfsetispeed(settings, baudRateValue) < 0 || cfsetospeed(settings, baudRateValue) < 0){
+            return -1;
         }
-        else {
-        #ifdef __SunOS
-            goto methodEnd;//Solaris don't support non standart baudrates
-        #elif defined __linux__
-            //Try to calculate a divisor for setting non standart baudrate
-            serial_struct *serial_info = new serial_struct();
-            if(ioctl(portHandle, TIOCGSERIAL, serial_info) < 0){ //Getting serial_info structure
-                delete serial_info;
-                goto methodEnd;
-            }
-            else {
-                serial_info->flags |= ASYNC_SPD_CUST;
-                serial_info->custom_divisor = (serial_info->baud_base/baudRate); //Calculate divisor
-                if(serial_info->custom_divisor == 0){ //If divisor == 0 go to method end to prevent "division by zero" error
-                    delete serial_info;
-                    goto methodEnd;
-                }
-                settings->c_cflag |= B38400;
-                if(cfsetispeed(settings, B38400) < 0 || cfsetospeed(settings, B38400) < 0){
-                    delete serial_info;
-                    goto methodEnd;
-                }
-                if(ioctl(portHandle, TIOCSSERIAL, serial_info) < 0){//Try to set new settings with non standart baudrate
-                    delete serial_info;
-                    goto methodEnd;
-                }
-                delete serial_info;
-            }
-        #endif
+    }
+    else {
+    #ifdef __SunOS
+        return -1;//Solaris don't support non standart baudrates
+    #elif defined __linux__
+        //The non standart baudrate is set once the other settings are applied, see setCustomBaudRate()
+        if(baudRate <= 0 || cfsetispeed(settings, B38400) < 0 || cfsetospeed(settings, B38400) < 0){
+            return -1;
         }
+    #endif
     }
 
     /*
@@ -297,7 +1231,7 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setParams
         settings->c_cflag |= dataBits;
     }
     else {
-        goto methodEnd;
+        return -1;
     }
 
     /*
@@ -310,7 +1244,7 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setParams
         settings->c_cflag |= CSTOPB;
     }
     else {
-        goto methodEnd;
+        return -1;
     }
 
     settings->c_cflag |= (CREAD | CLOCAL);
@@ -377,42 +1311,99 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setParams
         //Do nothing (Parity NONE)
     }
     else {
-        goto methodEnd;
+        return -1;
     }
+    return 0;
+}
 
-    if(tcsetattr(portHandle, TCSANOW, settings) == 0){//Try to set all settings
-    #ifdef __APPLE__
-        //Try to set non-standard baud rate in Mac OS X
-        if(baudRateValue == -1){
-            speed_t speed = (speed_t)baudRate;
-            if(ioctl(portHandle, IOSSIOSPEED, &speed) < 0){//IOSSIOSPEED must be used only after tcsetattr
-                goto methodEnd;
-            }
-        }
-    #endif
-        int lineStatus;
-        if(ioctl(portHandle, TIOCMGET, &lineStatus) >= 0){
-            if(setRTS == JNI_TRUE){
-                lineStatus |= TIOCM_RTS;
-            }
-            else {
-                lineStatus &= ~TIOCM_RTS;
-            }
-            if(setDTR == JNI_TRUE){
-                lineStatus |= TIOCM_DTR;
-            }
-            else {
-                lineStatus &= ~TIOCM_DTR;
-            }
-            if(ioctl(portHandle, TIOCMSET, &lineStatus) >= 0){
-                returnValue = JNI_TRUE;
-            }
+#ifdef JSSC_TERMIOS2
+/*
+ * Apply settings together with a baud rate without Bxxx constant in a single TCSETS2
+ * call (since 2.9.0). Returns 0 on success, -1 if the kernel or the driver has no
+ * termios2, setCustomBaudRate() then tries ASYNC_SPD_CUST.
+ */
+static int setPortSettingsWithRate(jlong portHandle, const termios *settings, jint baudRate) {
+    termios2 settings2;
+    settings2.c_iflag = settings->c_iflag;
+    settings2.c_oflag = settings->c_oflag;
+    settings2.c_cflag = (settings->c_cflag & ~CBAUD) | BOTHER;
+    settings2.c_lflag = settings->c_lflag;
+    settings2.c_line = settings->c_line;
+    memcpy(settings2.c_cc, settings->c_cc, sizeof(settings2.c_cc));
+    settings2.c_ispeed = (speed_t)baudRate;
+    settings2.c_ospeed = (speed_t)baudRate;
+    if(ioctl(portHandle, TCSETS2, &settings2) != 0){
+        return -1;
+    }
+    refreshPortSettings(portHandle);
+    return 0;
+}
+#endif
+
+/*
+ * Apply the settings built by buildPortSettings() for baudRate, including a baud rate
+ * without Bxxx constant. Returns 0 on success.
+ */
+static int applyPortSettings(jlong portHandle, const termios *settings, jint baudRate) {
+    speed_t baudRateValue = getBaudRateByNum(baudRate);
+#ifdef JSSC_TERMIOS2
+    if(baudRateValue == (speed_t)-1 && setPortSettingsWithRate(portHandle, settings, baudRate) == 0){
+        return 0;
+    }
+#endif
+    if(setPortSettings(portHandle, settings) != 0){//Try to set all settings
+        return -1;
+    }
+#ifdef __APPLE__
+    //Try to set non-standard baud rate in Mac OS X
+    if(baudRateValue == (speed_t)-1){
+        speed_t speed = (speed_t)baudRate;
+        if(ioctl(portHandle, IOSSIOSPEED, &speed) < 0){//IOSSIOSPEED must be used only after tcsetattr
+            return -1;
         }
     }
-    methodEnd: {
-        delete settings;
-        return returnValue;
+#elif defined __linux__
+    if(baudRateValue == (speed_t)-1 && setCustomBaudRate(portHandle, baudRate) != 0){
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+/* OK */
+/*
+ * Set serial port settings
+ *
+ * In 2.6.0 added flags parameter
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setParams
+  (JNIEnv *env, jobject object, jlong portHandle, jint baudRate, jint byteSize, jint stopBits, jint parity, jboolean setRTS, jboolean setDTR, jint flags){
+    termios settings;
+    if(getPortSettings(portHandle, &settings) != 0 ||
+       buildPortSettings(&settings, baudRate, byteSize, stopBits, parity, flags) != 0 ||
+       applyPortSettings(portHandle, &settings, baudRate) != 0){
+        return JNI_FALSE;
+    }
+    jboolean returnValue = JNI_FALSE;
+    int lineStatus;
+    if(ioctl(portHandle, TIOCMGET, &lineStatus) >= 0){
+        if(setRTS == JNI_TRUE){
+            lineStatus |= TIOCM_RTS;
+        }
+        else {
+            lineStatus &= ~TIOCM_RTS;
+        }
+        if(setDTR == JNI_TRUE){
+            lineStatus |= TIOCM_DTR;
+        }
+        else {
+            lineStatus &= ~TIOCM_DTR;
+        }
+        if(ioctl(portHandle, TIOCMSET, &lineStatus) >= 0){
+            returnValue = JNI_TRUE;
+        }
     }
+    return returnValue;
 }
 
 const jint PURGE_RXABORT = 0x0002; //ignored
@@ -442,6 +1433,9 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_purgePort
     else {
         return JNI_FALSE;
     }
+    if(flags & PURGE_RXCLEAR){
+        purgeInputRing(portHandle);//since 2.9.0
+    }
     return tcflush(portHandle, clearValue) == 0 ? JNI_TRUE : JNI_FALSE;
 }
 
@@ -452,16 +1446,183 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_closePort
 #if defined TIOCNXCL //&& !defined __SunOS
     ioctl(portHandle, TIOCNXCL);//since 2.1.0 Clear exclusive port access on closing
 #endif
+    //since 2.9.0 the reader thread of the buffered mode must be gone before the descriptor is closed
+    PortContext *context = acquireBufferedContext(portHandle);
+    if(context != NULL){
+        pthread_mutex_lock(&inputReadersLock);
+        stopInputReader(context);
+        pthread_mutex_unlock(&inputReadersLock);
+        releasePortContext(context);
+    }
+    //since 2.9.0 the reads and writes blocked on the port fail at once, and are gone before the descriptor is closed
+    context = acquirePortContext(portHandle);
+    if(context != NULL){
+        ringStore(context->closing, 1);
+        cancelPortIO(context);
+        waitPortIODone(context);
+        releasePortContext(context);
+    }
+    removePortContext((int)portHandle);//since 2.9.0
     return close(portHandle) == 0 ? JNI_TRUE : JNI_FALSE;
 }
 
+/*
+ * Cancel the blocking reads and writes of the port (since 2.9.0)
+ *
+ * They fail with a SerialPortException of type TYPE_IO_CANCELLED, whatever their
+ * timeout. Returns JNI_TRUE if there was any.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_cancelIO
+  (JNIEnv *env, jobject object, jlong portHandle){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    jboolean result = cancelPortIO(context);
+    releasePortContext(context);
+    return result;
+}
+
+/*
+ * Get the statistics of the reads and writes of the port (since 2.9.0)
+ *
+ * Returns STATS_LENGTH values indexed as described with PortStats, or NULL if the port
+ * has no context. If reset is set the counters start again from 0; operations ending
+ * during the call may be counted in either period, but never in both.
+ */
+JNIEXPORT jlongArray JNICALL Java_jssc_SerialNativeInterface_getStatistics
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean reset){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return NULL;
+    }
+    PortStats *stats = &context->stats;
+    jlong values[STATS_LENGTH];
+    pthread_mutex_lock(&context->lock);
+    jlong frameErrors = (jlong)stats->frameErrors;
+    if(reset){
+        stats->frameErrors = 0;
+    }
+    for(int i = 0; i < STATS_LENGTH; i++){
+        unsigned long long *field = (i < STATS_COUNTERS ? &stats->counters[i] : &stats->latency[i - STATS_COUNTERS]);
+        if(i >= STAT_OVERRUNS && i < STATS_COUNTERS){
+            values[i] = 0;
+        }
+        else {
+            values[i] = (jlong)*field;
+            if(reset){
+                *field = 0;
+            }
+        }
+    }
+    pthread_mutex_unlock(&context->lock);
+#ifdef TIOCGICOUNT
+    struct serial_icounter_struct icount;
+    if(ioctl(portHandle, TIOCGICOUNT, &icount) >= 0){
+        unsigned int current[STATS_COUNTERS - STAT_OVERRUNS] = {
+            (unsigned int)icount.overrun, (unsigned int)icount.buf_overrun, (unsigned int)icount.frame,
+            (unsigned int)icount.parity, (unsigned int)icount.brk
+        };
+        pthread_mutex_lock(&context->lock);
+        for(int i = STAT_OVERRUNS; i < STATS_COUNTERS; i++){
+            //The counters of the driver are 32 bits and wrap around
+            values[i] = (jlong)(current[i - STAT_OVERRUNS] - (unsigned int)stats->counters[i]);
+            if(reset){
+                stats->counters[i] = current[i - STAT_OVERRUNS];
+            }
+        }
+        pthread_mutex_unlock(&context->lock);
+    }
+#endif
+    values[STAT_FRAMING_ERRORS] += frameErrors;
+    releasePortContext(context);
+    jlongArray returnArray = env->NewLongArray(STATS_LENGTH);
+    if(returnArray != NULL){
+        env->SetLongArrayRegion(returnArray, 0, STATS_LENGTH, values);
+    }
+    return returnArray;
+}
+
+//Serializes "_captureStart" and "_captureStop" (since 2.9.0)
+static pthread_mutex_t capturesLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Start capturing the traffic of the port into a memory-mapped ring file (since 2.9.0),
+ * see jssc_Capture.h. Returns JNI_FALSE if the port already has a capture or the file
+ * couldn't be created.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_captureStart
+  (JNIEnv *env, jobject object, jlong portHandle, jstring fileName, jlong capacity){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    jboolean returnValue = JNI_FALSE;
+    pthread_mutex_lock(&capturesLock);
+    const char *path = env->GetStringUTFChars(fileName, NULL);
+    if(path != NULL){
+        if(ringLoad(context->capture) == NULL){
+            CaptureRing *capture = captureOpen(path, capacity);
+            if(capture != NULL){
+                ringStore(context->capture, capture);
+                returnValue = JNI_TRUE;
+            }
+        }
+        env->ReleaseStringUTFChars(fileName, path);
+    }
+    pthread_mutex_unlock(&capturesLock);
+    releasePortContext(context);
+    return returnValue;
+}
+
+/*
+ * Stop the capture of the port and close its file (since 2.9.0). Returns JNI_FALSE if
+ * the port had no capture.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_captureStop
+  (JNIEnv *env, jobject object, jlong portHandle){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    pthread_mutex_lock(&capturesLock);
+    CaptureRing *capture = ringExchange(context->capture, (CaptureRing*)NULL);
+    if(capture != NULL){
+        //The threads which have loaded the pointer are only copying their last record
+        while(ringLoad(context->captureUsers) != 0){
+            sched_yield();
+        }
+        captureClose(capture);
+    }
+    pthread_mutex_unlock(&capturesLock);
+    releasePortContext(context);
+    return (capture != NULL ? JNI_TRUE : JNI_FALSE);
+}
+
 /* OK */
 /*
  * Setting events mask
+ *
+ * Since 2.9.0 the mask is kept in the port context and applied by the event waiter,
+ * which is woken up to take the new mask into account.
  */
 JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setEventsMask
   (JNIEnv *env, jobject object, jlong portHandle, jint mask){
-    //Don't needed in linux, implemented in java code
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    pthread_mutex_lock(&context->lock);
+    context->eventsMask = mask;
+    if(context->eventsWakeupFd != -1){
+        char signal = 1;
+        //A full pipe means a wakeup is already pending
+        if(write(context->eventsWakeupFd, &signal, 1) != 1){
+            //Do nothing
+        }
+    }
+    pthread_mutex_unlock(&context->lock);
+    releasePortContext(context);
     return JNI_TRUE;
 }
 
@@ -471,64 +1632,968 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setEventsMask
  */
 JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_getEventsMask
   (JNIEnv *env, jobject object, jlong portHandle){
-    //Don't needed in linux, implemented in java code
-    return -1;
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return -1;
+    }
+    pthread_mutex_lock(&context->lock);
+    jint mask = context->eventsMask;
+    pthread_mutex_unlock(&context->lock);
+    releasePortContext(context);
+    return mask;
 }
 
-/* OK */
-/* 
- * RTS line status changing (ON || OFF)
+/*
+ * Waiting for the output to be sent (since 2.9.0)
+ *
+ * tcdrain() can't be cancelled nor given a timeout, so the queue of the driver is polled
+ * with TIOCOUTQ instead, and on Linux the line status register with TIOCSERGETLSR for the
+ * last character in the shift register (UART drivers only, USB adapters don't report it).
+ * Each wait lasts about the time the pending bytes take to be sent at the current rate,
+ * so the drain returns within a character time of the last stop bit.
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setRTS
-  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
-    int returnValue = 0;
-    int lineStatus;
-    ioctl(portHandle, TIOCMGET, &lineStatus);
-    if(enabled == JNI_TRUE){
-        lineStatus |= TIOCM_RTS;
+#define DRAIN_DONE              1
+#define DRAIN_TIMEOUT           0
+#define DRAIN_ERROR             -1
+#define DRAIN_CANCELLED         -2
+#define DRAIN_INTERRUPTED       -3
+
+#define DRAIN_MIN_WAIT_MICROS   50
+#define DRAIN_MAX_WAIT_MICROS   100000
+#define DRAIN_UNKNOWN_WAIT_MICROS   1000    //Rate unknown
+
+/*
+ * Reverse of getBaudRateByNum(), returns 0 for an unknown speed
+ */
+static jint getNumByBaudRate(speed_t speed) {
+#if B9600 == 9600
+    //BSD and Mac OS X: the speeds are the rates, also for IOSSIOSPEED
+    return (jint)speed;
+#else
+    for(size_t i = 0; i < BAUD_RATE_TABLE_LENGTH; i++){
+        if(baudRateTable[i].speed == speed){
+            return baudRateTable[i].rate;
+        }
     }
-    else {
-        lineStatus &= ~TIOCM_RTS;
+    return 0;
+#endif
+}
+
+/*
+ * Time to send one character with the current settings of a port, 0 if unknown
+ */
+static jlong getCharacterMicros(jlong portHandle) {
+    termios settings;
+    if(getPortSettings(portHandle, &settings) != 0){
+        return 0;
     }
-    returnValue = ioctl(portHandle, TIOCMSET, &lineStatus);
-    return (returnValue >= 0 ? JNI_TRUE : JNI_FALSE);
+    jint baudRate = getNumByBaudRate(cfgetospeed(&settings));
+#ifdef JSSC_TERMIOS2
+    termios2 settings2;
+    if((settings.c_cflag & CBAUD) == BOTHER && ioctl(portHandle, TCGETS2, &settings2) == 0){
+        baudRate = (jint)settings2.c_ospeed;
+    }
+#endif
+    if(baudRate <= 0){
+        return 0;
+    }
+    int dataBits = 8;
+    switch(settings.c_cflag & CSIZE){
+        case CS5: dataBits = 5; break;
+        case CS6: dataBits = 6; break;
+        case CS7: dataBits = 7; break;
+    }
+    int frameBits = 1 + dataBits + ((settings.c_cflag & PARENB) ? 1 : 0) + ((settings.c_cflag & CSTOPB) ? 2 : 1);
+    return ((jlong)frameBits * 1000000 + baudRate - 1) / baudRate;
 }
 
-/* OK */
-/* 
- * DTR line status changing (ON || OFF)
+/*
+ * Count of bytes not sent yet, the shift register counted as one byte where it can be
+ * read. Returns -1 if the port has no TIOCOUTQ.
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setDTR
-  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
-    int returnValue = 0;
-    int lineStatus;
-    ioctl(portHandle, TIOCMGET, &lineStatus);
-    if(enabled == JNI_TRUE){
-        lineStatus |= TIOCM_DTR;
+static int getPendingOutput(jlong portHandle) {
+    int pending = 0;
+    if(ioctl(portHandle, TIOCOUTQ, &pending) < 0){
+        return -1;
     }
-    else {
-        lineStatus &= ~TIOCM_DTR;
+#if defined TIOCSERGETLSR && defined TIOCSER_TEMT
+    if(pending == 0){
+        unsigned int lineStatus = 0;
+        if(ioctl(portHandle, TIOCSERGETLSR, &lineStatus) == 0 && !(lineStatus & TIOCSER_TEMT)){
+            pending = 1;
+        }
     }
-    returnValue = ioctl(portHandle, TIOCMSET, &lineStatus);
-    return (returnValue >= 0 ? JNI_TRUE : JNI_FALSE);
+#endif
+    return pending;
 }
 
-/* OK */
 /*
- * Writing data to the port
+ * Wait until all of the output of a port has been sent, the timeout expires (if
+ * timeoutMilliseconds is not negative) or the operation is cancelled. The java thread
+ * is checked for interruption every pollPeriodMillis, 0 to never check. Returns one of
+ * DRAIN_*, the caller throws the exceptions.
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_writeBytes
-  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer){
-    jbyte* jBuffer = env->GetByteArrayElements(buffer, JNI_FALSE);
-    jint bufferSize = env->GetArrayLength(buffer);
-    jint result = write(portHandle, jBuffer, (size_t)bufferSize);
-    env->ReleaseByteArrayElements(buffer, jBuffer, 0);
-    return result == bufferSize ? JNI_TRUE : JNI_FALSE;
+static int drainOutput(JNIEnv *env, jlong portHandle, PortIO *io, jlong timeoutMilliseconds, jlong pollPeriodMillis) {
+    jlong timeoutDeadline = (timeoutMilliseconds >= 0 ? getTimePreciseMicros() + timeoutMilliseconds*1000 : 0);
+    jlong characterMicros = getCharacterMicros(portHandle);
+    for(;;){
+        int pending = getPendingOutput(portHandle);
+        if(pending < 0){
+            //No way to poll the queue, only the blocking call is left
+            return (tcdrain(portHandle) == 0 ? DRAIN_DONE : DRAIN_ERROR);
+        }
+        if(pending == 0){
+            return DRAIN_DONE;
+        }
+        jlong waitMicros = (characterMicros > 0 ? pending * characterMicros : DRAIN_UNKNOWN_WAIT_MICROS);
+        if(waitMicros < DRAIN_MIN_WAIT_MICROS){
+            waitMicros = DRAIN_MIN_WAIT_MICROS;
+        }
+        else if(waitMicros > DRAIN_MAX_WAIT_MICROS){
+            waitMicros = DRAIN_MAX_WAIT_MICROS;
+        }
+        if(pollPeriodMillis > 0 && waitMicros > pollPeriodMillis*1000){
+            waitMicros = pollPeriodMillis*1000;
+        }
+        if(timeoutMilliseconds >= 0){
+            jlong remainingMicros = timeoutDeadline - getTimePreciseMicros();
+            if(remainingMicros <= 0){
+                io->counts[STAT_TIMEOUTS]++;
+                return DRAIN_TIMEOUT;
+            }
+            if(waitMicros > remainingMicros){
+                waitMicros = remainingMicros;
+            }
+        }
+        struct timeval timeout;
+        timeout.tv_sec = waitMicros / 1000000;
+        timeout.tv_usec = waitMicros % 1000000;
+        selectPortIO(io, -1, 0, &timeout);
+        if(isPortIOCancelled(io)){
+            return DRAIN_CANCELLED;
+        }
+        if(pollPeriodMillis > 0 && isThreadInterrupted(env)){
+            return DRAIN_INTERRUPTED;
+        }
+    }
 }
 
-    /**
-     * Read data from port
-     * 
+/*
+ * Wait for the output of a port to be sent (since 2.9.0)
+ *
+ * Returns 1 when all of the data has been sent, 0 if the timeout expired and -1 on error.
+ * Cancellation and interruption leave an exception pending.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_drainPort
+  (JNIEnv *env, jobject object, jlong portHandle, jlong timeoutMilliseconds, jlong pollPeriodMillis){
+    PortIO io;
+    beginPortIO(portHandle, &io);
+    int result = drainOutput(env, portHandle, &io, timeoutMilliseconds, (pollPeriodMillis < 0 ? 0 : pollPeriodMillis));
+    if(result == DRAIN_CANCELLED){
+        throwPortIOCancelled(env, &io, "<native>drainPort()");
+    }
+    else if(result == DRAIN_INTERRUPTED){
+        throwInterruptedException(env, "Interrupted while waiting for the output to be sent");
+    }
+    endPortIO(&io);
+    return (result < DRAIN_ERROR ? DRAIN_ERROR : result);
+}
+
+/*
+ * RS-485 direction control (since 2.9.0), see "_setRS485"
+ *
+ * With RS485_MODE_SOFTWARE every write raises RTS, writes, waits with drainOutput() until
+ * the last byte has left the shift register and drops RTS, all natively so the turnaround
+ * doesn't depend on the scheduling of the java thread.
+ */
+#define RS485_MODE_OFF          0
+#define RS485_MODE_DRIVER       1   //TIOCSRS485, the driver switches RTS
+#define RS485_MODE_SOFTWARE     2
+
+struct DirectionControl {
+    char active;
+    char rtsOnSend;
+    int delayAfter;
+};
+
+static void setRTSLevel(jlong portHandle, char level) {
+    int flag = TIOCM_RTS;
+    ioctl(portHandle, (level ? TIOCMBIS : TIOCMBIC), &flag);
+}
+
+static void sleepMillis(int millis) {
+    if(millis > 0){
+        struct timespec timeStruct;
+        timeStruct.tv_sec = millis / 1000;
+        timeStruct.tv_nsec = (millis % 1000) * 1000000L;
+        while(nanosleep(&timeStruct, &timeStruct) != 0 && errno == EINTR){
+            //Sleep the remaining time
+        }
+    }
+}
+
+static void beginDirectionControl(jlong portHandle, PortIO *io, DirectionControl *control) {
+    int delayBefore = 0;
+    control->active = 0;
+    control->rtsOnSend = 0;
+    control->delayAfter = 0;
+    if(io->context == NULL || ringLoad(io->context->rs485Mode) != RS485_MODE_SOFTWARE){
+        return;
+    }
+    pthread_mutex_lock(&io->context->lock);
+    if(io->context->rs485Mode == RS485_MODE_SOFTWARE){
+        control->active = 1;
+        control->rtsOnSend = io->context->rs485RtsOnSend;
+        control->delayAfter = io->context->rs485DelayAfter;
+        delayBefore = io->context->rs485DelayBefore;
+    }
+    pthread_mutex_unlock(&io->context->lock);
+    if(control->active){
+        setRTSLevel(portHandle, control->rtsOnSend);
+        sleepMillis(delayBefore);
+    }
+}
+
+static void endDirectionControl(JNIEnv *env, jlong portHandle, PortIO *io, DirectionControl *control, jint bytesWritten) {
+    if(control->active){
+        if(bytesWritten > 0){
+            //Stops early if the write is cancelled meanwhile
+            drainOutput(env, portHandle, io, -1, 0);
+        }
+        sleepMillis(control->delayAfter);
+        setRTSLevel(portHandle, !control->rtsOnSend);
+    }
+}
+
+/* OK */
+/* 
+ * RTS line status changing (ON || OFF)
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setRTS
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
+    int returnValue = 0;
+    int lineStatus;
+    ioctl(portHandle, TIOCMGET, &lineStatus);
+    if(enabled == JNI_TRUE){
+        lineStatus |= TIOCM_RTS;
+    }
+    else {
+        lineStatus &= ~TIOCM_RTS;
+    }
+    returnValue = ioctl(portHandle, TIOCMSET, &lineStatus);
+    return (returnValue >= 0 ? JNI_TRUE : JNI_FALSE);
+}
+
+/* OK */
+/* 
+ * DTR line status changing (ON || OFF)
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setDTR
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
+    int returnValue = 0;
+    int lineStatus;
+    ioctl(portHandle, TIOCMGET, &lineStatus);
+    if(enabled == JNI_TRUE){
+        lineStatus |= TIOCM_DTR;
+    }
+    else {
+        lineStatus &= ~TIOCM_DTR;
+    }
+    returnValue = ioctl(portHandle, TIOCMSET, &lineStatus);
+    return (returnValue >= 0 ? JNI_TRUE : JNI_FALSE);
+}
+
+//Lines of "_setLines" (since 2.9.0), the values of SerialPort.LINE_*
+#define LINE_RTS    1
+#define LINE_DTR    2
+#define LINE_BREAK  4
+#define LINE_CTS    8
+#define LINE_DSR    16
+#define LINE_RING   32
+#define LINE_RLSD   64
+
+/*
+ * Set RTS, DTR and break and read the modem lines in one call (since 2.9.0)
+ *
+ * The lines of mask are set to their bit in values, RTS and DTR together by a single
+ * TIOCMSET. Returns the LINE_* bits of the lines which are on afterwards (break
+ * excepted), or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setLines
+  (JNIEnv *env, jobject object, jlong portHandle, jint mask, jint values){
+    int lineStatus;
+    if(ioctl(portHandle, TIOCMGET, &lineStatus) < 0){
+        return -1;
+    }
+    if(mask & (LINE_RTS | LINE_DTR)){
+        int newStatus = lineStatus;
+        if(mask & LINE_RTS){
+            newStatus = ((values & LINE_RTS) ? (newStatus | TIOCM_RTS) : (newStatus & ~TIOCM_RTS));
+        }
+        if(mask & LINE_DTR){
+            newStatus = ((values & LINE_DTR) ? (newStatus | TIOCM_DTR) : (newStatus & ~TIOCM_DTR));
+        }
+        if(newStatus != lineStatus && ioctl(portHandle, TIOCMSET, &newStatus) < 0){
+            return -1;
+        }
+    }
+    if((mask & LINE_BREAK) && ioctl(portHandle, ((values & LINE_BREAK) ? TIOCSBRK : TIOCCBRK), 0) < 0){
+        return -1;
+    }
+    if(ioctl(portHandle, TIOCMGET, &lineStatus) < 0){
+        return -1;
+    }
+    return ((lineStatus & TIOCM_RTS) ? LINE_RTS : 0) | ((lineStatus & TIOCM_DTR) ? LINE_DTR : 0) |
+           ((lineStatus & TIOCM_CTS) ? LINE_CTS : 0) | ((lineStatus & TIOCM_DSR) ? LINE_DSR : 0) |
+           ((lineStatus & TIOCM_RNG) ? LINE_RING : 0) | ((lineStatus & TIOCM_CAR) ? LINE_RLSD : 0);
+}
+
+/*
+ * Switch the RS-485 direction control of the port (since 2.9.0)
+ *
+ * Uses the RS-485 mode of the driver (TIOCSRS485) where it is supported, RTS then
+ * follows the transmitter with the given delays. Otherwise the writes switch RTS
+ * themselves, see DirectionControl. rtsOnSend is the level of RTS while sending, the
+ * opposite level is set at once. Returns the RS485_MODE_* in use, -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setRS485
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled, jboolean rtsOnSend,
+    jint delayBeforeSendMillis, jint delayAfterSendMillis){
+    if(delayBeforeSendMillis < 0 || delayAfterSendMillis < 0){
+        return -1;
+    }
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return -1;
+    }
+    char mode = RS485_MODE_OFF;
+#if defined TIOCSRS485 && defined SER_RS485_ENABLED
+    struct serial_rs485 rs485;
+    memset(&rs485, 0, sizeof(rs485));
+    if(enabled == JNI_TRUE){
+        rs485.flags = SER_RS485_ENABLED | (rtsOnSend == JNI_TRUE ? SER_RS485_RTS_ON_SEND : SER_RS485_RTS_AFTER_SEND);
+        rs485.delay_rts_before_send = (__u32)delayBeforeSendMillis;
+        rs485.delay_rts_after_send = (__u32)delayAfterSendMillis;
+        if(ioctl(portHandle, TIOCSRS485, &rs485) >= 0){
+            mode = RS485_MODE_DRIVER;
+        }
+    }
+    else if(context->rs485Mode == RS485_MODE_DRIVER){
+        ioctl(portHandle, TIOCSRS485, &rs485);
+    }
+#endif
+    if(enabled == JNI_TRUE && mode == RS485_MODE_OFF){
+        mode = RS485_MODE_SOFTWARE;
+        setRTSLevel(portHandle, rtsOnSend != JNI_TRUE);
+    }
+    pthread_mutex_lock(&context->lock);
+    context->rs485RtsOnSend = (rtsOnSend == JNI_TRUE);
+    context->rs485DelayBefore = delayBeforeSendMillis;
+    context->rs485DelayAfter = delayAfterSendMillis;
+    ringStore(context->rs485Mode, mode);
+    pthread_mutex_unlock(&context->lock);
+    releasePortContext(context);
+    return mode;
+}
+
+/* OK */
+/*
+ * Source or destination of a transfer: either a block of native memory (for example
+ * the memory of a direct ByteBuffer) or a region of a java byte array.
+ */
+struct TransferBuffer {
+    jbyte *address;     //Native memory, or NULL if the java array should be used
+    jbyteArray array;   //Java array, used only if address is NULL
+    jint offset;        //Offset of the region in the java array
+};
+
+/*
+ * Writes at most length bytes from the source at the given position. A java array
+ * is only pinned for the duration of the write() call itself, which never blocks
+ * since the port is opened with O_NONBLOCK.
+ */
+static int writeFromSource(JNIEnv *env, PortContext *context, jlong portHandle, TransferBuffer *source, jint position, jint length) {
+    if(source->address != NULL){
+        int result = write(portHandle, source->address + position, length);
+        capturePortData(context, CAPTURE_WRITE, source->address + position, result);
+        return result;
+    }
+    jbyte *elements = (jbyte*)env->GetPrimitiveArrayCritical(source->array, NULL);
+    if(elements == NULL){
+        return -1;//OutOfMemoryError is pending
+    }
+    int result = write(portHandle, elements + source->offset + position, length);
+    int err = errno;
+    capturePortData(context, CAPTURE_WRITE, elements + source->offset + position, result);
+    env->ReleasePrimitiveArrayCritical(source->array, elements, JNI_ABORT);
+    errno = err;
+    return result;
+}
+
+//Most sources written by a single writev() call (since 2.9.0)
+#define WRITE_GATHER_MAX 16
+
+/*
+ * Writes the bytes of the sources following the given position, the sources holding
+ * lengths[i] bytes each. Several sources are written by a single writev() call, with
+ * all of the java arrays pinned for its duration only (since 2.9.0).
+ */
+static int writeFromSources(JNIEnv *env, PortContext *context, jlong portHandle, TransferBuffer *sources, const jint *lengths, int sourceCount, jint position) {
+    int first = 0;
+    while(first < sourceCount - 1 && position >= lengths[first]){
+        position -= lengths[first];
+        first++;
+    }
+    if(first == sourceCount - 1){
+        return writeFromSource(env, context, portHandle, &sources[first], position, lengths[first] - position);
+    }
+    struct iovec vectors[WRITE_GATHER_MAX];
+    jbyte *pinned[WRITE_GATHER_MAX];
+    int vectorCount = 0;
+    int result = -1;
+    for(int i = first; i < sourceCount; i++){
+        pinned[i] = NULL;
+        if(lengths[i] - position == 0){
+            continue;
+        }
+        jbyte *base = sources[i].address;
+        if(base == NULL){
+            pinned[i] = (jbyte*)env->GetPrimitiveArrayCritical(sources[i].array, NULL);
+            if(pinned[i] == NULL){
+                sourceCount = i;//OutOfMemoryError is pending, release the arrays already pinned
+                vectorCount = 0;
+                break;
+            }
+            base = pinned[i] + sources[i].offset;
+        }
+        vectors[vectorCount].iov_base = base + position;
+        vectors[vectorCount].iov_len = (size_t)(lengths[i] - position);
+        vectorCount++;
+        position = 0;
+    }
+    if(vectorCount > 0){
+        result = writev(portHandle, vectors, vectorCount);
+    }
+    int err = errno;
+    //Captured while the arrays are still pinned, one record per vector
+    jint captured = 0;
+    for(int i = 0; i < vectorCount && captured < result; i++){
+        jint length = (jint)vectors[i].iov_len;
+        if(length > result - captured){
+            length = result - captured;
+        }
+        capturePortData(context, CAPTURE_WRITE, vectors[i].iov_base, length);
+        captured += length;
+    }
+    for(int i = sourceCount - 1; i >= first; i--){
+        if(pinned[i] != NULL){
+            env->ReleasePrimitiveArrayCritical(sources[i].array, pinned[i], JNI_ABORT);
+        }
+    }
+    errno = err;
+    return result;
+}
+
+/*
+ * Write engine used by all of the writeBytes* functions. Writes byteCount bytes from
+ * the given sources, waiting with select() for the port to become writable whenever
+ * the driver accepts only part of the data (for example while the output is held
+ * back by hardware flow control).
+ *
+ * timeoutMilliseconds is the maximum time to wait for the port to accept all of the
+ * data, 0 to write only what can be written immediately, negative to block
+ * indefinitely. pollPeriodMillis is how often to check if the thread has been
+ * interrupted, 0 to never check. On interruption, select() error or timeout (if
+ * exceptionOnTimeout is set) a java exception is left pending.
+ *
+ * Returns the number of bytes written, or -1 if write() failed before any byte
+ * could be written.
+ */
+static jint writeBytesFromSources(JNIEnv *env, jlong portHandle, TransferBuffer *sources, const jint *lengths, int sourceCount, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+
+    struct timeval timeout;
+    int selectRetVal;
+    jlong timeoutDeadline = 0;
+    char deadlineValid = 0;
+    char blockForever = 0;
+    jint byteRemains = byteCount;
+    jint bytesWritten = 0;
+    PortIO io;//since 2.9.0
+    DirectionControl control;//since 2.9.0
+
+    if (pollPeriodMillis < 0)
+        pollPeriodMillis = 0;
+
+    if (pollPeriodMillis == 0 && timeoutMilliseconds < 0) {
+        blockForever = 1;
+    } else if (timeoutMilliseconds >= 0) {
+        timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+        deadlineValid = 1;
+    }
+
+    beginPortIO(portHandle, &io);
+    beginDirectionControl(portHandle, &io, &control);
+    while(byteRemains > 0) {
+        int result = writeFromSources(env, io.context, portHandle, sources, lengths, sourceCount, bytesWritten);
+        io.counts[STAT_WRITE_CALLS]++;
+        if(result > 0){
+            io.counts[STAT_BYTES_WRITTEN] += result;
+            if(result < byteRemains){
+                io.counts[STAT_PARTIAL_WRITES]++;
+            }
+            bytesWritten += result;
+            byteRemains -= result;
+            continue;
+        }
+        if(result < 0){
+            int err = errno;
+            if(env->ExceptionCheck()){
+                break;
+            }
+            if(err != EAGAIN && err != EWOULDBLOCK && err != EINTR){
+                //Hard error, the port is gone or misconfigured
+                if(bytesWritten == 0){
+                    bytesWritten = -1;
+                }
+                break;
+            }
+        }
+
+        //The output buffer of the driver is full, wait until it drains
+        if (!blockForever) {
+            if (getNextTimeout(&timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1) {
+                //Some error
+                //Return right away
+                timeout.tv_sec=0;
+                timeout.tv_usec=0;
+            }
+            if (deadlineValid && timeout.tv_sec == 0 && timeout.tv_usec == 0) {
+                //Timeout elapsed, but byteRemains > 0
+                io.counts[STAT_TIMEOUTS]++;
+                if (exceptionOnTimeout) {
+                    throwTimeoutException(env, "NoPort", "<native>writeBytes()", timeoutMilliseconds);
+                }
+                break;
+            }
+        }
+
+        selectRetVal = selectPortIO(&io, (int)portHandle, 1, (blockForever ? NULL : &timeout));
+        if (selectRetVal > 0) {
+            markPortIOReady(&io, 0);
+        }
+
+        if (isPortIOCancelled(&io)) {
+            throwPortIOCancelled(env, &io, "<native>writeBytes()");
+            break;
+        }
+        // Check if the java thread has been interrupted, and if so, throw the exception
+        if (pollPeriodMillis > 0 && isThreadInterrupted(env)) {
+            throwInterruptedException(env, "Interrupted while writing serial data");
+            break;
+        }
+        if (selectRetVal == -1) {
+            int err = errno;
+            if (err == EINTR) {
+                continue;
+            }
+            switch (err) {
+            case EBADF:
+                throwSerialException(env, "NoPort", "<native>writeBytes()", SP_EXCEPTION_TYPE_PORT_NOT_OPENED);
+                break;
+            case EINVAL:
+                throwSerialException(env, "NoPort", "<native>writeBytes()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+                break;
+            case ENOMEM:
+                throwSerialException(env, "NoPort", "<native>writeBytes()", SP_EXCEPTION_TYPE_NO_MEMORY);
+                break;
+            default:
+                throwSerialException(env, "NoPort", "<native>writeBytes()", SP_EXCEPTION_TYPE_UNKNOWN);
+                break;
+            }
+            break; //exit the loop
+        }
+    }
+    endDirectionControl(env, portHandle, &io, &control, bytesWritten);
+    endPortIO(&io);
+    return bytesWritten;
+}
+
+/*
+ * Writing data to the port
+ *
+ * Blocks until all of the data has been accepted by the driver.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_writeBytes
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer){
+    TransferBuffer source = {NULL, buffer, 0};
+    jint bufferSize = env->GetArrayLength(buffer);
+    jint result = writeBytesFromSources(env, portHandle, &source, &bufferSize, 1, bufferSize, -1, 0, JNI_FALSE);
+    return result == bufferSize ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Write data to port from a region of the given array.
+ *
+ * Same timeout behaviour as readBytesToArray. Returns the number of bytes written,
+ * or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesFromArray
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    if(buffer == NULL){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if(offset < 0 || byteCount < 0 || offset > arrayLength || byteCount > arrayLength - offset){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if(byteCount == 0){
+        return 0;
+    }
+    TransferBuffer source = {NULL, buffer, offset};
+    return writeBytesFromSources(env, portHandle, &source, &byteCount, 1, byteCount, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+}
+
+/*
+ * Write data to port from a direct ByteBuffer, starting at position.
+ * The buffer's position is not changed.
+ *
+ * Same timeout behaviour as readBytesToBuffer. Returns the number of bytes written,
+ * or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesFromBuffer
+  (JNIEnv *env, jobject object, jlong portHandle, jobject buffer, jint position, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jbyte *address = (buffer != NULL ? (jbyte*)env->GetDirectBufferAddress(buffer) : NULL);
+    if(address == NULL){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(position < 0 || byteCount < 0 || position > capacity || byteCount > capacity - position){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if(byteCount == 0){
+        return 0;
+    }
+    TransferBuffer source = {address + position, NULL, 0};
+    return writeBytesFromSources(env, portHandle, &source, &byteCount, 1, byteCount, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+}
+
+/*
+ * Write data to port from several buffers with a single writev() call (since 2.9.0)
+ *
+ * Each element of buffers is a direct ByteBuffer, or a byte array for the buffers
+ * backed by one, and counts[i] bytes are written from offsets[i]. The buffers are
+ * written in order as a continuous stream, without gaps between them. Same timeout
+ * behaviour as writeBytesFromArray. Returns the total number of bytes written, or -1
+ * on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesGather
+  (JNIEnv *env, jobject object, jlong portHandle, jobjectArray buffers, jintArray offsets, jintArray counts,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jint sourceCount = (buffers != NULL ? env->GetArrayLength(buffers) : 0);
+    if(sourceCount <= 0 || sourceCount > WRITE_GATHER_MAX || offsets == NULL || counts == NULL ||
+       env->GetArrayLength(offsets) < sourceCount || env->GetArrayLength(counts) < sourceCount ||
+       env->EnsureLocalCapacity(sourceCount) != 0){
+        throwSerialException(env, "NoPort", "<native>writeBytesGather()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    TransferBuffer sources[WRITE_GATHER_MAX];
+    jint positions[WRITE_GATHER_MAX];
+    jint lengths[WRITE_GATHER_MAX];
+    env->GetIntArrayRegion(offsets, 0, sourceCount, positions);
+    env->GetIntArrayRegion(counts, 0, sourceCount, lengths);
+    jint byteCount = 0;
+    for(int i = 0; i < sourceCount; i++){
+        jobject buffer = env->GetObjectArrayElement(buffers, i);
+        jbyte *address = (buffer != NULL ? (jbyte*)env->GetDirectBufferAddress(buffer) : NULL);
+        jlong capacity = 0;
+        if(address != NULL){
+            capacity = env->GetDirectBufferCapacity(buffer);
+        }
+        else if(buffer != NULL){
+            capacity = env->GetArrayLength((jarray)buffer);
+        }
+        if(buffer == NULL || positions[i] < 0 || lengths[i] < 0 || positions[i] > capacity || lengths[i] > capacity - positions[i] ||
+           lengths[i] > 0x7fffffff - byteCount){
+            throwSerialException(env, "NoPort", "<native>writeBytesGather()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+            return -1;
+        }
+        if(address != NULL){
+            TransferBuffer source = {address + positions[i], NULL, 0};
+            sources[i] = source;
+        }
+        else {
+            TransferBuffer source = {NULL, (jbyteArray)buffer, positions[i]};
+            sources[i] = source;
+        }
+        byteCount += lengths[i];
+    }
+    if(byteCount == 0){
+        return 0;
+    }
+    return writeBytesFromSources(env, portHandle, sources, lengths, sourceCount, byteCount, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+}
+
+/*
+ * Reads at most length bytes into the target at the given position. A java array
+ * is only pinned for the duration of the read() call itself, which never blocks
+ * since the port is opened with O_NONBLOCK.
+ */
+static int readToTarget(JNIEnv *env, PortContext *context, jlong portHandle, TransferBuffer *target, jint position, jint length) {
+    if(target->address != NULL){
+        int result = read(portHandle, target->address + position, length);
+        capturePortData(context, CAPTURE_READ, target->address + position, result);
+        return result;
+    }
+    jbyte *elements = (jbyte*)env->GetPrimitiveArrayCritical(target->array, NULL);
+    if(elements == NULL){
+        return -1;//OutOfMemoryError is pending
+    }
+    int result = read(portHandle, elements + target->offset + position, length);
+    int err = errno;
+    capturePortData(context, CAPTURE_READ, elements + target->offset + position, result);
+    env->ReleasePrimitiveArrayCritical(target->array, elements, (result > 0 ? 0 : JNI_ABORT));
+    errno = err;
+    return result;
+}
+
+/*
+ * Descriptor to wait on for input: the notification pipe while the ring is filled or
+ * still holds data, the port itself otherwise
+ */
+static int getInputWaitFd(jlong portHandle, InputRing *ring) {
+    if(ring == NULL || (!ringLoad(ring->running) && ringLoad(ring->head) == ringLoad(ring->tail))){
+        return (int)portHandle;
+    }
+    return ring->notifyPipe[0];
+}
+
+/*
+ * Copy count bytes of the ring starting at tail into the target at the given position,
+ * must be called with consumerLock held
+ */
+static void copyFromRing(JNIEnv *env, InputRing *ring, unsigned int tail, TransferBuffer *target, jint position, unsigned int count) {
+    unsigned int offset = tail & (ring->capacity - 1);
+    unsigned int first = ring->capacity - offset;
+    if(first > count){
+        first = count;
+    }
+    if(target->address != NULL){
+        memcpy(target->address + position, ring->data + offset, first);
+        memcpy(target->address + position + first, ring->data, count - first);
+    }
+    else {
+        env->SetByteArrayRegion(target->array, target->offset + position, first, ring->data + offset);
+        if(count > first){
+            env->SetByteArrayRegion(target->array, target->offset + position + first, count - first, ring->data);
+        }
+    }
+}
+
+/*
+ * Same as readToTarget() for a port in buffered mode: reads at most length bytes from
+ * the input ring, returns -1 with errno set to EAGAIN if it is empty. Once the reader
+ * thread has stopped and the ring is empty the port is read directly.
+ */
+static int readFromRing(JNIEnv *env, PortContext *context, jlong portHandle, InputRing *ring, TransferBuffer *target, jint position, jint length) {
+    pthread_mutex_lock(&ring->consumerLock);
+    unsigned int tail = ring->tail;
+    unsigned int available = ringLoad(ring->head) - tail;
+    char cleared = 0;
+    if(available == 0){
+        if(!ringLoad(ring->running)){
+            pthread_mutex_unlock(&ring->consumerLock);
+            return readToTarget(env, context, portHandle, target, position, length);
+        }
+        //Clear the notification before checking again, the reader thread sets it after storing data
+        ringStore(ring->dataSignalled, 0);
+        drainPipe(ring->notifyPipe[0]);
+        cleared = 1;
+        available = ringLoad(ring->head) - tail;
+        if(available == 0){
+            pthread_mutex_unlock(&ring->consumerLock);
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+    unsigned int count = ((unsigned int)length < available ? (unsigned int)length : available);
+    copyFromRing(env, ring, tail, target, position, count);
+    ringStore(ring->tail, tail + count);
+    if(count < available){
+        //Keep the pipe readable for the remaining data, the byte of the reader thread may have been drained
+        if(ringExchange(ring->dataSignalled, 1) == 0 || cleared){
+            signalPipe(ring->notifyPipe[1]);
+        }
+    }
+    pthread_mutex_unlock(&ring->consumerLock);
+    if(ringExchange(ring->spaceWanted, 0) == 1){
+        signalPipe(ring->controlPipe[1]);
+    }
+    return (int)count;
+}
+
+/*
+ * Read engine used by all of the readBytes* functions. Reads into the given target
+ * and returns the number of bytes read. The parameters are the same as for readBytes
+ * below; in addition if byteCount is 0, at most maxAvailable bytes are read from
+ * the input buffer. On error, interruption or timeout (if exceptionOnTimeout is
+ * set) a java exception is left pending.
+ */
+static jint readBytesToTarget(JNIEnv *env, jlong portHandle, TransferBuffer *target, jint byteCount, jint maxAvailable,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+
+    struct timeval timeout;
+    int selectRetVal;
+    jlong timeoutDeadline = 0;
+    char deadlineValid = 0;
+    char blockForever;
+    char readOnce;
+    jint byteRemains;
+    jint bytesRead = 0;
+    PortIO io;//since 2.9.0
+    PortContext *bufferedContext = acquireBufferedContext(portHandle);//since 2.9.0
+    InputRing *ring = (bufferedContext != NULL ? bufferedContext->ring : NULL);
+
+    if (byteCount < 0)
+        byteCount = 0;
+    if (pollPeriodMillis < 0)
+        pollPeriodMillis = 0;
+
+    readOnce = (byteCount == 0);
+    byteRemains = (readOnce ? maxAvailable : byteCount);
+
+    blockForever = 0;
+    if (!readOnce && pollPeriodMillis == 0 && timeoutMilliseconds < 0) {
+        blockForever = 1;
+    }
+
+    if (!blockForever) {
+        if (readOnce) {
+            //return immediately
+            timeoutDeadline = getTimePreciseMicros();
+            deadlineValid = 1;
+        } else {
+            if (timeoutMilliseconds < 0) {
+                //deadline is invalid, only pollPeriodMillis is used (which at this point we know is >0)
+                deadlineValid = 0;
+            } else {
+                timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+                deadlineValid = 1;
+            }
+        }
+
+        if (getNextTimeout(&timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1 ) {
+            //Some error
+            //Return right away
+            timeout.tv_sec=0;
+            timeout.tv_usec=0;
+        }
+    }
+
+    beginPortIO(portHandle, &io);
+    while(byteRemains > 0) {
+        int waitFd = getInputWaitFd(portHandle, ring);
+        selectRetVal = selectPortIO(&io, waitFd, 0, (blockForever ? NULL : &timeout));
+
+        if (isPortIOCancelled(&io)) {
+            throwPortIOCancelled(env, &io, "<native>readBytes()");
+            break;
+        }
+        // Check if the java thread has been interrupted, and if so, throw the exception
+        if (isThreadInterrupted(env)) {
+            throwInterruptedException(env, "Interrupted while waiting for serial data");
+            // It shouldn't matter what we return, the exception will be thrown right away
+            break;
+        }
+        if (selectRetVal == -1) {
+            int err = errno;
+            switch (err) {
+            case EBADF:
+                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_PORT_NOT_OPENED);
+                break;
+            case EINTR:
+                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_READ_INTERRUPTED);
+                break;
+            case EINVAL:
+                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+                break;
+            case ENOMEM:
+                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_NO_MEMORY);
+                break;
+            default:
+                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_UNKNOWN);
+                break;
+            }
+            break; //exit the loop
+        } else if (selectRetVal > 0) {
+            int result = (ring != NULL ? readFromRing(env, io.context, portHandle, ring, target, bytesRead, byteRemains) :
+                                         readToTarget(env, io.context, portHandle, target, bytesRead, byteRemains));
+            markPortIOReady(&io, result > 0);
+            io.counts[STAT_READ_CALLS]++;
+            if(result > 0){
+                io.counts[STAT_BYTES_READ] += result;
+                bytesRead += result;
+                byteRemains -= result;
+            }
+            else if(result < 0 && env->ExceptionCheck()){
+                break;
+            }
+        }
+
+        if (readOnce) {
+            //Non-blocking read, return whatever we've got
+            break;
+        }
+
+        // Check if we've timed out and if so, throw the exception or return the data
+        if (byteRemains > 0 && !blockForever) {
+            if (getNextTimeout(&timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1) {
+                //Some error
+                //Return right away
+                timeout.tv_sec=0;
+                timeout.tv_usec=0;
+            }
+            if (timeout.tv_sec == 0 && timeout.tv_usec == 0) {
+                //Timeout elapsed, but byteRemains > 0
+                io.counts[STAT_TIMEOUTS]++;
+                if (exceptionOnTimeout) {
+                    throwTimeoutException(env, "NoPort", "<native>readBytes()", timeoutMilliseconds);
+                }
+                break;
+            }
+        }
+    }
+    endPortIO(&io);
+    if (bufferedContext != NULL) {
+        releasePortContext(bufferedContext);
+    }
+    return bytesRead;
+}
+
+/*
+ * Returns a new array holding the first length bytes of the given one
+ */
+static jbyteArray truncateByteArray(JNIEnv *env, jbyteArray array, jint length) {
+    jbyteArray returnArray = env->NewByteArray(length);
+    if(returnArray != NULL && length > 0){
+        jbyte *elements = env->GetByteArrayElements(array, NULL);
+        if(elements != NULL){
+            env->SetByteArrayRegion(returnArray, 0, length, elements);
+            env->ReleaseByteArrayElements(array, elements, JNI_ABORT);
+        }
+    }
+    return returnArray;
+}
+
+    /**
+     * Read data from port
+     * 
      * @param portHandle handle of opened port
      *
      * @param byteCount number of bytes to block and wait for, or 0 to return immediately
@@ -556,136 +2621,585 @@ JNIEXPORT jbyteArray JNICALL Java_jssc_SerialNativeInterface_readBytes
   (JNIEnv *env, jobject object, jlong portHandle, jint byteCount,
     jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
 
-    fd_set read_fd_set;
-    int byteRemains = byteCount;
-    struct timeval timeout;
-    int selectRetVal;
-    long timeoutDeadline = 0;
-    char deadlineValid=0;
-    char blockForever;
-    jclass threadClass = env->FindClass("java/lang/Thread");
-    jmethodID areWeInterruptedMethod = env->GetStaticMethodID(threadClass, "interrupted", "()Z");
+    if (byteCount > 0) {
+        //Read straight into the returned array, it only has to be copied on timeout
+        jbyteArray returnArray = env->NewByteArray(byteCount);
+        if (returnArray == NULL) {
+            return NULL;//OutOfMemoryError is pending
+        }
+        TransferBuffer target = {NULL, returnArray, 0};
+        jint bytesRead = readBytesToTarget(env, portHandle, &target, byteCount, 0, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+        if (bytesRead == byteCount || env->ExceptionCheck()) {
+            return returnArray;
+        }
+        return truncateByteArray(env, returnArray, bytesRead);
+    }
 
-    if (byteCount < 0)
-        byteCount = 0;
-    if (pollPeriodMillis < 0)
-        pollPeriodMillis = 0;
-        
-    blockForever = 0;
-    if (pollPeriodMillis == 0 && timeoutMilliseconds < 0) {
-        blockForever = 1;
+    //Size the array by the count of bytes available instead of returning at most 256 bytes (since 2.9.0)
+    jint available = 0;
+    if (ioctl(portHandle, FIONREAD, &available) < 0 || available < 0) {
+        available = 0;
     }
-    
-    if (!blockForever) {
-        if (byteCount == 0) {
-            //return immediately
-            timeoutDeadline = getTimePreciseMicros(env);
-            deadlineValid = 1;
-            byteRemains = 256; //return max 256 bytes when byteCount is 0;
-        } else {
-            if (timeoutMilliseconds < 0) {
-                //deadline is invalid, only pollPeriodMillis is used (which at this point we know is >0)
-                deadlineValid = 0;
-            } else {
-                timeoutDeadline = getTimePreciseMicros(env) + timeoutMilliseconds*1000;
-                deadlineValid = 1;
-            }
+    available += getInputRingBytesCount(portHandle);
+    if (available > 0) {
+        jbyteArray returnArray = env->NewByteArray(available);
+        if (returnArray == NULL) {
+            return NULL;//OutOfMemoryError is pending
         }
-        
-        if (getNextTimeout(env, &timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1 ) {
-            //Some error
-            //Return right away
-            timeout.tv_sec=0;
-            timeout.tv_usec=0;
+        TransferBuffer target = {NULL, returnArray, 0};
+        jint bytesRead = readBytesToTarget(env, portHandle, &target, 0, available, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+        if (bytesRead == available || env->ExceptionCheck()) {
+            return returnArray;
         }
+        return truncateByteArray(env, returnArray, bytesRead);
     }
 
-    jbyte *lpBuffer = new jbyte[byteRemains];
+    jbyte lpBuffer[256]; //Data may arrive meanwhile, and errors are reported as before
+    TransferBuffer target = {lpBuffer, NULL, 0};
+    jint bytesRead = readBytesToTarget(env, portHandle, &target, 0, sizeof(lpBuffer), timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    jbyteArray returnArray = env->NewByteArray(bytesRead);
+    if (returnArray != NULL && bytesRead > 0)
+        env->SetByteArrayRegion(returnArray, 0, bytesRead, lpBuffer);
+    return returnArray;
+}
 
-    do {    //while(byteRemains > 0)
-        FD_ZERO(&read_fd_set);
-        FD_SET(portHandle, &read_fd_set);
+/*
+ * Read data from port into a region of the given array.
+ *
+ * Same as readBytes, but the data is stored in buffer starting at offset and the
+ * number of bytes read is returned. No java objects are allocated.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesToArray
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    if (buffer == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytesToArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if (offset < 0 || byteCount < 0 || offset > arrayLength || byteCount > arrayLength - offset) {
+        throwSerialException(env, "NoPort", "<native>readBytesToArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if (byteCount == 0) {
+        return 0;
+    }
+    TransferBuffer target = {NULL, buffer, offset};
+    return readBytesToTarget(env, portHandle, &target, byteCount, 0, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+}
 
-        if (blockForever) {
-            selectRetVal = select(portHandle + 1, &read_fd_set, NULL, NULL, NULL);
-        } else {
-            selectRetVal = select(portHandle + 1, &read_fd_set, NULL, NULL, &timeout);
+/*
+ * Read whatever is available into a region of the given array, without waiting
+ * (since 2.9.0)
+ *
+ * Same as readBytesToArray with a byteCount of 0: the whole input backlog, at most
+ * maxLength bytes, is read by a single read() call. Returns the number of bytes read,
+ * possibly 0.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readAvailable
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint maxLength){
+    if (buffer == NULL) {
+        throwSerialException(env, "NoPort", "<native>readAvailable()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if (offset < 0 || maxLength < 0 || offset > arrayLength || maxLength > arrayLength - offset) {
+        throwSerialException(env, "NoPort", "<native>readAvailable()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if (maxLength == 0) {
+        return 0;
+    }
+    TransferBuffer target = {NULL, buffer, offset};
+    return readBytesToTarget(env, portHandle, &target, 0, maxLength, 0, 0, JNI_FALSE);
+}
+
+/*
+ * Read a packet delimited by line idle into a region of the given array (since 2.9.0)
+ *
+ * Waits as readBytesToArray for the first byte, then keeps reading until the line has
+ * been quiet for idleMicros or maxLength bytes have been read. The port is opened with
+ * O_NONBLOCK, which disables VMIN/VTIME, and VTIME only counts tenths of a second, so
+ * the idle time is measured by the select() timeout. Returns the number of bytes read,
+ * 0 on timeout. A hangup also ends the packet, a read error throws.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesUntilIdle
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint maxLength, jlong idleMicros,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    if (buffer == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytesUntilIdle()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if (offset < 0 || maxLength < 0 || idleMicros < 0 || offset > arrayLength || maxLength > arrayLength - offset) {
+        throwSerialException(env, "NoPort", "<native>readBytesUntilIdle()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if (maxLength == 0) {
+        return 0;
+    }
+    TransferBuffer target = {NULL, buffer, offset};
+    jint bytesRead = readBytesToTarget(env, portHandle, &target, 1, 0, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    if (bytesRead <= 0 || env->ExceptionCheck()) {
+        return bytesRead;
+    }
+
+    PortIO io;
+    beginPortIO(portHandle, &io);
+    PortContext *bufferedContext = acquireBufferedContext(portHandle);
+    InputRing *ring = (bufferedContext != NULL ? bufferedContext->ring : NULL);
+    jlong idleDeadline = getTimePreciseMicros() + idleMicros;
+    while (bytesRead < maxLength) {
+        int result = (ring != NULL ? readFromRing(env, io.context, portHandle, ring, &target, bytesRead, maxLength - bytesRead) :
+                                     readToTarget(env, io.context, portHandle, &target, bytesRead, maxLength - bytesRead));
+        io.counts[STAT_READ_CALLS]++;
+        if (result > 0) {
+            io.counts[STAT_BYTES_READ] += result;
+            bytesRead += result;
+            idleDeadline = getTimePreciseMicros() + idleMicros;
+            continue;
         }
+        if (result == 0) {
+            break;//Hangup, select() would report the port readable again right away
+        }
+        if (env->ExceptionCheck()) {
+            break;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            throwSerialException(env, "NoPort", "<native>readBytesUntilIdle()", (errno == EBADF ? SP_EXCEPTION_TYPE_PORT_NOT_OPENED : SP_EXCEPTION_TYPE_UNKNOWN));
+            break;
+        }
+        jlong idleRemains = idleDeadline - getTimePreciseMicros();
+        if (idleRemains <= 0) {
+            break;
+        }
+        struct timeval timeout;
+        timeout.tv_sec = (time_t)(idleRemains / 1000000);
+        timeout.tv_usec = (suseconds_t)(idleRemains % 1000000);
+        int waitFd = getInputWaitFd(portHandle, ring);
+        int selectRetVal = selectPortIO(&io, waitFd, 0, &timeout);
+        int selectErr = errno;//isThreadInterrupted() calls into java
+        if (isPortIOCancelled(&io)) {
+            throwPortIOCancelled(env, &io, "<native>readBytesUntilIdle()");
+            break;
+        }
+        if (selectRetVal == 0) {
+            continue;//The line is idle once the idle deadline has passed
+        }
+        if (selectRetVal > 0) {
+            markPortIOReady(&io, 0);
+        }
+        if (isThreadInterrupted(env)) {
+            throwInterruptedException(env, "Interrupted while waiting for serial data");
+            break;
+        }
+        if (selectRetVal == -1 && selectErr != EINTR) {
+            throwSerialException(env, "NoPort", "<native>readBytesUntilIdle()", (selectErr == EBADF ? SP_EXCEPTION_TYPE_PORT_NOT_OPENED : SP_EXCEPTION_TYPE_UNKNOWN));
+            break;
+        }
+    }
+    endPortIO(&io);
+    if (bufferedContext != NULL) {
+        releasePortContext(bufferedContext);
+    }
+    return bytesRead;
+}
 
-        // Check if the java thread has been interrupted, and if so, throw the exception
-        if (env->CallStaticBooleanMethod(threadClass, areWeInterruptedMethod)) {
-            jclass excClass = env->FindClass("java/lang/InterruptedException");
-            env->ThrowNew(excClass, "Interrupted while waiting for serial data");
-            // It shouldn't matter what we return, the exception will be thrown right away
+/*
+ * Read data from port into a direct ByteBuffer.
+ *
+ * Same as readBytes, but the data is stored in the memory of the direct buffer
+ * starting at position and the number of bytes read is returned. The buffer's
+ * position is not changed. No java objects are allocated.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesToBuffer
+  (JNIEnv *env, jobject object, jlong portHandle, jobject buffer, jint position, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jbyte *address = (buffer != NULL ? (jbyte*)env->GetDirectBufferAddress(buffer) : NULL);
+    if (address == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytesToBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (position < 0 || byteCount < 0 || position > capacity || byteCount > capacity - position) {
+        throwSerialException(env, "NoPort", "<native>readBytesToBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if (byteCount == 0) {
+        return 0;
+    }
+    TransferBuffer target = {address + position, NULL, 0};
+    return readBytesToTarget(env, portHandle, &target, byteCount, 0, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+}
+
+/*
+ * Framed reads (since 2.9.0)
+ *
+ * A frame either ends with a delimiter or starts with a header holding the length of
+ * the data following it. Frames are searched in the input ring of the port, which the
+ * first framed read creates if the port is not in buffered mode. Such a ring has no
+ * reader thread: the framed reads fill it from the port themselves and it keeps the
+ * bytes received past the end of a frame until the next read.
+ */
+#define FRAME_DELIMITER_MAX_LENGTH 64
+
+#define ringByteAt(ring, position) ((ring)->data[(position) & ((ring)->capacity - 1)])
+
+struct FrameFormat {
+    const jbyte *delimiter;         //NULL for frames with a length field
+    unsigned int delimiterLength;
+    unsigned int headerLength;      //Length of the header, the length field included
+    unsigned int lengthFieldOffset;
+    unsigned int lengthFieldSize;   //1 to 4 bytes
+    jboolean bigEndian;
+    int checksumType;               //CHECKSUM_NONE or the checksum ending each frame
+};
+
+/*
+ * Search the end of a frame in the available bytes of the ring starting at tail. For
+ * delimited frames scanned is the count of bytes already searched, it is updated so
+ * the same bytes are not searched again while the frame is incomplete. Returns the
+ * length of the frame, 0 if it is incomplete, or -1 if its header gives a length
+ * over maxLength, see readFrameToTarget(). A delimited frame is cut at maxLength bytes if no delimiter is found.
+ */
+static jint findFrameInRing(InputRing *ring, unsigned int tail, unsigned int available, const FrameFormat *format,
+    unsigned int maxLength, unsigned int *scanned) {
+    if(format->delimiter == NULL){
+        if(available < format->headerLength){
+            return 0;
+        }
+        unsigned int dataLength = 0;
+        for(unsigned int i = 0; i < format->lengthFieldSize; i++){
+            unsigned int index = (format->bigEndian ? i : format->lengthFieldSize - 1 - i);
+            dataLength = (dataLength << 8) | (unsigned char)ringByteAt(ring, tail + format->lengthFieldOffset + index);
+        }
+        if(dataLength > maxLength - format->headerLength){
+            return -1;
+        }
+        unsigned int frameLength = format->headerLength + dataLength;
+        return (available >= frameLength ? (jint)frameLength : 0);
+    }
+    unsigned int limit = (available < maxLength ? available : maxLength);
+    unsigned int position = *scanned;
+    while(position + format->delimiterLength <= limit){
+        //memchr() on the first byte of the delimiter, for each contiguous part of the ring
+        unsigned int offset = (tail + position) & (ring->capacity - 1);
+        unsigned int length = ring->capacity - offset;
+        if(length > limit - position){
+            length = limit - position;
+        }
+        const jbyte *found = (const jbyte*)memchr(ring->data + offset, format->delimiter[0], length);
+        if(found == NULL){
+            position += length;
+            continue;
+        }
+        position += (unsigned int)(found - (ring->data + offset));
+        if(position + format->delimiterLength > limit){
             break;
         }
-        if (selectRetVal == -1) {
-            int err = errno;
-            switch (err) {
-            case EBADF:
-                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_PORT_NOT_OPENED);
-                break;
-            case EINTR:
-                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_READ_INTERRUPTED);
-                break;
-            case EINVAL:
-                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
-                break;
-            case ENOMEM:
-                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_NO_MEMORY);
-                break;
-            default:
-                throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_UNKNOWN);
-                break;
-            }
-            break; //exit the loop
-        } else if (selectRetVal > 0) {
-            int result;
-            if (byteCount > 0)
-                result = read(portHandle, lpBuffer + (byteCount - byteRemains), byteRemains);
-            else
-                result = read(portHandle, lpBuffer, byteRemains);
+        unsigned int matched = 1;
+        while(matched < format->delimiterLength && ringByteAt(ring, tail + position + matched) == format->delimiter[matched]){
+            matched++;
+        }
+        if(matched == format->delimiterLength){
+            return (jint)(position + matched);
+        }
+        position++;
+    }
+    //The last bytes may be the start of a delimiter, search them again with the next data
+    *scanned = (limit >= format->delimiterLength ? limit - format->delimiterLength + 1 : 0);
+    return (available >= maxLength ? (jint)maxLength : 0);
+}
 
-            if(result > 0){
-                if (byteCount == 0) {
-                    byteCount = result;
-                    byteRemains = 0;
-                } else {
-                    byteRemains -= result;
-                }
+/*
+ * Check the checksum of a frame found by findFrameInRing(). The checksum covers the
+ * bytes of the frame up to itself and is stored at its end, before the delimiter for
+ * delimited frames. A delimited frame cut at maxLength is never valid.
+ */
+static char isFrameChecksumValid(InputRing *ring, unsigned int tail, unsigned int frameLength, const FrameFormat *format) {
+    unsigned int checksumSize = getChecksumSize(format->checksumType);
+    unsigned int trailerLength = checksumSize;
+    if(format->delimiter != NULL){
+        if(frameLength < format->delimiterLength + checksumSize){
+            return 0;
+        }
+        for(unsigned int i = 0; i < format->delimiterLength; i++){
+            if(ringByteAt(ring, tail + frameLength - format->delimiterLength + i) != format->delimiter[i]){
+                return 0;
             }
         }
+        trailerLength += format->delimiterLength;
+    }
+    else if(frameLength < format->headerLength + checksumSize){
+        return 0;
+    }
+    //The covered bytes are in at most two contiguous parts of the ring
+    unsigned int dataLength = frameLength - trailerLength;
+    unsigned int offset = tail & (ring->capacity - 1);
+    unsigned int firstLength = ring->capacity - offset;
+    if(firstLength > dataLength){
+        firstLength = dataLength;
+    }
+    unsigned int state = checksumStart(format->checksumType);
+    state = checksumUpdate(format->checksumType, state, ring->data + offset, firstLength);
+    state = checksumUpdate(format->checksumType, state, ring->data, dataLength - firstLength);
+    jbyte field[4];
+    for(unsigned int i = 0; i < checksumSize; i++){
+        field[i] = ringByteAt(ring, tail + dataLength + i);
+    }
+    return checksumFinish(format->checksumType, state) == readChecksum(format->checksumType, field);
+}
 
-        // Check if we've timed out and if so, throw the exception or return the data
-        if (byteRemains > 0 && byteCount != 0) {
-            if (!blockForever) {
-                if (getNextTimeout(env, &timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1) {
-                    //Some error
-                    //Return right away
-                    timeout.tv_sec=0;
-                    timeout.tv_usec=0;
-                }
-                if (timeout.tv_sec == 0 && timeout.tv_usec == 0) {
-                    //Timeout elapsed, but byteRemains > 0
-                    if (exceptionOnTimeout) {
-                        throwTimeoutException(env, "NoPort", "<native>readBytes()", timeoutMilliseconds);
-                    }
-                    break;
+/*
+ * Move what the driver holds into a ring without reader thread, must be called with
+ * consumerLock held
+ */
+static void fillRingFromPort(PortContext *context, jlong portHandle, InputRing *ring) {
+    while(true){
+        unsigned int head = ring->head;
+        unsigned int space = ring->capacity - (head - ring->tail);
+        if(space == 0){
+            return;
+        }
+        unsigned int offset = head & (ring->capacity - 1);
+        unsigned int length = ring->capacity - offset;
+        if(length > space){
+            length = space;
+        }
+        ssize_t result = read(portHandle, ring->data + offset, length);
+        if(result <= 0){
+            return;
+        }
+        capturePortData(context, CAPTURE_READ, ring->data + offset, (jint)result);
+        ringStore(ring->head, head + (unsigned int)result);
+        if((unsigned int)result < length){
+            return;
+        }
+    }
+}
+
+/*
+ * Read engine of "_readUntil" and "_readFrame". Waits for a complete frame in the ring
+ * and copies it into the target, returns its length or 0 on timeout. The bytes of an
+ * incomplete frame stay in the ring, frames with a wrong checksum are dropped without
+ * being copied. On error, interruption or timeout (if exceptionOnTimeout is set) a java
+ * exception is left pending.
+ *
+ * A header giving a length over maxLength is taken for a lost synchronization: its first
+ * byte is dropped and counted as a framing error, and the search goes on from the next
+ * one. With a checksum the frames found that way are checked like any other, so the
+ * search simply continues. Without one nothing tells a real frame from noise, so the
+ * read fails and the next read goes on from the next byte.
+ */
+static jint readFrameToTarget(JNIEnv *env, jlong portHandle, InputRing *ring, TransferBuffer *target, unsigned int maxLength,
+    const FrameFormat *format, const char *methodName, jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+
+    struct timeval timeout;
+    jlong timeoutDeadline = 0;
+    char deadlineValid = 0;
+    char blockForever = 0;
+    PortIO io;//since 2.9.0
+    unsigned int scanned = 0;
+    unsigned int scannedTail = 0;
+    jint frameLength = 0;
+
+    if (pollPeriodMillis < 0)
+        pollPeriodMillis = 0;
+    if (pollPeriodMillis == 0 && timeoutMilliseconds < 0) {
+        blockForever = 1;
+    }
+    else if (timeoutMilliseconds >= 0) {
+        timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+        deadlineValid = 1;
+    }
+
+    beginPortIO(portHandle, &io);
+    while(true) {
+        pthread_mutex_lock(&ring->consumerLock);
+        char running = ringLoad(ring->running);
+        //Clear the notification before searching, it is set again by new data or below
+        ringStore(ring->dataSignalled, 0);
+        drainPipe(ring->notifyPipe[0]);
+        if(!running){
+            fillRingFromPort(io.context, portHandle, ring);
+        }
+        unsigned int tail = ring->tail;
+        if(tail != scannedTail){
+            //Another thread has read from the ring meanwhile
+            scanned = 0;
+            scannedTail = tail;
+        }
+        frameLength = findFrameInRing(ring, tail, ringLoad(ring->head) - tail, format, maxLength, &scanned);
+        char dropped = 0;
+        while(frameLength < 0 || (frameLength > 0 && format->checksumType != CHECKSUM_NONE &&
+              !isFrameChecksumValid(ring, tail, (unsigned int)frameLength, format))){
+            if(frameLength < 0){
+                tail++;
+                io.frameErrors++;
+            }
+            else {
+                tail += (unsigned int)frameLength;
+            }
+            ringStore(ring->tail, tail);
+            dropped = 1;
+            scanned = 0;
+            scannedTail = tail;
+            if(frameLength < 0 && format->checksumType == CHECKSUM_NONE){
+                break;
+            }
+            frameLength = findFrameInRing(ring, tail, ringLoad(ring->head) - tail, format, maxLength, &scanned);
+        }
+        if(frameLength > 0){
+            copyFromRing(env, ring, tail, target, 0, (unsigned int)frameLength);
+            ringStore(ring->tail, tail + (unsigned int)frameLength);
+            io.counts[STAT_BYTES_READ] += (unsigned int)frameLength;
+        }
+        io.counts[STAT_READ_CALLS]++;
+        pthread_mutex_unlock(&ring->consumerLock);
+        if((frameLength != 0 || dropped) && ringExchange(ring->spaceWanted, 0) == 1){
+            signalPipe(ring->controlPipe[1]);
+        }
+        if(frameLength != 0){
+            break;
+        }
+        //The reader thread also signals the pipe when it exits
+        int waitFd = (running ? ring->notifyPipe[0] : (int)portHandle);
+        if (!blockForever) {
+            if (getNextTimeout(&timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1) {
+                timeout.tv_sec = 0;
+                timeout.tv_usec = 0;
+            }
+            if (timeout.tv_sec == 0 && timeout.tv_usec == 0) {
+                io.counts[STAT_TIMEOUTS]++;
+                if (exceptionOnTimeout) {
+                    throwTimeoutException(env, "NoPort", methodName, timeoutMilliseconds);
                 }
+                break;
             }
         }
+        int selectRetVal = selectPortIO(&io, waitFd, 0, (blockForever ? NULL : &timeout));
+        if (selectRetVal > 0) {
+            markPortIOReady(&io, 1);
+        }
+        if (isPortIOCancelled(&io)) {
+            throwPortIOCancelled(env, &io, methodName);
+            break;
+        }
+        if (isThreadInterrupted(env)) {
+            throwInterruptedException(env, "Interrupted while waiting for serial data");
+            break;
+        }
+        if (selectRetVal == -1 && errno != EINTR) {
+            throwSerialException(env, "NoPort", methodName, (errno == EBADF ? SP_EXCEPTION_TYPE_PORT_NOT_OPENED : SP_EXCEPTION_TYPE_UNKNOWN));
+            break;
+        }
+    }
+    endPortIO(&io);
+    //Keep the pipe readable for the other reading threads while data is left
+    if(ringLoad(ring->head) != ringLoad(ring->tail) && ringExchange(ring->dataSignalled, 1) == 0){
+        signalPipe(ring->notifyPipe[1]);
+    }
+    if(frameLength < 0){
+        throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    return frameLength;
+}
 
-        if (byteCount == 0) {
-            //Couldn't read any data on non-blocking read
-            byteRemains = 0;
+/*
+ * Common part of "_readUntil" and "_readFrame": finds the input ring of the port,
+ * creating it with at least maxLength bytes if the port has none, and reads a frame
+ */
+static jint readFrameFromPort(JNIEnv *env, jlong portHandle, TransferBuffer *target, jint maxLength, const FrameFormat *format,
+    const char *methodName, jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    PortContext *context = acquireBufferedContext(portHandle);
+    InputRing *ring = (context != NULL ? context->ring : NULL);
+    if(context == NULL){
+        context = acquirePortContext(portHandle);
+        if(context == NULL){
+            throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_PORT_NOT_OPENED);
+            return -1;
+        }
+        pthread_mutex_lock(&inputReadersLock);
+        ring = createInputRing(context, maxLength);
+        pthread_mutex_unlock(&inputReadersLock);
+        if(ring == NULL){
+            releasePortContext(context);
+            throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_NO_MEMORY);
+            return -1;
         }
-    } while(byteRemains > 0);
+    }
+    //A frame can't be longer than the ring, whose capacity is smaller than maxLength if the buffered mode created it
+    unsigned int limit = ((unsigned int)maxLength < ring->capacity ? (unsigned int)maxLength : ring->capacity);
+    if(format->headerLength > limit){
+        releasePortContext(context);
+        throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint result = readFrameToTarget(env, portHandle, ring, target, limit, format, methodName,
+                                    timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    releasePortContext(context);
+    return result;
+}
 
-    jbyteArray returnArray = env->NewByteArray(byteCount-byteRemains);
-    if (byteCount > 0)
-        env->SetByteArrayRegion(returnArray, 0, byteCount-byteRemains, lpBuffer);
-    delete lpBuffer;
-    return returnArray;
+/*
+ * Read a frame ending with the given delimiter into buffer starting at offset
+ * (since 2.9.0)
+ *
+ * Returns the length of the frame, delimiter included. If no delimiter is found within
+ * maxLength bytes, maxLength bytes are returned as they are. Returns 0 on timeout, the
+ * bytes already received are then kept for the next read. If checksumType is not
+ * CHECKSUM_NONE, only the frames ending with a valid checksum before the delimiter are
+ * returned.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readUntil
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray delimiter, jbyteArray buffer, jint offset, jint maxLength,
+    jint checksumType, jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jint delimiterLength = (delimiter != NULL ? env->GetArrayLength(delimiter) : 0);
+    jint arrayLength = (buffer != NULL ? env->GetArrayLength(buffer) : 0);
+    if (buffer == NULL || delimiterLength <= 0 || delimiterLength > FRAME_DELIMITER_MAX_LENGTH || maxLength < delimiterLength ||
+        offset < 0 || offset > arrayLength || maxLength > arrayLength - offset ||
+        (checksumType != CHECKSUM_NONE && getChecksumSize(checksumType) == 0)) {
+        throwSerialException(env, "NoPort", "<native>readUntil()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jbyte delimiterBytes[FRAME_DELIMITER_MAX_LENGTH];
+    env->GetByteArrayRegion(delimiter, 0, delimiterLength, delimiterBytes);
+    FrameFormat format = {delimiterBytes, (unsigned int)delimiterLength, 0, 0, 0, JNI_FALSE, checksumType};
+    TransferBuffer target = {NULL, buffer, offset};
+    return readFrameFromPort(env, portHandle, &target, maxLength, &format, "<native>readUntil()",
+                             timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+}
+
+/*
+ * Read a frame starting with a header of headerLength bytes into buffer starting at
+ * offset (since 2.9.0)
+ *
+ * The header holds an unsigned length field of lengthFieldSize bytes (1 to 4) at
+ * lengthFieldOffset, giving the count of bytes following the header. Returns the length
+ * of the frame, header included, or 0 on timeout. If checksumType is not CHECKSUM_NONE,
+ * the last bytes counted by the length field are a checksum of the rest of the frame,
+ * and only the frames with a valid checksum are returned. A header giving a frame longer
+ * than maxLength loses its first byte, which is counted as a framing error; without
+ * checksum a SerialPortException is then thrown, with one the search goes on.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readFrame
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint maxLength, jint headerLength,
+    jint lengthFieldOffset, jint lengthFieldSize, jboolean bigEndian, jint checksumType, jlong timeoutMilliseconds,
+    jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jint arrayLength = (buffer != NULL ? env->GetArrayLength(buffer) : 0);
+    if (buffer == NULL || lengthFieldSize < 1 || lengthFieldSize > 4 || lengthFieldOffset < 0 ||
+        lengthFieldOffset > headerLength - lengthFieldSize || headerLength > maxLength ||
+        offset < 0 || offset > arrayLength || maxLength > arrayLength - offset ||
+        (checksumType != CHECKSUM_NONE && getChecksumSize(checksumType) == 0)) {
+        throwSerialException(env, "NoPort", "<native>readFrame()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    FrameFormat format = {NULL, 0, (unsigned int)headerLength, (unsigned int)lengthFieldOffset, (unsigned int)lengthFieldSize, bigEndian,
+                          checksumType};
+    TransferBuffer target = {NULL, buffer, offset};
+    return readFrameFromPort(env, portHandle, &target, maxLength, &format, "<native>readFrame()",
+                             timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
 }
 
 /* OK */
@@ -698,18 +3212,121 @@ JNIEXPORT jintArray JNICALL Java_jssc_SerialNativeInterface_getBuffersBytesCount
     returnValues[0] = -1; //Input buffer
     returnValues[1] = -1; //Output buffer
     jintArray returnArray = env->NewIntArray(2);
-    ioctl(portHandle, FIONREAD, &returnValues[0]);
+    if(ioctl(portHandle, FIONREAD, &returnValues[0]) >= 0){
+        returnValues[0] += getInputRingBytesCount(portHandle);//since 2.9.0
+    }
     ioctl(portHandle, TIOCOUTQ, &returnValues[1]);
     env->SetIntArrayRegion(returnArray, 0, 2, returnValues);
     return returnArray;
 }
 
+/*
+ * Enable the buffered mode of a port (since 2.9.0)
+ *
+ * Starts the reader thread, the input ring is created on the first call. Returns
+ * JNI_TRUE if the reader thread is running.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_bufferedReaderStart
+  (JNIEnv *env, jobject object, jlong portHandle, jint capacity){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    pthread_mutex_lock(&inputReadersLock);
+    char started = startInputReader(context, capacity);
+    pthread_mutex_unlock(&inputReadersLock);
+    releasePortContext(context);
+    return (started ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Disable the buffered mode of a port (since 2.9.0)
+ *
+ * Stops the reader thread. The data already in the input ring is read before the port.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_bufferedReaderStop
+  (JNIEnv *env, jobject object, jlong portHandle){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    pthread_mutex_lock(&inputReadersLock);
+    stopInputReader(context);
+    pthread_mutex_unlock(&inputReadersLock);
+    releasePortContext(context);
+    return JNI_TRUE;
+}
+
+/*
+ * Set the scheduling of the reader thread of a port (since 2.9.0)
+ *
+ * The settings are kept in the port context: the CPU mask and the priority are applied
+ * to the running reader thread and to every one started later, the ring is locked in
+ * memory now or when it is created. Returns the combination of SCHEDULING_* applied
+ * at once, so 0 if the port has neither a ring nor a reader thread yet.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setReaderScheduling
+  (JNIEnv *env, jobject object, jlong portHandle, jlong cpuMask, jint priority, jboolean lockMemory){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return 0;
+    }
+    jint applied = 0;
+    pthread_mutex_lock(&inputReadersLock);
+    context->readerCpuMask = cpuMask;
+    context->readerPriority = priority;
+    context->readerMemoryLocked = (lockMemory == JNI_TRUE ? 1 : 0);
+    pthread_mutex_lock(&context->lock);
+    InputRing *ring = context->ring;
+    pthread_mutex_unlock(&context->lock);
+    if(ring != NULL){
+        if(ring->threadStarted){
+            applied |= applyThreadScheduling(ring->thread, cpuMask, priority);
+        }
+        if(lockInputRing(ring, context->readerMemoryLocked)){
+            applied |= SCHEDULING_MEMORY_LOCKED;
+        }
+    }
+    pthread_mutex_unlock(&inputReadersLock);
+    releasePortContext(context);
+    return applied;
+}
+
+/*
+ * Set the scheduling of the calling thread (since 2.9.0), used by the thread of
+ * SerialPortReactor. Returns the combination of SCHEDULING_* which could be applied.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setThreadScheduling
+  (JNIEnv *env, jobject object, jlong cpuMask, jint priority){
+    return applyThreadScheduling(pthread_self(), cpuMask, priority);
+}
+
 const jint FLOWCONTROL_NONE = 0;
 const jint FLOWCONTROL_RTSCTS_IN = 1;
 const jint FLOWCONTROL_RTSCTS_OUT = 2;
 const jint FLOWCONTROL_XONXOFF_IN = 4;
 const jint FLOWCONTROL_XONXOFF_OUT = 8;
 
+/*
+ * Set the flow control flags of settings from a mask of FLOWCONTROL_* (since 2.9.0 shared
+ * with "_configure")
+ */
+static void buildFlowControl(termios *settings, jint mask) {
+    settings->c_cflag &= ~CRTSCTS;
+    settings->c_iflag &= ~(IXON | IXOFF);
+    if(mask != FLOWCONTROL_NONE){
+        if(((mask & FLOWCONTROL_RTSCTS_IN) == FLOWCONTROL_RTSCTS_IN) || ((mask & FLOWCONTROL_RTSCTS_OUT) == FLOWCONTROL_RTSCTS_OUT)){
+            settings->c_cflag |= CRTSCTS;
+        }
+        if((mask & FLOWCONTROL_XONXOFF_IN) == FLOWCONTROL_XONXOFF_IN){
+            settings->c_iflag |= IXOFF;
+        }
+        if((mask & FLOWCONTROL_XONXOFF_OUT) == FLOWCONTROL_XONXOFF_OUT){
+            settings->c_iflag |= IXON;
+        }
+    }
+}
+
 /* OK */
 /*
  * Setting flow control mode
@@ -717,26 +3334,13 @@ const jint FLOWCONTROL_XONXOFF_OUT = 8;
 JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setFlowControlMode
   (JNIEnv *env, jobject object, jlong portHandle, jint mask){
     jboolean returnValue = JNI_FALSE;
-    termios *settings = new termios();
-    if(tcgetattr(portHandle, settings) == 0){
-        settings->c_cflag &= ~CRTSCTS;
-        settings->c_iflag &= ~(IXON | IXOFF);
-        if(mask != FLOWCONTROL_NONE){
-            if(((mask & FLOWCONTROL_RTSCTS_IN) == FLOWCONTROL_RTSCTS_IN) || ((mask & FLOWCONTROL_RTSCTS_OUT) == FLOWCONTROL_RTSCTS_OUT)){
-                settings->c_cflag |= CRTSCTS;
-            }
-            if((mask & FLOWCONTROL_XONXOFF_IN) == FLOWCONTROL_XONXOFF_IN){
-                settings->c_iflag |= IXOFF;
-            }
-            if((mask & FLOWCONTROL_XONXOFF_OUT) == FLOWCONTROL_XONXOFF_OUT){
-                settings->c_iflag |= IXON;
-            }
-        }
-        if(tcsetattr(portHandle, TCSANOW, settings) == 0){
+    termios settings;
+    if(getPortSettings(portHandle, &settings) == 0){
+        buildFlowControl(&settings, mask);
+        if(setPortSettings(portHandle, &settings) == 0){
             returnValue = JNI_TRUE;
         }
     }
-    delete settings;
     return returnValue;
 }
 
@@ -747,15 +3351,15 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setFlowControlMode
 JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_getFlowControlMode
   (JNIEnv *env, jobject object, jlong portHandle){
     jint returnValue = 0;
-    termios *settings = new termios();
-    if(tcgetattr(portHandle, settings) == 0){
-        if(settings->c_cflag & CRTSCTS){
+    termios settings;
+    if(getPortSettings(portHandle, &settings) == 0){
+        if(settings.c_cflag & CRTSCTS){
             returnValue |= (FLOWCONTROL_RTSCTS_IN | FLOWCONTROL_RTSCTS_OUT);
         }
-        if(settings->c_iflag & IXOFF){
+        if(settings.c_iflag & IXOFF){
             returnValue |= FLOWCONTROL_XONXOFF_IN;
         }
-        if(settings->c_iflag & IXON){
+        if(settings.c_iflag & IXON){
             returnValue |= FLOWCONTROL_XONXOFF_OUT;
         }
     }
@@ -773,11 +3377,10 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_sendBreak
         if(ioctl(portHandle, TIOCSBRK, 0) >= 0){
             int sec = (duration >= 1000 ? duration/1000 : 0);
             int nanoSec = (sec > 0 ? duration - sec*1000 : duration)*1000000;
-            struct timespec *timeStruct = new timespec();
-            timeStruct->tv_sec = sec;
-            timeStruct->tv_nsec = nanoSec;
-            nanosleep(timeStruct, NULL);
-            delete(timeStruct);
+            struct timespec timeStruct;
+            timeStruct.tv_sec = sec;
+            timeStruct.tv_nsec = nanoSec;
+            nanosleep(&timeStruct, NULL);
             if(ioctl(portHandle, TIOCCBRK, 0) >= 0){
                 returnValue = JNI_TRUE;
             }
@@ -786,6 +3389,138 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_sendBreak
     return returnValue;
 }
 
+#define LOW_LATENCY_ASYNC_FLAG  1
+#define LOW_LATENCY_TIMER       2
+
+#ifdef __linux__
+//Latency timer of the FTDI adapters in milliseconds, 16 is the default of ftdi_sio
+#define FTDI_LATENCY_TIMER_LOW      1
+#define FTDI_LATENCY_TIMER_DEFAULT  16
+
+/*
+ * Write the latency timer of an ftdi_sio adapter, found in sysfs from the device number
+ * of the port. Returns 0 if the port has no latency timer or it couldn't be written
+ * (the attribute is usually only writable by root, unless a udev rule allows it).
+ */
+static char setLatencyTimer(jlong portHandle, int millis) {
+    struct stat portStat;
+    if(fstat(portHandle, &portStat) != 0 || !S_ISCHR(portStat.st_mode)){
+        return 0;
+    }
+    char path[80];
+    snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/device/latency_timer",
+             (unsigned int)major(portStat.st_rdev), (unsigned int)minor(portStat.st_rdev));
+    int fd = open(path, O_WRONLY);
+    if(fd < 0){
+        return 0;
+    }
+    char value[16];
+    int length = snprintf(value, sizeof(value), "%d", millis);
+    char written = (write(fd, value, length) == length);
+    close(fd);
+    return written;
+}
+#endif
+
+/*
+ * Set the low latency mode of the driver and the adapter, see "_setLowLatency"
+ */
+static jint applyLowLatency(jlong portHandle, jboolean enabled) {
+    jint applied = 0;
+#if defined __linux__
+    serial_struct serial_info;
+    if(ioctl(portHandle, TIOCGSERIAL, &serial_info) >= 0){
+        if(enabled == JNI_TRUE){
+            serial_info.flags |= ASYNC_LOW_LATENCY;
+        }
+        else {
+            serial_info.flags &= ~ASYNC_LOW_LATENCY;
+        }
+        if(ioctl(portHandle, TIOCSSERIAL, &serial_info) >= 0){
+            applied |= LOW_LATENCY_ASYNC_FLAG;
+        }
+    }
+    if(setLatencyTimer(portHandle, (enabled == JNI_TRUE ? FTDI_LATENCY_TIMER_LOW : FTDI_LATENCY_TIMER_DEFAULT))){
+        applied |= LOW_LATENCY_TIMER;
+    }
+#elif defined __APPLE__
+    unsigned long latency = (enabled == JNI_TRUE ? 1 : 0);
+    if(ioctl(portHandle, IOSSDATALAT, &latency) >= 0){
+        applied |= LOW_LATENCY_ASYNC_FLAG;
+    }
+#endif
+    return applied;
+}
+
+/*
+ * Enable or disable the low latency mode of a port (since 2.9.0)
+ *
+ * Asks the driver to pass received data on without delay: ASYNC_LOW_LATENCY on Linux,
+ * a receive latency of 1 microsecond instead of a filled DMA buffer (IOSSDATALAT) on
+ * Mac OS X. On Linux the latency timer of FTDI adapters is also lowered from 16 ms to
+ * 1 ms. Returns the combination of LOW_LATENCY_* flags which could be applied.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setLowLatency
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
+    jint applied = applyLowLatency(portHandle, enabled);
+    PortContext *context = acquirePortContext(portHandle);
+    if(context != NULL){
+        ringStore(context->lowLatency, (char)(enabled == JNI_TRUE ? 1 : 0));
+        releasePortContext(context);
+    }
+    return applied;
+}
+
+/*
+ * Apply the line parameters, the flow control and the low latency mode in one call
+ * (since 2.9.0)
+ *
+ * The settings are built from the copy kept in the port context, as "_setParams" and
+ * "_setFlowControlMode" would, and applied by a single tcsetattr() (TCSETS2 on Linux for
+ * a rate without Bxxx constant), or not at all if they don't change anything. The low
+ * latency mode is changed if flags has PARAMS_FLAG_LOW_LATENCY_ON or _OFF and it differs
+ * from the last mode applied, a failure of the driver to change it is not reported. RTS
+ * and DTR are left as they are, so this can be called repeatedly on a live line, for
+ * instance to probe the baud rate. VMIN and VTIME stay 0: the reads use O_NONBLOCK and
+ * select(), where they have no effect.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_configure
+  (JNIEnv *env, jobject object, jlong portHandle, jint baudRate, jint byteSize, jint stopBits, jint parity, jint flowControlMask, jint flags){
+    termios current;
+    if(getPortSettings(portHandle, &current) != 0){
+        return JNI_FALSE;
+    }
+    termios settings = current;
+    if(buildPortSettings(&settings, baudRate, byteSize, stopBits, parity, flags) != 0){
+        return JNI_FALSE;
+    }
+    buildFlowControl(&settings, flowControlMask);
+    //The current rate of BOTHER is not part of the settings, such rates are always applied
+    char unchanged = (getBaudRateByNum(baudRate) != (speed_t)-1 &&
+                      settings.c_iflag == current.c_iflag && settings.c_oflag == current.c_oflag &&
+                      settings.c_cflag == current.c_cflag && settings.c_lflag == current.c_lflag &&
+                      cfgetispeed(&settings) == cfgetispeed(&current) && cfgetospeed(&settings) == cfgetospeed(&current) &&
+                      memcmp(settings.c_cc, current.c_cc, sizeof(settings.c_cc)) == 0);
+    if(!unchanged && applyPortSettings(portHandle, &settings, baudRate) != 0){
+        return JNI_FALSE;
+    }
+    if(flags & (PARAMS_FLAG_LOW_LATENCY_ON | PARAMS_FLAG_LOW_LATENCY_OFF)){
+        char enabled = ((flags & PARAMS_FLAG_LOW_LATENCY_ON) ? 1 : 0);
+        PortContext *context = acquirePortContext(portHandle);
+        char applied = (context != NULL ? ringLoad(context->lowLatency) : -1);
+        if(applied != enabled){
+            applyLowLatency(portHandle, (enabled ? JNI_TRUE : JNI_FALSE));
+            if(context != NULL){
+                ringStore(context->lowLatency, enabled);//Concurrent calls may both apply it, which is harmless
+            }
+        }
+        if(context != NULL){
+            releasePortContext(context);
+        }
+    }
+    return JNI_TRUE;
+}
+
 /* OK */
 /*
  * Return "statusLines" from ioctl(portHandle, TIOCMGET, &statusLines)
@@ -811,15 +3546,14 @@ int getLinesStatus(jlong portHandle) {
  */
 void getInterruptsCount(jlong portHandle, int intArray[]) {
 #ifdef TIOCGICOUNT
-    struct serial_icounter_struct *icount = new serial_icounter_struct();
-    if(ioctl(portHandle, TIOCGICOUNT, icount) >= 0){
-        intArray[0] = icount->brk;
-        intArray[1] = icount->tx;
-        intArray[2] = icount->frame;
-        intArray[3] = icount->overrun;
-        intArray[4] = icount->parity;
+    struct serial_icounter_struct icount;//since 2.9.0 on the stack, this is called by every event wait
+    if(ioctl(portHandle, TIOCGICOUNT, &icount) >= 0){
+        intArray[0] = icount.brk;
+        intArray[1] = icount.tx;
+        intArray[2] = icount.frame;
+        intArray[3] = icount.overrun;
+        intArray[4] = icount.parity;
     }
-    delete icount;
 #endif
 }
 
@@ -836,6 +3570,13 @@ const jint EV_RLSD = 32;
 const jint EV_RXCHAR = 1;
 //const jint EV_RXFLAG = 2; //Not supported
 const jint EV_TXEMPTY = 4;
+const jint EV_BREAK = 64;//Only reported by the event waiter (since 2.9.0)
+const jint EV_ERR = 128;//Only reported by the event waiter (since 2.9.0)
+
+//Values of the EV_ERR event, the same as the CE_ flags of Windows
+const jint ERROR_OVERRUN = 0x0002;
+const jint ERROR_PARITY = 0x0004;
+const jint ERROR_FRAME = 0x0008;
 const jint events[] = {INTERRUPT_BREAK,
                        INTERRUPT_TX,
                        INTERRUPT_FRAME,
@@ -849,123 +3590,746 @@ const jint events[] = {INTERRUPT_BREAK,
                        //EV_RXFLAG, //Not supported
                        EV_TXEMPTY};
 
-/* OK */
+#define EVENTS_COUNT (sizeof(events)/sizeof(jint))
+
+//Groups of values sampled together by sampleEvents()
+#define EVENTS_SAMPLE_INPUT     1   //FIONREAD
+#define EVENTS_SAMPLE_OUTPUT    2   //TIOCOUTQ
+#define EVENTS_SAMPLE_LINES     4   //TIOCMGET
+#define EVENTS_SAMPLE_COUNTERS  8   //TIOCGICOUNT
+#define EVENTS_SAMPLE_ALL       15
+
+/*
+ * Returns the sample group of an entry of events[]
+ */
+static jint getSampleGroup(jint event) {
+    switch(event) {
+        case EV_RXCHAR:
+            return EVENTS_SAMPLE_INPUT;
+        case EV_TXEMPTY:
+            return EVENTS_SAMPLE_OUTPUT;
+        case EV_CTS:
+        case EV_DSR:
+        case EV_RING:
+        case EV_RLSD:
+            return EVENTS_SAMPLE_LINES;
+        default:
+            return EVENTS_SAMPLE_COUNTERS;
+    }
+}
+
+/*
+ * Sample the values reported for the entries of events[] which belong to one of
+ * "groups", the other values are left unchanged (since 2.9.0, was part of "_waitEvents")
+ */
+static void sampleEvents(jlong portHandle, jint values[], jint groups) {
+
+    /*Input buffer*/
+    jint bytesCountIn = 0;
+    if(groups & EVENTS_SAMPLE_INPUT){
+        ioctl(portHandle, FIONREAD, &bytesCountIn);
+        bytesCountIn += getInputRingBytesCount(portHandle);//since 2.9.0
+    }
+    
+    /*Output buffer*/
+    jint bytesCountOut = 0;
+    if(groups & EVENTS_SAMPLE_OUTPUT){
+        ioctl(portHandle, TIOCOUTQ, &bytesCountOut);
+    }
+
+    /*Lines status*/
+    int statusLines = 0;
+    if(groups & EVENTS_SAMPLE_LINES){
+        statusLines = getLinesStatus(portHandle);
+    }
+
+    jint statusCTS = 0;
+    jint statusDSR = 0;
+    jint statusRING = 0;
+    jint statusRLSD = 0;
+    
+    /*CTS status*/
+    if(statusLines & TIOCM_CTS){
+        statusCTS = 1;
+    }
+
+    /*DSR status*/
+    if(statusLines & TIOCM_DSR){
+        statusDSR = 1;
+    }
+
+    /*RING status*/
+    if(statusLines & TIOCM_RNG){
+        statusRING = 1;
+    }
+
+    /*RLSD(DCD) status*/
+    if(statusLines & TIOCM_CAR){
+        statusRLSD = 1;
+    }
+
+    /*Interrupts*/
+    int interrupts[] = {-1, -1, -1, -1, -1};
+    if(groups & EVENTS_SAMPLE_COUNTERS){
+        getInterruptsCount(portHandle, interrupts);
+    }
+
+    for(size_t i = 0; i < EVENTS_COUNT; i++){
+        if(!(groups & getSampleGroup(events[i]))){
+            continue;
+        }
+        switch(events[i]) {
+            case INTERRUPT_BREAK: //Interrupt Break - for BREAK event
+                values[i] = interrupts[0];
+                break;
+            case INTERRUPT_TX: //Interrupt TX - for TXEMPTY event
+                values[i] = interrupts[1];
+                break;
+            case INTERRUPT_FRAME: //Interrupt Frame - for ERR event
+                values[i] = interrupts[2];
+                break;
+            case INTERRUPT_OVERRUN: //Interrupt Overrun - for ERR event
+                values[i] = interrupts[3];
+                break;
+            case INTERRUPT_PARITY: //Interrupt Parity - for ERR event
+                values[i] = interrupts[4];
+                break;
+            case EV_CTS:
+                values[i] = statusCTS;
+                break;
+            case EV_DSR:
+                values[i] = statusDSR;
+                break;
+            case EV_RING:
+                values[i] = statusRING;
+                break;
+            case EV_RLSD: /*DCD*/
+                values[i] = statusRLSD;
+                break;
+            case EV_RXCHAR:
+                values[i] = bytesCountIn;
+                break;
+            /*case EV_RXFLAG: // Event RXFLAG - Not supported
+                values[i] = 0;
+                break;*/
+            case EV_TXEMPTY:
+                values[i] = bytesCountOut;
+                break;
+        }
+    }
+}
+
+/*
+ * Build the int[][] of {event, value} pairs returned to java, only the entries with
+ * a non zero "selected" flag are included
+ */
+static jobjectArray newEventsArray(JNIEnv *env, const jint values[], const char selected[]) {
+    jsize count = 0;
+    for(size_t i = 0; i < EVENTS_COUNT; i++){
+        if(selected[i]){
+            count++;
+        }
+    }
+    jobjectArray returnArray = env->NewObjectArray(count, getIntArrayClass(), NULL);
+    if(returnArray == NULL){
+        return NULL;
+    }
+    jsize index = 0;
+    for(size_t i = 0; i < EVENTS_COUNT; i++){
+        if(selected[i]){
+            jint returnValues[2];
+            returnValues[0] = events[i];
+            returnValues[1] = values[i];
+            jintArray singleResultArray = env->NewIntArray(2);
+            env->SetIntArrayRegion(singleResultArray, 0, 2, returnValues);
+            env->SetObjectArrayElement(returnArray, index++, singleResultArray);
+            env->DeleteLocalRef(singleResultArray);
+        }
+    }
+    return returnArray;
+}
+
+/*
+ * Store the {event, value} pairs with a non zero "selected" flag in "buffer" (at most
+ * length / 2 pairs, since 2.9.0) and return the bitmask of the stored event types
+ */
+static jint storeEventPairs(JNIEnv *env, jintArray buffer, const jint values[], const char selected[]) {
+    jint pairs[EVENTS_COUNT * 2];
+    jint maxCount = env->GetArrayLength(buffer) / 2;
+    jint count = 0;
+    jint eventsMask = 0;
+    for(size_t i = 0; i < EVENTS_COUNT && count < maxCount; i++){
+        if(selected[i]){
+            pairs[count * 2] = events[i];
+            pairs[count * 2 + 1] = values[i];
+            eventsMask |= events[i];
+            count++;
+        }
+    }
+    if(count > 0){
+        env->SetIntArrayRegion(buffer, 0, count * 2, pairs);
+    }
+    return eventsMask;
+}
+
+/* OK */
+/*
+ * Collecting data for EventListener class (Linux have no implementation of "WaitCommEvent" function from Windows)
+ * 
+ */
+JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
+  (JNIEnv *env, jobject object, jlong portHandle) {
+    jint values[EVENTS_COUNT];
+    char selected[EVENTS_COUNT];
+    sampleEvents(portHandle, values, EVENTS_SAMPLE_ALL);
+    for(size_t i = 0; i < EVENTS_COUNT; i++){
+        selected[i] = 1;
+    }
+    return newEventsArray(env, values, selected);
+}
+
+/*
+ * Same as "_waitEvents", but the pairs are stored in the flat "buffer" (event at even,
+ * value at odd indexes) with no allocation (since 2.9.0)
+ *
+ * Returns the bitmask of the stored event types.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_waitEventsInto
+  (JNIEnv *env, jobject object, jlong portHandle, jintArray buffer) {
+    jint values[EVENTS_COUNT];
+    char selected[EVENTS_COUNT];
+    sampleEvents(portHandle, values, EVENTS_SAMPLE_ALL);
+    for(size_t i = 0; i < EVENTS_COUNT; i++){
+        selected[i] = 1;
+    }
+    return storeEventPairs(env, buffer, values, selected);
+}
+
+/*
+ * Blocking event wait (since 2.9.0)
+ *
+ * An event waiter belongs to the event thread of one port. eventWaiterWait() blocks in
+ * poll() on the port and on a wakeup pipe until the state sampled by sampleEvents()
+ * changes, and turns the changes into the events of the mask set by "_setEventsMask"
+ * (only the values needed by the mask are sampled). Modem line changes are reported by
+ * a helper thread blocked in TIOCMIWAIT, which writes to the wakeup pipe.
+ * "_setEventsMask" and eventWaiterCancel() write to the same pipe, the helper thread is
+ * stopped with EVENTS_WAKEUP_SIGNAL since TIOCMIWAIT can't be cancelled otherwise.
+ *
+ * Short timed samples (EVENTS_SAMPLE_MILLIS) are only used for the states which have
+ * no wakeup source: pending output (TXEMPTY), unread input (new data can't be told
+ * from old data by poll()) and modem lines when TIOCMIWAIT isn't supported.
+ */
+#define EVENTS_SAMPLE_MILLIS 10
+
+#if defined TIOCMIWAIT
+    #define EVENTS_WAKEUP_SIGNAL (SIGRTMIN + 5)
+#endif
+
+struct EventWaiter {
+    PortContext *context;
+    int fd;
+    int wakeupPipe[2];
+    pthread_mutex_t lock;       //Guards the fields below
+    pthread_cond_t modemThreadExited;
+    char cancelled;
+    char modemThreadStarted;    //The helper thread must be joined if set
+    char modemThreadRunning;
+    char modemWaitSupported;    //Cleared if TIOCMIWAIT failed or can't be interrupted
+    pthread_t modemThread;
+    //Only used by the waiting thread
+    jint validGroups;           //Sample groups of the values below which have been sampled
+    jint values[EVENTS_COUNT];  //Values of the previous sample
+    char txPending;             //Data has been transmitted since the last EV_TXEMPTY
+};
+
+static void eventWaiterWakeup(EventWaiter *waiter) {
+    char signal = 1;
+    //A full pipe means a wakeup is already pending
+    if(write(waiter->wakeupPipe[1], &signal, 1) != 1){
+        //Do nothing
+    }
+}
+
+#if defined TIOCMIWAIT
+static void eventsWakeupHandler(int signalNumber) {
+    //Only used to interrupt TIOCMIWAIT with EINTR
+}
+
+static pthread_once_t eventsWakeupOnce = PTHREAD_ONCE_INIT;
+static char eventsWakeupInstalled = 0;
+
+/*
+ * Install the handler of EVENTS_WAKEUP_SIGNAL, without SA_RESTART so the interrupted
+ * ioctl() isn't restarted. A handler installed by the application is never replaced.
+ */
+static void installEventsWakeupHandler() {
+    struct sigaction current;
+    if(sigaction(EVENTS_WAKEUP_SIGNAL, NULL, &current) != 0 || current.sa_handler != SIG_DFL){
+        return;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = eventsWakeupHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    eventsWakeupInstalled = (sigaction(EVENTS_WAKEUP_SIGNAL, &action, NULL) == 0);
+}
+
+static void* eventWaiterModemThread(void *arg) {
+    EventWaiter *waiter = (EventWaiter*)arg;
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, EVENTS_WAKEUP_SIGNAL);
+    pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+    pthread_mutex_lock(&waiter->lock);
+    while(!waiter->cancelled){
+        pthread_mutex_unlock(&waiter->lock);
+        int result = ioctl(waiter->fd, TIOCMIWAIT, TIOCM_CTS | TIOCM_DSR | TIOCM_RNG | TIOCM_CAR);
+        int error = errno;
+        pthread_mutex_lock(&waiter->lock);
+        if(result == 0){
+            eventWaiterWakeup(waiter);
+        }
+        else if(error != EINTR){
+            //Not supported by the driver (pseudo terminals for example), fall back to sampling
+            waiter->modemWaitSupported = 0;
+            eventWaiterWakeup(waiter);
+            break;
+        }
+    }
+    waiter->modemThreadRunning = 0;
+    pthread_cond_signal(&waiter->modemThreadExited);
+    pthread_mutex_unlock(&waiter->lock);
+    return NULL;
+}
+#endif
+
+/*
+ * Start the modem lines helper thread if it isn't running. Must be called with the
+ * lock held. Returns non zero if modem line changes will wake up the waiter.
+ */
+static char eventWaiterStartModemThread(EventWaiter *waiter) {
+#if defined TIOCMIWAIT
+    if(waiter->modemThreadRunning){
+        return 1;
+    }
+    if(waiter->modemWaitSupported){
+        pthread_once(&eventsWakeupOnce, installEventsWakeupHandler);
+        if(eventsWakeupInstalled && pthread_create(&waiter->modemThread, NULL, eventWaiterModemThread, waiter) == 0){
+            waiter->modemThreadStarted = 1;
+            waiter->modemThreadRunning = 1;
+            return 1;
+        }
+        waiter->modemWaitSupported = 0;
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Returns the sample groups needed to report the events of "mask"
+ */
+static jint getSampleGroups(jint mask) {
+    jint groups = 0;
+    if(mask & EV_RXCHAR){
+        groups |= EVENTS_SAMPLE_INPUT;
+    }
+    if(mask & EV_TXEMPTY){
+        groups |= EVENTS_SAMPLE_OUTPUT | EVENTS_SAMPLE_COUNTERS;
+    }
+    if(mask & (EV_CTS | EV_DSR | EV_RING | EV_RLSD)){
+        groups |= EVENTS_SAMPLE_LINES;
+    }
+    if(mask & (EV_BREAK | EV_ERR)){
+        //Breaks and errors come with input, which must be sampled to know if poll() can be used
+        groups |= EVENTS_SAMPLE_COUNTERS | EVENTS_SAMPLE_INPUT;
+    }
+    return groups;
+}
+
+/*
+ * Create an event waiter for an opened port
+ *
+ * Returns the waiter handle, or -1 if it couldn't be created.
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_eventWaiterOpen
+  (JNIEnv *env, jobject object, jlong portHandle){
+    PortContext *context = acquirePortContext(portHandle);
+    if(context == NULL){
+        return -1;
+    }
+    EventWaiter *waiter = new EventWaiter();
+    if(pipe(waiter->wakeupPipe) != 0){
+        delete waiter;
+        releasePortContext(context);
+        return -1;
+    }
+    for(int i = 0; i < 2; i++){
+        fcntl(waiter->wakeupPipe[i], F_SETFL, fcntl(waiter->wakeupPipe[i], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(waiter->wakeupPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    waiter->fd = (int)portHandle;
+    pthread_mutex_init(&waiter->lock, NULL);
+    pthread_cond_init(&waiter->modemThreadExited, NULL);
+    waiter->cancelled = 0;
+    waiter->modemThreadStarted = 0;
+    waiter->modemThreadRunning = 0;
+    waiter->modemWaitSupported = 1;
+    waiter->validGroups = 0;
+    waiter->txPending = 0;
+    waiter->context = context;
+    pthread_mutex_lock(&context->lock);
+    context->eventsWakeupFd = waiter->wakeupPipe[1];
+    jint mask = context->eventsMask;
+    pthread_mutex_unlock(&context->lock);
+    //Take the initial state now, the changes which happen before the first wait are reported by it.
+    //The input isn't sampled so that the first wait reports the bytes already received.
+    jint groups = getSampleGroups(mask) & ~EVENTS_SAMPLE_INPUT;
+    sampleEvents(waiter->fd, waiter->values, groups);
+    waiter->validGroups = groups;
+    return (jlong)(intptr_t)waiter;
+}
+
+/*
+ * Wait until at least one of the events of the mask set by "_setEventsMask" occurred,
+ * and store the {event, value} pairs in "buffer" at indexes 2 * i and 2 * i + 1:
+ *
+ * EV_RXCHAR  - bytes count of the input buffer, when it isn't empty and has changed
+ * EV_TXEMPTY - 0, when the output buffer became empty
+ * EV_CTS, EV_DSR, EV_RING, EV_RLSD - the new line state, when it has changed
+ * EV_BREAK   - 0, when a break has been received
+ * EV_ERR     - combination of ERROR_FRAME, ERROR_OVERRUN and ERROR_PARITY
+ *
+ * Returns the bitmask of the stored event types, 0 if the wait has been cancelled, or
+ * -1 if the port can't be waited for anymore (closed or removed device).
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_eventWaiterWait
+  (JNIEnv *env, jobject object, jlong waiterHandle, jintArray buffer){
+    EventWaiter *waiter = (EventWaiter*)(intptr_t)waiterHandle;
+    jint values[EVENTS_COUNT];
+    char dataArrived = 0;
+    while(true){
+        pthread_mutex_lock(&waiter->context->lock);
+        jint mask = waiter->context->eventsMask;
+        pthread_mutex_unlock(&waiter->context->lock);
+        jint groups = getSampleGroups(mask);
+
+        pthread_mutex_lock(&waiter->lock);
+        char cancelled = waiter->cancelled;
+        char modemWakeup = 0;
+        if(!cancelled && (groups & EVENTS_SAMPLE_LINES)){
+            modemWakeup = eventWaiterStartModemThread(waiter);
+        }
+        pthread_mutex_unlock(&waiter->lock);
+        if(cancelled){
+            return 0;
+        }
+
+        for(size_t i = 0; i < EVENTS_COUNT; i++){
+            values[i] = waiter->values[i];
+        }
+        sampleEvents(waiter->fd, values, groups);
+        jint pairs[EVENTS_COUNT * 2];
+        jint pairsCount = 0;
+        jint eventsMask = 0;
+        jint errorMask = 0;
+        jint bytesCountIn = 0;
+        jint bytesCountOut = 0;
+        for(size_t i = 0; i < EVENTS_COUNT; i++){
+            jint group = getSampleGroup(events[i]);
+            if(!(groups & group)){
+                continue;
+            }
+            //A group sampled for the first time (the mask has changed) gives the initial state
+            char changed = ((waiter->validGroups & group) && values[i] != waiter->values[i]);
+            jint event = 0;
+            jint value = 0;
+            switch(events[i]) {
+                case INTERRUPT_BREAK:
+                    if(changed){
+                        event = EV_BREAK;
+                    }
+                    break;
+                case INTERRUPT_TX:
+                    if(changed){
+                        waiter->txPending = 1;
+                    }
+                    break;
+                case INTERRUPT_FRAME:
+                    if(changed){
+                        errorMask |= ERROR_FRAME;
+                    }
+                    break;
+                case INTERRUPT_OVERRUN:
+                    if(changed){
+                        errorMask |= ERROR_OVERRUN;
+                    }
+                    break;
+                case INTERRUPT_PARITY:
+                    if(changed){
+                        errorMask |= ERROR_PARITY;
+                    }
+                    //The last one of the error counters
+                    if(errorMask != 0){
+                        event = EV_ERR;
+                        value = errorMask;
+                    }
+                    break;
+                case EV_CTS:
+                case EV_DSR:
+                case EV_RING:
+                case EV_RLSD:
+                    if(changed){
+                        event = events[i];
+                        value = values[i];
+                    }
+                    break;
+                case EV_RXCHAR:
+                    bytesCountIn = values[i];
+                    if(values[i] > 0 && (changed || dataArrived || !(waiter->validGroups & group))){
+                        event = EV_RXCHAR;
+                        value = values[i];
+                    }
+                    break;
+                case EV_TXEMPTY:
+                    bytesCountOut = values[i];
+                    if(changed && values[i] == 0){
+                        waiter->txPending = 1;
+                    }
+                    if(waiter->txPending && values[i] == 0){
+                        waiter->txPending = 0;
+                        event = EV_TXEMPTY;
+                    }
+                    break;
+            }
+            if((event & mask) != 0){
+                pairs[pairsCount * 2] = event;
+                pairs[pairsCount * 2 + 1] = value;
+                pairsCount++;
+                eventsMask |= event;
+            }
+        }
+        for(size_t i = 0; i < EVENTS_COUNT; i++){
+            waiter->values[i] = values[i];
+        }
+        waiter->validGroups = groups;
+        if(!(groups & EVENTS_SAMPLE_OUTPUT)){
+            waiter->txPending = 0;
+        }
+        if(pairsCount > 0){
+            jint maxCount = env->GetArrayLength(buffer) / 2;
+            if(pairsCount > maxCount){
+                pairsCount = maxCount;
+            }
+            env->SetIntArrayRegion(buffer, 0, pairsCount * 2, pairs);
+            return eventsMask;
+        }
+
+        //Unread input keeps the port readable, poll() can only be used while it is empty
+        struct pollfd fds[2];
+        fds[0].fd = waiter->wakeupPipe[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = waiter->fd;
+        fds[1].events = ((groups & EVENTS_SAMPLE_INPUT) && bytesCountIn == 0 ? POLLIN : 0);
+        int timeout = -1;
+        if(bytesCountIn > 0 || bytesCountOut > 0 || (groups & EVENTS_SAMPLE_OUTPUT) ||
+           ((groups & EVENTS_SAMPLE_LINES) && !modemWakeup)){
+            timeout = EVENTS_SAMPLE_MILLIS;
+        }
+        int result = poll(fds, 2, timeout);
+        if(result == -1 && errno != EINTR){
+            return -1;
+        }
+        dataArrived = 0;
+        if(result > 0){
+            if(fds[1].revents & (POLLERR | POLLHUP | POLLNVAL)){
+                return -1;
+            }
+            dataArrived = ((fds[1].revents & POLLIN) != 0);
+            if(fds[0].revents & POLLIN){
+                char drain[16];
+                while(read(waiter->wakeupPipe[0], drain, sizeof(drain)) > 0){
+                    //Drain the pipe
+                }
+            }
+        }
+    }
+}
+
 /*
- * Collecting data for EventListener class (Linux have no implementation of "WaitCommEvent" function from Windows)
- * 
+ * Unblock the thread waiting in "_eventWaiterWait", the current and all of the next
+ * waits return 0.
  */
-JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
-  (JNIEnv *env, jobject object, jlong portHandle) {
-
-    jclass intClass = env->FindClass("[I");
-    jobjectArray returnArray = env->NewObjectArray(sizeof(events)/sizeof(jint), intClass, NULL);
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_eventWaiterCancel
+  (JNIEnv *env, jobject object, jlong waiterHandle){
+    EventWaiter *waiter = (EventWaiter*)(intptr_t)waiterHandle;
+    pthread_mutex_lock(&waiter->lock);
+    waiter->cancelled = 1;
+    eventWaiterWakeup(waiter);
+    pthread_mutex_unlock(&waiter->lock);
+    return JNI_TRUE;
+}
 
-    /*Input buffer*/
-    jint bytesCountIn = 0;
-    ioctl(portHandle, FIONREAD, &bytesCountIn);
-    
-    /*Output buffer*/
-    jint bytesCountOut = 0;
-    ioctl(portHandle, TIOCOUTQ, &bytesCountOut);
+/*
+ * Destroy an event waiter. No thread may be waiting in "_eventWaiterWait".
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_eventWaiterClose
+  (JNIEnv *env, jobject object, jlong waiterHandle){
+    EventWaiter *waiter = (EventWaiter*)(intptr_t)waiterHandle;
+    pthread_mutex_lock(&waiter->lock);
+    waiter->cancelled = 1;
+    char joinModemThread = waiter->modemThreadStarted;
+#if defined TIOCMIWAIT
+    //The signal is lost if it arrives just before the thread enters TIOCMIWAIT, repeat it
+    while(waiter->modemThreadRunning){
+        pthread_kill(waiter->modemThread, EVENTS_WAKEUP_SIGNAL);
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += EVENTS_SAMPLE_MILLIS * 1000000L;
+        if(deadline.tv_nsec >= 1000000000L){
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&waiter->modemThreadExited, &waiter->lock, &deadline);
+    }
+#endif
+    pthread_mutex_unlock(&waiter->lock);
+    if(joinModemThread){
+        pthread_join(waiter->modemThread, NULL);
+    }
+    pthread_mutex_lock(&waiter->context->lock);
+    waiter->context->eventsWakeupFd = -1;
+    pthread_mutex_unlock(&waiter->context->lock);
+    releasePortContext(waiter->context);
+    pthread_cond_destroy(&waiter->modemThreadExited);
+    pthread_mutex_destroy(&waiter->lock);
+    close(waiter->wakeupPipe[0]);
+    close(waiter->wakeupPipe[1]);
+    delete waiter;
+    return JNI_TRUE;
+}
 
-    /*Lines status*/
-    int statusLines = getLinesStatus(portHandle);
+/* OK */
+/*
+ * Port enumeration (since 2.9.0)
+ *
+ * The ports are listed from the kernel's own records, none of them is opened: from sysfs
+ * on Linux, where a tty is a serial port if it has a device (the virtual consoles and
+ * pseudo terminals have none) and, for the ports of the serial core, a known UART type;
+ * from the IOKit registry on Mac OS X. Other systems return NULL, the ports are then
+ * searched in /dev by the java code.
+ */
+#define PORT_NAMES_MAX 512
+#define PORT_NAME_MAX 128
 
-    jint statusCTS = 0;
-    jint statusDSR = 0;
-    jint statusRING = 0;
-    jint statusRLSD = 0;
-    
-    /*CTS status*/
-    if(statusLines & TIOCM_CTS){
-        statusCTS = 1;
+#ifdef __linux__
+/*
+ * Returns 1 if the tty of the given name in /sys/class/tty is a serial port
+ */
+static int isSysfsSerialPort(const char *name) {
+    char path[PORT_NAME_MAX + 32];
+    struct stat info;
+    snprintf(path, sizeof(path), "/sys/class/tty/%s/device", name);
+    if(stat(path, &info) != 0){
+        return 0;
     }
-
-    /*DSR status*/
-    if(statusLines & TIOCM_DSR){
-        statusDSR = 1;
+    //The serial core registers a port for every possible UART, PORT_UNKNOWN (0) if none was found
+    snprintf(path, sizeof(path), "/sys/class/tty/%s/type", name);
+    int fd = open(path, O_RDONLY);
+    if(fd != -1){
+        char type[4];
+        ssize_t length = read(fd, type, sizeof(type));
+        close(fd);
+        if(length >= 1 && type[0] == '0' && (length == 1 || type[1] == '\n')){
+            return 0;
+        }
     }
+    return 1;
+}
 
-    /*RING status*/
-    if(statusLines & TIOCM_RNG){
-        statusRING = 1;
+/*
+ * Store the device paths of the serial ports in names, returns their count or -1 if
+ * sysfs can't be read
+ */
+static int listPortNames(char (*names)[PORT_NAME_MAX]) {
+    DIR *dir = opendir("/sys/class/tty");
+    if(dir == NULL){
+        return -1;
     }
-
-    /*RLSD(DCD) status*/
-    if(statusLines & TIOCM_CAR){
-        statusRLSD = 1;
+    int count = 0;
+    struct dirent *entry;
+    while(count < PORT_NAMES_MAX && (entry = readdir(dir)) != NULL){
+        if(entry->d_name[0] != '.' && strlen(entry->d_name) < PORT_NAME_MAX - 5 && isSysfsSerialPort(entry->d_name)){
+            snprintf(names[count], PORT_NAME_MAX, "/dev/%.*s", (int)(PORT_NAME_MAX - 6), entry->d_name);
+            count++;
+        }
     }
-
-    /*Interrupts*/
-    int interrupts[] = {-1, -1, -1, -1, -1};
-    getInterruptsCount(portHandle, interrupts);
-
-    jint interruptBreak = interrupts[0];
-    jint interruptTX = interrupts[1];
-    jint interruptFrame = interrupts[2];
-    jint interruptOverrun = interrupts[3];
-    jint interruptParity = interrupts[4];
-
-    for(int i = 0; i < sizeof(events)/sizeof(jint); i++){
-        jint returnValues[2];
-        switch(events[i]) {
-            
-            case INTERRUPT_BREAK: //Interrupt Break - for BREAK event
-                returnValues[1] = interruptBreak;
-                goto forEnd;
-            case INTERRUPT_TX: //Interrupt TX - for TXEMPTY event
-                returnValues[1] = interruptTX;
-                goto forEnd;
-            case INTERRUPT_FRAME: //Interrupt Frame - for ERR event
-                returnValues[1] = interruptFrame;
-                goto forEnd;
-            case INTERRUPT_OVERRUN: //Interrupt Overrun - for ERR event
-                returnValues[1] = interruptOverrun;
-                goto forEnd;
-            case INTERRUPT_PARITY: //Interrupt Parity - for ERR event
-                returnValues[1] = interruptParity;
-                goto forEnd;
-            case EV_CTS:
-                returnValues[1] = statusCTS;
-                goto forEnd;
-            case EV_DSR:
-                returnValues[1] = statusDSR;
-                goto forEnd;
-            case EV_RING:
-                returnValues[1] = statusRING;
-                goto forEnd;
-            case EV_RLSD: /*DCD*/
-                returnValues[1] = statusRLSD;
-                goto forEnd;
-            case EV_RXCHAR:
-                returnValues[1] = bytesCountIn;
-                goto forEnd;
-            /*case EV_RXFLAG: // Event RXFLAG - Not supported
-                returnValues[0] = EV_RXFLAG;
-                returnValues[1] = 0;
-                goto forEnd;*/
-            case EV_TXEMPTY:
-                returnValues[1] = bytesCountOut;
-                goto forEnd;
+    closedir(dir);
+    return count;
+}
+#elif defined __APPLE__
+static int listPortNames(char (*names)[PORT_NAME_MAX]) {
+    CFMutableDictionaryRef matching = IOServiceMatching(kIOSerialBSDServiceValue);
+    if(matching == NULL){
+        return -1;
+    }
+    CFDictionarySetValue(matching, CFSTR(kIOSerialBSDTypeKey), CFSTR(kIOSerialBSDAllTypes));
+    io_iterator_t iterator;
+    //Takes the ownership of matching
+    if(IOServiceGetMatchingServices(kIOMasterPortDefault, matching, &iterator) != KERN_SUCCESS){
+        return -1;
+    }
+    int count = 0;
+    io_object_t service;
+    while((service = IOIteratorNext(iterator)) != 0){
+        //The dial-in device (/dev/tty.*), as searched in /dev before
+        CFTypeRef path = IORegistryEntryCreateCFProperty(service, CFSTR(kIODialinDeviceKey), kCFAllocatorDefault, 0);
+        if(path != NULL){
+            if(count < PORT_NAMES_MAX && CFStringGetCString((CFStringRef)path, names[count], PORT_NAME_MAX, kCFStringEncodingUTF8)){
+                count++;
+            }
+            CFRelease(path);
         }
-        forEnd: {
-            returnValues[0] = events[i];
-            jintArray singleResultArray = env->NewIntArray(2);
-            env->SetIntArrayRegion(singleResultArray, 0, 2, returnValues);
-            env->SetObjectArrayElement(returnArray, i, singleResultArray);
-        };
+        IOObjectRelease(service);
     }
-    return returnArray;
+    IOObjectRelease(iterator);
+    return count;
+}
+#else
+static int listPortNames(char (*names)[PORT_NAME_MAX]) {
+    return -1;
 }
+#endif
 
-/* OK */
 /*
  * Getting serial ports names like an a String array (String[])
+ *
+ * Since 2.9.0 the device paths are listed natively on Linux and Mac OS X, see above.
+ * Returns NULL on the other systems.
  */
 JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_getSerialPortNames
   (JNIEnv *env, jobject object){
-    //Don't needed in linux, implemented in java code (Note: null will be returned)
-    return NULL;
+    char (*names)[PORT_NAME_MAX] = new (std::nothrow) char[PORT_NAMES_MAX][PORT_NAME_MAX];
+    if(names == NULL){
+        return NULL;
+    }
+    jobjectArray returnArray = NULL;
+    int count = listPortNames(names);
+    if(count >= 0){
+        returnArray = env->NewObjectArray(count, getStringClass(), NULL);
+        for(int i = 0; returnArray != NULL && i < count; i++){
+            jstring name = env->NewStringUTF(names[i]);
+            if(name == NULL){
+                returnArray = NULL;//OutOfMemoryError is pending
+                break;
+            }
+            env->SetObjectArrayElement(returnArray, i, name);
+            env->DeleteLocalRef(name);
+        }
+    }
+    delete[] names;
+    return returnArray;
 }
 
 /* OK */
@@ -1011,3 +4375,494 @@ JNIEXPORT jintArray JNICALL Java_jssc_SerialNativeInterface_getLinesStatus
     env->SetIntArrayRegion(returnArray, 0, 4, returnValues);
     return returnArray;
 }
+
+/*
+ * SerialPortSelector (since 2.9.0)
+ *
+ * Waits for many ports in a single call. The backend is epoll on Linux, kqueue on
+ * Mac OS X and the BSDs, and poll() elsewhere. In all cases the selector owns a pipe
+ * that is registered for reading, this is used by selectorWakeup() to unblock a
+ * thread waiting in selectorSelect().
+ */
+
+//Must match SerialPortSelector.OP_READ and SerialPortSelector.OP_WRITE
+#define SELECTOR_OP_READ    1
+#define SELECTOR_OP_WRITE   4
+
+//Maximum count of ready ports reported by a single selectorSelect() call, the
+//remaining ones are reported by the next call since all backends are level triggered
+#define SELECTOR_MAX_EVENTS 64
+
+struct SerialSelector {
+    int backendFd;          //epoll or kqueue descriptor, -1 for the poll() backend
+    int wakeupPipe[2];
+#if !defined JSSC_SELECTOR_EPOLL && !defined JSSC_SELECTOR_KQUEUE
+    pthread_mutex_t lock;   //Guards the registrations below
+    struct pollfd *fds;     //Registered ports, fds[i].events holds the interest set
+    int count;
+    int capacity;
+#endif
+};
+
+/*
+ * Registers, changes (if the port is already registered) or removes (if ops is 0)
+ * the interest set of a port. Returns 0 on success.
+ */
+static int selectorUpdate(SerialSelector *selector, int fd, jint ops) {
+#if defined JSSC_SELECTOR_EPOLL
+    if (ops == 0) {
+        struct epoll_event event = {0, {0}};//Non-NULL for kernels before 2.6.9
+        return epoll_ctl(selector->backendFd, EPOLL_CTL_DEL, fd, &event) == 0 || errno == ENOENT ? 0 : -1;
+    }
+    struct epoll_event event;
+    event.events = ((ops & SELECTOR_OP_READ) ? (uint32_t)EPOLLIN : 0) | ((ops & SELECTOR_OP_WRITE) ? (uint32_t)EPOLLOUT : 0);
+    event.data.u64 = 0;
+    event.data.fd = fd;
+    if (epoll_ctl(selector->backendFd, EPOLL_CTL_ADD, fd, &event) == 0) {
+        return 0;
+    }
+    //Already registered, change the interest set
+    return (errno == EEXIST ? epoll_ctl(selector->backendFd, EPOLL_CTL_MOD, fd, &event) : -1);
+#elif defined JSSC_SELECTOR_KQUEUE
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, (ops & SELECTOR_OP_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, (ops & SELECTOR_OP_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    for (int i = 0; i < 2; i++) {
+        //Deleting a filter which was never added fails with ENOENT, that's fine
+        if (kevent(selector->backendFd, &changes[i], 1, NULL, 0, NULL) == -1 && !(changes[i].flags & EV_DELETE)) {
+            return -1;
+        }
+    }
+    return 0;
+#else
+    short events = ((ops & SELECTOR_OP_READ) ? POLLIN : 0) | ((ops & SELECTOR_OP_WRITE) ? POLLOUT : 0);
+    pthread_mutex_lock(&selector->lock);
+    int index = -1;
+    for (int i = 0; i < selector->count; i++) {
+        if (selector->fds[i].fd == fd) {
+            index = i;
+            break;
+        }
+    }
+    if (ops == 0) {
+        if (index >= 0) {
+            selector->fds[index] = selector->fds[--selector->count];
+        }
+    } else if (index >= 0) {
+        selector->fds[index].events = events;
+    } else {
+        if (selector->count == selector->capacity) {
+            int capacity = (selector->capacity == 0 ? 8 : selector->capacity * 2);
+            struct pollfd *fds = new struct pollfd[capacity];
+            for (int i = 0; i < selector->count; i++) {
+                fds[i] = selector->fds[i];
+            }
+            delete[] selector->fds;
+            selector->fds = fds;
+            selector->capacity = capacity;
+        }
+        selector->fds[selector->count].fd = fd;
+        selector->fds[selector->count].events = events;
+        selector->fds[selector->count].revents = 0;
+        selector->count++;
+    }
+    pthread_mutex_unlock(&selector->lock);
+    return 0;
+#endif
+}
+
+/*
+ * Drains the wakeup pipe
+ */
+static void selectorClearWakeup(SerialSelector *selector) {
+    char buffer[64];
+    while (read(selector->wakeupPipe[0], buffer, sizeof(buffer)) > 0);
+}
+
+/*
+ * Open a new selector
+ *
+ * Returns the selector handle, or -1 if the selector couldn't be created.
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_selectorOpen
+  (JNIEnv *env, jobject object){
+    SerialSelector *selector = new SerialSelector();
+    if (pipe(selector->wakeupPipe) != 0) {
+        delete selector;
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(selector->wakeupPipe[i], F_SETFL, fcntl(selector->wakeupPipe[i], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(selector->wakeupPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+#if defined JSSC_SELECTOR_EPOLL
+    selector->backendFd = epoll_create(SELECTOR_MAX_EVENTS);//The size is ignored since Linux 2.6.8
+    if (selector->backendFd != -1) {
+        fcntl(selector->backendFd, F_SETFD, FD_CLOEXEC);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = 0;
+        event.data.fd = selector->wakeupPipe[0];
+        if (epoll_ctl(selector->backendFd, EPOLL_CTL_ADD, selector->wakeupPipe[0], &event) != 0) {
+            close(selector->backendFd);
+            selector->backendFd = -1;
+        }
+    }
+#elif defined JSSC_SELECTOR_KQUEUE
+    selector->backendFd = kqueue();
+    if (selector->backendFd != -1) {
+        struct kevent change;
+        EV_SET(&change, selector->wakeupPipe[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+        if (kevent(selector->backendFd, &change, 1, NULL, 0, NULL) == -1) {
+            close(selector->backendFd);
+            selector->backendFd = -1;
+        }
+    }
+#else
+    selector->backendFd = -1;
+    pthread_mutex_init(&selector->lock, NULL);
+    selector->fds = NULL;
+    selector->count = 0;
+    selector->capacity = 0;
+#endif
+#if defined JSSC_SELECTOR_EPOLL || defined JSSC_SELECTOR_KQUEUE
+    if (selector->backendFd == -1) {
+        close(selector->wakeupPipe[0]);
+        close(selector->wakeupPipe[1]);
+        delete selector;
+        return -1;
+    }
+#endif
+    return (jlong)(intptr_t)selector;
+}
+
+/*
+ * Register a port with the selector, or change the interest set of a port which is
+ * already registered. ops is a combination of SELECTOR_OP_READ and SELECTOR_OP_WRITE.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorRegister
+  (JNIEnv *env, jobject object, jlong selectorHandle, jlong portHandle, jint ops){
+    SerialSelector *selector = (SerialSelector*)(intptr_t)selectorHandle;
+    if (ops == 0) {
+        return JNI_FALSE;
+    }
+    return selectorUpdate(selector, (int)portHandle, ops) == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Remove a port from the selector
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorUnregister
+  (JNIEnv *env, jobject object, jlong selectorHandle, jlong portHandle){
+    SerialSelector *selector = (SerialSelector*)(intptr_t)selectorHandle;
+    return selectorUpdate(selector, (int)portHandle, 0) == 0 ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Wait until at least one of the registered ports is ready, the timeout expires or
+ * selectorWakeup() is called.
+ *
+ * For each ready port, its handle is stored in portHandles, the ready operations in
+ * readyOps and the count of bytes in its input buffer in inputCounts. At most
+ * length of portHandles ports are reported.
+ *
+ * timeoutMilliseconds - 0 to return immediately, negative to block indefinitely.
+ *
+ * Returns the count of ready ports (0 on timeout or wakeup), or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_selectorSelect
+  (JNIEnv *env, jobject object, jlong selectorHandle, jlongArray portHandles, jintArray readyOps,
+    jintArray inputCounts, jlong timeoutMilliseconds){
+    SerialSelector *selector = (SerialSelector*)(intptr_t)selectorHandle;
+    jlong handles[SELECTOR_MAX_EVENTS];
+    jint ops[SELECTOR_MAX_EVENTS];
+    jint counts[SELECTOR_MAX_EVENTS];
+    jint maxReady = env->GetArrayLength(portHandles);
+    jint readyCount = 0;
+    if (maxReady > SELECTOR_MAX_EVENTS) {
+        maxReady = SELECTOR_MAX_EVENTS;
+    }
+    int waitMillis = (timeoutMilliseconds < 0 ? -1 : (timeoutMilliseconds > 0x7fffffff ? 0x7fffffff : (int)timeoutMilliseconds));
+
+#if defined JSSC_SELECTOR_EPOLL
+    struct epoll_event events[SELECTOR_MAX_EVENTS + 1];
+    int eventsCount = epoll_wait(selector->backendFd, events, maxReady + 1, waitMillis);
+    if (eventsCount == -1) {
+        return (errno == EINTR ? 0 : -1);
+    }
+    for (int i = 0; i < eventsCount; i++) {
+        if (events[i].data.fd == selector->wakeupPipe[0]) {
+            selectorClearWakeup(selector);
+            continue;
+        }
+        if (readyCount == maxReady) {
+            break;
+        }
+        handles[readyCount] = events[i].data.fd;
+        ops[readyCount] = ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) ? SELECTOR_OP_READ : 0) |
+                          ((events[i].events & EPOLLOUT) ? SELECTOR_OP_WRITE : 0);
+        readyCount++;
+    }
+#elif defined JSSC_SELECTOR_KQUEUE
+    struct kevent events[SELECTOR_MAX_EVENTS * 2 + 1];
+    struct timespec timeout;
+    timeout.tv_sec = waitMillis / 1000;
+    timeout.tv_nsec = (waitMillis % 1000) * 1000000;
+    int eventsCount = kevent(selector->backendFd, NULL, 0, events, maxReady * 2 + 1, (waitMillis < 0 ? NULL : &timeout));
+    if (eventsCount == -1) {
+        return (errno == EINTR ? 0 : -1);
+    }
+    for (int i = 0; i < eventsCount; i++) {
+        int fd = (int)events[i].ident;
+        if (fd == selector->wakeupPipe[0]) {
+            selectorClearWakeup(selector);
+            continue;
+        }
+        jint op = (events[i].filter == EVFILT_WRITE ? SELECTOR_OP_WRITE : SELECTOR_OP_READ);
+        //Read and write readiness are reported as separate events, merge them
+        int index = 0;
+        while (index < readyCount && handles[index] != fd) {
+            index++;
+        }
+        if (index == readyCount) {
+            if (readyCount == maxReady) {
+                continue;
+            }
+            handles[readyCount] = fd;
+            ops[readyCount] = 0;
+            readyCount++;
+        }
+        ops[index] |= op;
+    }
+#else
+    pthread_mutex_lock(&selector->lock);
+    int fdsCount = selector->count + 1;
+    struct pollfd *fds = new struct pollfd[fdsCount];
+    fds[0].fd = selector->wakeupPipe[0];
+    fds[0].events = POLLIN;
+    for (int i = 0; i < selector->count; i++) {
+        fds[i + 1] = selector->fds[i];
+    }
+    pthread_mutex_unlock(&selector->lock);
+    int eventsCount = poll(fds, fdsCount, waitMillis);
+    if (eventsCount == -1) {
+        delete[] fds;
+        return (errno == EINTR ? 0 : -1);
+    }
+    if (fds[0].revents & POLLIN) {
+        selectorClearWakeup(selector);
+    }
+    for (int i = 1; i < fdsCount && readyCount < maxReady; i++) {
+        if (fds[i].revents == 0 || (fds[i].revents & POLLNVAL)) {
+            continue;
+        }
+        handles[readyCount] = fds[i].fd;
+        ops[readyCount] = ((fds[i].revents & (POLLIN | POLLERR | POLLHUP)) ? SELECTOR_OP_READ : 0) |
+                          ((fds[i].revents & POLLOUT) ? SELECTOR_OP_WRITE : 0);
+        readyCount++;
+    }
+    delete[] fds;
+#endif
+
+    for (jint i = 0; i < readyCount; i++) {
+        int available = 0;
+        if (ioctl((int)handles[i], FIONREAD, &available) != 0) {
+            available = 0;
+        }
+        counts[i] = available;
+    }
+    if (readyCount > 0) {
+        env->SetLongArrayRegion(portHandles, 0, readyCount, handles);
+        env->SetIntArrayRegion(readyOps, 0, readyCount, ops);
+        env->SetIntArrayRegion(inputCounts, 0, readyCount, counts);
+    }
+    return readyCount;
+}
+
+/*
+ * Unblock the thread waiting in selectorSelect(), or make the next call return
+ * immediately if no thread is waiting.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorWakeup
+  (JNIEnv *env, jobject object, jlong selectorHandle){
+    SerialSelector *selector = (SerialSelector*)(intptr_t)selectorHandle;
+    char signal = 1;
+    //A full pipe means a wakeup is already pending
+    return (write(selector->wakeupPipe[1], &signal, 1) == 1 || errno == EAGAIN) ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Close the selector. The registered ports are not closed.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorClose
+  (JNIEnv *env, jobject object, jlong selectorHandle){
+    SerialSelector *selector = (SerialSelector*)(intptr_t)selectorHandle;
+#if defined JSSC_SELECTOR_EPOLL || defined JSSC_SELECTOR_KQUEUE
+    close(selector->backendFd);
+#else
+    pthread_mutex_destroy(&selector->lock);
+    delete[] selector->fds;
+#endif
+    close(selector->wakeupPipe[0]);
+    close(selector->wakeupPipe[1]);
+    delete selector;
+    return JNI_TRUE;
+}
+
+/*
+ * Hot-plug watcher (since 2.9.0)
+ *
+ * Waits for serial ports to be added or removed, for the cached port list of
+ * jssc.SerialPortList. On Linux the kernel uevents of the tty subsystem are received on
+ * a netlink socket, the udev daemon isn't needed. Elsewhere "_portWatcherOpen" fails and
+ * the java code polls the port list instead. A pipe is used to wake up the waiting
+ * thread, as for SerialSelector.
+ */
+#ifdef __linux__
+struct PortWatcher {
+    int netlinkFd;
+    int wakeupPipe[2];
+};
+
+#define UEVENT_BUFFER_SIZE 8192
+
+/*
+ * Returns 1 if the uevent in message is the addition or removal of a tty
+ */
+static int isTtyUevent(const char *message, size_t length) {
+    char added = 0;
+    char tty = 0;
+    //"ACTION@DEVPATH" followed by the "KEY=VALUE" pairs, each ended by a null character
+    for(size_t offset = 0; offset < length; offset += strlen(message + offset) + 1){
+        const char *field = message + offset;
+        if(strcmp(field, "ACTION=add") == 0 || strcmp(field, "ACTION=remove") == 0){
+            added = 1;
+        }
+        else if(strcmp(field, "SUBSYSTEM=tty") == 0){
+            tty = 1;
+        }
+    }
+    return (added && tty);
+}
+#endif
+
+/*
+ * Open a watcher, returns its handle or -1 if the system has no hot-plug notification
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_portWatcherOpen
+  (JNIEnv *env, jobject object){
+#ifdef __linux__
+    int netlinkFd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    if(netlinkFd == -1){
+        return -1;
+    }
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1;//The kernel events, the udev daemon sends its own on group 2
+    if(bind(netlinkFd, (struct sockaddr*)&address, sizeof(address)) != 0){
+        close(netlinkFd);
+        return -1;
+    }
+    fcntl(netlinkFd, F_SETFL, fcntl(netlinkFd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(netlinkFd, F_SETFD, FD_CLOEXEC);
+    PortWatcher *watcher = new (std::nothrow) PortWatcher();
+    if(watcher == NULL){
+        close(netlinkFd);
+        return -1;
+    }
+    watcher->netlinkFd = netlinkFd;
+    if(openNonBlockingPipe(watcher->wakeupPipe) != 0){
+        close(netlinkFd);
+        delete watcher;
+        return -1;
+    }
+    fcntl(watcher->wakeupPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(watcher->wakeupPipe[1], F_SETFD, FD_CLOEXEC);
+    return (jlong)(intptr_t)watcher;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * Wait for a port to be added or removed.
+ *
+ * timeoutMilliseconds - 0 to return immediately, negative to block indefinitely.
+ *
+ * Returns 1 if a port has been added or removed, 0 on timeout, wakeup or other device
+ * events, -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_portWatcherWait
+  (JNIEnv *env, jobject object, jlong watcherHandle, jlong timeoutMilliseconds){
+#ifdef __linux__
+    PortWatcher *watcher = (PortWatcher*)(intptr_t)watcherHandle;
+    struct pollfd fds[2];
+    fds[0].fd = watcher->netlinkFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = watcher->wakeupPipe[0];
+    fds[1].events = POLLIN;
+    int waitMillis = (timeoutMilliseconds < 0 ? -1 : (timeoutMilliseconds > 0x7fffffff ? 0x7fffffff : (int)timeoutMilliseconds));
+    int result = poll(fds, 2, waitMillis);
+    if(result == -1){
+        return (errno == EINTR ? 0 : -1);
+    }
+    if(fds[1].revents & POLLIN){
+        drainPipe(watcher->wakeupPipe[0]);
+    }
+    jint changed = 0;
+    if(fds[0].revents & POLLIN){
+        char *message = new (std::nothrow) char[UEVENT_BUFFER_SIZE];
+        if(message == NULL){
+            return -1;
+        }
+        ssize_t length;
+        while((length = recv(watcher->netlinkFd, message, UEVENT_BUFFER_SIZE - 1, 0)) > 0){
+            message[length] = 0;
+            if(isTtyUevent(message, (size_t)length)){
+                changed = 1;
+            }
+        }
+        delete[] message;
+        //ENOBUFS means events have been lost, one of them may be a change
+        if(length == -1 && errno == ENOBUFS){
+            changed = 1;
+        }
+    }
+    return changed;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * Make the thread waiting in "_portWatcherWait" return
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_portWatcherWakeup
+  (JNIEnv *env, jobject object, jlong watcherHandle){
+#ifdef __linux__
+    PortWatcher *watcher = (PortWatcher*)(intptr_t)watcherHandle;
+    char signal = 1;
+    //A full pipe means a wakeup is already pending
+    return (write(watcher->wakeupPipe[1], &signal, 1) == 1 || errno == EAGAIN) ? JNI_TRUE : JNI_FALSE;
+#else
+    return JNI_FALSE;
+#endif
+}
+
+/*
+ * Close the watcher, no thread may be waiting in "_portWatcherWait"
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_portWatcherClose
+  (JNIEnv *env, jobject object, jlong watcherHandle){
+#ifdef __linux__
+    PortWatcher *watcher = (PortWatcher*)(intptr_t)watcherHandle;
+    close(watcher->netlinkFd);
+    close(watcher->wakeupPipe[0]);
+    close(watcher->wakeupPipe[1]);
+    delete watcher;
+    return JNI_TRUE;
+#else
+    return JNI_FALSE;
+#endif
+}
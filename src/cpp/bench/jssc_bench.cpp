@@ -0,0 +1,363 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ *
+ *
+ * jssc_bench.cpp
+ * Native side of the benchmark suite (since 2.9.0), POSIX only.
+ *
+ * "jssc_bench loopback" opens a pseudo-terminal pair, prints the name of the slave side
+ * and echoes back everything written to it until its standard input is closed. The java
+ * benchmark (src/bench/jssc/bench/SerialBenchmark.java) opens the slave with SerialPort,
+ * the pair then behaves as a serial port with a TX-RX loopback plug.
+ *
+ * "jssc_bench baseline" measures the same transfers over a pair with plain system calls,
+ * reading the way the read engine of jssc.cpp does (O_NONBLOCK, select() then read()),
+ * and the cost of the clock and timeout helpers of jssc_Common.cpp. Subtracted from
+ * the java results, it gives the cost of jSSC itself.
+ *
+ * Both reports are tab separated: name, unit, median, minimum and maximum of the runs.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#ifdef __APPLE__
+    #include <util.h>
+#else
+    #include <pty.h>
+#endif
+
+#include <algorithm>
+
+#include "../jssc_Common.h"
+
+#define BENCH_DEFAULT_RUNS      5
+#define BENCH_DEFAULT_BYTES     (4 * 1024 * 1024)
+#define BENCH_ROUND_TRIPS       2000
+#define BENCH_MESSAGE_SIZE      16
+#define BENCH_CLOCK_CALLS       1000000
+
+struct PtyPair {
+    int master;
+    int slave;
+    char name[128];
+};
+
+static int openPtyPair(PtyPair *pair) {
+    struct termios settings;
+    if (openpty(&pair->master, &pair->slave, pair->name, NULL, NULL) != 0) {
+        perror("openpty");
+        return -1;
+    }
+    //Raw on both sides, the master as the far end of a serial line
+    tcgetattr(pair->slave, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(pair->slave, TCSANOW, &settings);
+    tcgetattr(pair->master, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(pair->master, TCSANOW, &settings);
+    return 0;
+}
+
+static void closePtyPair(PtyPair *pair) {
+    close(pair->slave);
+    close(pair->master);
+}
+
+static int writeFully(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t result = write(fd, data, length);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += result;
+        length -= (size_t)result;
+    }
+    return 0;
+}
+
+/*
+ * Echo everything read from fd back to it, until it fails or stopFd becomes readable
+ */
+static void echoLoop(int fd, int stopFd) {
+    char buffer[4096];
+    struct pollfd fds[2];
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopFd;
+    fds[1].events = POLLIN;
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents != 0) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            ssize_t result = read(fd, buffer, sizeof(buffer));
+            if (result <= 0 || writeFully(fd, buffer, (size_t)result) != 0) {
+                return;
+            }
+        }
+        else if (fds[0].revents != 0) {
+            //POLLHUP while nobody has the slave opened, wait for the next open
+            usleep(1000);
+        }
+    }
+}
+
+static int runLoopback() {
+    PtyPair pair;
+    if (openPtyPair(&pair) != 0) {
+        return 1;
+    }
+    //jSSC opens the slave by name, the pair stays alive through our descriptor
+    printf("%s\n", pair.name);
+    fflush(stdout);
+    echoLoop(pair.master, STDIN_FILENO);
+    closePtyPair(&pair);
+    return 0;
+}
+
+/*
+ * Baseline measures
+ */
+struct Metric {
+    const char *name;
+    const char *unit;
+    double values[64];
+    int count;
+};
+
+static void printMetric(Metric *metric) {
+    std::sort(metric->values, metric->values + metric->count);
+    printf("%s\t%s\t%.3f\t%.3f\t%.3f\n", metric->name, metric->unit, metric->values[metric->count / 2],
+           metric->values[0], metric->values[metric->count - 1]);
+    fflush(stdout);
+}
+
+/*
+ * Read length bytes from a descriptor in O_NONBLOCK mode the way the read engine does
+ */
+static int readFully(int fd, char *buffer, size_t length) {
+    while (length > 0) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        if (select(fd + 1, &readSet, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ssize_t result = read(fd, buffer, length);
+        if (result < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buffer += result;
+        length -= (size_t)result;
+    }
+    return 0;
+}
+
+struct WriterArgs {
+    int fd;
+    size_t totalBytes;
+    size_t blockSize;
+};
+
+static void* writerThread(void *arg) {
+    WriterArgs *args = (WriterArgs*)arg;
+    char block[4096];
+    for (size_t i = 0; i < sizeof(block); i++) {
+        block[i] = (char)(i * 31 + 7);
+    }
+    for (size_t sent = 0; sent < args->totalBytes; sent += args->blockSize) {
+        if (writeFully(args->fd, block, args->blockSize) != 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static double measureThroughput(PtyPair *pair, size_t totalBytes, size_t blockSize) {
+    char buffer[4096];
+    WriterArgs args = {pair->master, totalBytes - totalBytes % blockSize, blockSize};
+    pthread_t writer;
+    jlong start = getTimePreciseMicros();
+    pthread_create(&writer, NULL, writerThread, &args);
+    for (size_t received = 0; received < args.totalBytes; received += blockSize) {
+        if (readFully(pair->slave, buffer, blockSize) != 0) {
+            break;
+        }
+    }
+    pthread_join(writer, NULL);
+    jlong elapsed = getTimePreciseMicros() - start;
+    return (double)args.totalBytes / (elapsed > 0 ? elapsed : 1);//Bytes per micro second = MB/s
+}
+
+struct EchoArgs {
+    int fd;
+    int stopPipe[2];
+};
+
+static void* echoThread(void *arg) {
+    EchoArgs *args = (EchoArgs*)arg;
+    echoLoop(args->fd, args->stopPipe[0]);
+    return NULL;
+}
+
+static void measureRoundTrips(PtyPair *pair, double *mean, double *p99) {
+    static double samples[BENCH_ROUND_TRIPS];
+    char message[BENCH_MESSAGE_SIZE];
+    char reply[BENCH_MESSAGE_SIZE];
+    memset(message, 0x55, sizeof(message));
+    EchoArgs args;
+    args.fd = pair->master;
+    if (pipe(args.stopPipe) != 0) {
+        *mean = *p99 = 0;
+        return;
+    }
+    pthread_t echo;
+    pthread_create(&echo, NULL, echoThread, &args);
+    double total = 0;
+    for (int i = 0; i < BENCH_ROUND_TRIPS; i++) {
+        jlong start = getTimePreciseMicros();
+        if (writeFully(pair->slave, message, sizeof(message)) != 0 || readFully(pair->slave, reply, sizeof(reply)) != 0) {
+            break;
+        }
+        samples[i] = (double)(getTimePreciseMicros() - start);
+        total += samples[i];
+    }
+    close(args.stopPipe[1]);
+    pthread_join(echo, NULL);
+    close(args.stopPipe[0]);
+    std::sort(samples, samples + BENCH_ROUND_TRIPS);
+    *mean = total / BENCH_ROUND_TRIPS;
+    *p99 = samples[BENCH_ROUND_TRIPS * 99 / 100];
+}
+
+static double measureClock() {
+    volatile jlong sink = 0;
+    jlong start = getTimePreciseMicros();
+    for (int i = 0; i < BENCH_CLOCK_CALLS; i++) {
+        sink += getTimePreciseMicros();
+    }
+    return (double)(getTimePreciseMicros() - start) * 1000 / BENCH_CLOCK_CALLS;
+}
+
+static double measureNextTimeout() {
+    struct timeval timeout;
+    volatile long sink = 0;
+    jlong deadline = getTimePreciseMicros() + 60 * 1000000LL;
+    jlong start = getTimePreciseMicros();
+    for (int i = 0; i < BENCH_CLOCK_CALLS; i++) {
+        getNextTimeout(&timeout, 1, deadline, 50);
+        sink += timeout.tv_usec;
+    }
+    return (double)(getTimePreciseMicros() - start) * 1000 / BENCH_CLOCK_CALLS;
+}
+
+static int runBaseline(int runs, size_t totalBytes) {
+    static const size_t blockSizes[] = {1, 64, 4096};
+    static const char *throughputNames[] = {"baseline.throughput.1", "baseline.throughput.64", "baseline.throughput.4096"};
+    Metric throughput[3];
+    Metric roundTrip = {"baseline.roundtrip.16.mean", "us", {0}, 0};
+    Metric roundTripP99 = {"baseline.roundtrip.16.p99", "us", {0}, 0};
+    Metric clockCost = {"baseline.getTimePreciseMicros", "ns/call", {0}, 0};
+    Metric timeoutCost = {"baseline.getNextTimeout", "ns/call", {0}, 0};
+    for (int i = 0; i < 3; i++) {
+        throughput[i].name = throughputNames[i];
+        throughput[i].unit = "MB/s";
+        throughput[i].count = 0;
+    }
+    printf("#jssc_bench baseline runs=%d bytes=%lu roundtrips=%d message=%d\n", runs, (unsigned long)totalBytes,
+           BENCH_ROUND_TRIPS, BENCH_MESSAGE_SIZE);
+    printf("#name\tunit\tmedian\tmin\tmax\n");
+    for (int run = 0; run < runs; run++) {
+        PtyPair pair;
+        if (openPtyPair(&pair) != 0) {
+            return 1;
+        }
+        fcntl(pair.slave, F_SETFL, fcntl(pair.slave, F_GETFL) | O_NONBLOCK);
+        for (int i = 0; i < 3; i++) {
+            //The single byte blocks take long, a sixteenth of the data is enough
+            throughput[i].values[run] = measureThroughput(&pair, (blockSizes[i] == 1 ? totalBytes / 16 : totalBytes), blockSizes[i]);
+            throughput[i].count++;
+        }
+        measureRoundTrips(&pair, &roundTrip.values[run], &roundTripP99.values[run]);
+        roundTrip.count++;
+        roundTripP99.count++;
+        closePtyPair(&pair);
+        clockCost.values[clockCost.count++] = measureClock();
+        timeoutCost.values[timeoutCost.count++] = measureNextTimeout();
+    }
+    for (int i = 0; i < 3; i++) {
+        printMetric(&throughput[i]);
+    }
+    printMetric(&roundTrip);
+    printMetric(&roundTripP99);
+    printMetric(&clockCost);
+    printMetric(&timeoutCost);
+    return 0;
+}
+
+static int usage() {
+    fprintf(stderr, "usage: jssc_bench loopback\n"
+                    "       jssc_bench baseline [runs (default %d, max 64)] [bytes (default %d)]\n",
+            BENCH_DEFAULT_RUNS, BENCH_DEFAULT_BYTES);
+    return 2;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "loopback") == 0) {
+        return runLoopback();
+    }
+    if (argc >= 2 && strcmp(argv[1], "baseline") == 0) {
+        int runs = (argc >= 3 ? atoi(argv[2]) : BENCH_DEFAULT_RUNS);
+        long totalBytes = (argc >= 4 ? atol(argv[3]) : BENCH_DEFAULT_BYTES);
+        if (runs < 1 || runs > 64 || totalBytes < 4096) {
+            return usage();
+        }
+        return runBaseline(runs, (size_t)totalBytes);
+    }
+    return usage();
+}
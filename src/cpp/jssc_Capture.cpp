@@ -0,0 +1,223 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ *
+ * jssc_Capture.cpp
+ * Capture of the traffic of a port into a memory-mapped ring file (since 2.9.0).
+ *
+ * The records are copied straight into the shared mapping of the file, a capture costs
+ * a clock read, a lock and a memcpy() per transfer and no system call. The pages are
+ * written back by the kernel, also if the process dies.
+ */
+
+#include <jssc_Capture.h>
+#include <jssc_Common.h>
+
+#include <string.h>
+#include <new>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <pthread.h>
+    #include <sys/mman.h>
+    #include <sys/time.h>
+#endif
+
+struct CaptureRing {
+    CaptureFileHeader *header;      //Start of the mapping
+    unsigned char *data;            //Data area, after the header
+    uint64_t capacity;
+    uint64_t maxPayload;            //Longer transfers are split
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+    CRITICAL_SECTION lock;
+#else
+    int fd;
+    size_t mappingSize;
+    pthread_mutex_t lock;
+#endif
+};
+
+static int64_t getWallClockMillis() {
+#ifdef _WIN32
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    //100 ns intervals since 1601
+    int64_t intervals = ((int64_t)now.dwHighDateTime << 32) | now.dwLowDateTime;
+    return intervals / 10000 - 11644473600000LL;
+#else
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+#endif
+}
+
+static void* mapCaptureFile(CaptureRing *ring, const char *path, size_t size) {
+#ifdef _WIN32
+    ring->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (ring->file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    //The mapping extends the file to its size
+    ring->mapping = CreateFileMappingA(ring->file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+    void *address = (ring->mapping != NULL ? MapViewOfFile(ring->mapping, FILE_MAP_WRITE, 0, 0, size) : NULL);
+    if (address == NULL) {
+        if (ring->mapping != NULL) {
+            CloseHandle(ring->mapping);
+        }
+        CloseHandle(ring->file);
+    }
+    return address;
+#else
+    ring->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (ring->fd < 0) {
+        return NULL;
+    }
+    ring->mappingSize = size;
+    void *address = NULL;
+    if (ftruncate(ring->fd, (off_t)size) == 0) {
+        address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+        if (address == MAP_FAILED) {
+            address = NULL;
+        }
+    }
+    if (address == NULL) {
+        close(ring->fd);
+    }
+    return address;
+#endif
+}
+
+CaptureRing* captureOpen(const char *path, jlong capacity) {
+    uint64_t size = CAPTURE_MIN_CAPACITY;
+    while (size < (uint64_t)capacity && size < CAPTURE_MAX_CAPACITY) {
+        size <<= 1;
+    }
+    CaptureRing *ring = new (std::nothrow) CaptureRing();
+    if (ring == NULL) {
+        return NULL;
+    }
+    void *address = mapCaptureFile(ring, path, (size_t)(sizeof(CaptureFileHeader) + size));
+    if (address == NULL) {
+        delete ring;
+        return NULL;
+    }
+    ring->header = (CaptureFileHeader*)address;
+    ring->data = (unsigned char*)address + sizeof(CaptureFileHeader);
+    ring->capacity = size;
+    ring->maxPayload = size / 4;
+#ifdef _WIN32
+    InitializeCriticalSection(&ring->lock);
+#else
+    pthread_mutex_init(&ring->lock, NULL);
+#endif
+    CaptureFileHeader *header = ring->header;
+    memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = CAPTURE_VERSION;
+    header->headerSize = sizeof(CaptureFileHeader);
+    header->capacity = size;
+    header->head = 0;
+    header->tail = 0;
+    header->startMicros = getTimePreciseMicros();
+    header->startTimeMillis = getWallClockMillis();
+    header->dropped = 0;
+    return ring;
+}
+
+/*
+ * Drop the oldest records until size more bytes fit, lock held
+ */
+static void reserveCaptureSpace(CaptureRing *ring, uint64_t size) {
+    CaptureFileHeader *header = ring->header;
+    while (header->head + size - header->tail > ring->capacity) {
+        CaptureRecordHeader *oldest = (CaptureRecordHeader*)(ring->data + (header->tail & (ring->capacity - 1)));
+        if (oldest->direction != CAPTURE_PADDING) {
+            header->dropped++;
+        }
+        header->tail += CAPTURE_RECORD_SIZE(oldest->length);
+    }
+}
+
+static void appendCaptureRecord(CaptureRing *ring, int64_t micros, int direction, const unsigned char *data, uint64_t length) {
+    CaptureFileHeader *header = ring->header;
+    uint64_t size = CAPTURE_RECORD_SIZE(length);
+    uint64_t offset = header->head & (ring->capacity - 1);
+    if (ring->capacity - offset < size) {
+        uint64_t padding = ring->capacity - offset;
+        reserveCaptureSpace(ring, padding);
+        CaptureRecordHeader *record = (CaptureRecordHeader*)(ring->data + offset);
+        record->micros = micros;
+        record->length = (uint32_t)(padding - sizeof(CaptureRecordHeader));
+        record->direction = CAPTURE_PADDING;
+        record->reserved = 0;
+        header->head += padding;
+        offset = 0;
+    }
+    reserveCaptureSpace(ring, size);
+    CaptureRecordHeader *record = (CaptureRecordHeader*)(ring->data + offset);
+    record->micros = micros;
+    record->length = (uint32_t)length;
+    record->direction = (uint16_t)direction;
+    record->reserved = 0;
+    memcpy(record + 1, data, (size_t)length);
+    header->head += size;
+}
+
+void captureBytes(CaptureRing *ring, int direction, const void *data, size_t length) {
+    int64_t micros = getTimePreciseMicros();
+    const unsigned char *bytes = (const unsigned char*)data;
+#ifdef _WIN32
+    EnterCriticalSection(&ring->lock);
+#else
+    pthread_mutex_lock(&ring->lock);
+#endif
+    while (length > 0) {
+        uint64_t chunk = (length < ring->maxPayload ? length : ring->maxPayload);
+        appendCaptureRecord(ring, micros, direction, bytes, chunk);
+        bytes += chunk;
+        length -= (size_t)chunk;
+    }
+#ifdef _WIN32
+    LeaveCriticalSection(&ring->lock);
+#else
+    pthread_mutex_unlock(&ring->lock);
+#endif
+}
+
+void captureClose(CaptureRing *ring) {
+#ifdef _WIN32
+    UnmapViewOfFile(ring->header);
+    CloseHandle(ring->mapping);
+    CloseHandle(ring->file);
+    DeleteCriticalSection(&ring->lock);
+#else
+    munmap(ring->header, ring->mappingSize);
+    close(ring->fd);
+    pthread_mutex_destroy(&ring->lock);
+#endif
+    delete ring;
+}
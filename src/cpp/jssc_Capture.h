@@ -0,0 +1,99 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ *
+ * jssc_Capture.h
+ * Capture of the traffic of a port into a memory-mapped ring file (since 2.9.0).
+ */
+
+#ifndef JSSC_CAPTURE_H
+#define JSSC_CAPTURE_H
+
+#include <jni.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Layout of a capture file, in the byte order of the machine which wrote it: a
+ * CaptureFileHeader, then a data area of capacity bytes used as a ring of records. Each
+ * record is a CaptureRecordHeader followed by length bytes of payload, padded to
+ * CAPTURE_ALIGNMENT. The oldest record starts at tail and the records follow each other
+ * up to head, both counted in bytes since the capture started (the offset in the data
+ * area is the count modulo capacity). A record never wraps around the end of the data
+ * area, the space left before it is filled by a CAPTURE_PADDING record.
+ */
+#define CAPTURE_MAGIC           "JSSCCAP1"
+#define CAPTURE_VERSION         1
+#define CAPTURE_ALIGNMENT       16
+
+#define CAPTURE_PADDING         0
+#define CAPTURE_READ            1   //Bytes received from the port
+#define CAPTURE_WRITE           2   //Bytes sent to the port
+
+#define CAPTURE_MIN_CAPACITY    65536
+#define CAPTURE_MAX_CAPACITY    (1 << 30)
+
+struct CaptureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;            //sizeof(CaptureFileHeader), the data area follows
+    uint64_t capacity;              //Size of the data area, a power of two
+    uint64_t head;                  //End of the newest record
+    uint64_t tail;                  //Start of the oldest record
+    int64_t startMicros;            //getTimePreciseMicros() when the capture started
+    int64_t startTimeMillis;        //Wall clock time when the capture started, since 1970
+    uint64_t dropped;               //Records overwritten by newer ones
+};
+
+struct CaptureRecordHeader {
+    int64_t micros;                 //getTimePreciseMicros() when the bytes were transferred
+    uint32_t length;                //Bytes of payload
+    uint16_t direction;             //CAPTURE_*
+    uint16_t reserved;
+};
+
+#define CAPTURE_RECORD_SIZE(length) \
+    ((sizeof(CaptureRecordHeader) + (uint64_t)(length) + CAPTURE_ALIGNMENT - 1) & ~(uint64_t)(CAPTURE_ALIGNMENT - 1))
+
+struct CaptureRing;
+
+/*
+ * Create (or truncate) the capture file at path with a data area of at least capacity
+ * bytes, clamped to CAPTURE_MIN_CAPACITY..CAPTURE_MAX_CAPACITY. Returns NULL if the
+ * file couldn't be created or mapped.
+ */
+CaptureRing* captureOpen(const char *path, jlong capacity) ;
+
+/*
+ * Append the bytes transferred in one direction, split into several records if they
+ * are longer than a quarter of the ring. Safe to call from several threads.
+ */
+void captureBytes(CaptureRing *ring, int direction, const void *data, size_t length) ;
+
+/*
+ * Unmap and close the file, no other thread may use the ring anymore
+ */
+void captureClose(CaptureRing *ring) ;
+
+#endif
@@ -0,0 +1,360 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ *
+ * jssc_Checksum.cpp
+ * Checksums of the framing protocols, platform independent (since 2.9.0).
+ *
+ * All of the CRCs are computed 8 bytes at a time with "slicing-by-8" lookup tables.
+ * CRC-32 uses the carry-less multiplication of x86 processors (PCLMULQDQ) or the
+ * CRC32 instructions of ARMv8 instead when they are available.
+ */
+
+#include <jssc_Checksum.h>
+#include <jssc_Common.h>
+#include "jssc_SerialNativeInterface.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <wmmintrin.h>
+    #include <smmintrin.h>
+    #define JSSC_CRC32_PCLMUL
+#elif defined(__ARM_FEATURE_CRC32) && !defined(__ARM_BIG_ENDIAN)
+    #include <arm_acle.h>
+    #include <stdint.h>
+    #define JSSC_CRC32_ARMV8
+#endif
+
+static unsigned int crc32Table[8][256];
+static unsigned int modbusTable[8][256];
+static unsigned int ccittTable[8][256];
+
+/*
+ * Tables of a reflected CRC: table[k][i] is the CRC of byte i followed by k zero bytes
+ */
+static void buildReflectedTables(unsigned int table[8][256], unsigned int polynomial) {
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned int crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = ((crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1);
+        }
+        table[0][i] = crc;
+    }
+    for (unsigned int i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+    }
+}
+
+/*
+ * Tables of a 16 bits CRC computed most significant bit first
+ */
+static void buildForwardTables16(unsigned int table[8][256], unsigned int polynomial) {
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned int crc = i << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = ((crc & 0x8000) ? (crc << 1) ^ polynomial : crc << 1) & 0xFFFF;
+        }
+        table[0][i] = crc;
+    }
+    for (unsigned int i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            table[k][i] = ((table[k - 1][i] << 8) & 0xFFFF) ^ table[0][table[k - 1][i] >> 8];
+        }
+    }
+}
+
+/*
+ * Slicing-by-8 of a reflected CRC of up to 32 bits. The bytes are loaded one by one,
+ * so the data needs no alignment and the result doesn't depend on the byte order of
+ * the processor.
+ */
+static unsigned int updateReflected(const unsigned int table[8][256], unsigned int crc, const unsigned char *data, size_t length) {
+    while (length >= 8) {
+        unsigned int low = crc ^ ((unsigned int)data[0] | ((unsigned int)data[1] << 8) |
+                                  ((unsigned int)data[2] << 16) | ((unsigned int)data[3] << 24));
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+/*
+ * Slicing-by-8 of a 16 bits CRC computed most significant bit first
+ */
+static unsigned int updateForward16(const unsigned int table[8][256], unsigned int crc, const unsigned char *data, size_t length) {
+    while (length >= 8) {
+        crc = table[7][data[0] ^ (crc >> 8)] ^ table[6][data[1] ^ (crc & 0xFF)] ^ table[5][data[2]] ^ table[4][data[3]] ^
+              table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = ((crc << 8) & 0xFFFF) ^ table[0][(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+static unsigned int updateCrc32Tables(unsigned int crc, const unsigned char *data, size_t length) {
+    return updateReflected(crc32Table, crc, data, length);
+}
+
+#ifdef JSSC_CRC32_PCLMUL
+/*
+ * CRC-32 by folding 64 bytes at a time with carry-less multiplications, then a Barrett
+ * reduction, as described in "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction" (Intel, 2009). The constants are those of the bit reflected
+ * CRC-32 polynomial.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static unsigned int foldCrc32Pclmul(unsigned int crc, const unsigned char *data, size_t length) {
+    static const long long k1k2[2] __attribute__((aligned(16))) = {0x0154442bd4LL, 0x01c6e41596LL};
+    static const long long k3k4[2] __attribute__((aligned(16))) = {0x01751997d0LL, 0x00ccaa009eLL};
+    static const long long k5k0[2] __attribute__((aligned(16))) = {0x0163cd6124LL, 0x0000000000LL};
+    static const long long poly[2] __attribute__((aligned(16))) = {0x01db710641LL, 0x01f7011641LL};
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    //At least 64 bytes, a multiple of 16
+    x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+    data += 64;
+    length -= 64;
+
+    //Fold 4 blocks of 16 bytes in parallel
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        data += 64;
+        length -= 64;
+    }
+
+    //Fold the 4 blocks into one
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    //Fold the remaining blocks of 16 bytes
+    while (length >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)data);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        data += 16;
+        length -= 16;
+    }
+
+    //Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    //Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (unsigned int)_mm_extract_epi32(x1, 1);
+}
+
+static unsigned int updateCrc32Pclmul(unsigned int crc, const unsigned char *data, size_t length) {
+    if (length >= 64) {
+        size_t folded = length & ~(size_t)15;
+        crc = foldCrc32Pclmul(crc, data, folded);
+        data += folded;
+        length -= folded;
+    }
+    return updateReflected(crc32Table, crc, data, length);
+}
+#endif
+
+#ifdef JSSC_CRC32_ARMV8
+static unsigned int updateCrc32Armv8(unsigned int crc, const unsigned char *data, size_t length) {
+    while (length > 0 && ((uintptr_t)data & 7) != 0) {
+        crc = __crc32b(crc, *data++);
+        length--;
+    }
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc = __crc32d(crc, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = __crc32b(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+static unsigned int (*updateCrc32)(unsigned int crc, const unsigned char *data, size_t length) = updateCrc32Tables;
+
+/*
+ * Builds the lookup tables and selects the CRC-32 instructions of the processor if
+ * it has any
+ */
+void initChecksumTables() {
+    buildReflectedTables(crc32Table, 0xEDB88320);
+    buildReflectedTables(modbusTable, 0xA001);
+    buildForwardTables16(ccittTable, 0x1021);
+#if defined JSSC_CRC32_PCLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        updateCrc32 = updateCrc32Pclmul;
+    }
+#elif defined JSSC_CRC32_ARMV8
+    updateCrc32 = updateCrc32Armv8;
+#endif
+}
+
+unsigned int getChecksumSize(int type) {
+    switch (type) {
+        case CHECKSUM_CRC16_MODBUS:
+        case CHECKSUM_CRC16_CCITT:
+            return 2;
+        case CHECKSUM_CRC32:
+            return 4;
+    }
+    return 0;
+}
+
+unsigned int checksumStart(int type) {
+    return (type == CHECKSUM_CRC32 ? 0xFFFFFFFF : 0xFFFF);
+}
+
+unsigned int checksumUpdate(int type, unsigned int state, const jbyte *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char*)data;
+    switch (type) {
+        case CHECKSUM_CRC16_MODBUS:
+            return updateReflected(modbusTable, state, bytes, length);
+        case CHECKSUM_CRC16_CCITT:
+            return updateForward16(ccittTable, state, bytes, length);
+        case CHECKSUM_CRC32:
+            return updateCrc32(state, bytes, length);
+    }
+    return state;
+}
+
+unsigned int checksumFinish(int type, unsigned int state) {
+    return (type == CHECKSUM_CRC32 ? ~state : state);
+}
+
+/*
+ * Returns the checksum of the given type stored at field, in the byte order of the
+ * type
+ */
+unsigned int readChecksum(int type, const jbyte *field) {
+    const unsigned char *bytes = (const unsigned char*)field;
+    switch (type) {
+        case CHECKSUM_CRC16_MODBUS:
+            return bytes[0] | (bytes[1] << 8);
+        case CHECKSUM_CRC16_CCITT:
+            return (bytes[0] << 8) | bytes[1];
+        case CHECKSUM_CRC32:
+            return (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) |
+                   ((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+    }
+    return 0;
+}
+
+/*
+ * Compute the checksum of a region of an array (since 2.9.0)
+ *
+ * Returns the checksum as an unsigned value, or -1 if a parameter is not correct.
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_checksum
+  (JNIEnv *env, jobject object, jint type, jbyteArray buffer, jint offset, jint length){
+    jint arrayLength = (buffer != NULL ? env->GetArrayLength(buffer) : 0);
+    if (buffer == NULL || getChecksumSize(type) == 0 || offset < 0 || length < 0 ||
+        offset > arrayLength || length > arrayLength - offset) {
+        throwSerialException(env, "NoPort", "<native>checksum()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jbyte *elements = (jbyte*)env->GetPrimitiveArrayCritical(buffer, NULL);
+    if (elements == NULL) {
+        return -1;//OutOfMemoryError is pending
+    }
+    unsigned int state = checksumUpdate(type, checksumStart(type), elements + offset, (size_t)length);
+    env->ReleasePrimitiveArrayCritical(buffer, elements, JNI_ABORT);
+    return (jlong)checksumFinish(type, state);
+}
+
+/*
+ * Compute the checksum of a region of a direct ByteBuffer, starting at position
+ * (since 2.9.0)
+ *
+ * Returns the checksum as an unsigned value, or -1 if a parameter is not correct.
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_checksumBuffer
+  (JNIEnv *env, jobject object, jint type, jobject buffer, jint position, jint length){
+    jbyte *address = (buffer != NULL ? (jbyte*)env->GetDirectBufferAddress(buffer) : NULL);
+    jlong capacity = (address != NULL ? env->GetDirectBufferCapacity(buffer) : 0);
+    if (address == NULL || getChecksumSize(type) == 0 || position < 0 || length < 0 ||
+        position > capacity || length > capacity - position) {
+        throwSerialException(env, "NoPort", "<native>checksumBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    unsigned int state = checksumUpdate(type, checksumStart(type), address + position, (size_t)length);
+    return (jlong)checksumFinish(type, state);
+}
@@ -0,0 +1,74 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ *
+ * jssc_Checksum.h
+ * Checksums of the framing protocols, platform independent (since 2.9.0).
+ */
+
+#ifndef JSSC_CHECKSUM_H
+#define JSSC_CHECKSUM_H
+
+#include <jni.h>
+
+#include <stddef.h>
+
+/*
+ * Checksum types, must match the constants of jssc.SerialChecksum. In a frame the
+ * checksum is stored low byte first for CRC16_MODBUS and CRC32, high byte first for
+ * CRC16_CCITT, as these protocols do.
+ */
+#define CHECKSUM_NONE                   0
+#define CHECKSUM_CRC16_MODBUS           1   //Reflected 0x8005, initial value 0xFFFF
+#define CHECKSUM_CRC16_CCITT            2   //0x1021, initial value 0xFFFF (CCITT-FALSE)
+#define CHECKSUM_CRC32                  3   //Reflected 0x04C11DB7 as used by zlib and Ethernet
+
+/*
+ * Builds the lookup tables and selects the CRC-32 instructions of the processor if
+ * it has any. Called once from JNI_OnLoad, before any other checksum function.
+ */
+void initChecksumTables() ;
+
+/*
+ * Returns the size in bytes of a checksum of the given type, or 0 if the type is
+ * unknown or CHECKSUM_NONE
+ */
+unsigned int getChecksumSize(int type) ;
+
+/*
+ * The checksum of a sequence of blocks is computed by checksumStart(), then
+ * checksumUpdate() for each block in order, and checksumFinish().
+ */
+unsigned int checksumStart(int type) ;
+
+unsigned int checksumUpdate(int type, unsigned int state, const jbyte *data, size_t length) ;
+
+unsigned int checksumFinish(int type, unsigned int state) ;
+
+/*
+ * Returns the checksum of the given type stored at field, in the byte order of the
+ * type
+ */
+unsigned int readChecksum(int type, const jbyte *field) ;
+
+#endif
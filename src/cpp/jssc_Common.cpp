@@ -28,6 +28,138 @@
  */
 
 #include <jssc_Common.h>
+#include <jssc_Checksum.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#elif defined __APPLE__
+    #include <mach/mach_time.h>
+#else
+    #include <time.h>
+#endif
+
+static jclass systemClass = NULL;
+static jfieldID systemOutField = NULL;
+static jmethodID printlnMethod = NULL;
+static jclass threadClass = NULL;
+static jmethodID interruptedMethod = NULL;
+static jclass interruptedExceptionClass = NULL;
+static jclass stringClass = NULL;
+static jclass intArrayClass = NULL;
+static jclass serialExceptionClass = NULL;
+static jmethodID serialExceptionCtor = NULL;
+static jclass timeoutExceptionClass = NULL;
+static jmethodID timeoutExceptionCtor = NULL;
+static jfieldID typeReadInterruptedField = NULL;
+static jfieldID typeNoMemoryField = NULL;
+static jfieldID typeParameterIsNotCorrectField = NULL;
+static jfieldID typePortNotOpenedField = NULL;
+static jfieldID typeUnknownField = NULL;
+static jfieldID typeIOCancelledField = NULL;
+
+/*
+ * Finds the class and returns a global reference to it, or NULL if it can't be found
+ */
+static jclass findGlobalClass(JNIEnv *env, const char* name) {
+    jclass localClass = env->FindClass(name);
+    if (localClass == NULL) {
+        return NULL;
+    }
+    jclass globalClass = (jclass)env->NewGlobalRef(localClass);
+    env->DeleteLocalRef(localClass);
+    return globalClass;
+}
+
+/*
+ * Resolves all of the classes, methods and fields used by the native library. The
+ * library is loaded by jssc.SerialNativeInterface, so the jssc classes are visible
+ * to FindClass here through its class loader.
+ */
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env;
+    if (vm->GetEnv((void**)&env, JNI_VERSION_1_2) != JNI_OK) {
+        return JNI_ERR;
+    }
+    initChecksumTables();
+
+    systemClass = findGlobalClass(env, "java/lang/System");
+    threadClass = findGlobalClass(env, "java/lang/Thread");
+    interruptedExceptionClass = findGlobalClass(env, "java/lang/InterruptedException");
+    stringClass = findGlobalClass(env, "java/lang/String");
+    intArrayClass = findGlobalClass(env, "[I");
+    serialExceptionClass = findGlobalClass(env, "jssc/SerialPortException");
+    timeoutExceptionClass = findGlobalClass(env, "jssc/SerialPortTimeoutException");
+    jclass printStreamClass = env->FindClass("java/io/PrintStream");
+    if (systemClass == NULL || threadClass == NULL || interruptedExceptionClass == NULL || stringClass == NULL ||
+        intArrayClass == NULL || serialExceptionClass == NULL || timeoutExceptionClass == NULL || printStreamClass == NULL) {
+        return JNI_ERR;
+    }
+
+    systemOutField = env->GetStaticFieldID(systemClass, "out", "Ljava/io/PrintStream;");
+    printlnMethod = env->GetMethodID(printStreamClass, "println", "(Ljava/lang/String;)V");
+    env->DeleteLocalRef(printStreamClass);
+    interruptedMethod = env->GetStaticMethodID(threadClass, "interrupted", "()Z");
+    serialExceptionCtor = env->GetMethodID(serialExceptionClass, "<init>", "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
+    timeoutExceptionCtor = env->GetMethodID(timeoutExceptionClass, "<init>", "(Ljava/lang/String;Ljava/lang/String;J)V");
+    typeReadInterruptedField = env->GetStaticFieldID(serialExceptionClass, "TYPE_READ_INTERRUPTED", "Ljava/lang/String;");
+    typeNoMemoryField = env->GetStaticFieldID(serialExceptionClass, "TYPE_NO_MEMORY", "Ljava/lang/String;");
+    typeParameterIsNotCorrectField = env->GetStaticFieldID(serialExceptionClass, "TYPE_PARAMETER_IS_NOT_CORRECT", "Ljava/lang/String;");
+    typePortNotOpenedField = env->GetStaticFieldID(serialExceptionClass, "TYPE_PORT_NOT_OPENED", "Ljava/lang/String;");
+    typeUnknownField = env->GetStaticFieldID(serialExceptionClass, "TYPE_UNKNOWN", "Ljava/lang/String;");
+    typeIOCancelledField = env->GetStaticFieldID(serialExceptionClass, "TYPE_IO_CANCELLED", "Ljava/lang/String;");
+    if (env->ExceptionCheck()) {
+        //NoSuchMethodError or NoSuchFieldError, the java and native parts don't match
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_2;
+}
+
+/*
+ * Releases the global references taken in JNI_OnLoad
+ */
+JNIEXPORT void JNICALL JNI_OnUnload(JavaVM *vm, void *reserved) {
+    JNIEnv *env;
+    if (vm->GetEnv((void**)&env, JNI_VERSION_1_2) != JNI_OK) {
+        return;
+    }
+    jclass *classes[] = {&systemClass, &threadClass, &interruptedExceptionClass, &stringClass,
+                         &intArrayClass, &serialExceptionClass, &timeoutExceptionClass};
+    for (size_t i = 0; i < sizeof(classes)/sizeof(classes[0]); i++) {
+        if (*classes[i] != NULL) {
+            env->DeleteGlobalRef(*classes[i]);
+            *classes[i] = NULL;
+        }
+    }
+}
+
+/*
+ * Returns the cached class of java.lang.String
+ */
+jclass getStringClass() {
+    return stringClass;
+}
+
+/*
+ * Returns the cached class of int[]
+ */
+jclass getIntArrayClass() {
+    return intArrayClass;
+}
+
+/*
+ * Calls Thread.interrupted(): returns JNI_TRUE if the current java thread has been
+ * interrupted, and clears its interrupted status.
+ */
+jboolean isThreadInterrupted(JNIEnv *env) {
+    return env->CallStaticBooleanMethod(threadClass, interruptedMethod);
+}
+
+/*
+ * Throws a java InterruptedException with the given message.
+ */
+void throwInterruptedException(JNIEnv *env, const char* msg) {
+    env->ThrowNew(interruptedExceptionClass, msg);
+}
 
 /*
  * Calls System.out.println(String msg) with the given message.
@@ -35,31 +167,43 @@
 void println(JNIEnv *env, const char* msg) {
     //Adapted from 
     // http://stackoverflow.com/questions/25417792/how-to-call-system-out-println-from-c-via-jni
-    jclass syscls = env->FindClass("java/lang/System");
-    jfieldID fid = env->GetStaticFieldID(syscls, "out", "Ljava/io/PrintStream;");
-    jobject out = env->GetStaticObjectField(syscls, fid);
-    jclass pscls = env->FindClass("java/io/PrintStream");
-    jmethodID mid = env->GetMethodID(pscls, "println", "(Ljava/lang/String;)V");
-
+    jobject out = env->GetStaticObjectField(systemClass, systemOutField);
     jstring str = env->NewStringUTF(msg);
-    env->CallVoidMethod(out, mid, str);
+    env->CallVoidMethod(out, printlnMethod, str);
 }
 
 /*
- * Get the number of micro seconds since some epoch.  Uses System.nanoTime(). 
- * May be negative. 
+ * Get the number of micro seconds since some epoch from a monotonic clock, without
+ * calling into the JVM. May be negative.
  */
-long getTimePreciseMicros(JNIEnv *env) {
-    jclass syscls = env->FindClass("java/lang/System");
-    jmethodID mid = env->GetStaticMethodID(syscls, "nanoTime", "()J");
-
-    jlong ret = env->CallStaticLongMethod(syscls, mid)/1000;
-    return ret;
+jlong getTimePreciseMicros() {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    //Split the conversion so that counter*1000000 can't overflow
+    return (counter.QuadPart / frequency.QuadPart) * 1000000 +
+           ((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart;
+#elif defined __APPLE__
+    static mach_timebase_info_data_t timebase = {0, 0};
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+    uint64_t nanos = mach_absolute_time() / timebase.denom * timebase.numer;
+    return (jlong)(nanos / 1000);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (jlong)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
 }
 
 /*
  * Updates the supplied timeval struct with the next timeout to use for a select call.
- * timeoutDeadline is a point on the time scale provided by System.nanoTime(), but in micro-
+ * timeoutDeadline is a point on the time scale provided by getTimePreciseMicros(), in micro-
  * seconds.  It may be negative, 0, or positive.
  * pollPeriodMillis is how often the thread should check its interrupted status, or 0 if
  * the thread should never check.
@@ -72,7 +216,7 @@ long getTimePreciseMicros(JNIEnv *env) {
  * Returns 1 on error (and thus the time* is undefined), returns 0 if the time struct has been 
  * filled with the next unblock timeout for select().
  */
-int getNextTimeout(JNIEnv *env, struct timeval *time, char deadlineValid, long timeoutDeadline, long pollPeriodMillis) {
+int getNextTimeout(struct timeval *time, char deadlineValid, jlong timeoutDeadline, jlong pollPeriodMillis) {
 
     if (time == NULL)
         return 1;
@@ -80,13 +224,13 @@ int getNextTimeout(JNIEnv *env, struct timeval *time, char deadlineValid, long t
     if (deadlineValid == 0 && pollPeriodMillis == 0)
         return 1;
 
-    long pollPeriodMicros = pollPeriodMillis * 1000;
+    jlong pollPeriodMicros = pollPeriodMillis * 1000;
     if (deadlineValid == 0) {
         time->tv_sec = pollPeriodMicros / 1000000;
         time->tv_usec = pollPeriodMicros % 1000000;
     } else {
-        long currentTime = getTimePreciseMicros(env);
-        long timeUntilTimeout = timeoutDeadline - currentTime;
+        jlong currentTime = getTimePreciseMicros();
+        jlong timeUntilTimeout = timeoutDeadline - currentTime;
         if (timeUntilTimeout <= 0) {
             time->tv_sec=0;
             time->tv_usec=0;
@@ -108,38 +252,38 @@ int getNextTimeout(JNIEnv *env, struct timeval *time, char deadlineValid, long t
  * Throws a java SerialPortTimeoutException with the provided parameters.
  */
 void throwTimeoutException(JNIEnv *env, const char* portName, const char* methodName, jlong timeoutMillis) {
-    jclass excClass = env->FindClass("jssc/SerialPortTimeoutException");
-    jmethodID ctor = env->GetMethodID(excClass, "<init>", "(Ljava/lang/String;Ljava/lang/String;J)V");
     jstring port = env->NewStringUTF(portName);
     jstring method = env->NewStringUTF(methodName);
-    jobject exception = env->NewObject(excClass, ctor, port, method, timeoutMillis);
+    jobject exception = env->NewObject(timeoutExceptionClass, timeoutExceptionCtor, port, method, timeoutMillis);
     env->Throw((jthrowable)exception);
 }
 
 static jstring getExceptionType(JNIEnv *env, int type) {
-    jclass excClass = env->FindClass("jssc/SerialPortException");
     jfieldID field = NULL;
     jstring ret;
     switch (type) {
     case SP_EXCEPTION_TYPE_READ_INTERRUPTED:
-        field = env->GetStaticFieldID(excClass, "TYPE_READ_INTERRUPTED", "Ljava/lang/String;");
+        field = typeReadInterruptedField;
         break;
     case SP_EXCEPTION_TYPE_NO_MEMORY:
-        field = env->GetStaticFieldID(excClass, "TYPE_NO_MEMORY", "Ljava/lang/String;");
+        field = typeNoMemoryField;
         break;
     case SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT:
-        field = env->GetStaticFieldID(excClass, "TYPE_PARAMETER_IS_NOT_CORRECT", "Ljava/lang/String;");
+        field = typeParameterIsNotCorrectField;
         break;
     case SP_EXCEPTION_TYPE_PORT_NOT_OPENED:
-        field = env->GetStaticFieldID(excClass, "TYPE_PORT_NOT_OPENED", "Ljava/lang/String;");
+        field = typePortNotOpenedField;
         break;
     case SP_EXCEPTION_TYPE_UNKNOWN:
-        field = env->GetStaticFieldID(excClass, "TYPE_UNKNOWN", "Ljava/lang/String;");
+        field = typeUnknownField;
+        break;
+    case SP_EXCEPTION_TYPE_IO_CANCELLED:
+        field = typeIOCancelledField;
         break;
     }
 
     if (field != NULL) {
-        ret = (jstring)env->GetStaticObjectField(excClass, field);
+        ret = (jstring)env->GetStaticObjectField(serialExceptionClass, field);
     } else {
         ret = env->NewStringUTF("Invalid Exception Type");
     }
@@ -150,12 +294,9 @@ static jstring getExceptionType(JNIEnv *env, int type) {
  * Throws a java SerialPortException with the provided parameters.
  */
 void throwSerialException(JNIEnv *env, const char* portName, const char* methodName, int exceptionType) {
-    jclass excClass = env->FindClass("jssc/SerialPortException");
-    jmethodID ctor = env->GetMethodID(excClass, "<init>", "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String)V");
     jstring port = env->NewStringUTF(portName);
     jstring method = env->NewStringUTF(methodName);
     jstring type = getExceptionType(env, exceptionType);
-    jobject exception = env->NewObject(excClass, ctor, port, method, type);
+    jobject exception = env->NewObject(serialExceptionClass, serialExceptionCtor, port, method, type);
     env->Throw((jthrowable)exception);
 }
-
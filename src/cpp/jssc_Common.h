@@ -27,6 +27,9 @@
  * Contributors: Charles Hache <chalz@member.fsf.org>
  */
 
+#ifndef JSSC_COMMON_H
+#define JSSC_COMMON_H
+
 #include <jni.h>
 
 #include <sys/time.h> 
@@ -36,6 +39,33 @@
 #define SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT      3
 #define SP_EXCEPTION_TYPE_PORT_NOT_OPENED               4
 #define SP_EXCEPTION_TYPE_UNKNOWN                       5
+#define SP_EXCEPTION_TYPE_IO_CANCELLED                  6//since 2.9.0
+
+/*
+ * Classes, method and field IDs are resolved once in JNI_OnLoad (see jssc_Common.cpp)
+ * and kept as global references until the library is unloaded.
+ */
+
+/*
+ * Returns the cached class of java.lang.String
+ */
+jclass getStringClass() ;
+
+/*
+ * Returns the cached class of int[]
+ */
+jclass getIntArrayClass() ;
+
+/*
+ * Calls Thread.interrupted(): returns JNI_TRUE if the current java thread has been
+ * interrupted, and clears its interrupted status.
+ */
+jboolean isThreadInterrupted(JNIEnv *env) ;
+
+/*
+ * Throws a java InterruptedException with the given message.
+ */
+void throwInterruptedException(JNIEnv *env, const char* msg) ;
 
 /*
  * Calls System.out.println(String msg) with the given message.
@@ -43,14 +73,15 @@
 void println(JNIEnv *env, const char* msg) ;
 
 /*
- * Get the number of micro seconds since some epoch.  Uses System.nanoTime(). 
- * May be negative. 
+ * Get the number of micro seconds since some epoch from a monotonic clock
+ * (clock_gettime(CLOCK_MONOTONIC), mach_absolute_time() on Mac OS X,
+ * QueryPerformanceCounter() on Windows). May be negative. 
  */
-long getTimePreciseMicros(JNIEnv *env) ;
+jlong getTimePreciseMicros() ;
 
 /*
  * Updates the supplied timeval struct with the next timeout to use for a select call.
- * timeoutDeadline is a point on the time scale provided by System.nanoTime(), but in micro-
+ * timeoutDeadline is a point on the time scale provided by getTimePreciseMicros(), in micro-
  * seconds.  It may be negative, 0, or positive.
  * pollPeriodMillis is how often the thread should check its interrupted status, or 0 if
  * the thread should never check.
@@ -63,7 +94,7 @@ long getTimePreciseMicros(JNIEnv *env) ;
  * Returns 1 on error (and thus the time* is undefined), returns 0 if the time struct has been 
  * filled with the next unblock timeout for select().
  */
-int getNextTimeout(JNIEnv *env, struct timeval *time, char deadlineValid, long timeoutDeadline, long pollPeriodMillis) ;
+int getNextTimeout(struct timeval *time, char deadlineValid, jlong timeoutDeadline, jlong pollPeriodMillis) ;
 
 /*
  * Throws a java SerialPortTimeoutException with the provided parameters.
@@ -75,3 +106,4 @@ void throwTimeoutException(JNIEnv *env, const char* portName, const char* method
  */
 void throwSerialException(JNIEnv *env, const char* portName, const char* methodName, int exceptionType) ;
 
+#endif
@@ -131,6 +131,22 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setRTS
 JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setDTR
   (JNIEnv *, jobject, jlong, jboolean);
 
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    setLines
+ * Signature: (JII)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setLines
+  (JNIEnv *, jobject, jlong, jint, jint);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    setRS485
+ * Signature: (JZZII)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setRS485
+  (JNIEnv *, jobject, jlong, jboolean, jboolean, jint, jint);
+
 /*
  * Class:     jssc_SerialNativeInterface
  * Method:    readBytes
@@ -139,6 +155,38 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setDTR
 JNIEXPORT jbyteArray JNICALL Java_jssc_SerialNativeInterface_readBytes
   (JNIEnv *, jobject, jlong, jint, jlong, jlong, jboolean);
 
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    readBytesToArray
+ * Signature: (J[BIIJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesToArray
+  (JNIEnv *, jobject, jlong, jbyteArray, jint, jint, jlong, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    readAvailable
+ * Signature: (J[BII)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readAvailable
+  (JNIEnv *, jobject, jlong, jbyteArray, jint, jint);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    readBytesUntilIdle
+ * Signature: (J[BIIJJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesUntilIdle
+  (JNIEnv *, jobject, jlong, jbyteArray, jint, jint, jlong, jlong, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    readBytesToBuffer
+ * Signature: (JLjava/nio/ByteBuffer;IIJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesToBuffer
+  (JNIEnv *, jobject, jlong, jobject, jint, jint, jlong, jlong, jboolean);
+
 /*
  * Class:     jssc_SerialNativeInterface
  * Method:    writeBytes
@@ -147,6 +195,70 @@ JNIEXPORT jbyteArray JNICALL Java_jssc_SerialNativeInterface_readBytes
 JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_writeBytes
   (JNIEnv *, jobject, jlong, jbyteArray);
 
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    writeBytesFromArray
+ * Signature: (J[BIIJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesFromArray
+  (JNIEnv *, jobject, jlong, jbyteArray, jint, jint, jlong, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    writeBytesFromBuffer
+ * Signature: (JLjava/nio/ByteBuffer;IIJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesFromBuffer
+  (JNIEnv *, jobject, jlong, jobject, jint, jint, jlong, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    writeBytesGather
+ * Signature: (J[Ljava/lang/Object;[I[IJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesGather
+  (JNIEnv *, jobject, jlong, jobjectArray, jintArray, jintArray, jlong, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    drainPort
+ * Signature: (JJJ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_drainPort
+  (JNIEnv *, jobject, jlong, jlong, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    cancelIO
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_cancelIO
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    getStatistics
+ * Signature: (JZ)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_jssc_SerialNativeInterface_getStatistics
+  (JNIEnv *, jobject, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    captureStart
+ * Signature: (JLjava/lang/String;J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_captureStart
+  (JNIEnv *, jobject, jlong, jstring, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    captureStop
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_captureStop
+  (JNIEnv *, jobject, jlong);
+
 /*
  * Class:     jssc_SerialNativeInterface
  * Method:    getBuffersBytesCount
@@ -179,6 +291,22 @@ JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_getFlowControlMode
 JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_getSerialPortNames
   (JNIEnv *, jobject);
 
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    setLowLatency
+ * Signature: (JZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setLowLatency
+  (JNIEnv *, jobject, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    configure
+ * Signature: (JIIIIII)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_configure
+  (JNIEnv *, jobject, jlong, jint, jint, jint, jint, jint, jint);
+
 /*
  * Class:     jssc_SerialNativeInterface
  * Method:    getLinesStatus
@@ -195,6 +323,190 @@ JNIEXPORT jintArray JNICALL Java_jssc_SerialNativeInterface_getLinesStatus
 JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_sendBreak
   (JNIEnv *, jobject, jlong, jint);
 
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    selectorOpen
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_selectorOpen
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    selectorRegister
+ * Signature: (JJI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorRegister
+  (JNIEnv *, jobject, jlong, jlong, jint);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    selectorUnregister
+ * Signature: (JJ)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorUnregister
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    selectorSelect
+ * Signature: (J[J[I[IJ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_selectorSelect
+  (JNIEnv *, jobject, jlong, jlongArray, jintArray, jintArray, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    selectorWakeup
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorWakeup
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    selectorClose
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorClose
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    waitEventsInto
+ * Signature: (J[I)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_waitEventsInto
+  (JNIEnv *, jobject, jlong, jintArray);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    eventWaiterOpen
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_eventWaiterOpen
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    eventWaiterWait
+ * Signature: (J[I)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_eventWaiterWait
+  (JNIEnv *, jobject, jlong, jintArray);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    eventWaiterCancel
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_eventWaiterCancel
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    eventWaiterClose
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_eventWaiterClose
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    bufferedReaderStart
+ * Signature: (JI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_bufferedReaderStart
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    bufferedReaderStop
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_bufferedReaderStop
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    setReaderScheduling
+ * Signature: (JJIZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setReaderScheduling
+  (JNIEnv *, jobject, jlong, jlong, jint, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    setThreadScheduling
+ * Signature: (JI)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setThreadScheduling
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    readUntil
+ * Signature: (J[B[BIIIJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readUntil
+  (JNIEnv *, jobject, jlong, jbyteArray, jbyteArray, jint, jint, jint, jlong, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    readFrame
+ * Signature: (J[BIIIIIZIJJZ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readFrame
+  (JNIEnv *, jobject, jlong, jbyteArray, jint, jint, jint, jint, jint, jboolean, jint, jlong, jlong, jboolean);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    checksum
+ * Signature: (I[BII)J
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_checksum
+  (JNIEnv *, jobject, jint, jbyteArray, jint, jint);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    checksumBuffer
+ * Signature: (ILjava/nio/ByteBuffer;II)J
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_checksumBuffer
+  (JNIEnv *, jobject, jint, jobject, jint, jint);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    portWatcherOpen
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_portWatcherOpen
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    portWatcherWait
+ * Signature: (JJ)I
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_portWatcherWait
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    portWatcherWakeup
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_portWatcherWakeup
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     jssc_SerialNativeInterface
+ * Method:    portWatcherClose
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_portWatcherClose
+  (JNIEnv *, jobject, jlong);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,356 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ *
+ *
+ * jssc_replay.cpp
+ * Reader of the capture files of SerialPort.startCapture() (since 2.9.0), POSIX only.
+ *
+ * "jssc_replay dump <file>" prints the records of a capture, one per line: the time since
+ * the capture started, the direction as seen by the application (R for the bytes it
+ * received, W for those it sent), the length and the first bytes in hex.
+ *
+ * "jssc_replay play <file>" opens a pseudo-terminal pair and prints the name of the slave
+ * side, which the application under test opens instead of the real port. Once a line is
+ * read from the standard input, the received bytes of the capture are sent to it again
+ * with their original timing (or faster or slower with --speed). With --check the bytes
+ * the application writes are compared with the sent bytes of the capture, and the first
+ * difference is reported. The pair is closed after the next line or the end of the
+ * standard input, unless --no-wait is given.
+ *
+ * A capture still running can be read, but the records being overwritten meanwhile may
+ * come out garbled; stop the capture first, or copy the file.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __APPLE__
+    #include <util.h>
+#else
+    #include <pty.h>
+#endif
+
+#include "../jssc_Common.h"
+#include "../jssc_Capture.h"
+
+#define REPLAY_DUMP_BYTES           16
+#define REPLAY_CHECK_TIMEOUT_MILLIS 5000
+
+struct CaptureFile {
+    const unsigned char *mapping;
+    size_t size;
+    CaptureFileHeader header;       //Copy taken when the file was opened
+    const unsigned char *data;
+};
+
+static int openCaptureFile(const char *path, CaptureFile *file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat status;
+    void *address = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(CaptureFileHeader)) {
+        address = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (address == MAP_FAILED) {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return -1;
+    }
+    file->mapping = (const unsigned char*)address;
+    file->size = (size_t)status.st_size;
+    memcpy(&file->header, address, sizeof(CaptureFileHeader));
+    const CaptureFileHeader *header = &file->header;
+    uint64_t capacity = header->capacity;
+    if (memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0 || header->version != CAPTURE_VERSION ||
+        header->headerSize < sizeof(CaptureFileHeader) || capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        header->headerSize + capacity > file->size || header->head - header->tail > capacity) {
+        fprintf(stderr, "%s: not a capture file of version %d\n", path, CAPTURE_VERSION);
+        munmap(address, file->size);
+        return -1;
+    }
+    file->data = file->mapping + header->headerSize;
+    return 0;
+}
+
+static void closeCaptureFile(CaptureFile *file) {
+    munmap((void*)file->mapping, file->size);
+}
+
+/*
+ * Returns the record at position, or NULL at the end of the capture or if the record
+ * doesn't fit in the data area
+ */
+static const CaptureRecordHeader* getCaptureRecord(const CaptureFile *file, uint64_t position) {
+    const CaptureFileHeader *header = &file->header;
+    if (position >= header->head) {
+        return NULL;
+    }
+    uint64_t offset = position & (header->capacity - 1);
+    const CaptureRecordHeader *record = (const CaptureRecordHeader*)(file->data + offset);
+    uint64_t size = CAPTURE_RECORD_SIZE(record->length);
+    if (header->capacity - offset < size || header->head - position < size) {
+        fprintf(stderr, "Corrupted record at %llu, stopping\n", (unsigned long long)position);
+        return NULL;
+    }
+    return record;
+}
+
+static int runDump(const char *path) {
+    CaptureFile file;
+    if (openCaptureFile(path, &file) != 0) {
+        return 1;
+    }
+    const CaptureFileHeader *header = &file.header;
+    time_t started = (time_t)(header->startTimeMillis / 1000);
+    char startText[64];
+    strftime(startText, sizeof(startText), "%Y-%m-%d %H:%M:%S", localtime(&started));
+    printf("# started %s.%03d, ring of %llu bytes, %llu records dropped\n", startText, (int)(header->startTimeMillis % 1000),
+           (unsigned long long)header->capacity, (unsigned long long)header->dropped);
+    unsigned long long totals[3] = {0, 0, 0};
+    uint64_t position = header->tail;
+    const CaptureRecordHeader *record;
+    while ((record = getCaptureRecord(&file, position)) != NULL) {
+        position += CAPTURE_RECORD_SIZE(record->length);
+        if (record->direction != CAPTURE_READ && record->direction != CAPTURE_WRITE) {
+            continue;
+        }
+        totals[record->direction] += record->length;
+        jlong micros = record->micros - header->startMicros;
+        printf("%lld.%06lld\t%c\t%u\t", (long long)(micros / 1000000), (long long)(micros % 1000000),
+               (record->direction == CAPTURE_READ ? 'R' : 'W'), record->length);
+        const unsigned char *bytes = (const unsigned char*)(record + 1);
+        for (uint32_t i = 0; i < record->length && i < REPLAY_DUMP_BYTES; i++) {
+            printf("%s%02x", (i > 0 ? " " : ""), bytes[i]);
+        }
+        printf("%s\n", (record->length > REPLAY_DUMP_BYTES ? " ..." : ""));
+    }
+    printf("# %llu bytes received, %llu bytes sent\n", totals[CAPTURE_READ], totals[CAPTURE_WRITE]);
+    closeCaptureFile(&file);
+    return 0;
+}
+
+static int writeFully(int fd, const unsigned char *data, size_t length) {
+    while (length > 0) {
+        ssize_t result = write(fd, data, length);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += result;
+        length -= (size_t)result;
+    }
+    return 0;
+}
+
+/*
+ * Read length bytes from fd within timeoutMillis, returns the count of bytes read
+ */
+static size_t readWithTimeout(int fd, unsigned char *buffer, size_t length, int timeoutMillis) {
+    size_t done = 0;
+    jlong deadline = getTimePreciseMicros() + (jlong)timeoutMillis * 1000;
+    while (done < length) {
+        jlong remains = deadline - getTimePreciseMicros();
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (remains <= 0) {
+            break;
+        }
+        int ready = poll(&pfd, 1, (int)((remains + 999) / 1000));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            break;
+        }
+        ssize_t result = read(fd, buffer + done, length - done);
+        if (result <= 0) {
+            if (result < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            break;
+        }
+        done += (size_t)result;
+    }
+    return done;
+}
+
+//Throw away what the application has written, so that it never blocks on a full pty
+static void discardInput(int fd) {
+    unsigned char buffer[4096];
+    while (read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+static void sleepUntil(jlong micros) {
+    jlong remains;
+    while ((remains = micros - getTimePreciseMicros()) > 0) {
+        struct timespec delay;
+        delay.tv_sec = (time_t)(remains / 1000000);
+        delay.tv_nsec = (long)(remains % 1000000) * 1000;
+        nanosleep(&delay, NULL);
+    }
+}
+
+static void waitForLine() {
+    char line[256];
+    if (fgets(line, sizeof(line), stdin) == NULL) {
+        //End of the standard input, go on
+    }
+}
+
+static int runPlay(const char *path, double speed, bool check, bool wait) {
+    CaptureFile file;
+    if (openCaptureFile(path, &file) != 0) {
+        return 1;
+    }
+    int master;
+    int slave;
+    char name[128];
+    if (openpty(&master, &slave, name, NULL, NULL) != 0) {
+        perror("openpty");
+        closeCaptureFile(&file);
+        return 1;
+    }
+    struct termios settings;
+    tcgetattr(slave, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(slave, TCSANOW, &settings);
+    tcgetattr(master, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(master, TCSANOW, &settings);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    printf("%s\n", name);
+    fflush(stdout);
+    if (wait) {
+        waitForLine();
+    }
+
+    int returnValue = 0;
+    unsigned long long sent = 0;
+    unsigned long long compared = 0;
+    unsigned char *expected = NULL;
+    const CaptureFileHeader *header = &file.header;
+    uint64_t position = header->tail;
+    jlong firstMicros = 0;
+    jlong playStart = getTimePreciseMicros();
+    const CaptureRecordHeader *record;
+    while ((record = getCaptureRecord(&file, position)) != NULL) {
+        position += CAPTURE_RECORD_SIZE(record->length);
+        const unsigned char *bytes = (const unsigned char*)(record + 1);
+        if (record->direction == CAPTURE_READ) {
+            if (firstMicros == 0) {
+                firstMicros = record->micros;
+            }
+            sleepUntil(playStart + (jlong)((record->micros - firstMicros) / speed));
+            if (!check) {
+                discardInput(master);
+            }
+            if (writeFully(master, bytes, record->length) != 0) {
+                perror("write");
+                returnValue = 1;
+                break;
+            }
+            sent += record->length;
+        }
+        else if (record->direction == CAPTURE_WRITE && check) {
+            expected = (unsigned char*)realloc(expected, record->length);
+            size_t received = readWithTimeout(master, expected, record->length, REPLAY_CHECK_TIMEOUT_MILLIS);
+            size_t same = 0;
+            while (same < received && expected[same] == bytes[same]) {
+                same++;
+            }
+            if (same < record->length) {
+                if (same < received) {
+                    fprintf(stderr, "Mismatch at sent byte %llu: expected %02x, got %02x\n", compared + same, bytes[same], expected[same]);
+                }
+                else {
+                    fprintf(stderr, "Missing data at sent byte %llu: expected %u more bytes\n", compared + same,
+                            (unsigned)(record->length - same));
+                }
+                returnValue = 1;
+                break;
+            }
+            compared += record->length;
+        }
+    }
+    free(expected);
+    fprintf(stderr, "%llu bytes sent, %llu bytes checked%s\n", sent, compared, (returnValue == 0 ? "" : ", failed"));
+    if (wait) {
+        waitForLine();
+    }
+    close(slave);
+    close(master);
+    closeCaptureFile(&file);
+    return returnValue;
+}
+
+static int usage() {
+    fprintf(stderr, "usage: jssc_replay dump <file>\n"
+                    "       jssc_replay play <file> [--speed <factor>] [--check] [--no-wait]\n");
+    return 2;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "dump") == 0) {
+        return runDump(argv[2]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "play") == 0) {
+        double speed = 1;
+        bool check = false;
+        bool wait = true;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+                speed = atof(argv[++i]);
+                if (speed <= 0) {
+                    return usage();
+                }
+            }
+            else if (strcmp(argv[i], "--check") == 0) {
+                check = true;
+            }
+            else if (strcmp(argv[i], "--no-wait") == 0) {
+                wait = false;
+            }
+            else {
+                return usage();
+            }
+        }
+        return runPlay(argv[2], speed, check, wait);
+    }
+    return usage();
+}
@@ -24,264 +24,2134 @@
  */
 #include <jni.h>
 #include <stdlib.h>
+#include <string.h>
+#include <new>//since 2.9.0 for std::nothrow
 #include <windows.h>
 #include "../jssc_SerialNativeInterface.h"
 #include "../jssc_Common.h"
+#include "../jssc_Checksum.h"
+#include "../jssc_Capture.h"//since 2.9.0
 
 //#include <iostream>
 
 /*
- * Get native library version
+ * Port contexts (since 2.9.0)
+ *
+ * Native state of an opened port, created by "_openPort" and removed by "_closePort".
+ * A context owns one OVERLAPPED (with its event) for each kind of transfer and a read
+ * buffer, so the steady state reads, writes and event waits don't allocate anything.
+ * Contexts are found by port handle and reference counted, a transfer still running
+ * in another thread keeps its context valid after the port has been closed. Each
+ * context has a lock of its own, the reads and writes of different ports never meet.
  */
-JNIEXPORT jstring JNICALL Java_jssc_SerialNativeInterface_getNativeLibraryVersion(JNIEnv *env, jobject object) {
-    return env->NewStringUTF(jSSC_NATIVE_LIB_VERSION);
-}
+#define TRANSFER_READ   0
+#define TRANSFER_WRITE  1
+#define TRANSFER_EVENTS 2
+#define TRANSFER_KINDS  3
+
+struct PortContext;
+
+struct TransferSlot {
+    OVERLAPPED overlapped;
+    jbyte *buffer;              //Read or write buffer, grown on demand
+    jint bufferSize;
+    volatile LONG busy;         //Set while a thread uses the slot
+    PortContext *context;       //NULL for a temporary slot
+};
 
 /*
- * Port opening.
+ * Input ring of the buffered mode (since 2.9.0)
  *
- * In 2.2.0 added useTIOCEXCL (not used in Windows, only for compatibility with _nix version)
+ * Filled by a reader thread which drains the port continuously (see inputReaderThread())
+ * and emptied by the readBytes* functions. head and tail are free running counters,
+ * head is only written by the reader thread and tail by the reading java thread, so
+ * the data itself is exchanged without locks. A reading thread waits for dataEvent,
+ * which is set while dataSignalled is set, the reader thread waits for spaceEvent
+ * while the ring is full.
  */
-JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_openPort(JNIEnv *env, jobject object, jstring portName, jboolean useTIOCEXCL){
-    char prefix[] = "\\\\.\\";
-    const char* port = env->GetStringUTFChars(portName, JNI_FALSE);
+#define INPUT_RING_MIN_CAPACITY 4096
+#define INPUT_RING_MAX_CAPACITY (64 * 1024 * 1024)
 
-    //since 2.1.0 -> string concat fix
-    char portFullName[strlen(prefix) + strlen(port) + 1];
-    strcpy(portFullName, prefix);
-    strcat(portFullName, port);
-    //<- since 2.1.0
+#define ringLoad(field) InterlockedCompareExchange(&(field), 0, 0)
+#define ringStore(field, value) InterlockedExchange(&(field), (value))
+#define ringExchange(field, value) InterlockedExchange(&(field), (value))
 
-    HANDLE hComm = CreateFile(portFullName,
-                       	   	  GENERIC_READ | GENERIC_WRITE,
-                       	   	  0,
-                       	   	  0,
-                       	   	  OPEN_EXISTING,
-                       	   	  FILE_FLAG_OVERLAPPED,
-                       	   	  0);
-    env->ReleaseStringUTFChars(portName, port);
+struct InputRing {
+    jbyte *data;
+    DWORD capacity;                 //Power of two
+    volatile LONG head;             //Count of bytes stored
+    volatile LONG tail;             //Count of bytes consumed, written with consumerLock held
+    volatile LONG dataSignalled;    //Set while dataEvent is set
+    volatile LONG spaceWanted;      //Set while the reader thread waits for free space
+    volatile LONG running;          //Cleared by the reader thread when it exits
+    HANDLE dataEvent;               //Manual reset
+    HANDLE spaceEvent;              //Auto reset
+    HANDLE stopEvent;               //Manual reset
+    OVERLAPPED overlapped;          //Used by the reader thread
+    CRITICAL_SECTION consumerLock;  //Taken by the reading threads
+    HANDLE thread;                  //Guarded by inputReadersLock
+    bool memoryLocked;              //Guarded by inputReadersLock, see lockInputRing()
+};
 
-    //since 2.3.0 ->
-    if(hComm != INVALID_HANDLE_VALUE){
-    	DCB *dcb = new DCB();
-    	if(!GetCommState(hComm, dcb)){
-    		CloseHandle(hComm);//since 2.7.0
-    		hComm = (HANDLE)jssc_SerialNativeInterface_ERR_INCORRECT_SERIAL_PORT;//(-4)Incorrect serial port
-    	}
-    	delete dcb;
+/*
+ * Statistics of the reads and writes (since 2.9.0)
+ *
+ * Every read and write counts its system calls, wakeups and bytes in its PortIO and adds
+ * them to the statistics of the port context when it ends (see endPortIO()), under the
+ * lock of the context endPortIO() takes anyway. The indexes are those of the array
+ * returned by "_getStatistics", see SerialPortStatistics. The read latency is the time
+ * from the first wakeup of a read with data to its return, its histogram counts in
+ * bucket i the latencies below 2^i micro seconds and above the previous bucket. The
+ * error counters count the errors reported by the ClearCommError() calls of the library,
+ * the driver gathers the errors received between two calls into one.
+ */
+#define STAT_BYTES_READ         0
+#define STAT_BYTES_WRITTEN      1
+#define STAT_READ_CALLS         2   //ReadFile() calls, or reads from the input ring
+#define STAT_WRITE_CALLS        3   //WriteFile() calls
+#define STAT_WAKEUPS            4   //Completions of a pending read or write, data of the input ring
+#define STAT_TIMEOUTS           5
+#define STAT_PARTIAL_WRITES     6   //Writes accepted only in part before their timeout
+#define STATS_IO_COUNTERS       7   //Counted by PortIO
+#define STAT_LATENCY_COUNT      7
+#define STAT_LATENCY_TOTAL      8   //Micro seconds
+#define STAT_LATENCY_MAX        9
+#define STAT_OVERRUNS           10  //CE_OVERRUN
+#define STAT_BUFFER_OVERRUNS    11  //CE_RXOVER
+#define STAT_FRAMING_ERRORS     12  //CE_FRAME
+#define STAT_PARITY_ERRORS      13  //CE_RXPARITY
+#define STAT_BREAKS             14  //CE_BREAK
+#define STATS_COUNTERS          15
+#define STATS_LATENCY_BUCKETS   32
+#define STATS_LENGTH (STATS_COUNTERS + STATS_LATENCY_BUCKETS)
+
+struct PortStats {
+    unsigned long long counters[STATS_COUNTERS];
+    unsigned long long latency[STATS_LATENCY_BUCKETS];
+};
+
+struct PortContext {
+    HANDLE hComm;
+    volatile LONG refCount;     //Changed with interlocked operations
+    CRITICAL_SECTION lock;      //Guards activeIOCount, the cancellations, setting ring, the statistics and the RS-485 fields
+    TransferSlot slots[TRANSFER_KINDS];
+    InputRing *volatile ring;   //Set once, by "_bufferedReaderStart" or a framed read, or NULL
+    HANDLE cancelEvent;         //Manual reset, set while a cancellation is pending (see cancelPortIO()), or NULL
+    volatile LONG cancelGeneration;     //Incremented by every cancellation
+    int activeIOCount;          //Count of reads and writes in progress
+    volatile LONG staleIOCount; //Reads and writes started before the last cancellation and still running
+    volatile LONG closing;      //Set by "_closePort", the cancelled reads and writes then fail with PORT_NOT_OPENED
+    PortStats stats;            //Guarded by lock
+    volatile LONG rs485Mode;    //RS485_MODE_*, set by "_setRS485" with the fields below
+    char rs485RtsOnSend;        //Software direction control: RTS level while sending
+    int rs485DelayBefore;       //Milliseconds between raising RTS and the first byte
+    int rs485DelayAfter;        //Milliseconds between the last byte and dropping RTS
+    DWORD rs485SavedRtsControl; //fRtsControl to restore when RS485_MODE_DRIVER is switched off
+    CaptureRing *volatile capture;  //Set by "_captureStart" or NULL, see capturePortData()
+    volatile LONG captureUsers; //Threads writing to capture
+    jlong readerCpuMask;        //Set by "_setReaderScheduling" with the fields below, guarded by inputReadersLock
+    jint readerPriority;
+    bool readerMemoryLocked;
+    PortContext *volatile next; //Next context of the same slot of portContextTable
+};
+
+/*
+ * The contexts are kept in a table hashed by port handle, which the lookups walk without
+ * lock. A lookup is counted in its slot while it walks the chain and takes its reference:
+ * a context unlinked by "_closePort" is only released once the lookups of its slot are
+ * done, so no lookup meets a freed context. portContextsLock only serializes the changes
+ * of the table, by "_openPort" and "_closePort". Each slot has a cache line to itself so
+ * the lookups of different ports don't share one.
+ */
+#define PORT_CONTEXT_SLOTS 256
+
+#define contextLoad(field) ((PortContext*)InterlockedCompareExchangePointer((PVOID volatile*)&(field), NULL, NULL))
+#define contextStore(field, value) InterlockedExchangePointer((PVOID volatile*)&(field), (value))
+
+struct PortContextSlot {
+    PortContext *volatile first;    //Read and written with interlocked operations
+    volatile LONG lookups;          //Lookups walking the chain of the slot
+    char padding[64 - sizeof(PortContext*) - sizeof(LONG)];
+};
+
+//The lock must be usable before JNI_OnLoad, so it is initialized by a static constructor
+static struct PortContextsLock {
+    CRITICAL_SECTION section;
+    PortContextsLock() { InitializeCriticalSection(&section); }
+    ~PortContextsLock() { DeleteCriticalSection(&section); }
+} portContextsLock;
+
+static PortContextSlot portContextTable[PORT_CONTEXT_SLOTS];
+
+static PortContextSlot* getPortContextSlot(HANDLE hComm) {
+    //The low two bits of a handle are always clear
+    return &portContextTable[((ULONG_PTR)hComm >> 2) % PORT_CONTEXT_SLOTS];
+}
+
+//Count of ports having an input ring, the read functions skip the context lookup while it is 0
+static volatile LONG inputRingsCount = 0;
+
+//Serializes starting and stopping the reader threads
+static struct InputReadersLock {
+    CRITICAL_SECTION section;
+    InputReadersLock() { InitializeCriticalSection(&section); }
+    ~InputReadersLock() { DeleteCriticalSection(&section); }
+} inputReadersLock;
+
+static void closeRingHandle(HANDLE handle) {
+    if (handle != NULL) {
+        CloseHandle(handle);
     }
-    else {
-    	DWORD errorValue = GetLastError();
-    	if(errorValue == ERROR_ACCESS_DENIED){
-    		hComm = (HANDLE)jssc_SerialNativeInterface_ERR_PORT_BUSY;//(-1)Port busy
-    	}
-    	else if(errorValue == ERROR_FILE_NOT_FOUND){
-    		hComm = (HANDLE)jssc_SerialNativeInterface_ERR_PORT_NOT_FOUND;//(-2)Port not found
-    	}
+}
+
+static void freeInputRing(InputRing *ring) {
+    //A thread still running belongs to a port whose handle has been closed without "_closePort"
+    closeRingHandle(ring->thread);
+    closeRingHandle(ring->dataEvent);
+    closeRingHandle(ring->spaceEvent);
+    closeRingHandle(ring->stopEvent);
+    closeRingHandle(ring->overlapped.hEvent);
+    DeleteCriticalSection(&ring->consumerLock);
+    if (ring->data != NULL) {
+        VirtualFree(ring->data, 0, MEM_RELEASE);//Unlocks the pages
     }
-    //<- since 2.3.0
-    return (jlong)hComm;//since 2.4.0 changed to jlong
-};
+    delete ring;
+}
 
 /*
- * Setting serial port params.
- *
- * In 2.6.0 added flags (not used in Windows, only for compatibility with _nix version)
+ * Create a ring of at least capacity bytes (rounded up to a power of two), returns NULL
+ * on failure
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setParams
-  (JNIEnv *env, jobject object, jlong portHandle, jint baudRate, jint byteSize, jint stopBits, jint parity, jboolean setRTS, jboolean setDTR, jint flags){
-    HANDLE hComm = (HANDLE)portHandle;
-    DCB *dcb = new DCB();
-    jboolean returnValue = JNI_FALSE;
-    if(GetCommState(hComm, dcb)){
-        dcb->BaudRate = baudRate;
-        dcb->ByteSize = byteSize;
-        dcb->StopBits = stopBits;
-        dcb->Parity = parity;
+static InputRing* newInputRing(jint capacity) {
+    DWORD size = INPUT_RING_MIN_CAPACITY;
+    while (size < (DWORD)capacity && size < INPUT_RING_MAX_CAPACITY) {
+        size <<= 1;
+    }
+    InputRing *ring = new InputRing();
+    memset(ring, 0, sizeof(InputRing));
+    InitializeCriticalSection(&ring->consumerLock);
+    //Whole pages of its own, so the ring can be locked in memory without its neighbours
+    ring->data = (jbyte*)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    ring->capacity = size;
+    ring->dataEvent = CreateEventA(NULL, true, false, NULL);
+    ring->spaceEvent = CreateEventA(NULL, false, false, NULL);
+    ring->stopEvent = CreateEventA(NULL, true, false, NULL);
+    ring->overlapped.hEvent = CreateEventA(NULL, true, false, NULL);
+    if (ring->data == NULL || ring->dataEvent == NULL || ring->spaceEvent == NULL ||
+        ring->stopEvent == NULL || ring->overlapped.hEvent == NULL) {
+        freeInputRing(ring);
+        return NULL;
+    }
+    return ring;
+}
 
-        //since 0.8 ->
-        if(setRTS == JNI_TRUE){
-        	dcb->fRtsControl = RTS_CONTROL_ENABLE;
+static void initTransferSlot(TransferSlot *slot, PortContext *context) {
+    memset(slot, 0, sizeof(TransferSlot));
+    slot->overlapped.hEvent = CreateEventA(NULL, true, false, NULL);
+    slot->context = context;
+}
+
+static void freeTransferSlot(TransferSlot *slot) {
+    if (slot->overlapped.hEvent != NULL) {
+        CloseHandle(slot->overlapped.hEvent);
+    }
+    delete[] slot->buffer;
+}
+
+static void releasePortContext(PortContext *context) {
+    if (InterlockedDecrement(&context->refCount) == 0) {
+        for (int i = 0; i < TRANSFER_KINDS; i++) {
+            freeTransferSlot(&context->slots[i]);
         }
-        else {
-        	dcb->fRtsControl = RTS_CONTROL_DISABLE;
+        if (context->ring != NULL) {
+            freeInputRing(context->ring);
+            InterlockedDecrement(&inputRingsCount);
         }
-        if(setDTR == JNI_TRUE){
-        	dcb->fDtrControl = DTR_CONTROL_ENABLE;
+        if (context->cancelEvent != NULL) {
+            CloseHandle(context->cancelEvent);
         }
-        else {
-           	dcb->fDtrControl = DTR_CONTROL_DISABLE;
+        if (context->capture != NULL) {
+            captureClose(context->capture);
         }
-        dcb->fOutxCtsFlow = FALSE;
-        dcb->fOutxDsrFlow = FALSE;
-        dcb->fDsrSensitivity = FALSE;
-        dcb->fTXContinueOnXoff = TRUE;
-        dcb->fOutX = FALSE;
-        dcb->fInX = FALSE;
-        dcb->fErrorChar = FALSE;
-        dcb->fNull = FALSE;
-        dcb->fAbortOnError = FALSE;
-        dcb->XonLim = 2048;
-        dcb->XoffLim = 512;
-        dcb->XonChar = (char)17; //DC1
-        dcb->XoffChar = (char)19; //DC3
-        //<- since 0.8
+        DeleteCriticalSection(&context->lock);
+        delete context;
+    }
+}
 
-        if(SetCommState(hComm, dcb)){
+/*
+ * Copy the bytes just read from or written to the port into its capture (since 2.9.0).
+ * A port without capture costs one interlocked read; captureUsers lets "_captureStop"
+ * wait for the copies in progress before it closes the file.
+ */
+static void capturePortData(PortContext *context, int direction, const void *data, DWORD length) {
+    if (context == NULL || length == 0 || InterlockedCompareExchangePointer((PVOID volatile*)&context->capture, NULL, NULL) == NULL) {
+        return;
+    }
+    InterlockedIncrement(&context->captureUsers);
+    CaptureRing *capture = (CaptureRing*)InterlockedCompareExchangePointer((PVOID volatile*)&context->capture, NULL, NULL);
+    if (capture != NULL) {
+        captureBytes(capture, direction, data, (size_t)length);
+    }
+    InterlockedDecrement(&context->captureUsers);
+}
 
-        	//since 2.1.0 -> previously setted timeouts by another application should be cleared
-        	COMMTIMEOUTS *lpCommTimeouts = new COMMTIMEOUTS();
-        	lpCommTimeouts->ReadIntervalTimeout = 0;
-        	lpCommTimeouts->ReadTotalTimeoutConstant = 0;
-        	lpCommTimeouts->ReadTotalTimeoutMultiplier = 0;
-        	lpCommTimeouts->WriteTotalTimeoutConstant = 0;
-        	lpCommTimeouts->WriteTotalTimeoutMultiplier = 0;
-        	if(SetCommTimeouts(hComm, lpCommTimeouts)){
-        		returnValue = JNI_TRUE;
-        	}
-        	delete lpCommTimeouts;
-        	//<- since 2.1.0
+/*
+ * Unlink the context of a port from the table, must be called with portContextsLock
+ * held. Returns the unlinked context, which no lookup uses anymore, or NULL.
+ */
+static PortContext* unlinkPortContext(HANDLE hComm) {
+    PortContextSlot *slot = getPortContextSlot(hComm);
+    for (PortContext *volatile *link = &slot->first; *link != NULL; link = &(*link)->next) {
+        if ((*link)->hComm == hComm) {
+            PortContext *context = *link;
+            contextStore(*link, context->next);
+            while (ringLoad(slot->lookups) != 0) {
+                SwitchToThread();//A lookup may be on the context, it only has a few loads to do
+            }
+            context->next = NULL;
+            return context;
         }
     }
-    delete dcb;
-    return returnValue;
+    return NULL;
+}
+
+static void createPortContext(HANDLE hComm) {
+    PortContext *context = new PortContext();
+    context->hComm = hComm;
+    context->refCount = 1;//Owned by the table
+    InitializeCriticalSection(&context->lock);
+    context->ring = NULL;
+    //Without the event the I/O of the port can't be cancelled, it still times out and checks interruption
+    context->cancelEvent = CreateEventA(NULL, true, false, NULL);
+    context->cancelGeneration = 0;
+    context->activeIOCount = 0;
+    context->staleIOCount = 0;
+    context->closing = 0;
+    memset(&context->stats, 0, sizeof(PortStats));
+    context->rs485Mode = 0;
+    context->rs485RtsOnSend = 1;
+    context->rs485DelayBefore = 0;
+    context->rs485DelayAfter = 0;
+    context->rs485SavedRtsControl = RTS_CONTROL_DISABLE;
+    context->capture = NULL;
+    context->captureUsers = 0;
+    context->readerCpuMask = 0;
+    context->readerPriority = 0;
+    context->readerMemoryLocked = false;
+    for (int i = 0; i < TRANSFER_KINDS; i++) {
+        initTransferSlot(&context->slots[i], context);
+    }
+    EnterCriticalSection(&portContextsLock.section);
+    PortContext *stale = unlinkPortContext(hComm);//Left by a handle closed without "_closePort"
+    if (stale != NULL) {
+        releasePortContext(stale);
+    }
+    PortContextSlot *slot = getPortContextSlot(hComm);
+    context->next = slot->first;
+    contextStore(slot->first, context);
+    LeaveCriticalSection(&portContextsLock.section);
+}
+
+static void removePortContext(HANDLE hComm) {
+    EnterCriticalSection(&portContextsLock.section);
+    PortContext *context = unlinkPortContext(hComm);
+    LeaveCriticalSection(&portContextsLock.section);
+    if (context != NULL) {
+        releasePortContext(context);
+    }
 }
 
 /*
- * PurgeComm
+ * Find the context of an opened port and take a reference on it, returns NULL if
+ * the port is not opened
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_purgePort
-  (JNIEnv *env, jobject object, jlong portHandle, jint flags){
-    HANDLE hComm = (HANDLE)portHandle;
-    DWORD dwFlags = (DWORD)flags;
-    return (PurgeComm(hComm, dwFlags) ? JNI_TRUE : JNI_FALSE);
+static PortContext* acquirePortContext(HANDLE hComm) {
+    PortContextSlot *slot = getPortContextSlot(hComm);
+    InterlockedIncrement(&slot->lookups);
+    PortContext *context = contextLoad(slot->first);
+    while (context != NULL && context->hComm != hComm) {
+        context = contextLoad(context->next);
+    }
+    if (context != NULL) {
+        InterlockedIncrement(&context->refCount);
+    }
+    InterlockedDecrement(&slot->lookups);
+    return context;
 }
 
 /*
- * Port closing
+ * Take the transfer slot of the given kind of a port for the calling thread. If the port
+ * has no context or the slot is used by another thread, a temporary slot is created.
+ * Returns NULL if no event could be created. The slot must be given back with
+ * releaseTransferSlot().
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_closePort
-  (JNIEnv *env, jobject object, jlong portHandle){
-    HANDLE hComm = (HANDLE)portHandle;
-    return (CloseHandle(hComm) ? JNI_TRUE : JNI_FALSE);
+static TransferSlot* acquireTransferSlot(HANDLE hComm, int kind) {
+    TransferSlot *slot = NULL;
+    PortContext *context = acquirePortContext(hComm);
+    if (context != NULL) {
+        TransferSlot *candidate = &context->slots[kind];
+        if (candidate->overlapped.hEvent != NULL && InterlockedCompareExchange(&candidate->busy, 1, 0) == 0) {
+            slot = candidate;//Keeps the reference
+        }
+        else {
+            releasePortContext(context);
+        }
+    }
+    if (slot == NULL) {
+        slot = new TransferSlot();
+        initTransferSlot(slot, NULL);
+        if (slot->overlapped.hEvent == NULL) {
+            delete slot;
+            return NULL;
+        }
+    }
+    return slot;
+}
+
+static void releaseTransferSlot(TransferSlot *slot) {
+    PortContext *context = slot->context;
+    if (context == NULL) {
+        freeTransferSlot(slot);
+        delete slot;
+        return;
+    }
+    InterlockedExchange(&slot->busy, 0);
+    releasePortContext(context);
 }
 
 /*
- * Set events mask
+ * Returns the OVERLAPPED of a slot ready for a new operation
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setEventsMask
-  (JNIEnv *env, jobject object, jlong portHandle, jint mask){
-    HANDLE hComm = (HANDLE)portHandle;
-    DWORD dwEvtMask = (DWORD)mask;
-    return (SetCommMask(hComm, dwEvtMask) ? JNI_TRUE : JNI_FALSE);
+static OVERLAPPED* prepareOverlapped(TransferSlot *slot) {
+    HANDLE hEvent = slot->overlapped.hEvent;
+    memset(&slot->overlapped, 0, sizeof(OVERLAPPED));
+    slot->overlapped.hEvent = hEvent;
+    ResetEvent(hEvent);
+    return &slot->overlapped;
 }
 
 /*
- * Get events mask
+ * Returns the buffer of a slot, grown to at least size bytes, or NULL if it
+ * couldn't be allocated
  */
-JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_getEventsMask
-  (JNIEnv *env, jobject object, jlong portHandle){
-    HANDLE hComm = (HANDLE)portHandle;
-    DWORD lpEvtMask;
-    if(GetCommMask(hComm, &lpEvtMask)){
-        return (jint)lpEvtMask;
+static jbyte* getSlotBuffer(TransferSlot *slot, jint size) {
+    if (slot->bufferSize < size) {
+        delete[] slot->buffer;
+        slot->buffer = new (std::nothrow) jbyte[size];
+        slot->bufferSize = (slot->buffer != NULL ? size : 0);
     }
-    else {
-        return -1;
+    return slot->buffer;
+}
+
+/*
+ * Find the context of a port in buffered mode and take a reference on it, returns NULL
+ * if the port has no input ring
+ */
+static PortContext* acquireBufferedContext(HANDLE hComm) {
+    if (ringLoad(inputRingsCount) == 0) {
+        return NULL;
+    }
+    PortContext *context = acquirePortContext(hComm);
+    if (context != NULL && InterlockedCompareExchangePointer((PVOID volatile*)&context->ring, NULL, NULL) == NULL) {
+        releasePortContext(context);
+        context = NULL;
     }
+    return context;
 }
 
 /*
- * Change RTS line state (ON || OFF)
+ * Cancellation of blocking reads and writes (since 2.9.0)
+ *
+ * Every read and write waits for the cancel event of its port context besides its own
+ * operation, so it can block without a timeout and still be stopped at once by
+ * "_cancelIO" or "_closePort". cancelPortIO() increments the generation of the context
+ * and sets the event, an operation is cancelled when the generation differs from the one
+ * it started with. The event is reset by the last of these operations to finish; the
+ * operations started meanwhile don't wait for it, they recheck every
+ * CANCEL_RECHECK_MILLIS instead until it is reset.
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setRTS
-  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
-    HANDLE hComm = (HANDLE)portHandle;
-    if(enabled == JNI_TRUE){
-        return (EscapeCommFunction(hComm, SETRTS) ? JNI_TRUE : JNI_FALSE);
+#define CANCEL_RECHECK_MILLIS 1
+
+struct PortIO {
+    PortContext *context;           //NULL if the port has no context
+    LONG generation;                //Cancel generation when the operation started
+    LONG64 counts[STATS_IO_COUNTERS];   //Added to the statistics of the context by endPortIO()
+    jlong readyMicros;              //Time of the first wakeup with data of a read, or 0
+    LONG64 frameErrors;             //Frame headers with a wrong length skipped by a framed read
+};
+
+static void beginPortIO(HANDLE hComm, PortIO *io) {
+    io->generation = 0;
+    memset(io->counts, 0, sizeof(io->counts));
+    io->readyMicros = 0;
+    io->frameErrors = 0;
+    io->context = acquirePortContext(hComm);
+    if (io->context != NULL) {
+        //The reads and writes of the port only meet here and in endPortIO()
+        EnterCriticalSection(&io->context->lock);
+        io->context->activeIOCount++;
+        io->generation = io->context->cancelGeneration;
+        LeaveCriticalSection(&io->context->lock);
     }
-    else {
-        return (EscapeCommFunction(hComm, CLRRTS) ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Note the wakeup of an operation by its completion or by data of the input ring
+ */
+static void markPortIOReady(PortIO *io, bool withData) {
+    io->counts[STAT_WAKEUPS]++;
+    if (withData && io->readyMicros == 0) {
+        io->readyMicros = getTimePreciseMicros();
     }
 }
 
 /*
- * Change DTR line state (ON || OFF)
+ * Add the counts of an operation ended at endMicros to the statistics of its port, must
+ * be called with the lock of the context held
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setDTR
-  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
-    HANDLE hComm = (HANDLE)portHandle;
-    if(enabled == JNI_TRUE){
-        return (EscapeCommFunction(hComm, SETDTR) ? JNI_TRUE : JNI_FALSE);
+static void addPortIOStatsLocked(PortIO *io, jlong endMicros) {
+    PortStats *stats = &io->context->stats;
+    for (int i = 0; i < STATS_IO_COUNTERS; i++) {
+        stats->counters[i] += (unsigned long long)io->counts[i];
     }
-    else {
-        return (EscapeCommFunction(hComm, CLRDTR) ? JNI_TRUE : JNI_FALSE);
+    stats->counters[STAT_FRAMING_ERRORS] += (unsigned long long)io->frameErrors;
+    if (io->readyMicros != 0 && io->counts[STAT_BYTES_READ] != 0) {
+        unsigned long long latency = (unsigned long long)(endMicros - io->readyMicros);
+        int bucket = 0;
+        while (bucket < STATS_LATENCY_BUCKETS - 1 && (latency >> bucket) != 0) {
+            bucket++;
+        }
+        stats->latency[bucket]++;
+        stats->counters[STAT_LATENCY_COUNT]++;
+        stats->counters[STAT_LATENCY_TOTAL] += latency;
+        if (latency > stats->counters[STAT_LATENCY_MAX]) {
+            stats->counters[STAT_LATENCY_MAX] = latency;
+        }
     }
 }
 
 /*
- * Write data to port
- * portHandle - port handle
- * buffer - byte array for sending
+ * Count the errors returned by ClearCommError() in the statistics of the port
  */
-JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_writeBytes
-  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer){
-    HANDLE hComm = (HANDLE)portHandle;
-    DWORD lpNumberOfBytesTransferred;
-    DWORD lpNumberOfBytesWritten;
-    OVERLAPPED *overlapped = new OVERLAPPED();
-    jboolean returnValue = JNI_FALSE;
-    jbyte* jBuffer = env->GetByteArrayElements(buffer, JNI_FALSE);
-    overlapped->hEvent = CreateEventA(NULL, true, false, NULL);
-    if(WriteFile(hComm, jBuffer, (DWORD)env->GetArrayLength(buffer), &lpNumberOfBytesWritten, overlapped)){
-        returnValue = JNI_TRUE;
+static void addCommErrors(PortContext *context, DWORD errors) {
+    static const DWORD flags[STATS_COUNTERS - STAT_OVERRUNS] = {CE_OVERRUN, CE_RXOVER, CE_FRAME, CE_RXPARITY, CE_BREAK};
+    EnterCriticalSection(&context->lock);
+    for (int i = 0; i < STATS_COUNTERS - STAT_OVERRUNS; i++) {
+        if (errors & flags[i]) {
+            context->stats.counters[STAT_OVERRUNS + i]++;
+        }
     }
-    else if(GetLastError() == ERROR_IO_PENDING){
-        if(WaitForSingleObject(overlapped->hEvent, INFINITE) == WAIT_OBJECT_0){
-            if(GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesTransferred, false)){
-                returnValue = JNI_TRUE;
-            }
+    LeaveCriticalSection(&context->lock);
+}
+
+static void recordCommErrors(HANDLE hComm, DWORD errors) {
+    if ((errors & (CE_OVERRUN | CE_RXOVER | CE_FRAME | CE_RXPARITY | CE_BREAK)) == 0) {
+        return;
+    }
+    PortContext *context = acquirePortContext(hComm);
+    if (context != NULL) {
+        addCommErrors(context, errors);
+        releasePortContext(context);
+    }
+}
+
+static void endPortIO(PortIO *io) {
+    PortContext *context = io->context;
+    if (context == NULL) {
+        return;
+    }
+    jlong endMicros = (io->readyMicros != 0 ? getTimePreciseMicros() : 0);//Out of the lock
+    EnterCriticalSection(&context->lock);
+    addPortIOStatsLocked(io, endMicros);
+    context->activeIOCount--;
+    if (io->generation != context->cancelGeneration && InterlockedDecrement(&context->staleIOCount) == 0) {
+        ResetEvent(context->cancelEvent);
+    }
+    LeaveCriticalSection(&context->lock);
+    releasePortContext(context);
+    io->context = NULL;
+}
+
+static bool isPortIOCancelled(PortIO *io) {
+    //The operations started while the port is closing are cancelled too
+    return (io->context != NULL &&
+            (ringLoad(io->context->cancelGeneration) != io->generation || ringLoad(io->context->closing) != 0));
+}
+
+/*
+ * Wait for the reads and writes of a closing port to return, so its handle isn't closed
+ * while they still wait for their overlapped operations. They notice the cancellation
+ * at once through the cancel event, the wait is bounded in case they can't be woken up.
+ */
+#define CLOSE_IO_WAIT_MILLIS 2000
+
+static void waitPortIODone(PortContext *context) {
+    for (DWORD waited = 0; waited < CLOSE_IO_WAIT_MILLIS; waited += CANCEL_RECHECK_MILLIS) {
+        EnterCriticalSection(&context->lock);
+        int activeIOCount = context->activeIOCount;
+        LeaveCriticalSection(&context->lock);
+        if (activeIOCount == 0) {
+            break;
         }
+        Sleep(CANCEL_RECHECK_MILLIS);
     }
-    env->ReleaseByteArrayElements(buffer, jBuffer, 0);
-    CloseHandle(overlapped->hEvent);
-    delete overlapped;
-    return returnValue;
 }
 
-DWORD getNextTimeoutWindows(JNIEnv *env, char deadlineValid, long timeoutDeadline, long pollPeriodMillis) {
-    struct timeval timeout;
-    if (getNextTimeout(env, &timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1) {
-        //Error
-        return 0;
+/*
+ * Fail the reads and writes in progress on the port of the context. Returns JNI_TRUE if
+ * there was any.
+ */
+static jboolean cancelPortIO(PortContext *context) {
+    jboolean cancelled = JNI_FALSE;
+    EnterCriticalSection(&context->lock);
+    if (context->activeIOCount > 0 && context->cancelEvent != NULL) {
+        InterlockedIncrement(&context->cancelGeneration);
+        //Every operation in progress is now stale, including those of earlier cancellations
+        ringStore(context->staleIOCount, context->activeIOCount);
+        SetEvent(context->cancelEvent);
+        cancelled = JNI_TRUE;
     }
+    LeaveCriticalSection(&context->lock);
+    return cancelled;
+}
 
-    DWORD millisecondTimeout = timeout.tv_sec*1000 + timeout.tv_usec/1000;
-    return millisecondTimeout;
+static void throwPortIOCancelled(JNIEnv *env, PortIO *io, const char *methodName) {
+    throwSerialException(env, "NoPort", methodName,
+                         (ringLoad(io->context->closing) ? SP_EXCEPTION_TYPE_PORT_NOT_OPENED : SP_EXCEPTION_TYPE_IO_CANCELLED));
 }
 
-void getBuffersBytesCount(HANDLE hComm, jint* retVals) {
+/*
+ * Wait for hEvent or the operation to be cancelled. Returns as WaitForSingleObject(),
+ * the caller checks isPortIOCancelled() first.
+ */
+static DWORD waitPortIO(PortIO *io, HANDLE hEvent, DWORD waitMillis) {
+    if (isPortIOCancelled(io)) {
+        return WAIT_TIMEOUT;
+    }
+    if (io->context != NULL && io->context->cancelEvent != NULL) {
+        if (ringLoad(io->context->staleIOCount) == 0) {
+            HANDLE waitHandles[2] = {hEvent, io->context->cancelEvent};
+            DWORD result = WaitForMultipleObjects(2, waitHandles, false, waitMillis);
+            return (result == WAIT_OBJECT_0 + 1 ? WAIT_TIMEOUT : result);
+        }
+        if (waitMillis > CANCEL_RECHECK_MILLIS) {
+            //The event is still set by an earlier cancellation
+            waitMillis = CANCEL_RECHECK_MILLIS;
+        }
+    }
+    return WaitForSingleObject(hEvent, waitMillis);
+}
 
-    DWORD lpErrors;
-    COMSTAT *comstat = new COMSTAT();
-    if(ClearCommError(hComm, &lpErrors, comstat)){
-        retVals[0] = (jint)comstat->cbInQue;
-        retVals[1] = (jint)comstat->cbOutQue;
-    } else {
-        retVals[0] = -1;
-        retVals[1] = -1;
+/*
+ * Tells if the reader thread of the buffered mode runs for a port
+ */
+static bool isInputReaderRunning(HANDLE hComm) {
+    PortContext *context = acquireBufferedContext(hComm);
+    if (context == NULL) {
+        return false;
     }
-    delete comstat;
+    bool running = (ringLoad(context->ring->running) != 0);
+    releasePortContext(context);
+    return running;
 }
 
-    /**
-     * Read data from port
-     * 
-     * @param portHandle handle of opened port
-     *
-     * @param byteCount number of bytes to block and wait for, or 0 to return immediately
-     * with whatever data is available. If timeoutMilliseconds is 0 and byteCount
-     * is positive, then immediately returns with at most byteCount bytes (possibly 0).
+/*
+ * Count of bytes in the input ring of a port, 0 if it has none
+ */
+static jint getInputRingBytesCount(HANDLE hComm) {
+    PortContext *context = acquireBufferedContext(hComm);
+    if (context == NULL) {
+        return 0;
+    }
+    InputRing *ring = context->ring;
+    jint count = (jint)((DWORD)ringLoad(ring->head) - (DWORD)ringLoad(ring->tail));
+    releasePortContext(context);
+    return count;
+}
+
+/*
+ * Buffered mode (since 2.9.0)
+ *
+ * The reader thread keeps a read pending and moves whatever the driver holds into the
+ * input ring, so the driver buffer is drained even while no java thread is reading.
+ * Being the only reader of the port while it runs, it switches the port to the
+ * "return when any data" COMMTIMEOUTS (see setAnyDataTimeouts()): a read of the free
+ * space of the ring then completes as soon as a byte arrives, with everything received
+ * so far, in a single call. Without them it reads one byte, then what the driver has
+ * received since. When the ring is full the port is left alone
+ * until a reading thread has made room, the driver then applies the flow control as
+ * without the buffered mode. On read error the thread exits, the reading threads then
+ * empty the ring and go back to reading the port directly.
+ */
+/*
+ * Change the read fields of timeouts so that a read returns at once with the bytes the
+ * driver holds, or if there are none, as soon as one arrives. ReadTotalTimeoutConstant
+ * must be below MAXDWORD for these semantics, the largest value makes an idle port
+ * never time out (49 days).
+ */
+static void setAnyDataReadTimeouts(COMMTIMEOUTS *timeouts) {
+    timeouts->ReadIntervalTimeout = MAXDWORD;
+    timeouts->ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts->ReadTotalTimeoutConstant = MAXDWORD - 1;
+}
+
+/*
+ * Switch a port to the timeouts of setAnyDataReadTimeouts(), savedTimeouts receives the
+ * timeouts to restore. Returns false if the timeouts couldn't be changed.
+ */
+static bool setAnyDataTimeouts(HANDLE hComm, COMMTIMEOUTS *savedTimeouts) {
+    if (!GetCommTimeouts(hComm, savedTimeouts)) {
+        return false;
+    }
+    COMMTIMEOUTS timeouts = *savedTimeouts;
+    setAnyDataReadTimeouts(&timeouts);
+    return SetCommTimeouts(hComm, &timeouts) != FALSE;
+}
+
+static DWORD WINAPI inputReaderThread(LPVOID arg) {
+    PortContext *context = (PortContext*)arg;
+    InputRing *ring = context->ring;
+    HANDLE hComm = context->hComm;
+    HANDLE waitHandles[2];
+    waitHandles[0] = ring->stopEvent;
+    COMMTIMEOUTS savedTimeouts;
+    bool anyData = setAnyDataTimeouts(hComm, &savedTimeouts);
+    while (WaitForSingleObject(ring->stopEvent, 0) != WAIT_OBJECT_0) {
+        DWORD head = (DWORD)ring->head;
+        DWORD space = ring->capacity - (head - (DWORD)ringLoad(ring->tail));
+        if (space == 0) {
+            //Ask for a wakeup before checking again, see readFromRing()
+            ringStore(ring->spaceWanted, 1);
+            space = ring->capacity - (head - (DWORD)ringLoad(ring->tail));
+            if (space == 0) {
+                waitHandles[1] = ring->spaceEvent;
+                WaitForMultipleObjects(2, waitHandles, false, INFINITE);
+                continue;
+            }
+        }
+        DWORD offset = head & (ring->capacity - 1);
+        DWORD length = ring->capacity - offset;
+        if (length > space) {
+            length = space;
+        }
+
+        //Wait for the first byte
+        HANDLE hEvent = ring->overlapped.hEvent;
+        memset(&ring->overlapped, 0, sizeof(OVERLAPPED));
+        ring->overlapped.hEvent = hEvent;
+        ResetEvent(hEvent);
+        DWORD bytesRead = 0;
+        if (!ReadFile(hComm, ring->data + offset, (anyData ? length : 1), &bytesRead, &ring->overlapped)) {
+            if (GetLastError() != ERROR_IO_PENDING) {
+                break;
+            }
+            waitHandles[1] = hEvent;
+            if (WaitForMultipleObjects(2, waitHandles, false, INFINITE) != WAIT_OBJECT_0 + 1) {
+                CancelIo(hComm);
+            }
+            //Also waits for the cancellation, a byte received meanwhile is kept
+            if (!GetOverlappedResult(hComm, &ring->overlapped, &bytesRead, true) && bytesRead == 0 &&
+                GetLastError() != ERROR_OPERATION_ABORTED) {
+                break;
+            }
+        }
+
+        //Then take what the driver has received since, the errors are counted in both modes
+        if (bytesRead > 0) {
+            DWORD lpErrors;
+            COMSTAT comstat;
+            DWORD more = 0;
+            if (ClearCommError(hComm, &lpErrors, &comstat)) {
+                if (!anyData && length > 1) {
+                    more = (comstat.cbInQue < length - 1 ? comstat.cbInQue : length - 1);
+                }
+                if (lpErrors != 0) {
+                    addCommErrors(context, lpErrors);
+                }
+            }
+            if (more > 0) {
+                ResetEvent(hEvent);
+                DWORD moreRead = 0;
+                if (ReadFile(hComm, ring->data + offset + 1, more, &moreRead, &ring->overlapped) ||
+                    (GetLastError() == ERROR_IO_PENDING && GetOverlappedResult(hComm, &ring->overlapped, &moreRead, true))) {
+                    bytesRead += moreRead;
+                }
+            }
+        }
+        if (bytesRead > 0) {
+            capturePortData(context, CAPTURE_READ, ring->data + offset, bytesRead);
+            ringStore(ring->head, (LONG)(head + bytesRead));
+            if (ringExchange(ring->dataSignalled, 1) == 0) {
+                SetEvent(ring->dataEvent);
+            }
+        }
+    }
+    if (anyData) {
+        SetCommTimeouts(hComm, &savedTimeouts);
+    }
+    ringStore(ring->running, 0);
+    //Wake up the reading threads, they go on with the port itself once the ring is empty
+    ringStore(ring->dataSignalled, 1);
+    SetEvent(ring->dataEvent);
+    releasePortContext(context);
+    return 0;
+}
+
+/*
+ * Scheduling of the native threads (since 2.9.0)
+ *
+ * A thread can be restricted to the CPUs of a mask (bit n for CPU n, within the
+ * processor group of the process, 0 for the affinity of the process) and raised to
+ * THREAD_PRIORITY_TIME_CRITICAL by any priority above 0, 0 sets it back to
+ * THREAD_PRIORITY_NORMAL. The priority class of the process is left alone, so the
+ * thread stays below the REALTIME_PRIORITY_CLASS threads of other processes. The reader
+ * thread of a port is created suspended and scheduled as set by "_setReaderScheduling"
+ * before it runs, and its ring can be locked in the working set so the thread never
+ * takes a page fault on it.
+ */
+#define SCHEDULING_AFFINITY         1
+#define SCHEDULING_PRIORITY         2
+#define SCHEDULING_MEMORY_LOCKED    4
+
+/*
+ * Apply a CPU mask and a priority to a thread, returns the combination of SCHEDULING_*
+ * which could be applied
+ */
+static jint applyThreadScheduling(HANDLE thread, jlong cpuMask, jint priority) {
+    jint applied = 0;
+    DWORD_PTR cpus = (DWORD_PTR)cpuMask;
+    DWORD_PTR systemCpus;
+    if (cpuMask == 0 && !GetProcessAffinityMask(GetCurrentProcess(), &cpus, &systemCpus)) {
+        cpus = 0;
+    }
+    if (cpus != 0 && SetThreadAffinityMask(thread, cpus) != 0) {
+        applied |= SCHEDULING_AFFINITY;
+    }
+    if (SetThreadPriority(thread, (priority > 0 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL))) {
+        applied |= SCHEDULING_PRIORITY;
+    }
+    return applied;
+}
+
+/*
+ * Lock the pages of a ring in memory or unlock them, returns true if they are locked.
+ * Must be called with inputReadersLock held.
+ */
+static bool lockInputRing(InputRing *ring, bool locked) {
+    if (ring->memoryLocked == locked) {
+        return locked;
+    }
+    if (!locked) {
+        if (VirtualUnlock(ring->data, ring->capacity)) {
+            ring->memoryLocked = false;
+        }
+        return ring->memoryLocked;
+    }
+    BOOL result = VirtualLock(ring->data, ring->capacity);
+    if (!result && GetLastError() == ERROR_WORKING_SET_QUOTA) {
+        //The locked pages count against the minimum working set, make room for the ring
+        SIZE_T minimum, maximum;
+        if (GetProcessWorkingSetSize(GetCurrentProcess(), &minimum, &maximum) &&
+            SetProcessWorkingSetSize(GetCurrentProcess(), minimum + ring->capacity, maximum + ring->capacity)) {
+            result = VirtualLock(ring->data, ring->capacity);
+        }
+    }
+    ring->memoryLocked = (result != FALSE);
+    return ring->memoryLocked;
+}
+
+/*
+ * Returns the ring of a port, creating it with capacity bytes if needed. Returns NULL if
+ * it couldn't be created. Must be called with inputReadersLock held.
+ */
+static InputRing* createInputRing(PortContext *context, jint capacity) {
+    EnterCriticalSection(&context->lock);
+    InputRing *ring = context->ring;
+    LeaveCriticalSection(&context->lock);
+    if (ring == NULL) {
+        ring = newInputRing(capacity);
+        if (ring == NULL) {
+            return NULL;
+        }
+        if (context->readerMemoryLocked) {
+            lockInputRing(ring, true);
+        }
+        EnterCriticalSection(&context->lock);
+        InterlockedExchangePointer((PVOID volatile*)&context->ring, ring);
+        LeaveCriticalSection(&context->lock);
+        InterlockedIncrement(&inputRingsCount);
+    }
+    return ring;
+}
+
+/*
+ * Start the reader thread of a port, creating its ring of capacity bytes if needed.
+ * Must be called with inputReadersLock held.
+ */
+static bool startInputReader(PortContext *context, jint capacity) {
+    InputRing *ring = createInputRing(context, capacity);
+    if (ring == NULL) {
+        return false;
+    }
+    if (ring->thread != NULL) {
+        if (ringLoad(ring->running)) {
+            return true;
+        }
+        WaitForSingleObject(ring->thread, INFINITE);//Exited on a read error
+        CloseHandle(ring->thread);
+        ring->thread = NULL;
+    }
+    ResetEvent(ring->stopEvent);
+    //A framed read may be filling the ring itself while there is no reader thread
+    EnterCriticalSection(&ring->consumerLock);
+    ringStore(ring->running, 1);
+    LeaveCriticalSection(&ring->consumerLock);
+    InterlockedIncrement(&context->refCount);//Released by the reader thread
+    bool scheduled = (context->readerCpuMask != 0 || context->readerPriority != 0);
+    //A scheduled thread starts suspended, so it never runs on other CPUs or at the normal priority
+    ring->thread = CreateThread(NULL, 0, inputReaderThread, context, (scheduled ? CREATE_SUSPENDED : 0), NULL);
+    if (ring->thread == NULL) {
+        ringStore(ring->running, 0);
+        releasePortContext(context);
+        return false;
+    }
+    if (scheduled) {
+        applyThreadScheduling(ring->thread, context->readerCpuMask, context->readerPriority);
+        ResumeThread(ring->thread);
+    }
+    return true;
+}
+
+/*
+ * Stop the reader thread of a port and wait for it to exit, the data left in the ring
+ * can still be read. Must be called with inputReadersLock held.
+ */
+static void stopInputReader(PortContext *context) {
+    EnterCriticalSection(&context->lock);
+    InputRing *ring = context->ring;
+    LeaveCriticalSection(&context->lock);
+    if (ring == NULL || ring->thread == NULL) {
+        return;
+    }
+    SetEvent(ring->stopEvent);
+    WaitForSingleObject(ring->thread, INFINITE);
+    CloseHandle(ring->thread);
+    ring->thread = NULL;
+}
+
+/*
+ * Reads at most length bytes from the input ring into lpBuffer. Returns the count of
+ * bytes read, 0 if the ring is empty. Once the reader thread has stopped and the ring
+ * is empty, -1 is returned and the port must be read directly.
+ */
+static jint readFromRing(InputRing *ring, jbyte *lpBuffer, jint length) {
+    EnterCriticalSection(&ring->consumerLock);
+    DWORD tail = (DWORD)ring->tail;
+    DWORD available = (DWORD)ringLoad(ring->head) - tail;
+    bool cleared = false;
+    if (available == 0) {
+        if (!ringLoad(ring->running)) {
+            LeaveCriticalSection(&ring->consumerLock);
+            return -1;
+        }
+        //Clear the notification before checking again, the reader thread sets it after storing data
+        ringStore(ring->dataSignalled, 0);
+        ResetEvent(ring->dataEvent);
+        cleared = true;
+        available = (DWORD)ringLoad(ring->head) - tail;
+        if (available == 0) {
+            LeaveCriticalSection(&ring->consumerLock);
+            return 0;
+        }
+    }
+    DWORD count = ((DWORD)length < available ? (DWORD)length : available);
+    DWORD offset = tail & (ring->capacity - 1);
+    DWORD first = ring->capacity - offset;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(lpBuffer, ring->data + offset, first);
+    memcpy(lpBuffer + first, ring->data, count - first);
+    ringStore(ring->tail, (LONG)(tail + count));
+    if (count < available) {
+        //Keep the event set for the remaining data, the reader thread may have set it before it was reset
+        if (ringExchange(ring->dataSignalled, 1) == 0 || cleared) {
+            SetEvent(ring->dataEvent);
+        }
+    }
+    LeaveCriticalSection(&ring->consumerLock);
+    if (ringExchange(ring->spaceWanted, 0) == 1) {
+        SetEvent(ring->spaceEvent);
+    }
+    return (jint)count;
+}
+
+/*
+ * Drop the content of the input ring of a port, used by "_purgePort"
+ */
+static void purgeInputRing(HANDLE hComm) {
+    PortContext *context = acquireBufferedContext(hComm);
+    if (context != NULL) {
+        InputRing *ring = context->ring;
+        EnterCriticalSection(&ring->consumerLock);
+        ringStore(ring->tail, ringLoad(ring->head));
+        LeaveCriticalSection(&ring->consumerLock);
+        if (ringExchange(ring->spaceWanted, 0) == 1) {
+            SetEvent(ring->spaceEvent);
+        }
+        releasePortContext(context);
+    }
+}
+
+/*
+ * Get native library version
+ */
+JNIEXPORT jstring JNICALL Java_jssc_SerialNativeInterface_getNativeLibraryVersion(JNIEnv *env, jobject object) {
+    return env->NewStringUTF(jSSC_NATIVE_LIB_VERSION);
+}
+
+/*
+ * Port opening.
+ *
+ * In 2.2.0 added useTIOCEXCL (not used in Windows, only for compatibility with _nix version)
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_openPort(JNIEnv *env, jobject object, jstring portName, jboolean useTIOCEXCL){
+    char prefix[] = "\\\\.\\";
+    const char* port = env->GetStringUTFChars(portName, JNI_FALSE);
+
+    //since 2.1.0 -> string concat fix
+    char portFullName[strlen(prefix) + strlen(port) + 1];
+    strcpy(portFullName, prefix);
+    strcat(portFullName, port);
+    //<- since 2.1.0
+
+    HANDLE hComm = CreateFile(portFullName,
+                       	   	  GENERIC_READ | GENERIC_WRITE,
+                       	   	  0,
+                       	   	  0,
+                       	   	  OPEN_EXISTING,
+                       	   	  FILE_FLAG_OVERLAPPED,
+                       	   	  0);
+    env->ReleaseStringUTFChars(portName, port);
+
+    //since 2.3.0 ->
+    if(hComm != INVALID_HANDLE_VALUE){
+    	DCB *dcb = new DCB();
+    	if(!GetCommState(hComm, dcb)){
+    		CloseHandle(hComm);//since 2.7.0
+    		hComm = (HANDLE)jssc_SerialNativeInterface_ERR_INCORRECT_SERIAL_PORT;//(-4)Incorrect serial port
+    	}
+    	else {
+    		createPortContext(hComm);//since 2.9.0
+    	}
+    	delete dcb;
+    }
+    else {
+    	DWORD errorValue = GetLastError();
+    	if(errorValue == ERROR_ACCESS_DENIED){
+    		hComm = (HANDLE)jssc_SerialNativeInterface_ERR_PORT_BUSY;//(-1)Port busy
+    	}
+    	else if(errorValue == ERROR_FILE_NOT_FOUND){
+    		hComm = (HANDLE)jssc_SerialNativeInterface_ERR_PORT_NOT_FOUND;//(-2)Port not found
+    	}
+    }
+    //<- since 2.3.0
+    return (jlong)hComm;//since 2.4.0 changed to jlong
+};
+
+/*
+ * Setting serial port params.
+ *
+ * In 2.6.0 added flags (not used in Windows, only for compatibility with _nix version)
+ */
+/*
+ * Set the line parameters of "_setParams" in dcb, without the RTS and DTR control
+ * (since 2.9.0 shared with "_configure")
+ */
+static void buildCommState(DCB *dcb, jint baudRate, jint byteSize, jint stopBits, jint parity) {
+    dcb->BaudRate = baudRate;
+    dcb->ByteSize = byteSize;
+    dcb->StopBits = stopBits;
+    dcb->Parity = parity;
+
+    //since 0.8 ->
+    dcb->fOutxCtsFlow = FALSE;
+    dcb->fOutxDsrFlow = FALSE;
+    dcb->fDsrSensitivity = FALSE;
+    dcb->fTXContinueOnXoff = TRUE;
+    dcb->fOutX = FALSE;
+    dcb->fInX = FALSE;
+    dcb->fErrorChar = FALSE;
+    dcb->fNull = FALSE;
+    dcb->fAbortOnError = FALSE;
+    dcb->XonLim = 2048;
+    dcb->XoffLim = 512;
+    dcb->XonChar = (char)17; //DC1
+    dcb->XoffChar = (char)19; //DC3
+    //<- since 0.8
+}
+
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setParams
+  (JNIEnv *env, jobject object, jlong portHandle, jint baudRate, jint byteSize, jint stopBits, jint parity, jboolean setRTS, jboolean setDTR, jint flags){
+    HANDLE hComm = (HANDLE)portHandle;
+    DCB *dcb = new DCB();
+    jboolean returnValue = JNI_FALSE;
+    if(GetCommState(hComm, dcb)){
+        buildCommState(dcb, baudRate, byteSize, stopBits, parity);
+
+        //since 0.8 ->
+        if(setRTS == JNI_TRUE){
+        	dcb->fRtsControl = RTS_CONTROL_ENABLE;
+        }
+        else {
+        	dcb->fRtsControl = RTS_CONTROL_DISABLE;
+        }
+        if(setDTR == JNI_TRUE){
+        	dcb->fDtrControl = DTR_CONTROL_ENABLE;
+        }
+        else {
+           	dcb->fDtrControl = DTR_CONTROL_DISABLE;
+        }
+        //<- since 0.8
+
+        if(SetCommState(hComm, dcb)){
+
+        	//since 2.1.0 -> previously setted timeouts by another application should be cleared
+        	COMMTIMEOUTS *lpCommTimeouts = new COMMTIMEOUTS();
+        	lpCommTimeouts->ReadIntervalTimeout = 0;
+        	lpCommTimeouts->ReadTotalTimeoutConstant = 0;
+        	lpCommTimeouts->ReadTotalTimeoutMultiplier = 0;
+        	lpCommTimeouts->WriteTotalTimeoutConstant = 0;
+        	lpCommTimeouts->WriteTotalTimeoutMultiplier = 0;
+        	//since 2.9.0 the reader thread of the buffered mode needs its own read timeouts,
+        	//it restores those it found when it exits
+        	if(isInputReaderRunning(hComm)){
+        		setAnyDataReadTimeouts(lpCommTimeouts);
+        	}
+        	if(SetCommTimeouts(hComm, lpCommTimeouts)){
+        		returnValue = JNI_TRUE;
+        	}
+        	delete lpCommTimeouts;
+        	//<- since 2.1.0
+        }
+    }
+    delete dcb;
+    return returnValue;
+}
+
+/*
+ * PurgeComm
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_purgePort
+  (JNIEnv *env, jobject object, jlong portHandle, jint flags){
+    HANDLE hComm = (HANDLE)portHandle;
+    DWORD dwFlags = (DWORD)flags;
+    if(dwFlags & PURGE_RXCLEAR){
+        purgeInputRing(hComm);//since 2.9.0
+    }
+    return (PurgeComm(hComm, dwFlags) ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Port closing
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_closePort
+  (JNIEnv *env, jobject object, jlong portHandle){
+    HANDLE hComm = (HANDLE)portHandle;
+    //since 2.9.0 the reader thread of the buffered mode must be gone before the handle is closed
+    PortContext *context = acquireBufferedContext(hComm);
+    if(context != NULL){
+        EnterCriticalSection(&inputReadersLock.section);
+        stopInputReader(context);
+        LeaveCriticalSection(&inputReadersLock.section);
+        releasePortContext(context);
+    }
+    //since 2.9.0 the reads and writes blocked on the port fail at once, and are gone before the handle is closed
+    context = acquirePortContext(hComm);
+    if(context != NULL){
+        ringStore(context->closing, 1);
+        cancelPortIO(context);
+        waitPortIODone(context);
+        releasePortContext(context);
+    }
+    removePortContext(hComm);//since 2.9.0
+    return (CloseHandle(hComm) ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Cancel the blocking reads and writes of the port (since 2.9.0)
+ *
+ * They fail with a SerialPortException of type TYPE_IO_CANCELLED, whatever their
+ * timeout. Returns JNI_TRUE if there was any.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_cancelIO
+  (JNIEnv *env, jobject object, jlong portHandle){
+    PortContext *context = acquirePortContext((HANDLE)portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    jboolean result = cancelPortIO(context);
+    releasePortContext(context);
+    return result;
+}
+
+/*
+ * Get the statistics of the reads and writes of the port (since 2.9.0)
+ *
+ * Returns STATS_LENGTH values indexed as described with PortStats, or NULL if the port
+ * has no context. If reset is set the counters start again from 0; operations ending
+ * during the call may be counted in either period, but never in both.
+ */
+JNIEXPORT jlongArray JNICALL Java_jssc_SerialNativeInterface_getStatistics
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean reset){
+    PortContext *context = acquirePortContext((HANDLE)portHandle);
+    if(context == NULL){
+        return NULL;
+    }
+    jlong values[STATS_LENGTH];
+    EnterCriticalSection(&context->lock);
+    for(int i = 0; i < STATS_LENGTH; i++){
+        unsigned long long *field = (i < STATS_COUNTERS ? &context->stats.counters[i] : &context->stats.latency[i - STATS_COUNTERS]);
+        values[i] = (jlong)*field;
+        if(reset){
+            *field = 0;
+        }
+    }
+    LeaveCriticalSection(&context->lock);
+    releasePortContext(context);
+    jlongArray returnArray = env->NewLongArray(STATS_LENGTH);
+    if(returnArray != NULL){
+        env->SetLongArrayRegion(returnArray, 0, STATS_LENGTH, values);
+    }
+    return returnArray;
+}
+
+//Serializes "_captureStart" and "_captureStop" (since 2.9.0)
+static struct CapturesLock {
+    CRITICAL_SECTION section;
+    CapturesLock() { InitializeCriticalSection(&section); }
+    ~CapturesLock() { DeleteCriticalSection(&section); }
+} capturesLock;
+
+/*
+ * Start capturing the traffic of the port into a memory-mapped ring file (since 2.9.0),
+ * see jssc_Capture.h. Returns JNI_FALSE if the port already has a capture or the file
+ * couldn't be created.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_captureStart
+  (JNIEnv *env, jobject object, jlong portHandle, jstring fileName, jlong capacity){
+    PortContext *context = acquirePortContext((HANDLE)portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    jboolean returnValue = JNI_FALSE;
+    EnterCriticalSection(&capturesLock.section);
+    const char *path = env->GetStringUTFChars(fileName, NULL);
+    if(path != NULL){
+        if(context->capture == NULL){
+            CaptureRing *capture = captureOpen(path, capacity);
+            if(capture != NULL){
+                InterlockedExchangePointer((PVOID volatile*)&context->capture, capture);
+                returnValue = JNI_TRUE;
+            }
+        }
+        env->ReleaseStringUTFChars(fileName, path);
+    }
+    LeaveCriticalSection(&capturesLock.section);
+    releasePortContext(context);
+    return returnValue;
+}
+
+/*
+ * Stop the capture of the port and close its file (since 2.9.0). Returns JNI_FALSE if
+ * the port had no capture.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_captureStop
+  (JNIEnv *env, jobject object, jlong portHandle){
+    PortContext *context = acquirePortContext((HANDLE)portHandle);
+    if(context == NULL){
+        return JNI_FALSE;
+    }
+    EnterCriticalSection(&capturesLock.section);
+    CaptureRing *capture = (CaptureRing*)InterlockedExchangePointer((PVOID volatile*)&context->capture, NULL);
+    if(capture != NULL){
+        //The threads which have loaded the pointer are only copying their last record
+        while(ringLoad(context->captureUsers) != 0){
+            SwitchToThread();
+        }
+        captureClose(capture);
+    }
+    LeaveCriticalSection(&capturesLock.section);
+    releasePortContext(context);
+    return (capture != NULL ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Set events mask
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setEventsMask
+  (JNIEnv *env, jobject object, jlong portHandle, jint mask){
+    HANDLE hComm = (HANDLE)portHandle;
+    DWORD dwEvtMask = (DWORD)mask;
+    return (SetCommMask(hComm, dwEvtMask) ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Get events mask
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_getEventsMask
+  (JNIEnv *env, jobject object, jlong portHandle){
+    HANDLE hComm = (HANDLE)portHandle;
+    DWORD lpEvtMask;
+    if(GetCommMask(hComm, &lpEvtMask)){
+        return (jint)lpEvtMask;
+    }
+    else {
+        return -1;
+    }
+}
+
+/*
+ * Change RTS line state (ON || OFF)
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setRTS
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
+    HANDLE hComm = (HANDLE)portHandle;
+    if(enabled == JNI_TRUE){
+        return (EscapeCommFunction(hComm, SETRTS) ? JNI_TRUE : JNI_FALSE);
+    }
+    else {
+        return (EscapeCommFunction(hComm, CLRRTS) ? JNI_TRUE : JNI_FALSE);
+    }
+}
+
+/*
+ * Change DTR line state (ON || OFF)
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_setDTR
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
+    HANDLE hComm = (HANDLE)portHandle;
+    if(enabled == JNI_TRUE){
+        return (EscapeCommFunction(hComm, SETDTR) ? JNI_TRUE : JNI_FALSE);
+    }
+    else {
+        return (EscapeCommFunction(hComm, CLRDTR) ? JNI_TRUE : JNI_FALSE);
+    }
+}
+
+//Lines of "_setLines" (since 2.9.0), the values of SerialPort.LINE_*
+#define LINE_RTS    1
+#define LINE_DTR    2
+#define LINE_BREAK  4
+#define LINE_CTS    8
+#define LINE_DSR    16
+#define LINE_RING   32
+#define LINE_RLSD   64
+
+/*
+ * Set RTS, DTR and break and read the modem lines in one call (since 2.9.0)
+ *
+ * The lines of mask are set to their bit in values. Windows has no call changing
+ * several lines at once, so they are switched one after the other. Returns the LINE_*
+ * bits of the modem lines which are on and of the lines of mask which were switched
+ * on, or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setLines
+  (JNIEnv *env, jobject object, jlong portHandle, jint mask, jint values){
+    HANDLE hComm = (HANDLE)portHandle;
+    if((mask & LINE_RTS) && !EscapeCommFunction(hComm, ((values & LINE_RTS) ? SETRTS : CLRRTS))){
+        return -1;
+    }
+    if((mask & LINE_DTR) && !EscapeCommFunction(hComm, ((values & LINE_DTR) ? SETDTR : CLRDTR))){
+        return -1;
+    }
+    if((mask & LINE_BREAK) && !((values & LINE_BREAK) ? SetCommBreak(hComm) : ClearCommBreak(hComm))){
+        return -1;
+    }
+    DWORD modemStatus;
+    if(!GetCommModemStatus(hComm, &modemStatus)){
+        return -1;
+    }
+    return (values & mask & (LINE_RTS | LINE_DTR)) |
+           ((modemStatus & MS_CTS_ON) ? LINE_CTS : 0) | ((modemStatus & MS_DSR_ON) ? LINE_DSR : 0) |
+           ((modemStatus & MS_RING_ON) ? LINE_RING : 0) | ((modemStatus & MS_RLSD_ON) ? LINE_RLSD : 0);
+}
+
+/*
+ * Waiting for the output to be sent (since 2.9.0)
+ *
+ * FlushFileBuffers() can't be cancelled nor given a timeout and EV_TXEMPTY belongs to the
+ * event listener, so the output queue of the driver is polled with ClearCommError()
+ * instead. Each wait lasts about the time the pending bytes take to be sent at the current
+ * rate, one more character time is waited for the shift register once the queue is empty.
+ */
+#define DRAIN_DONE              1
+#define DRAIN_TIMEOUT           0
+#define DRAIN_ERROR             -1
+#define DRAIN_CANCELLED         -2
+#define DRAIN_INTERRUPTED       -3
+
+#define DRAIN_MAX_WAIT_MILLIS   100
+#define DRAIN_UNKNOWN_WAIT_MILLIS   1   //Rate unknown
+
+/*
+ * Time to send one character with the current settings of a port, 0 if unknown
+ */
+static jlong getCharacterMicros(HANDLE hComm) {
+    DCB *dcb = new DCB();
+    jlong characterMicros = 0;
+    if (GetCommState(hComm, dcb) && dcb->BaudRate > 0) {
+        //Half bits are rounded up, 1.5 stop bits counted as 2
+        int frameBits = 1 + dcb->ByteSize + (dcb->Parity != NOPARITY ? 1 : 0) + (dcb->StopBits != ONESTOPBIT ? 2 : 1);
+        characterMicros = ((jlong)frameBits * 1000000 + dcb->BaudRate - 1) / dcb->BaudRate;
+    }
+    delete dcb;
+    return characterMicros;
+}
+
+/*
+ * Sleep waitMillis or until the operation is cancelled
+ */
+static void sleepPortIO(PortIO *io, DWORD waitMillis) {
+    if (isPortIOCancelled(io)) {
+        return;
+    }
+    if (io->context != NULL && io->context->cancelEvent != NULL && ringLoad(io->context->staleIOCount) == 0) {
+        WaitForSingleObject(io->context->cancelEvent, waitMillis);
+    }
+    else {
+        Sleep(waitMillis);
+    }
+}
+
+/*
+ * Wait until all of the output of a port has been sent, the timeout expires (if
+ * timeoutMilliseconds is not negative) or the operation is cancelled. The java thread
+ * is checked for interruption every pollPeriodMillis, 0 to never check. Returns one of
+ * DRAIN_*, the caller throws the exceptions.
+ */
+static int drainOutput(JNIEnv *env, HANDLE hComm, PortIO *io, jlong timeoutMilliseconds, jlong pollPeriodMillis) {
+    jlong timeoutDeadline = (timeoutMilliseconds >= 0 ? getTimePreciseMicros() + timeoutMilliseconds*1000 : 0);
+    jlong characterMicros = getCharacterMicros(hComm);
+    char queued = 0;
+    for (;;) {
+        DWORD errors;
+        COMSTAT comstat;
+        if (!ClearCommError(hComm, &errors, &comstat)) {
+            return DRAIN_ERROR;
+        }
+        recordCommErrors(hComm, errors);
+        jlong pending = (jlong)comstat.cbOutQue;
+        char lastWait = 0;
+        if (pending == 0) {
+            if (!queued) {
+                return DRAIN_DONE;
+            }
+            //The last character is still in the shift register
+            pending = 1;
+            lastWait = 1;
+        }
+        queued = 1;
+        jlong waitMillis = (characterMicros > 0 ? (pending * characterMicros + 999) / 1000 : DRAIN_UNKNOWN_WAIT_MILLIS);
+        if (waitMillis > DRAIN_MAX_WAIT_MILLIS) {
+            waitMillis = DRAIN_MAX_WAIT_MILLIS;
+        }
+        if (pollPeriodMillis > 0 && waitMillis > pollPeriodMillis) {
+            waitMillis = pollPeriodMillis;
+        }
+        if (timeoutMilliseconds >= 0) {
+            jlong remainingMillis = (timeoutDeadline - getTimePreciseMicros() + 999) / 1000;
+            if (remainingMillis <= 0) {
+                io->counts[STAT_TIMEOUTS]++;
+                return DRAIN_TIMEOUT;
+            }
+            if (waitMillis > remainingMillis) {
+                waitMillis = remainingMillis;
+            }
+        }
+        sleepPortIO(io, (DWORD)waitMillis);
+        if (isPortIOCancelled(io)) {
+            return DRAIN_CANCELLED;
+        }
+        if (pollPeriodMillis > 0 && isThreadInterrupted(env)) {
+            return DRAIN_INTERRUPTED;
+        }
+        if (lastWait) {
+            return DRAIN_DONE;
+        }
+    }
+}
+
+/*
+ * Wait for the output of a port to be sent (since 2.9.0)
+ *
+ * Returns 1 when all of the data has been sent, 0 if the timeout expired and -1 on error.
+ * Cancellation and interruption leave an exception pending.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_drainPort
+  (JNIEnv *env, jobject object, jlong portHandle, jlong timeoutMilliseconds, jlong pollPeriodMillis){
+    HANDLE hComm = (HANDLE)portHandle;
+    PortIO io;
+    beginPortIO(hComm, &io);
+    int result = drainOutput(env, hComm, &io, timeoutMilliseconds, (pollPeriodMillis < 0 ? 0 : pollPeriodMillis));
+    if (result == DRAIN_CANCELLED) {
+        throwPortIOCancelled(env, &io, "<native>drainPort()");
+    }
+    else if (result == DRAIN_INTERRUPTED) {
+        throwInterruptedException(env, "Interrupted while waiting for the output to be sent");
+    }
+    endPortIO(&io);
+    return (result < DRAIN_ERROR ? DRAIN_ERROR : result);
+}
+
+/*
+ * RS-485 direction control (since 2.9.0), see "_setRS485"
+ *
+ * With RS485_MODE_SOFTWARE every write raises RTS, writes, waits with drainOutput() until
+ * the driver has sent the data and drops RTS.
+ */
+#define RS485_MODE_OFF          0
+#define RS485_MODE_DRIVER       1   //RTS_CONTROL_TOGGLE, the driver switches RTS
+#define RS485_MODE_SOFTWARE     2
+
+struct DirectionControl {
+    char active;
+    char rtsOnSend;
+    int delayAfter;
+};
+
+static void beginDirectionControl(HANDLE hComm, PortIO *io, DirectionControl *control) {
+    int delayBefore = 0;
+    control->active = 0;
+    if (io->context == NULL || ringLoad(io->context->rs485Mode) != RS485_MODE_SOFTWARE) {
+        return;
+    }
+    EnterCriticalSection(&io->context->lock);
+    if (io->context->rs485Mode == RS485_MODE_SOFTWARE) {
+        control->active = 1;
+        control->rtsOnSend = io->context->rs485RtsOnSend;
+        control->delayAfter = io->context->rs485DelayAfter;
+        delayBefore = io->context->rs485DelayBefore;
+    }
+    LeaveCriticalSection(&io->context->lock);
+    if (control->active) {
+        EscapeCommFunction(hComm, (control->rtsOnSend ? SETRTS : CLRRTS));
+        if (delayBefore > 0) {
+            Sleep((DWORD)delayBefore);
+        }
+    }
+}
+
+static void endDirectionControl(JNIEnv *env, HANDLE hComm, PortIO *io, DirectionControl *control, jint bytesWritten) {
+    if (control->active) {
+        if (bytesWritten > 0) {
+            //Stops early if the write is cancelled meanwhile
+            drainOutput(env, hComm, io, -1, 0);
+        }
+        if (control->delayAfter > 0) {
+            Sleep((DWORD)control->delayAfter);
+        }
+        EscapeCommFunction(hComm, (control->rtsOnSend ? CLRRTS : SETRTS));
+    }
+}
+
+/*
+ * Switch the RS-485 direction control of the port (since 2.9.0)
+ *
+ * Uses RTS_CONTROL_TOGGLE of the driver when RTS is high while sending and both delays
+ * are 0, the writes switch RTS themselves otherwise, see DirectionControl. The DCB is
+ * rewritten by "_setParams" and "_setFlowControlMode", so this must be called after
+ * them. Returns the RS485_MODE_* in use, -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setRS485
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled, jboolean rtsOnSend,
+    jint delayBeforeSendMillis, jint delayAfterSendMillis){
+    HANDLE hComm = (HANDLE)portHandle;
+    if (delayBeforeSendMillis < 0 || delayAfterSendMillis < 0) {
+        return -1;
+    }
+    PortContext *context = acquirePortContext(hComm);
+    if (context == NULL) {
+        return -1;
+    }
+    LONG mode = RS485_MODE_OFF;
+    DCB *dcb = new DCB();
+    if (GetCommState(hComm, dcb)) {
+        if (enabled == JNI_TRUE && rtsOnSend == JNI_TRUE && delayBeforeSendMillis == 0 && delayAfterSendMillis == 0) {
+            DWORD previousRtsControl = dcb->fRtsControl;
+            dcb->fRtsControl = RTS_CONTROL_TOGGLE;
+            //Some drivers accept the DCB but ignore the toggle mode, so it's read back
+            if (SetCommState(hComm, dcb) && GetCommState(hComm, dcb) && dcb->fRtsControl == RTS_CONTROL_TOGGLE) {
+                mode = RS485_MODE_DRIVER;
+                if (context->rs485Mode != RS485_MODE_DRIVER) {
+                    context->rs485SavedRtsControl = previousRtsControl;
+                }
+            }
+        }
+        else if (context->rs485Mode == RS485_MODE_DRIVER && dcb->fRtsControl == RTS_CONTROL_TOGGLE) {
+            dcb->fRtsControl = context->rs485SavedRtsControl;
+            SetCommState(hComm, dcb);
+        }
+    }
+    delete dcb;
+    if (enabled == JNI_TRUE && mode == RS485_MODE_OFF) {
+        mode = RS485_MODE_SOFTWARE;
+        EscapeCommFunction(hComm, (rtsOnSend == JNI_TRUE ? CLRRTS : SETRTS));
+    }
+    EnterCriticalSection(&context->lock);
+    context->rs485RtsOnSend = (rtsOnSend == JNI_TRUE);
+    context->rs485DelayBefore = delayBeforeSendMillis;
+    context->rs485DelayAfter = delayAfterSendMillis;
+    ringStore(context->rs485Mode, mode);
+    LeaveCriticalSection(&context->lock);
+    releasePortContext(context);
+    return mode;
+}
+
+DWORD getNextTimeoutWindows(char deadlineValid, jlong timeoutDeadline, jlong pollPeriodMillis) {
+    struct timeval timeout;
+    if (getNextTimeout(&timeout, deadlineValid, timeoutDeadline, pollPeriodMillis) == 1) {
+        //Error
+        return 0;
+    }
+
+    DWORD millisecondTimeout = timeout.tv_sec*1000 + timeout.tv_usec/1000;
+    return millisecondTimeout;
+}
+
+void getBuffersBytesCount(HANDLE hComm, jint* retVals) {
+
+    DWORD lpErrors;
+    COMSTAT comstat;
+    if(ClearCommError(hComm, &lpErrors, &comstat)){
+        retVals[0] = (jint)comstat.cbInQue + getInputRingBytesCount(hComm);//since 2.9.0 with the input ring
+        retVals[1] = (jint)comstat.cbOutQue;
+        recordCommErrors(hComm, lpErrors);//since 2.9.0
+    } else {
+        retVals[0] = -1;
+        retVals[1] = -1;
+    }
+}
+
+/*
+ * Write engine used by all of the writeBytes* functions. Writes byteCount bytes from
+ * lpBuffer, which must stay valid until the function returns.
+ *
+ * timeoutMilliseconds is the maximum time to wait for the port to accept all of the
+ * data, 0 to write only what can be written immediately, negative to block
+ * indefinitely. pollPeriodMillis is how often to check if the thread has been
+ * interrupted, 0 to never check. On interruption or timeout (if exceptionOnTimeout
+ * is set) a java exception is left pending.
+ *
+ * Returns the number of bytes written, or -1 if the write failed. slot is the write
+ * slot taken by the caller, see writeBytesFromMemory() below.
+ */
+static jint writeBytesFromSlot(JNIEnv *env, HANDLE hComm, TransferSlot *slot, jbyte *lpBuffer, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    DWORD lpNumberOfBytesTransferred = 0;
+    DWORD lpNumberOfBytesWritten;
+    jlong timeoutDeadline = 0;
+    char deadlineValid = 0;
+    DWORD waitMillis = INFINITE;
+    jint returnValue = -1;
+    PortIO io;//since 2.9.0
+    DirectionControl control;//since 2.9.0
+
+    if (pollPeriodMillis < 0)
+        pollPeriodMillis = 0;
+    if (pollPeriodMillis != 0 || timeoutMilliseconds >= 0) {
+        if (timeoutMilliseconds >= 0) {
+            timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+            deadlineValid = 1;
+        }
+        waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+    }
+
+    beginPortIO(hComm, &io);
+    beginDirectionControl(hComm, &io, &control);
+    OVERLAPPED *overlapped = prepareOverlapped(slot);
+    io.counts[STAT_WRITE_CALLS]++;
+    if(WriteFile(hComm, lpBuffer, (DWORD)byteCount, &lpNumberOfBytesWritten, overlapped)){
+        returnValue = (jint)lpNumberOfBytesWritten;
+    }
+    else if(GetLastError() == ERROR_IO_PENDING){
+        DWORD waitRetVal;
+        char interrupted = 0;
+        do {
+            waitRetVal = waitPortIO(&io, overlapped->hEvent, waitMillis);
+            if (isPortIOCancelled(&io)) {
+                throwPortIOCancelled(env, &io, "<native>writeBytes()");
+                interrupted = 1;
+                break;
+            }
+            if (waitRetVal != WAIT_TIMEOUT)
+                break;
+            // Check if the java thread has been interrupted, and if so, throw the exception
+            if (pollPeriodMillis > 0 && isThreadInterrupted(env)) {
+                throwInterruptedException(env, "Interrupted while writing serial data");
+                interrupted = 1;
+                break;
+            }
+            if (waitMillis != INFINITE)
+                waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+        } while (waitMillis > 0);
+
+        if(waitRetVal == WAIT_OBJECT_0){
+            markPortIOReady(&io, false);
+            if(GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesTransferred, false)){
+                returnValue = (jint)lpNumberOfBytesTransferred;
+            }
+        } else {
+            CancelIo(hComm);
+            //Wait for the cancellation, lpBuffer must not be read after we return.
+            //Bytes accepted before the cancellation are reported to the caller.
+            GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesTransferred, true);
+            returnValue = (jint)lpNumberOfBytesTransferred;
+            if (!interrupted && returnValue < byteCount) {
+                io.counts[STAT_TIMEOUTS]++;
+                if (returnValue > 0) {
+                    io.counts[STAT_PARTIAL_WRITES]++;
+                }
+                if (exceptionOnTimeout) {
+                    throwTimeoutException(env, "NoPort", "<native>writeBytes()", timeoutMilliseconds);
+                }
+            }
+        }
+    }
+    if (returnValue > 0) {
+        io.counts[STAT_BYTES_WRITTEN] += returnValue;
+        capturePortData(io.context, CAPTURE_WRITE, lpBuffer, (DWORD)returnValue);
+    }
+    endDirectionControl(env, hComm, &io, &control, returnValue);
+    endPortIO(&io);
+    return returnValue;
+}
+
+/*
+ * Same as writeBytesFromSlot() with the write slot of the port
+ */
+static jint writeBytesFromMemory(JNIEnv *env, HANDLE hComm, jbyte *lpBuffer, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_WRITE);
+    if(slot == NULL){
+        return -1;
+    }
+    jint result = writeBytesFromSlot(env, hComm, slot, lpBuffer, byteCount, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    releaseTransferSlot(slot);
+    return result;
+}
+
+/*
+ * Write data to port
+ * portHandle - port handle
+ * buffer - byte array for sending
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_writeBytes
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer){
+    jbyte* jBuffer = env->GetByteArrayElements(buffer, NULL);
+    if(jBuffer == NULL){
+        return JNI_FALSE;//OutOfMemoryError is pending
+    }
+    jint bufferSize = env->GetArrayLength(buffer);
+    jint result = writeBytesFromMemory(env, (HANDLE)portHandle, jBuffer, bufferSize, -1, 0, JNI_FALSE);
+    env->ReleaseByteArrayElements(buffer, jBuffer, JNI_ABORT);//The data is never modified, don't copy it back
+    return result == bufferSize ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Write data to port from a region of the given array.
+ *
+ * Same timeout behaviour as readBytesToArray. Returns the number of bytes written,
+ * or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesFromArray
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    if(buffer == NULL){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if(offset < 0 || byteCount < 0 || offset > arrayLength || byteCount > arrayLength - offset){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if(byteCount == 0){
+        return 0;
+    }
+    //Only the region is copied, into the buffer of the write slot which is kept for the next writes
+    TransferSlot *slot = acquireTransferSlot((HANDLE)portHandle, TRANSFER_WRITE);
+    if(slot == NULL){
+        return -1;
+    }
+    jbyte *lpBuffer = getSlotBuffer(slot, byteCount);
+    if(lpBuffer == NULL){
+        releaseTransferSlot(slot);
+        throwSerialException(env, "NoPort", "<native>writeBytesFromArray()", SP_EXCEPTION_TYPE_NO_MEMORY);
+        return -1;
+    }
+    env->GetByteArrayRegion(buffer, offset, byteCount, lpBuffer);
+    jint result = writeBytesFromSlot(env, (HANDLE)portHandle, slot, lpBuffer, byteCount, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    releaseTransferSlot(slot);
+    return result;
+}
+
+/*
+ * Write data to port from a direct ByteBuffer, starting at position.
+ * The buffer's position is not changed.
+ *
+ * Same timeout behaviour as readBytesToBuffer. Returns the number of bytes written,
+ * or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesFromBuffer
+  (JNIEnv *env, jobject object, jlong portHandle, jobject buffer, jint position, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jbyte *address = (buffer != NULL ? (jbyte*)env->GetDirectBufferAddress(buffer) : NULL);
+    if(address == NULL){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if(position < 0 || byteCount < 0 || position > capacity || byteCount > capacity - position){
+        throwSerialException(env, "NoPort", "<native>writeBytesFromBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if(byteCount == 0){
+        return 0;
+    }
+    return writeBytesFromMemory(env, (HANDLE)portHandle, address + position, byteCount, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+}
+
+//Most buffers of a single writeBytesGather() call (since 2.9.0)
+#define WRITE_GATHER_MAX 16
+#define WRITE_GATHER_STACK_SIZE 4096
+
+/*
+ * Write data to port from several buffers with a single WriteFile() call (since 2.9.0)
+ *
+ * Each element of buffers is a direct ByteBuffer, or a byte array for the buffers
+ * backed by one, and counts[i] bytes are written from offsets[i]. Windows has no
+ * gather write for communication devices, so the buffers are copied one after the
+ * other into a single block which is written by one overlapped operation. Same
+ * timeout behaviour as writeBytesFromArray. Returns the total number of bytes
+ * written, or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_writeBytesGather
+  (JNIEnv *env, jobject object, jlong portHandle, jobjectArray buffers, jintArray offsets, jintArray counts,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jint sourceCount = (buffers != NULL ? env->GetArrayLength(buffers) : 0);
+    if(sourceCount <= 0 || sourceCount > WRITE_GATHER_MAX || offsets == NULL || counts == NULL ||
+       env->GetArrayLength(offsets) < sourceCount || env->GetArrayLength(counts) < sourceCount ||
+       env->EnsureLocalCapacity(sourceCount) != 0){
+        throwSerialException(env, "NoPort", "<native>writeBytesGather()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jobject sources[WRITE_GATHER_MAX];
+    jbyte *addresses[WRITE_GATHER_MAX];
+    jint positions[WRITE_GATHER_MAX];
+    jint lengths[WRITE_GATHER_MAX];
+    env->GetIntArrayRegion(offsets, 0, sourceCount, positions);
+    env->GetIntArrayRegion(counts, 0, sourceCount, lengths);
+    jint byteCount = 0;
+    for(int i = 0; i < sourceCount; i++){
+        sources[i] = env->GetObjectArrayElement(buffers, i);
+        addresses[i] = (sources[i] != NULL ? (jbyte*)env->GetDirectBufferAddress(sources[i]) : NULL);
+        jlong capacity = 0;
+        if(addresses[i] != NULL){
+            capacity = env->GetDirectBufferCapacity(sources[i]);
+        }
+        else if(sources[i] != NULL){
+            capacity = env->GetArrayLength((jarray)sources[i]);
+        }
+        if(sources[i] == NULL || positions[i] < 0 || lengths[i] < 0 || positions[i] > capacity || lengths[i] > capacity - positions[i] ||
+           lengths[i] > 0x7fffffff - byteCount){
+            throwSerialException(env, "NoPort", "<native>writeBytesGather()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+            return -1;
+        }
+        byteCount += lengths[i];
+    }
+    if(byteCount == 0){
+        return 0;
+    }
+    jbyte stackBuffer[WRITE_GATHER_STACK_SIZE];
+    jbyte *lpBuffer = (byteCount <= WRITE_GATHER_STACK_SIZE ? stackBuffer : new (std::nothrow) jbyte[byteCount]);
+    if(lpBuffer == NULL){
+        return -1;
+    }
+    jint gathered = 0;
+    for(int i = 0; i < sourceCount; i++){
+        if(addresses[i] != NULL){
+            memcpy(lpBuffer + gathered, addresses[i] + positions[i], lengths[i]);
+        }
+        else {
+            env->GetByteArrayRegion((jbyteArray)sources[i], positions[i], lengths[i], lpBuffer + gathered);
+        }
+        gathered += lengths[i];
+    }
+    jint result = writeBytesFromMemory(env, (HANDLE)portHandle, lpBuffer, byteCount, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    if(lpBuffer != stackBuffer){
+        delete[] lpBuffer;
+    }
+    return result;
+}
+
+/*
+ * Read engine used by all of the readBytes* functions. Reads into lpBuffer, which
+ * must stay valid until the function returns, and returns the number of bytes read.
+ * The parameters are the same as for readBytes below; in addition if byteCount is 0,
+ * at most maxAvailable bytes are read from the input buffer. slot is the read slot
+ * taken by the caller. On error, interruption or timeout (if exceptionOnTimeout is
+ * set) a java exception is left pending.
+ *
+ * Since 2.9.0 ports in buffered mode are read by readBytesFromRing() instead.
+ */
+static jint readBytesFromPort(JNIEnv *env, HANDLE hComm, TransferSlot *slot, PortIO *io, jbyte *lpBuffer, jint byteCount, jint maxAvailable,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jlong timeoutDeadline = 0;
+    char deadlineValid = 0;
+    DWORD byteRemains = byteCount;
+    DWORD waitMillis=0;
+    
+
+    if (byteCount < 0)
+        byteCount = 0;
+    if (pollPeriodMillis < 0)
+        pollPeriodMillis = 0;
+        
+    waitMillis = 0;
+    if (byteCount > 0 && pollPeriodMillis == 0 && timeoutMilliseconds < 0) {
+        waitMillis = INFINITE;
+    }
+    
+    if (waitMillis != INFINITE) {
+        if (byteCount == 0) {
+            //Return right away
+            jint bufferCounts[2];
+            getBuffersBytesCount(hComm, bufferCounts);
+            if (bufferCounts[0] <= 0) {
+                byteRemains = 0;
+            } else {
+                byteRemains = (bufferCounts[0] < maxAvailable ? bufferCounts[0] : maxAvailable);
+            }
+            deadlineValid = 0;
+        } else {
+            if (timeoutMilliseconds < 0) {
+                deadlineValid = 0;
+            } else {
+                timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+                deadlineValid = 1;
+            }
+        }
+        waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+    }
+    
+    while(byteRemains > 0){
+        OVERLAPPED *overlapped = prepareOverlapped(slot);
+        DWORD lpNumberOfBytesRead;
+        BOOL readFileRet;
+
+        io->counts[STAT_READ_CALLS]++;
+        if (byteCount == 0){
+            readFileRet = ReadFile(hComm, lpBuffer, byteRemains, &lpNumberOfBytesRead, overlapped);
+        } else {
+            readFileRet = ReadFile(hComm, lpBuffer + (byteCount - byteRemains), byteRemains, &lpNumberOfBytesRead, overlapped);
+        }
+        if(readFileRet){
+            if (lpNumberOfBytesRead > 0 && io->readyMicros == 0) {
+                io->readyMicros = getTimePreciseMicros();
+            }
+            if (byteCount == 0) {
+                byteCount = lpNumberOfBytesRead;
+                byteRemains = 0;
+            } else {
+                byteRemains -= lpNumberOfBytesRead;
+            }
+        } else if(GetLastError() == ERROR_IO_PENDING) {
+            if (byteCount == 0) {
+                byteRemains = 0;
+                CancelIo(hComm);
+                //Wait for the cancellation, lpBuffer must not be written after we return
+                lpNumberOfBytesRead = 0;
+                GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesRead, true);
+                byteCount = lpNumberOfBytesRead;
+                break;
+            }
+
+            if (waitMillis != INFINITE)
+                waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+
+            DWORD waitRetVal = WAIT_TIMEOUT;
+            while (waitRetVal == WAIT_TIMEOUT && waitMillis > 0) {
+                waitRetVal = waitPortIO(io, overlapped->hEvent, waitMillis);
+                if (waitMillis != INFINITE)
+                    waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+                if (isPortIOCancelled(io)) {
+                    throwPortIOCancelled(env, io, "<native>readBytes()");
+                    CancelIo(hComm);
+                    GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesRead, true);
+                    goto done;
+                }
+                // Check if the java thread has been interrupted, and if so, throw the exception
+                if (isThreadInterrupted(env)) {
+                    throwInterruptedException(env, "Interrupted while waiting for serial data");
+                    // It shouldn't matter what we return, the exception will be thrown right away
+                    CancelIo(hComm);
+                    GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesRead, true);
+                    goto done;
+                }
+            }
+            if(waitRetVal == WAIT_OBJECT_0){
+                if(GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesRead, false)){
+                    markPortIOReady(io, lpNumberOfBytesRead > 0);
+                    byteRemains -= lpNumberOfBytesRead;
+                }
+            } else {
+                CancelIo(hComm);
+                //Bytes that arrived before the cancellation are kept
+                lpNumberOfBytesRead = 0;
+                if(GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesRead, true) || lpNumberOfBytesRead > 0){
+                    byteRemains -= lpNumberOfBytesRead;
+                }
+            }
+        }
+        
+        // Check if we've timed out and if so, throw the exception or return the data
+        if (waitMillis != INFINITE) {
+            if (byteRemains > 0 && byteCount != 0) {
+                waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+                if (waitMillis == 0) {
+                    io->counts[STAT_TIMEOUTS]++;
+                    if (exceptionOnTimeout) {
+                        throwTimeoutException(env, "NoPort", "<native>readBytes()", timeoutMilliseconds);
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (byteCount == 0) {
+            //Couldn't read any data on non-blocking read
+            byteRemains = 0;
+        }
+    }
+    done:
+
+    //The bytes read are at the start of lpBuffer in both modes
+    capturePortData(io->context, CAPTURE_READ, lpBuffer, byteCount - byteRemains);
+    return byteCount - byteRemains;
+}
+
+/*
+ * Same as readBytesFromPort() for a port in buffered mode, the data is taken from the
+ * input ring. Once the reader thread has stopped and the ring is empty, the port is
+ * read directly for the remaining bytes and time.
+ */
+static jint readBytesFromRing(JNIEnv *env, HANDLE hComm, TransferSlot *slot, PortIO *io, InputRing *ring, jbyte *lpBuffer, jint byteCount,
+    jint maxAvailable, jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    if (pollPeriodMillis < 0)
+        pollPeriodMillis = 0;
+
+    if (byteCount <= 0) {
+        //Return right away
+        jint result = readFromRing(ring, lpBuffer, maxAvailable);
+        if (result < 0) {
+            return readBytesFromPort(env, hComm, slot, io, lpBuffer, 0, maxAvailable, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+        }
+        return result;
+    }
+
+    jlong timeoutDeadline = 0;
+    char deadlineValid = 0;
+    DWORD waitMillis = INFINITE;
+    if (timeoutMilliseconds >= 0) {
+        timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+        deadlineValid = 1;
+        waitMillis = 0;
+    } else if (pollPeriodMillis > 0) {
+        waitMillis = 0;
+    }
+
+    jint bytesRead = 0;
+    while (bytesRead < byteCount) {
+        jint result = readFromRing(ring, lpBuffer + bytesRead, byteCount - bytesRead);
+        if (result > 0) {
+            io->counts[STAT_READ_CALLS]++;
+            if (io->readyMicros == 0) {
+                io->readyMicros = getTimePreciseMicros();
+            }
+            bytesRead += result;
+            continue;
+        }
+        if (result < 0) {
+            jlong remainingMillis = -1;
+            if (deadlineValid) {
+                remainingMillis = (timeoutDeadline - getTimePreciseMicros()) / 1000;
+                if (remainingMillis < 0)
+                    remainingMillis = 0;
+            }
+            return bytesRead + readBytesFromPort(env, hComm, slot, io, lpBuffer + bytesRead, byteCount - bytesRead, 0,
+                                                 remainingMillis, pollPeriodMillis, exceptionOnTimeout);
+        }
+        if (waitMillis != INFINITE) {
+            waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+            if (deadlineValid && waitMillis == 0) {
+                io->counts[STAT_TIMEOUTS]++;
+                if (exceptionOnTimeout) {
+                    throwTimeoutException(env, "NoPort", "<native>readBytes()", timeoutMilliseconds);
+                }
+                break;
+            }
+        }
+        if (waitPortIO(io, ring->dataEvent, waitMillis) == WAIT_OBJECT_0) {
+            markPortIOReady(io, true);
+        }
+        if (isPortIOCancelled(io)) {
+            throwPortIOCancelled(env, io, "<native>readBytes()");
+            break;
+        }
+        // Check if the java thread has been interrupted, and if so, throw the exception
+        if (isThreadInterrupted(env)) {
+            throwInterruptedException(env, "Interrupted while waiting for serial data");
+            break;
+        }
+    }
+    return bytesRead;
+}
+
+/*
+ * Read engine used by all of the readBytes* functions, see readBytesFromPort()
+ */
+static jint readBytesToMemory(JNIEnv *env, HANDLE hComm, TransferSlot *slot, jbyte *lpBuffer, jint byteCount, jint maxAvailable,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    PortIO io;
+    jint bytesRead;
+    beginPortIO(hComm, &io);
+    PortContext *context = acquireBufferedContext(hComm);
+    if (context == NULL) {
+        bytesRead = readBytesFromPort(env, hComm, slot, &io, lpBuffer, byteCount, maxAvailable, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    } else {
+        bytesRead = readBytesFromRing(env, hComm, slot, &io, context->ring, lpBuffer, byteCount, maxAvailable,
+                                      timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+        releasePortContext(context);
+    }
+    if (bytesRead > 0) {
+        io.counts[STAT_BYTES_READ] += bytesRead;
+    }
+    endPortIO(&io);
+    return bytesRead;
+}
+
+//Reads up to this size don't need a heap allocated buffer
+#define READ_STACK_BUFFER_SIZE 4096
+
+    /**
+     * Read data from port
+     * 
+     * @param portHandle handle of opened port
+     *
+     * @param byteCount number of bytes to block and wait for, or 0 to return immediately
+     * with whatever data is available. If timeoutMilliseconds is 0 and byteCount
+     * is positive, then immediately returns with at most byteCount bytes (possibly 0).
      *
      * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
      * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
@@ -303,145 +2173,729 @@ JNIEXPORT jbyteArray JNICALL Java_jssc_SerialNativeInterface_readBytes
   (JNIEnv *env, jobject object, jlong portHandle, jint byteCount,
     jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
     HANDLE hComm = (HANDLE)portHandle;
-    DWORD timeoutDeadline = 0;
-    char deadlineValid = 0;
-    DWORD byteRemains = byteCount;
-    DWORD waitMillis=0;
-    
-    jclass threadClass = env->FindClass("java/lang/Thread");
-    jmethodID areWeInterruptedMethod = env->GetStaticMethodID(threadClass, "interrupted", "()Z");
+    jint bufferSize = byteCount;
 
-    if (byteCount < 0)
+    if (byteCount <= 0) {
         byteCount = 0;
-    if (pollPeriodMillis < 0)
-        pollPeriodMillis = 0;
-        
-    waitMillis = 0;
-    if (pollPeriodMillis == 0 && timeoutMilliseconds < 0) {
-        waitMillis = INFINITE;
+        jint bufferCounts[2];
+        getBuffersBytesCount(hComm, bufferCounts);
+        bufferSize = (bufferCounts[0] > 0 ? bufferCounts[0] : 0);
     }
-    
-    if (waitMillis != INFINITE) {
-        if (byteCount == 0) {
-            //Return right away
-            jint bufferCounts[2];
-            getBuffersBytesCount(hComm, bufferCounts);
-            if (bufferCounts[0] == 0) {
-                byteRemains = 0;
-            } else {
-                byteRemains = bufferCounts[0];
+
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_READ);
+    if (slot == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_NO_MEMORY);
+        return NULL;
+    }
+    jbyte stackBuffer[READ_STACK_BUFFER_SIZE];
+    jbyte *lpBuffer = (bufferSize <= READ_STACK_BUFFER_SIZE ? stackBuffer : getSlotBuffer(slot, bufferSize));
+    jint bytesRead = 0;
+    if (lpBuffer == NULL) {
+        releaseTransferSlot(slot);
+        throwSerialException(env, "NoPort", "<native>readBytes()", SP_EXCEPTION_TYPE_NO_MEMORY);
+        return NULL;
+    }
+    if (bufferSize > 0) {
+        bytesRead = readBytesToMemory(env, hComm, slot, lpBuffer, byteCount, bufferSize, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    }
+
+    jbyteArray returnArray = env->NewByteArray(bytesRead);
+    if (returnArray != NULL && bytesRead > 0)
+        env->SetByteArrayRegion(returnArray, 0, bytesRead, lpBuffer);
+    releaseTransferSlot(slot);
+    return returnArray;
+}
+
+/*
+ * Read data from port into a region of the given array.
+ *
+ * Same as readBytes, but the data is stored in buffer starting at offset and the
+ * number of bytes read is returned. Overlapped reads can't target the java array
+ * directly, so the data is received in native memory and copied once.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesToArray
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    HANDLE hComm = (HANDLE)portHandle;
+    if (buffer == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytesToArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if (offset < 0 || byteCount < 0 || offset > arrayLength || byteCount > arrayLength - offset) {
+        throwSerialException(env, "NoPort", "<native>readBytesToArray()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if (byteCount == 0) {
+        return 0;
+    }
+
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_READ);
+    jbyte stackBuffer[READ_STACK_BUFFER_SIZE];
+    jbyte *lpBuffer = (slot == NULL ? NULL : (byteCount <= READ_STACK_BUFFER_SIZE ? stackBuffer : getSlotBuffer(slot, byteCount)));
+    if (lpBuffer == NULL) {
+        if (slot != NULL)
+            releaseTransferSlot(slot);
+        throwSerialException(env, "NoPort", "<native>readBytesToArray()", SP_EXCEPTION_TYPE_NO_MEMORY);
+        return -1;
+    }
+    jint bytesRead = readBytesToMemory(env, hComm, slot, lpBuffer, byteCount, 0, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    if (bytesRead > 0)
+        env->SetByteArrayRegion(buffer, offset, bytesRead, lpBuffer);
+    releaseTransferSlot(slot);
+    return bytesRead;
+}
+
+/*
+ * Read whatever is available into a region of the given array, without waiting
+ * (since 2.9.0)
+ *
+ * Same as readBytesToArray with a byteCount of 0: the whole input backlog, at most
+ * maxLength bytes, is read at once. Returns the number of bytes read, possibly 0.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readAvailable
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint maxLength){
+    HANDLE hComm = (HANDLE)portHandle;
+    if (buffer == NULL) {
+        throwSerialException(env, "NoPort", "<native>readAvailable()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if (offset < 0 || maxLength < 0 || offset > arrayLength || maxLength > arrayLength - offset) {
+        throwSerialException(env, "NoPort", "<native>readAvailable()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint bufferCounts[2];
+    getBuffersBytesCount(hComm, bufferCounts);
+    jint byteCount = (bufferCounts[0] < maxLength ? bufferCounts[0] : maxLength);
+    if (byteCount <= 0) {
+        return 0;
+    }
+
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_READ);
+    jbyte stackBuffer[READ_STACK_BUFFER_SIZE];
+    jbyte *lpBuffer = (slot == NULL ? NULL : (byteCount <= READ_STACK_BUFFER_SIZE ? stackBuffer : getSlotBuffer(slot, byteCount)));
+    if (lpBuffer == NULL) {
+        if (slot != NULL)
+            releaseTransferSlot(slot);
+        throwSerialException(env, "NoPort", "<native>readAvailable()", SP_EXCEPTION_TYPE_NO_MEMORY);
+        return -1;
+    }
+    jint bytesRead = readBytesToMemory(env, hComm, slot, lpBuffer, 0, byteCount, 0, 0, JNI_FALSE);
+    if (bytesRead > 0)
+        env->SetByteArrayRegion(buffer, offset, bytesRead, lpBuffer);
+    releaseTransferSlot(slot);
+    return bytesRead;
+}
+
+/*
+ * Read a packet delimited by line idle into a region of the given array (since 2.9.0)
+ *
+ * Waits as readBytesToArray for the first byte, then keeps reading until the line has
+ * been quiet for idleMicros or maxLength bytes have been read. The port keeps its
+ * COMMTIMEOUTS: the idle time is the timeout of a pending read of one byte, so it is
+ * rounded up to milliseconds and subject to the resolution of the system timer.
+ * Returns the number of bytes read, 0 on timeout.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesUntilIdle
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint maxLength, jlong idleMicros,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    HANDLE hComm = (HANDLE)portHandle;
+    if (buffer == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytesUntilIdle()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jint arrayLength = env->GetArrayLength(buffer);
+    if (offset < 0 || maxLength < 0 || idleMicros < 0 || offset > arrayLength || maxLength > arrayLength - offset) {
+        throwSerialException(env, "NoPort", "<native>readBytesUntilIdle()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if (maxLength == 0) {
+        return 0;
+    }
+
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_READ);
+    jbyte stackBuffer[READ_STACK_BUFFER_SIZE];
+    jbyte *lpBuffer = (slot == NULL ? NULL : (maxLength <= READ_STACK_BUFFER_SIZE ? stackBuffer : getSlotBuffer(slot, maxLength)));
+    if (lpBuffer == NULL) {
+        if (slot != NULL)
+            releaseTransferSlot(slot);
+        throwSerialException(env, "NoPort", "<native>readBytesUntilIdle()", SP_EXCEPTION_TYPE_NO_MEMORY);
+        return -1;
+    }
+    jlong idleMillis = (idleMicros + 999) / 1000;
+    jint bytesRead = readBytesToMemory(env, hComm, slot, lpBuffer, 1, 0, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    while (bytesRead > 0 && bytesRead < maxLength && !env->ExceptionCheck()) {
+        //Take the backlog, then wait for one more byte at most the idle time
+        jint result = readBytesToMemory(env, hComm, slot, lpBuffer + bytesRead, 0, maxLength - bytesRead, 0, 0, JNI_FALSE);
+        if (result <= 0) {
+            result = readBytesToMemory(env, hComm, slot, lpBuffer + bytesRead, 1, 0, idleMillis, 0, JNI_FALSE);
+            if (result <= 0) {
+                break;//The line is idle, the packet is complete
             }
-            deadlineValid = 0;
-        } else {
-            if (timeoutMilliseconds < 0) {
-                deadlineValid = 0;
-            } else {
-                timeoutDeadline = getTimePreciseMicros(env) + timeoutMilliseconds*1000;
-                deadlineValid = 1;
+        }
+        bytesRead += result;
+    }
+    if (bytesRead > 0)
+        env->SetByteArrayRegion(buffer, offset, bytesRead, lpBuffer);
+    releaseTransferSlot(slot);
+    return bytesRead;
+}
+
+/*
+ * Read data from port into a direct ByteBuffer.
+ *
+ * Same as readBytes, but the data is stored in the memory of the direct buffer
+ * starting at position and the number of bytes read is returned. The buffer's
+ * position is not changed. No java objects are allocated.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readBytesToBuffer
+  (JNIEnv *env, jobject object, jlong portHandle, jobject buffer, jint position, jint byteCount,
+    jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    HANDLE hComm = (HANDLE)portHandle;
+    jbyte *address = (buffer != NULL ? (jbyte*)env->GetDirectBufferAddress(buffer) : NULL);
+    if (address == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytesToBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (position < 0 || byteCount < 0 || position > capacity || byteCount > capacity - position) {
+        throwSerialException(env, "NoPort", "<native>readBytesToBuffer()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    if (byteCount == 0) {
+        return 0;
+    }
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_READ);
+    if (slot == NULL) {
+        throwSerialException(env, "NoPort", "<native>readBytesToBuffer()", SP_EXCEPTION_TYPE_NO_MEMORY);
+        return -1;
+    }
+    jint bytesRead = readBytesToMemory(env, hComm, slot, address + position, byteCount, 0, timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    releaseTransferSlot(slot);
+    return bytesRead;
+}
+
+/*
+ * Get bytes count in serial port buffers (Input and Output)
+ */
+JNIEXPORT jintArray JNICALL Java_jssc_SerialNativeInterface_getBuffersBytesCount
+  (JNIEnv *env, jobject object, jlong portHandle){
+    HANDLE hComm = (HANDLE)portHandle;
+    jint returnValues[2];
+    jintArray returnArray = env->NewIntArray(2);
+    getBuffersBytesCount(hComm, returnValues);
+    env->SetIntArrayRegion(returnArray, 0, 2, returnValues);
+    return returnArray;
+}
+
+/*
+ * Enable the buffered mode of a port (since 2.9.0)
+ *
+ * Starts the reader thread, the input ring is created on the first call. Returns
+ * JNI_TRUE if the reader thread is running.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_bufferedReaderStart
+  (JNIEnv *env, jobject object, jlong portHandle, jint capacity){
+    PortContext *context = acquirePortContext((HANDLE)portHandle);
+    if (context == NULL) {
+        return JNI_FALSE;
+    }
+    EnterCriticalSection(&inputReadersLock.section);
+    bool started = startInputReader(context, capacity);
+    LeaveCriticalSection(&inputReadersLock.section);
+    releasePortContext(context);
+    return (started ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Disable the buffered mode of a port (since 2.9.0)
+ *
+ * Stops the reader thread. The data already in the input ring is read before the port.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_bufferedReaderStop
+  (JNIEnv *env, jobject object, jlong portHandle){
+    PortContext *context = acquirePortContext((HANDLE)portHandle);
+    if (context == NULL) {
+        return JNI_FALSE;
+    }
+    EnterCriticalSection(&inputReadersLock.section);
+    stopInputReader(context);
+    LeaveCriticalSection(&inputReadersLock.section);
+    releasePortContext(context);
+    return JNI_TRUE;
+}
+
+/*
+ * Set the scheduling of the reader thread of a port (since 2.9.0)
+ *
+ * Kept in the port context: the CPU mask and the priority are applied to the running
+ * reader thread and to the ones started later, the ring is locked now or once it is
+ * created. Returns the combination of SCHEDULING_* applied at once.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setReaderScheduling
+  (JNIEnv *env, jobject object, jlong portHandle, jlong cpuMask, jint priority, jboolean lockMemory){
+    PortContext *context = acquirePortContext((HANDLE)portHandle);
+    if (context == NULL) {
+        return 0;
+    }
+    jint applied = 0;
+    EnterCriticalSection(&inputReadersLock.section);
+    context->readerCpuMask = cpuMask;
+    context->readerPriority = priority;
+    context->readerMemoryLocked = (lockMemory == JNI_TRUE);
+    EnterCriticalSection(&context->lock);
+    InputRing *ring = context->ring;
+    LeaveCriticalSection(&context->lock);
+    if (ring != NULL) {
+        if (ring->thread != NULL) {
+            applied |= applyThreadScheduling(ring->thread, cpuMask, priority);
+        }
+        if (lockInputRing(ring, context->readerMemoryLocked)) {
+            applied |= SCHEDULING_MEMORY_LOCKED;
+        }
+    }
+    LeaveCriticalSection(&inputReadersLock.section);
+    releasePortContext(context);
+    return applied;
+}
+
+/*
+ * Set the scheduling of the calling thread (since 2.9.0), used by the thread of
+ * SerialPortReactor
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setThreadScheduling
+  (JNIEnv *env, jobject object, jlong cpuMask, jint priority){
+    return applyThreadScheduling(GetCurrentThread(), cpuMask, priority);
+}
+
+/*
+ * Framed reads (since 2.9.0)
+ *
+ * A frame either ends with a delimiter or starts with a header holding the length of
+ * the data following it. Frames are searched in the input ring of the port, which the
+ * first framed read creates if the port is not in buffered mode. Such a ring has no
+ * reader thread: the framed reads fill it from the port themselves and it keeps the
+ * bytes received past the end of a frame until the next read.
+ */
+#define FRAME_DELIMITER_MAX_LENGTH 64
+
+//Longest wait for the port with consumerLock held, see waitRingFromPort()
+#define FRAME_WAIT_SLICE_MILLIS 100
+
+#define ringByteAt(ring, position) ((ring)->data[(position) & ((ring)->capacity - 1)])
+
+struct FrameFormat {
+    const jbyte *delimiter;         //NULL for frames with a length field
+    DWORD delimiterLength;
+    DWORD headerLength;             //Length of the header, the length field included
+    DWORD lengthFieldOffset;
+    DWORD lengthFieldSize;          //1 to 4 bytes
+    jboolean bigEndian;
+    int checksumType;               //CHECKSUM_NONE or the checksum ending each frame
+};
+
+/*
+ * Search the end of a frame in the available bytes of the ring starting at tail. For
+ * delimited frames scanned is the count of bytes already searched, it is updated so
+ * the same bytes are not searched again while the frame is incomplete. Returns the
+ * length of the frame, 0 if it is incomplete, or -1 if its header gives a length
+ * over maxLength, see readFrameToArray(). A delimited frame is cut at maxLength bytes if no delimiter is found.
+ */
+static jint findFrameInRing(InputRing *ring, DWORD tail, DWORD available, const FrameFormat *format,
+    DWORD maxLength, DWORD *scanned) {
+    if (format->delimiter == NULL) {
+        if (available < format->headerLength) {
+            return 0;
+        }
+        DWORD dataLength = 0;
+        for (DWORD i = 0; i < format->lengthFieldSize; i++) {
+            DWORD index = (format->bigEndian ? i : format->lengthFieldSize - 1 - i);
+            dataLength = (dataLength << 8) | (unsigned char)ringByteAt(ring, tail + format->lengthFieldOffset + index);
+        }
+        if (dataLength > maxLength - format->headerLength) {
+            return -1;
+        }
+        DWORD frameLength = format->headerLength + dataLength;
+        return (available >= frameLength ? (jint)frameLength : 0);
+    }
+    DWORD limit = (available < maxLength ? available : maxLength);
+    DWORD position = *scanned;
+    while (position + format->delimiterLength <= limit) {
+        //memchr() on the first byte of the delimiter, for each contiguous part of the ring
+        DWORD offset = (tail + position) & (ring->capacity - 1);
+        DWORD length = ring->capacity - offset;
+        if (length > limit - position) {
+            length = limit - position;
+        }
+        const jbyte *found = (const jbyte*)memchr(ring->data + offset, format->delimiter[0], length);
+        if (found == NULL) {
+            position += length;
+            continue;
+        }
+        position += (DWORD)(found - (ring->data + offset));
+        if (position + format->delimiterLength > limit) {
+            break;
+        }
+        DWORD matched = 1;
+        while (matched < format->delimiterLength && ringByteAt(ring, tail + position + matched) == format->delimiter[matched]) {
+            matched++;
+        }
+        if (matched == format->delimiterLength) {
+            return (jint)(position + matched);
+        }
+        position++;
+    }
+    //The last bytes may be the start of a delimiter, search them again with the next data
+    *scanned = (limit >= format->delimiterLength ? limit - format->delimiterLength + 1 : 0);
+    return (available >= maxLength ? (jint)maxLength : 0);
+}
+
+/*
+ * Check the checksum of a frame found by findFrameInRing(). The checksum covers the
+ * bytes of the frame up to itself and is stored at its end, before the delimiter for
+ * delimited frames. A delimited frame cut at maxLength is never valid.
+ */
+static bool isFrameChecksumValid(InputRing *ring, DWORD tail, DWORD frameLength, const FrameFormat *format) {
+    DWORD checksumSize = getChecksumSize(format->checksumType);
+    DWORD trailerLength = checksumSize;
+    if (format->delimiter != NULL) {
+        if (frameLength < format->delimiterLength + checksumSize) {
+            return false;
+        }
+        for (DWORD i = 0; i < format->delimiterLength; i++) {
+            if (ringByteAt(ring, tail + frameLength - format->delimiterLength + i) != format->delimiter[i]) {
+                return false;
             }
         }
-        waitMillis = getNextTimeoutWindows(env, deadlineValid, timeoutDeadline, pollPeriodMillis);
+        trailerLength += format->delimiterLength;
     }
-    
-    jbyte *lpBuffer = new jbyte[byteRemains];
-    
-    while(byteRemains > 0){
-        OVERLAPPED *overlapped = new OVERLAPPED();
-        overlapped->hEvent = CreateEventA(NULL, true, false, NULL);
-        DWORD lpNumberOfBytesRead;
-        BOOL readFileRet;
+    else if (frameLength < format->headerLength + checksumSize) {
+        return false;
+    }
+    //The covered bytes are in at most two contiguous parts of the ring
+    DWORD dataLength = frameLength - trailerLength;
+    DWORD offset = tail & (ring->capacity - 1);
+    DWORD firstLength = ring->capacity - offset;
+    if (firstLength > dataLength) {
+        firstLength = dataLength;
+    }
+    unsigned int state = checksumStart(format->checksumType);
+    state = checksumUpdate(format->checksumType, state, ring->data + offset, firstLength);
+    state = checksumUpdate(format->checksumType, state, ring->data, dataLength - firstLength);
+    jbyte field[4];
+    for (DWORD i = 0; i < checksumSize; i++) {
+        field[i] = ringByteAt(ring, tail + dataLength + i);
+    }
+    return checksumFinish(format->checksumType, state) == readChecksum(format->checksumType, field);
+}
 
-        if (byteCount == 0){
-            readFileRet = ReadFile(hComm, lpBuffer, byteRemains, &lpNumberOfBytesRead, overlapped);
-        } else {
-            readFileRet = ReadFile(hComm, lpBuffer + (byteCount - byteRemains), byteRemains, &lpNumberOfBytesRead, overlapped);
+/*
+ * Move what the driver holds into a ring without reader thread, must be called with
+ * consumerLock held
+ */
+static void fillRingFromPort(HANDLE hComm, TransferSlot *slot, InputRing *ring) {
+    while (true) {
+        DWORD head = (DWORD)ring->head;
+        DWORD space = ring->capacity - (head - (DWORD)ring->tail);
+        DWORD lpErrors;
+        COMSTAT comstat;
+        if (space == 0 || !ClearCommError(hComm, &lpErrors, &comstat)) {
+            return;
         }
-        if(readFileRet){
-            if (byteCount == 0) {
-                byteCount = lpNumberOfBytesRead;
-                byteRemains = 0;
+        recordCommErrors(hComm, lpErrors);
+        if (comstat.cbInQue == 0) {
+            return;
+        }
+        DWORD offset = head & (ring->capacity - 1);
+        DWORD length = ring->capacity - offset;
+        if (length > space) {
+            length = space;
+        }
+        if (length > comstat.cbInQue) {
+            length = comstat.cbInQue;
+        }
+        OVERLAPPED *overlapped = prepareOverlapped(slot);
+        DWORD bytesRead = 0;
+        if (!ReadFile(hComm, ring->data + offset, length, &bytesRead, overlapped) &&
+            (GetLastError() != ERROR_IO_PENDING || !GetOverlappedResult(hComm, overlapped, &bytesRead, true))) {
+            return;
+        }
+        if (bytesRead == 0) {
+            return;
+        }
+        capturePortData(slot->context, CAPTURE_READ, ring->data + offset, bytesRead);
+        ringStore(ring->head, (LONG)(head + bytesRead));
+    }
+}
+
+/*
+ * Wait at most waitMillis for a byte from the port and store it in a ring without reader
+ * thread, must be called with consumerLock held. The pending read targets the ring, so
+ * the lock is kept for the whole wait. Returns false if the read failed.
+ */
+static bool waitRingFromPort(HANDLE hComm, TransferSlot *slot, PortIO *io, InputRing *ring, DWORD waitMillis) {
+    DWORD head = (DWORD)ring->head;
+    OVERLAPPED *overlapped = prepareOverlapped(slot);
+    DWORD bytesRead = 0;
+    if (!ReadFile(hComm, &ringByteAt(ring, head), 1, &bytesRead, overlapped)) {
+        if (GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        if (waitPortIO(io, overlapped->hEvent, waitMillis) != WAIT_OBJECT_0) {
+            CancelIo(hComm);
+        }
+        //Also waits for the cancellation, a byte received meanwhile is kept
+        if (!GetOverlappedResult(hComm, overlapped, &bytesRead, true) && bytesRead == 0 &&
+            GetLastError() != ERROR_OPERATION_ABORTED) {
+            return false;
+        }
+    }
+    if (bytesRead > 0) {
+        capturePortData(slot->context, CAPTURE_READ, &ringByteAt(ring, head), bytesRead);
+        ringStore(ring->head, (LONG)(head + bytesRead));
+    }
+    return true;
+}
+
+/*
+ * Read engine of "_readUntil" and "_readFrame". Waits for a complete frame in the ring
+ * and copies it into buffer at offset, returns its length or 0 on timeout. The bytes of
+ * an incomplete frame stay in the ring, frames with a wrong checksum are dropped without
+ * being copied. On error, interruption or timeout (if exceptionOnTimeout is set) a java
+ * exception is left pending.
+ *
+ * A header giving a length over maxLength is taken for a lost synchronization: its first
+ * byte is dropped and counted as a framing error, and the search goes on from the next
+ * one. With a checksum the frames found that way are checked like any other, so the
+ * search simply continues. Without one nothing tells a real frame from noise, so the
+ * read fails and the next read goes on from the next byte.
+ */
+static jint readFrameToArray(JNIEnv *env, HANDLE hComm, TransferSlot *slot, PortIO *io, InputRing *ring, jbyteArray buffer, jint offset,
+    DWORD maxLength, const FrameFormat *format, const char *methodName, jlong timeoutMilliseconds, jlong pollPeriodMillis,
+    jboolean exceptionOnTimeout){
+    jlong timeoutDeadline = 0;
+    char deadlineValid = 0;
+    DWORD waitMillis = INFINITE;
+    DWORD scanned = 0;
+    DWORD scannedTail = 0;
+    jint frameLength = 0;
+
+    if (pollPeriodMillis < 0)
+        pollPeriodMillis = 0;
+    if (timeoutMilliseconds >= 0) {
+        timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+        deadlineValid = 1;
+        waitMillis = 0;
+    } else if (pollPeriodMillis > 0) {
+        waitMillis = 0;
+    }
+
+    while (true) {
+        EnterCriticalSection(&ring->consumerLock);
+        bool running = (ringLoad(ring->running) != 0);
+        //Clear the notification before searching, it is set again by new data or below
+        ringStore(ring->dataSignalled, 0);
+        ResetEvent(ring->dataEvent);
+        if (!running) {
+            fillRingFromPort(hComm, slot, ring);
+        }
+        DWORD tail = (DWORD)ring->tail;
+        if (tail != scannedTail) {
+            //Another thread has read from the ring meanwhile
+            scanned = 0;
+            scannedTail = tail;
+        }
+        frameLength = findFrameInRing(ring, tail, (DWORD)ringLoad(ring->head) - tail, format, maxLength, &scanned);
+        bool dropped = false;
+        while (frameLength < 0 || (frameLength > 0 && format->checksumType != CHECKSUM_NONE &&
+               !isFrameChecksumValid(ring, tail, (DWORD)frameLength, format))) {
+            if (frameLength < 0) {
+                tail++;
+                io->frameErrors++;
             } else {
-                byteRemains -= lpNumberOfBytesRead;
+                tail += (DWORD)frameLength;
             }
-        } else if(GetLastError() == ERROR_IO_PENDING) {
-            if (byteCount == 0) {
-                byteRemains = 0;
-                CancelIo(hComm);
-                CloseHandle(overlapped->hEvent);
-                delete overlapped;
+            ringStore(ring->tail, (LONG)tail);
+            dropped = true;
+            scanned = 0;
+            scannedTail = tail;
+            if (frameLength < 0 && format->checksumType == CHECKSUM_NONE) {
                 break;
             }
-
-            if (waitMillis != INFINITE)
-                waitMillis = getNextTimeoutWindows(env, deadlineValid, timeoutDeadline, pollPeriodMillis);
-
-            DWORD waitRetVal = WAIT_TIMEOUT;
-            while (waitRetVal == WAIT_TIMEOUT && waitMillis > 0) {
-                waitRetVal = WaitForSingleObject(overlapped->hEvent, waitMillis);
-                if (waitMillis != INFINITE)
-                    waitMillis = getNextTimeoutWindows(env, deadlineValid, timeoutDeadline, pollPeriodMillis);
-                // Check if the java thread has been interrupted, and if so, throw the exception
-                if (env->CallStaticBooleanMethod(threadClass, areWeInterruptedMethod)) {
-                    jclass excClass = env->FindClass("java/lang/InterruptedException");
-                    env->ThrowNew(excClass, "Interrupted while waiting for serial data");
-                    // It shouldn't matter what we return, the exception will be thrown right away
-                    CancelIo(hComm);
-                    CloseHandle(overlapped->hEvent);
-                    delete overlapped;
-                    goto done;
-                }
+            frameLength = findFrameInRing(ring, tail, (DWORD)ringLoad(ring->head) - tail, format, maxLength, &scanned);
+        }
+        if (dropped && frameLength <= 0 && ringExchange(ring->spaceWanted, 0) == 1) {
+            SetEvent(ring->spaceEvent);
+        }
+        if (frameLength > 0) {
+            DWORD first = ring->capacity - (tail & (ring->capacity - 1));
+            if (first > (DWORD)frameLength) {
+                first = (DWORD)frameLength;
             }
-            if(waitRetVal == WAIT_OBJECT_0){
-                if(GetOverlappedResult(hComm, overlapped, &lpNumberOfBytesRead, false)){
-                    byteRemains -= lpNumberOfBytesRead;
-                }
-            } else {
-                CancelIo(hComm);
+            env->SetByteArrayRegion(buffer, offset, first, ring->data + (tail & (ring->capacity - 1)));
+            if ((DWORD)frameLength > first) {
+                env->SetByteArrayRegion(buffer, offset + first, frameLength - first, ring->data);
             }
+            ringStore(ring->tail, (LONG)(tail + frameLength));
+            io->counts[STAT_BYTES_READ] += frameLength;
+        }
+        io->counts[STAT_READ_CALLS]++;
+        if (frameLength != 0) {
+            LeaveCriticalSection(&ring->consumerLock);
+            if (ringExchange(ring->spaceWanted, 0) == 1) {
+                SetEvent(ring->spaceEvent);
+            }
+            break;
         }
-        
-        // Check if we've timed out and if so, throw the exception or return the data
         if (waitMillis != INFINITE) {
-            if (byteRemains > 0 && byteCount != 0) {
-                waitMillis = getNextTimeoutWindows(env, deadlineValid, timeoutDeadline, pollPeriodMillis);
-                if (waitMillis == 0) {
-                    if (exceptionOnTimeout) {
-                        throwTimeoutException(env, "NoPort", "<native>readBytes()", timeoutMilliseconds);
-                    }
-                    CloseHandle(overlapped->hEvent);
-                    delete overlapped;
-                    break;
+            waitMillis = getNextTimeoutWindows(deadlineValid, timeoutDeadline, pollPeriodMillis);
+            if (deadlineValid && waitMillis == 0) {
+                LeaveCriticalSection(&ring->consumerLock);
+                io->counts[STAT_TIMEOUTS]++;
+                if (exceptionOnTimeout) {
+                    throwTimeoutException(env, "NoPort", methodName, timeoutMilliseconds);
                 }
+                break;
+            }
+        }
+        if (!running) {
+            bool waited = waitRingFromPort(hComm, slot, io, ring, (waitMillis < FRAME_WAIT_SLICE_MILLIS ? waitMillis : FRAME_WAIT_SLICE_MILLIS));
+            LeaveCriticalSection(&ring->consumerLock);
+            if (!waited) {
+                throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_UNKNOWN);
+                break;
+            }
+        } else {
+            //The reader thread also sets the event when it exits
+            LeaveCriticalSection(&ring->consumerLock);
+            if (waitPortIO(io, ring->dataEvent, waitMillis) == WAIT_OBJECT_0) {
+                markPortIOReady(io, true);
             }
         }
+        if (isPortIOCancelled(io)) {
+            throwPortIOCancelled(env, io, methodName);
+            break;
+        }
+        // Check if the java thread has been interrupted, and if so, throw the exception
+        if (isThreadInterrupted(env)) {
+            throwInterruptedException(env, "Interrupted while waiting for serial data");
+            break;
+        }
+    }
+    //Keep the event set for the other reading threads while data is left
+    if (ringLoad(ring->head) != ringLoad(ring->tail) && ringExchange(ring->dataSignalled, 1) == 0) {
+        SetEvent(ring->dataEvent);
+    }
+    if (frameLength < 0) {
+        throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    return frameLength;
+}
 
-        if (byteCount == 0) {
-            //Couldn't read any data on non-blocking read
-            byteRemains = 0;
+/*
+ * Common part of "_readUntil" and "_readFrame": finds the input ring of the port,
+ * creating it with at least maxLength bytes if the port has none, and reads a frame
+ */
+static jint readFrameFromPort(JNIEnv *env, HANDLE hComm, jbyteArray buffer, jint offset, jint maxLength, const FrameFormat *format,
+    const char *methodName, jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    PortContext *context = acquireBufferedContext(hComm);
+    InputRing *ring = (context != NULL ? context->ring : NULL);
+    if (context == NULL) {
+        context = acquirePortContext(hComm);
+        if (context == NULL) {
+            throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_PORT_NOT_OPENED);
+            return -1;
+        }
+        EnterCriticalSection(&inputReadersLock.section);
+        ring = createInputRing(context, maxLength);
+        LeaveCriticalSection(&inputReadersLock.section);
+        if (ring == NULL) {
+            releasePortContext(context);
+            throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_NO_MEMORY);
+            return -1;
         }
-        CloseHandle(overlapped->hEvent);
-        delete overlapped;
     }
-    done:
+    //A frame can't be longer than the ring, whose capacity is smaller than maxLength if the buffered mode created it
+    DWORD limit = ((DWORD)maxLength < ring->capacity ? (DWORD)maxLength : ring->capacity);
+    if (format->headerLength > limit) {
+        releasePortContext(context);
+        throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_READ);
+    if (slot == NULL) {
+        releasePortContext(context);
+        throwSerialException(env, "NoPort", methodName, SP_EXCEPTION_TYPE_NO_MEMORY);
+        return -1;
+    }
+    PortIO io;
+    beginPortIO(hComm, &io);
+    jint result = readFrameToArray(env, hComm, slot, &io, ring, buffer, offset, limit, format, methodName,
+                                   timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
+    endPortIO(&io);
+    releaseTransferSlot(slot);
+    releasePortContext(context);
+    return result;
+}
 
-    jbyteArray returnArray = env->NewByteArray(byteCount-byteRemains);
-    if (byteCount > 0)
-        env->SetByteArrayRegion(returnArray, 0, byteCount-byteRemains, lpBuffer);
-    delete lpBuffer;
-    return returnArray;
+/*
+ * Read a frame ending with the given delimiter into buffer starting at offset
+ * (since 2.9.0)
+ *
+ * Returns the length of the frame, delimiter included. If no delimiter is found within
+ * maxLength bytes, maxLength bytes are returned as they are. Returns 0 on timeout, the
+ * bytes already received are then kept for the next read. If checksumType is not
+ * CHECKSUM_NONE, only the frames ending with a valid checksum before the delimiter are
+ * returned.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readUntil
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray delimiter, jbyteArray buffer, jint offset, jint maxLength,
+    jint checksumType, jlong timeoutMilliseconds, jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jint delimiterLength = (delimiter != NULL ? env->GetArrayLength(delimiter) : 0);
+    jint arrayLength = (buffer != NULL ? env->GetArrayLength(buffer) : 0);
+    if (buffer == NULL || delimiterLength <= 0 || delimiterLength > FRAME_DELIMITER_MAX_LENGTH || maxLength < delimiterLength ||
+        offset < 0 || offset > arrayLength || maxLength > arrayLength - offset ||
+        (checksumType != CHECKSUM_NONE && getChecksumSize(checksumType) == 0)) {
+        throwSerialException(env, "NoPort", "<native>readUntil()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    jbyte delimiterBytes[FRAME_DELIMITER_MAX_LENGTH];
+    env->GetByteArrayRegion(delimiter, 0, delimiterLength, delimiterBytes);
+    FrameFormat format = {delimiterBytes, (DWORD)delimiterLength, 0, 0, 0, JNI_FALSE, checksumType};
+    return readFrameFromPort(env, (HANDLE)portHandle, buffer, offset, maxLength, &format, "<native>readUntil()",
+                             timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
 }
 
 /*
- * Get bytes count in serial port buffers (Input and Output)
+ * Read a frame starting with a header of headerLength bytes into buffer starting at
+ * offset (since 2.9.0)
+ *
+ * The header holds an unsigned length field of lengthFieldSize bytes (1 to 4) at
+ * lengthFieldOffset, giving the count of bytes following the header. Returns the length
+ * of the frame, header included, or 0 on timeout. If checksumType is not CHECKSUM_NONE,
+ * the last bytes counted by the length field are a checksum of the rest of the frame,
+ * and only the frames with a valid checksum are returned. A header giving a frame longer
+ * than maxLength loses its first byte, which is counted as a framing error; without
+ * checksum a SerialPortException is then thrown, with one the search goes on.
  */
-JNIEXPORT jintArray JNICALL Java_jssc_SerialNativeInterface_getBuffersBytesCount
-  (JNIEnv *env, jobject object, jlong portHandle){
-    HANDLE hComm = (HANDLE)portHandle;
-    jint returnValues[2];
-    jintArray returnArray = env->NewIntArray(2);
-    getBuffersBytesCount(hComm, returnValues);
-    env->SetIntArrayRegion(returnArray, 0, 2, returnValues);
-    return returnArray;
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_readFrame
+  (JNIEnv *env, jobject object, jlong portHandle, jbyteArray buffer, jint offset, jint maxLength, jint headerLength,
+    jint lengthFieldOffset, jint lengthFieldSize, jboolean bigEndian, jint checksumType, jlong timeoutMilliseconds,
+    jlong pollPeriodMillis, jboolean exceptionOnTimeout){
+    jint arrayLength = (buffer != NULL ? env->GetArrayLength(buffer) : 0);
+    if (buffer == NULL || lengthFieldSize < 1 || lengthFieldSize > 4 || lengthFieldOffset < 0 ||
+        lengthFieldOffset > headerLength - lengthFieldSize || headerLength > maxLength ||
+        offset < 0 || offset > arrayLength || maxLength > arrayLength - offset ||
+        (checksumType != CHECKSUM_NONE && getChecksumSize(checksumType) == 0)) {
+        throwSerialException(env, "NoPort", "<native>readFrame()", SP_EXCEPTION_TYPE_PARAMETER_IS_NOT_CORRECT);
+        return -1;
+    }
+    FrameFormat format = {NULL, 0, (DWORD)headerLength, (DWORD)lengthFieldOffset, (DWORD)lengthFieldSize, bigEndian,
+                          checksumType};
+    return readFrameFromPort(env, (HANDLE)portHandle, buffer, offset, maxLength, &format, "<native>readFrame()",
+                             timeoutMilliseconds, pollPeriodMillis, exceptionOnTimeout);
 }
 
 //since 0.8 ->
@@ -538,19 +2992,71 @@ JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_sendBreak
 }
 
 /*
- * Wait event
- * portHandle - port handle
+ * Enable or disable the low latency mode of a port (since 2.9.0)
+ *
+ * Windows has no such setting for the serial drivers, the latency timer of FTDI
+ * adapters is a property of the device in the registry which the VCP driver only reads
+ * when the port is opened. Nothing is applied, 0 is returned.
  */
-JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
-  (JNIEnv *env, jobject object, jlong portHandle) {
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_setLowLatency
+  (JNIEnv *env, jobject object, jlong portHandle, jboolean enabled){
+    return 0;
+}
+
+/*
+ * Apply the line parameters and the flow control mode with a single SetCommState()
+ * call (since 2.9.0), none if the port already has them. DTR is kept, and RTS as well
+ * unless RTS/CTS handshake is switched on or off. The low latency flags have nothing to
+ * change, see "_setLowLatency", and the flags of "_setParams" only concern the *nix
+ * versions.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_configure
+  (JNIEnv *env, jobject object, jlong portHandle, jint baudRate, jint byteSize, jint stopBits, jint parity, jint flowControlMask, jint flags){
     HANDLE hComm = (HANDLE)portHandle;
+    DCB current;
+    if(!GetCommState(hComm, &current)){
+        return JNI_FALSE;
+    }
+    DCB dcb;
+    memcpy(&dcb, &current, sizeof(DCB));
+    buildCommState(&dcb, baudRate, byteSize, stopBits, parity);
+    if((flowControlMask & FLOWCONTROL_RTSCTS_IN) == FLOWCONTROL_RTSCTS_IN){
+        dcb.fRtsControl = RTS_CONTROL_HANDSHAKE;
+    }
+    else if(dcb.fRtsControl == RTS_CONTROL_HANDSHAKE){
+        dcb.fRtsControl = RTS_CONTROL_ENABLE;//As "_setFlowControlMode"
+    }
+    dcb.fOutxCtsFlow = ((flowControlMask & FLOWCONTROL_RTSCTS_OUT) == FLOWCONTROL_RTSCTS_OUT);
+    dcb.fInX = ((flowControlMask & FLOWCONTROL_XONXOFF_IN) == FLOWCONTROL_XONXOFF_IN);
+    dcb.fOutX = ((flowControlMask & FLOWCONTROL_XONXOFF_OUT) == FLOWCONTROL_XONXOFF_OUT);
+    if(memcmp(&dcb, &current, sizeof(DCB)) == 0){
+        return JNI_TRUE;
+    }
+    return (SetCommState(hComm, &dcb) ? JNI_TRUE : JNI_FALSE);
+}
+
+//Maximum count of {event, value} pairs returned by a single wait
+#define COMM_EVENTS_MAX 9
+
+/*
+ * Wait event (since 2.9.0 shared by "_waitEvents" and "_waitEventsInto")
+ * hComm - port handle
+ * pairs - receives the {event, value} pairs, COMM_EVENTS_MAX at most
+ *
+ * Returns the count of pairs, or -1 if the wait failed (then pairs[1] holds the error code)
+ */
+static jint waitCommEvents(HANDLE hComm, jint pairs[]) {
     DWORD lpEvtMask = 0;
     DWORD lpNumberOfBytesTransferred = 0;
-    OVERLAPPED *overlapped = new OVERLAPPED();
-    jclass intClass = env->FindClass("[I");
-    jobjectArray returnArray;
+    TransferSlot *slot = acquireTransferSlot(hComm, TRANSFER_EVENTS);
+    if(slot == NULL){
+        pairs[0] = -1;
+        pairs[1] = (jint)GetLastError();
+        return -1;
+    }
+    OVERLAPPED *overlapped = prepareOverlapped(slot);
+    jint returnValue;
     jboolean functionSuccessful = false;
-    overlapped->hEvent = CreateEventA(NULL, true, false, NULL);
     if(WaitCommEvent(hComm, &lpEvtMask, overlapped)){
         functionSuccessful = true;
     }
@@ -564,7 +3070,7 @@ JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
     if(functionSuccessful){
         jboolean executeGetCommModemStatus = false;
         jboolean executeClearCommError = false;
-        DWORD events[9];//fixed since 0.8 (old value is 8)
+        DWORD events[COMM_EVENTS_MAX];//fixed since 0.8 (old value is 8)
         jint eventsCount = 0;
         if((EV_BREAK & lpEvtMask) == EV_BREAK){
             events[eventsCount] = EV_BREAK;
@@ -652,12 +3158,13 @@ JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
         jboolean successClearCommError = false;
         if(executeClearCommError){
             DWORD lpErrors;
-            COMSTAT *comstat = new COMSTAT();
-            if(ClearCommError(hComm, &lpErrors, comstat)){
+            COMSTAT comstat;
+            if(ClearCommError(hComm, &lpErrors, &comstat)){
                 successClearCommError = true;
-                bytesCountIn = (jint)comstat->cbInQue;
-                bytesCountOut = (jint)comstat->cbOutQue;
+                bytesCountIn = (jint)comstat.cbInQue + getInputRingBytesCount(hComm);//since 2.9.0
+                bytesCountOut = (jint)comstat.cbOutQue;
                 communicationsErrors = (jint)lpErrors;
+                recordCommErrors(hComm, lpErrors);//since 2.9.0
             }
             else {
                 jint lastError = (jint)GetLastError();
@@ -665,17 +3172,12 @@ JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
                 bytesCountOut = lastError;
                 communicationsErrors = lastError;
             }
-            delete comstat;
         }
-        /*
-         * Create int[][] for events values
-         */
-        returnArray = env->NewObjectArray(eventsCount, intClass, NULL);
         /*
          * Set events values
          */
         for(jint i = 0; i < eventsCount; i++){
-            jint returnValues[2];
+            jint *returnValues = &pairs[i * 2];
             switch(events[i]){
                 case EV_BREAK:
                     returnValues[0] = (jint)events[i];
@@ -729,28 +3231,80 @@ JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
                 goto forEnd;
             }
             forEnd: {
-                jintArray singleResultArray = env->NewIntArray(2);
-                env->SetIntArrayRegion(singleResultArray, 0, 2, returnValues);
-                env->SetObjectArrayElement(returnArray, i, singleResultArray);
+                //Stored in place
             };
         }
+        returnValue = eventsCount;
     }
     else {
-        returnArray = env->NewObjectArray(1, intClass, NULL);
-        jint returnValues[2];
-        returnValues[0] = -1;
-        returnValues[1] = (jint)GetLastError();
-        jintArray singleResultArray = env->NewIntArray(2);
-        env->SetIntArrayRegion(singleResultArray, 0, 2, returnValues);
-        env->SetObjectArrayElement(returnArray, 0, singleResultArray);
+        pairs[0] = -1;
+        pairs[1] = (jint)GetLastError();
+        returnValue = -1;
     };
-    CloseHandle(overlapped->hEvent);
-    delete overlapped;
+    releaseTransferSlot(slot);
+    return returnValue;
+}
+
+/*
+ * Wait event
+ * portHandle - port handle
+ */
+JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_waitEvents
+  (JNIEnv *env, jobject object, jlong portHandle) {
+    jint pairs[COMM_EVENTS_MAX * 2];
+    jint eventsCount = waitCommEvents((HANDLE)portHandle, pairs);
+    if(eventsCount < 0){
+        eventsCount = 1;//The error pair
+    }
+    jobjectArray returnArray = env->NewObjectArray(eventsCount, getIntArrayClass(), NULL);
+    if(returnArray == NULL){
+        return NULL;
+    }
+    for(jint i = 0; i < eventsCount; i++){
+        jintArray singleResultArray = env->NewIntArray(2);
+        env->SetIntArrayRegion(singleResultArray, 0, 2, &pairs[i * 2]);
+        env->SetObjectArrayElement(returnArray, i, singleResultArray);
+        env->DeleteLocalRef(singleResultArray);
+    }
     return returnArray;
 }
 
+/*
+ * Same as "_waitEvents", but the pairs are stored in the flat "buffer" (event at even,
+ * value at odd indexes) with no allocation (since 2.9.0). The pairs whose value couldn't
+ * be read are left out.
+ *
+ * Returns the bitmask of the stored event types, or -1 if the wait failed.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_waitEventsInto
+  (JNIEnv *env, jobject object, jlong portHandle, jintArray buffer) {
+    jint pairs[COMM_EVENTS_MAX * 2];
+    jint eventsCount = waitCommEvents((HANDLE)portHandle, pairs);
+    if(eventsCount < 0){
+        return -1;
+    }
+    jint maxCount = env->GetArrayLength(buffer) / 2;
+    jint count = 0;
+    jint eventsMask = 0;
+    for(jint i = 0; i < eventsCount && count < maxCount; i++){
+        if(pairs[i * 2] > 0){
+            pairs[count * 2] = pairs[i * 2];
+            pairs[count * 2 + 1] = pairs[i * 2 + 1];
+            eventsMask |= pairs[i * 2];
+            count++;
+        }
+    }
+    if(count > 0){
+        env->SetIntArrayRegion(buffer, 0, count * 2, pairs);
+    }
+    return eventsMask;
+}
+
 /*
  * Get serial port names
+ *
+ * The ports are listed from the device map kept by the serial drivers in the registry,
+ * none of them is opened.
  */
 JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_getSerialPortNames
   (JNIEnv *env, jobject object){
@@ -777,7 +3331,7 @@ JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_getSerialPortName
             }
         }
         if(keysCount > 0){
-            jclass stringClass = env->FindClass("java/lang/String");
+            jclass stringClass = getStringClass();
             returnArray = env->NewObjectArray((jsize)keysCount, stringClass, NULL);
             char lpValueName[256];
             DWORD lpcchValueName;
@@ -789,15 +3343,118 @@ JNIEXPORT jobjectArray JNICALL Java_jssc_SerialNativeInterface_getSerialPortName
                 lpcbData = 256;
                 result = RegEnumValueA(phkResult, i, lpValueName, &lpcchValueName, NULL, NULL, lpData, &lpcbData);
                 if(result == ERROR_SUCCESS){
-                    env->SetObjectArrayElement(returnArray, i, env->NewStringUTF((char*)lpData));
+                    lpData[lpcbData < 256 ? lpcbData : 255] = 0;//since 2.9.0 REG_SZ data may lack the terminator
+                    jstring portName = env->NewStringUTF((char*)lpData);
+                    env->SetObjectArrayElement(returnArray, i, portName);
+                    env->DeleteLocalRef(portName);
                 }
             }
         }
-        CloseHandle(phkResult);
+        RegCloseKey(phkResult);//since 2.9.0 was CloseHandle()
     }
     return returnArray;
 }
 
+/*
+ * Hot-plug watcher (since 2.9.0)
+ *
+ * Waits for serial ports to be added or removed, for the cached port list of
+ * jssc.SerialPortList. The serial drivers add and remove their ports in the device map
+ * of the registry, so RegNotifyChangeKeyValue() on HARDWARE\DEVICEMAP reports them
+ * without a window for WM_DEVICECHANGE. The whole device map is watched, since the
+ * SERIALCOMM key only exists while there is a port.
+ */
+struct PortWatcher {
+    HKEY key;
+    HANDLE changeEvent;         //Auto reset, set by the registry
+    HANDLE wakeupEvent;         //Auto reset
+    bool armed;                 //Set while a notification is requested, only used by the waiting thread
+};
+
+static void freePortWatcher(PortWatcher *watcher) {
+    if (watcher->key != NULL) {
+        RegCloseKey(watcher->key);
+    }
+    if (watcher->changeEvent != NULL) {
+        CloseHandle(watcher->changeEvent);
+    }
+    if (watcher->wakeupEvent != NULL) {
+        CloseHandle(watcher->wakeupEvent);
+    }
+    delete watcher;
+}
+
+/*
+ * Open a watcher, returns its handle or -1 on failure
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_portWatcherOpen
+  (JNIEnv *env, jobject object){
+    PortWatcher *watcher = new (std::nothrow) PortWatcher();
+    if (watcher == NULL) {
+        return -1;
+    }
+    watcher->key = NULL;
+    watcher->armed = false;
+    watcher->changeEvent = CreateEventA(NULL, false, false, NULL);
+    watcher->wakeupEvent = CreateEventA(NULL, false, false, NULL);
+    if (watcher->changeEvent == NULL || watcher->wakeupEvent == NULL ||
+        RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DEVICEMAP", 0, KEY_NOTIFY, &watcher->key) != ERROR_SUCCESS) {
+        watcher->key = NULL;
+        freePortWatcher(watcher);
+        return -1;
+    }
+    return (jlong)(intptr_t)watcher;
+}
+
+/*
+ * Wait for a port to be added or removed. The notification is requested by the waiting
+ * thread and ends with it, so the same thread must do all of the waits.
+ *
+ * timeoutMilliseconds - 0 to return immediately, negative to block indefinitely.
+ *
+ * Returns 1 if the device map has changed, 0 on timeout or wakeup, -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_portWatcherWait
+  (JNIEnv *env, jobject object, jlong watcherHandle, jlong timeoutMilliseconds){
+    PortWatcher *watcher = (PortWatcher*)(intptr_t)watcherHandle;
+    if (!watcher->armed) {
+        if (RegNotifyChangeKeyValue(watcher->key, true, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET,
+                                    watcher->changeEvent, true) != ERROR_SUCCESS) {
+            return -1;
+        }
+        watcher->armed = true;
+    }
+    DWORD waitMillis = (timeoutMilliseconds < 0 ? INFINITE : (timeoutMilliseconds >= (jlong)INFINITE ? INFINITE - 1 : (DWORD)timeoutMilliseconds));
+    HANDLE waitHandles[2] = {watcher->changeEvent, watcher->wakeupEvent};
+    switch (WaitForMultipleObjects(2, waitHandles, false, waitMillis)) {
+        case WAIT_OBJECT_0:
+            watcher->armed = false;
+            return 1;
+        case WAIT_OBJECT_0 + 1:
+        case WAIT_TIMEOUT:
+            return 0;
+    }
+    return -1;
+}
+
+/*
+ * Make the thread waiting in "_portWatcherWait" return
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_portWatcherWakeup
+  (JNIEnv *env, jobject object, jlong watcherHandle){
+    PortWatcher *watcher = (PortWatcher*)(intptr_t)watcherHandle;
+    return (SetEvent(watcher->wakeupEvent) ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Close the watcher, no thread may be waiting in "_portWatcherWait"
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_portWatcherClose
+  (JNIEnv *env, jobject object, jlong watcherHandle){
+    freePortWatcher((PortWatcher*)(intptr_t)watcherHandle);
+    return JNI_TRUE;
+}
+
 /*
  * Get lines status
  *
@@ -834,3 +3491,361 @@ JNIEXPORT jintArray JNICALL Java_jssc_SerialNativeInterface_getLinesStatus
     return returnArray;
 }
 
+/*
+ * SerialPortSelector (since 2.9.0)
+ *
+ * Waits for many ports in a single call using an I/O completion port. Every
+ * registered port has an overlapped WaitCommEvent() pending on the completion port,
+ * so the port's event mask is owned by the selector while it is registered and an
+ * event listener must not be used on the same port.
+ *
+ * A handle stays associated with the completion port until it is closed, so the
+ * completions of the regular overlapped reads and writes on a registered port are
+ * queued too. These are recognized by their OVERLAPPED and dropped.
+ */
+
+//Must match SerialPortSelector.OP_READ and SerialPortSelector.OP_WRITE
+#define SELECTOR_OP_READ    1
+#define SELECTOR_OP_WRITE   4
+
+//Maximum count of ready ports reported by a single selectorSelect() call
+#define SELECTOR_MAX_EVENTS 64
+
+//Completion key of the packets posted by selectorWakeup()
+#define SELECTOR_WAKEUP_KEY ((ULONG_PTR)-1)
+
+struct SelectorRegistration {
+    OVERLAPPED overlapped;          //Must be the first member
+    HANDLE hComm;
+    jint ops;                       //0 once unregistered
+    DWORD eventMask;                //Filled by WaitCommEvent()
+    bool pending;                   //WaitCommEvent() is in progress
+    bool associated;                //hComm is associated with the completion port
+    SelectorRegistration *next;
+};
+
+struct SerialSelector {
+    HANDLE completionPort;
+    CRITICAL_SECTION lock;          //Guards the registrations
+    SelectorRegistration *registrations;
+};
+
+static SelectorRegistration* selectorFind(SerialSelector *selector, HANDLE hComm) {
+    for (SelectorRegistration *reg = selector->registrations; reg != NULL; reg = reg->next) {
+        if (reg->hComm == hComm && reg->ops != 0) {
+            return reg;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Removes and deletes the registrations which were unregistered and have no
+ * WaitCommEvent() in progress any more. Must be called with the lock held.
+ */
+static void selectorPurge(SerialSelector *selector) {
+    SelectorRegistration **link = &selector->registrations;
+    while (*link != NULL) {
+        SelectorRegistration *reg = *link;
+        if (reg->ops == 0 && !reg->pending) {
+            *link = reg->next;
+            delete reg;
+        } else {
+            link = &reg->next;
+        }
+    }
+}
+
+/*
+ * Checks if the port is ready for the operations in its interest set, returns the
+ * ready operations and stores the input buffer bytes count in inputCount.
+ */
+static jint selectorCheckReady(SelectorRegistration *reg, jint *inputCount) {
+    DWORD errors;
+    COMSTAT comstat;
+    jint ready = 0;
+    *inputCount = 0;
+    if (ClearCommError(reg->hComm, &errors, &comstat)) {
+        *inputCount = (jint)comstat.cbInQue;
+        recordCommErrors(reg->hComm, errors);
+        if ((reg->ops & SELECTOR_OP_READ) && comstat.cbInQue > 0) {
+            ready |= SELECTOR_OP_READ;
+        }
+        if ((reg->ops & SELECTOR_OP_WRITE) && comstat.cbOutQue == 0) {
+            ready |= SELECTOR_OP_WRITE;
+        }
+    } else if (reg->ops & SELECTOR_OP_READ) {
+        //Report broken ports as readable, the following read reports the error
+        ready |= SELECTOR_OP_READ;
+    }
+    return ready;
+}
+
+/*
+ * Starts the overlapped WaitCommEvent() of the registration unless it is already in
+ * progress. Must be called with the lock held.
+ */
+static void selectorArm(SelectorRegistration *reg) {
+    if (reg->pending) {
+        return;
+    }
+    DWORD mask = ((reg->ops & SELECTOR_OP_READ) ? EV_RXCHAR | EV_ERR : 0) | ((reg->ops & SELECTOR_OP_WRITE) ? EV_TXEMPTY : 0);
+    SetCommMask(reg->hComm, mask);
+    ZeroMemory(&reg->overlapped, sizeof(OVERLAPPED));
+    reg->eventMask = 0;
+    BOOL result = WaitCommEvent(reg->hComm, &reg->eventMask, &reg->overlapped);
+    //A completion packet is queued even if the wait completes right away
+    reg->pending = (result || GetLastError() == ERROR_IO_PENDING);
+}
+
+/*
+ * Open a new selector
+ *
+ * Returns the selector handle, or -1 if the selector couldn't be created.
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_selectorOpen
+  (JNIEnv *env, jobject object){
+    HANDLE completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (completionPort == NULL) {
+        return -1;
+    }
+    SerialSelector *selector = new SerialSelector();
+    selector->completionPort = completionPort;
+    InitializeCriticalSection(&selector->lock);
+    selector->registrations = NULL;
+    return (jlong)selector;
+}
+
+/*
+ * Register a port with the selector, or change the interest set of a port which is
+ * already registered. ops is a combination of SELECTOR_OP_READ and SELECTOR_OP_WRITE.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorRegister
+  (JNIEnv *env, jobject object, jlong selectorHandle, jlong portHandle, jint ops){
+    SerialSelector *selector = (SerialSelector*)selectorHandle;
+    HANDLE hComm = (HANDLE)portHandle;
+    jboolean returnValue = JNI_TRUE;
+    if (ops == 0) {
+        return JNI_FALSE;
+    }
+    EnterCriticalSection(&selector->lock);
+    SelectorRegistration *reg = selectorFind(selector, hComm);
+    if (reg != NULL) {
+        reg->ops = ops;
+        if (reg->pending) {
+            //Restart the wait with the new event mask
+            SetCommMask(hComm, 0);
+        }
+    } else {
+        bool associated = false;
+        //A handle can only be associated once, look for a previous registration
+        for (SelectorRegistration *old = selector->registrations; old != NULL; old = old->next) {
+            if (old->hComm == hComm && old->associated) {
+                associated = true;
+            }
+        }
+        if (!associated && CreateIoCompletionPort(hComm, selector->completionPort, (ULONG_PTR)hComm, 0) == NULL) {
+            returnValue = JNI_FALSE;
+        } else {
+            reg = new SelectorRegistration();
+            ZeroMemory(&reg->overlapped, sizeof(OVERLAPPED));
+            reg->hComm = hComm;
+            reg->ops = ops;
+            reg->eventMask = 0;
+            reg->pending = false;
+            reg->associated = true;
+            reg->next = selector->registrations;
+            selector->registrations = reg;
+        }
+    }
+    LeaveCriticalSection(&selector->lock);
+    if (returnValue) {
+        //Let a waiting thread arm the new registration
+        PostQueuedCompletionStatus(selector->completionPort, 0, SELECTOR_WAKEUP_KEY, NULL);
+    }
+    return returnValue;
+}
+
+/*
+ * Remove a port from the selector
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorUnregister
+  (JNIEnv *env, jobject object, jlong selectorHandle, jlong portHandle){
+    SerialSelector *selector = (SerialSelector*)selectorHandle;
+    HANDLE hComm = (HANDLE)portHandle;
+    EnterCriticalSection(&selector->lock);
+    SelectorRegistration *reg = selectorFind(selector, hComm);
+    if (reg != NULL) {
+        reg->ops = 0;
+        if (reg->pending) {
+            //Completes the pending WaitCommEvent(), the registration is deleted when its packet is dequeued
+            SetCommMask(hComm, 0);
+        }
+    }
+    selectorPurge(selector);
+    LeaveCriticalSection(&selector->lock);
+    return (reg != NULL ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Wait until at least one of the registered ports is ready, the timeout expires or
+ * selectorWakeup() is called.
+ *
+ * For each ready port, its handle is stored in portHandles, the ready operations in
+ * readyOps and the count of bytes in its input buffer in inputCounts. At most
+ * length of portHandles ports are reported.
+ *
+ * timeoutMilliseconds - 0 to return immediately, negative to block indefinitely.
+ *
+ * Returns the count of ready ports (0 on timeout or wakeup), or -1 on error.
+ */
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_selectorSelect
+  (JNIEnv *env, jobject object, jlong selectorHandle, jlongArray portHandles, jintArray readyOps,
+    jintArray inputCounts, jlong timeoutMilliseconds){
+    SerialSelector *selector = (SerialSelector*)selectorHandle;
+    jlong handles[SELECTOR_MAX_EVENTS];
+    jint ops[SELECTOR_MAX_EVENTS];
+    jint counts[SELECTOR_MAX_EVENTS];
+    jint maxReady = env->GetArrayLength(portHandles);
+    jint readyCount = 0;
+    jlong timeoutDeadline = getTimePreciseMicros() + timeoutMilliseconds*1000;
+    DWORD waitMillis = (timeoutMilliseconds < 0 ? INFINITE : (DWORD)timeoutMilliseconds);
+    if (maxReady > SELECTOR_MAX_EVENTS) {
+        maxReady = SELECTOR_MAX_EVENTS;
+    }
+
+    while (true) {
+        //Report the ports which are already ready, arm the others
+        EnterCriticalSection(&selector->lock);
+        for (SelectorRegistration *reg = selector->registrations; reg != NULL && readyCount < maxReady; reg = reg->next) {
+            if (reg->ops == 0) {
+                continue;
+            }
+            jint ready = selectorCheckReady(reg, &counts[readyCount]);
+            if (ready != 0) {
+                handles[readyCount] = (jlong)reg->hComm;
+                ops[readyCount] = ready;
+                readyCount++;
+            } else {
+                selectorArm(reg);
+            }
+        }
+        LeaveCriticalSection(&selector->lock);
+        if (readyCount > 0) {
+            break;
+        }
+
+        DWORD bytesTransferred;
+        ULONG_PTR completionKey;
+        OVERLAPPED *overlapped = NULL;
+        BOOL dequeued = GetQueuedCompletionStatus(selector->completionPort, &bytesTransferred, &completionKey, &overlapped, waitMillis);
+        if (!dequeued && overlapped == NULL) {
+            //Timeout, or the completion port is broken
+            break;
+        }
+        if (completionKey == SELECTOR_WAKEUP_KEY) {
+            break;
+        }
+        //Only the completions of our own WaitCommEvent() calls are of interest
+        EnterCriticalSection(&selector->lock);
+        for (SelectorRegistration *reg = selector->registrations; reg != NULL; reg = reg->next) {
+            if (&reg->overlapped == overlapped) {
+                reg->pending = false;
+                break;
+            }
+        }
+        selectorPurge(selector);
+        LeaveCriticalSection(&selector->lock);
+
+        if (waitMillis != INFINITE) {
+            jlong remains = timeoutDeadline - getTimePreciseMicros();
+            waitMillis = (remains > 0 ? (DWORD)(remains / 1000) : 0);
+        }
+    }
+
+    if (readyCount > 0) {
+        env->SetLongArrayRegion(portHandles, 0, readyCount, handles);
+        env->SetIntArrayRegion(readyOps, 0, readyCount, ops);
+        env->SetIntArrayRegion(inputCounts, 0, readyCount, counts);
+    }
+    return readyCount;
+}
+
+/*
+ * Unblock the thread waiting in selectorSelect(), or make the next call return
+ * immediately if no thread is waiting.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorWakeup
+  (JNIEnv *env, jobject object, jlong selectorHandle){
+    SerialSelector *selector = (SerialSelector*)selectorHandle;
+    return (PostQueuedCompletionStatus(selector->completionPort, 0, SELECTOR_WAKEUP_KEY, NULL) ? JNI_TRUE : JNI_FALSE);
+}
+
+/*
+ * Close the selector. The registered ports are not closed.
+ */
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_selectorClose
+  (JNIEnv *env, jobject object, jlong selectorHandle){
+    SerialSelector *selector = (SerialSelector*)selectorHandle;
+    EnterCriticalSection(&selector->lock);
+    jint pendingCount = 0;
+    for (SelectorRegistration *reg = selector->registrations; reg != NULL; reg = reg->next) {
+        reg->ops = 0;
+        if (reg->pending) {
+            SetCommMask(reg->hComm, 0);
+            pendingCount++;
+        }
+    }
+    LeaveCriticalSection(&selector->lock);
+    //The OVERLAPPED structures must stay valid until the cancelled waits complete
+    while (pendingCount > 0) {
+        DWORD bytesTransferred;
+        ULONG_PTR completionKey;
+        OVERLAPPED *overlapped = NULL;
+        if (!GetQueuedCompletionStatus(selector->completionPort, &bytesTransferred, &completionKey, &overlapped, 1000) && overlapped == NULL) {
+            break;
+        }
+        for (SelectorRegistration *reg = selector->registrations; reg != NULL; reg = reg->next) {
+            if (&reg->overlapped == overlapped && reg->pending) {
+                reg->pending = false;
+                pendingCount--;
+            }
+        }
+    }
+    if (pendingCount == 0) {
+        selectorPurge(selector);
+    }
+    //else leak the registrations, the kernel may still write into them
+    CloseHandle(selector->completionPort);
+    DeleteCriticalSection(&selector->lock);
+    if (pendingCount == 0) {
+        delete selector;
+    }
+    return JNI_TRUE;
+}
+
+/*
+ * Event waiter (since 2.9.0)
+ *
+ * Only used by the event thread of the POSIX platforms, on Windows the event thread
+ * blocks in WaitCommEvent() (see "_waitEvents").
+ */
+JNIEXPORT jlong JNICALL Java_jssc_SerialNativeInterface_eventWaiterOpen
+  (JNIEnv *env, jobject object, jlong portHandle){
+    return -1;
+}
+
+JNIEXPORT jint JNICALL Java_jssc_SerialNativeInterface_eventWaiterWait
+  (JNIEnv *env, jobject object, jlong waiterHandle, jintArray buffer){
+    return -1;
+}
+
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_eventWaiterCancel
+  (JNIEnv *env, jobject object, jlong waiterHandle){
+    return JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_jssc_SerialNativeInterface_eventWaiterClose
+  (JNIEnv *env, jobject object, jlong waiterHandle){
+    return JNI_FALSE;
+}
@@ -0,0 +1,131 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ */
+package jssc;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Checksums of the usual serial framing protocols, computed by the native library.
+ * The same types are used to validate frames natively, see
+ * {@link SerialPort#setFrameChecksum(int)}.
+ * <br>
+ * In a frame the checksum is stored low byte first for {@link #CRC16_MODBUS} and
+ * {@link #CRC32}, high byte first for {@link #CRC16_CCITT}.
+ *
+ * @since 2.9.0
+ */
+public final class SerialChecksum {
+
+    /**
+     * No checksum
+     */
+    public static final int NONE = 0;
+    /**
+     * CRC-16 of Modbus RTU: reflected polynomial 0x8005, initial value 0xFFFF
+     */
+    public static final int CRC16_MODBUS = 1;
+    /**
+     * CRC-16 CCITT (CCITT-FALSE): polynomial 0x1021, initial value 0xFFFF
+     */
+    public static final int CRC16_CCITT = 2;
+    /**
+     * CRC-32 as used by zlib and Ethernet
+     */
+    public static final int CRC32 = 3;
+
+    private static final SerialNativeInterface serialInterface = new SerialNativeInterface();
+
+    private SerialChecksum() {
+    }
+
+    /**
+     * Getting the size of a checksum
+     *
+     * @param type one of the checksum types
+     *
+     * @return size in bytes of a checksum of this type, 0 for {@link #NONE}
+     */
+    public static int getSize(int type) {
+        switch(type){
+            case CRC16_MODBUS:
+            case CRC16_CCITT:
+                return 2;
+            case CRC32:
+                return 4;
+        }
+        return 0;
+    }
+
+    /**
+     * Compute the checksum of a region of an array
+     *
+     * @param type {@link #CRC16_MODBUS}, {@link #CRC16_CCITT} or {@link #CRC32}
+     * @param buffer array holding the bytes
+     * @param offset index in buffer of the first byte
+     * @param length count of bytes
+     *
+     * @return the checksum as an unsigned value
+     *
+     * @throws SerialPortException if a parameter is not correct
+     */
+    public static long compute(int type, byte[] buffer, int offset, int length) throws SerialPortException {
+        if(buffer == null){
+            throw new SerialPortException("SerialChecksum", "compute()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(getSize(type) == 0 || offset < 0 || length < 0 || length > buffer.length - offset){
+            throw new SerialPortException("SerialChecksum", "compute()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        return serialInterface.checksum(type, buffer, offset, length);
+    }
+
+    /**
+     * Compute the checksum of the remaining bytes of a {@link ByteBuffer}. The position
+     * of the buffer is not changed.
+     *
+     * @param type {@link #CRC16_MODBUS}, {@link #CRC16_CCITT} or {@link #CRC32}
+     * @param buffer buffer holding the bytes
+     *
+     * @return the checksum as an unsigned value
+     *
+     * @throws SerialPortException if a parameter is not correct
+     */
+    public static long compute(int type, ByteBuffer buffer) throws SerialPortException {
+        if(buffer == null){
+            throw new SerialPortException("SerialChecksum", "compute()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(getSize(type) == 0){
+            throw new SerialPortException("SerialChecksum", "compute()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(buffer.isDirect()){
+            return serialInterface.checksumBuffer(type, buffer, buffer.position(), buffer.remaining());
+        }
+        if(buffer.hasArray()){
+            return serialInterface.checksum(type, buffer.array(), buffer.arrayOffset() + buffer.position(), buffer.remaining());
+        }
+        byte[] data = new byte[buffer.remaining()];
+        buffer.duplicate().get(data);
+        return serialInterface.checksum(type, data, 0, data.length);
+    }
+}
@@ -13,6 +13,12 @@ import java.io.InputStream;
  * instance.  Do not create multiple streams for the 
  * same serial port unless you implement your own
  * synchronization.
+ * <br>
+ * The reads and the writes of a port are independent: a
+ * {@link SerialInputStream} and a {@link SerialOutputStream}
+ * of the same port can be used by two threads at the same
+ * time, and {@link SerialPort#closePort()} from a third thread
+ * makes their blocked calls fail (since 2.9.0).
  * @author Charles Hache <chalz@member.fsf.org>
  *
  */
@@ -20,10 +26,12 @@ public class SerialInputStream extends InputStream {
 	
 	private SerialPort serialPort;
 	private int defaultTimeout = 0;
+	private final byte[] singleByte = new byte[1];
 
 	/** Instantiates a SerialInputStream for the given {@link SerialPort}
 	 * Do not create multiple streams for the same serial port
-	 * unless you implement your own synchronization.
+	 * unless you implement your own synchronization, a single
+	 * SerialOutputStream may be used alongside it.
 	 * @param sp The serial port to stream.
 	 */
 	public SerialInputStream(SerialPort sp) {
@@ -63,11 +71,10 @@ public class SerialInputStream extends InputStream {
 	 * @throws IOException On serial port error or timeout
 	 */
 	public int read(int timeout) throws IOException {
-		byte[] data = serialPort.readBytes(1, timeout);
-		if (data.length==0) {
+		if (serialPort.readBytesWithTimeout(singleByte, 0, 1, timeout, true) == 0) {
 			throw new SerialPortTimeoutException(serialPort.getPortName(), "read(int timeout)", timeout);
 		}
-		return data[0];
+		return singleByte[0];
 	}
 	
 	/** Non-blocking read of up to buf.length bytes from the stream.
@@ -96,9 +103,7 @@ public class SerialInputStream extends InputStream {
 		if (buf.length < offset + length)
 			length = buf.length - offset;
 		
-		byte[] readBuf = serialPort.readBytesWithTimeout(length, 0, false);
-		System.arraycopy(readBuf, 0, buf, offset, readBuf.length);
-		return readBuf.length;
+		return serialPort.readAvailable(buf, offset, length);
 	}
 	
 	/** Blocks until buf.length bytes are read, an error occurs, or the default timeout is hit (if specified).
@@ -147,9 +152,7 @@ public class SerialInputStream extends InputStream {
 		if (buf.length < offset + length)
 			throw new IOException("Not enough buffer space for serial data");
 		
-		byte[] readBuf = serialPort.readBytesWithTimeout(length, timeout, true);
-		System.arraycopy(readBuf, 0, buf, offset, readBuf.length);
-		return readBuf.length;
+		return serialPort.readBytesWithTimeout(buf, offset, length, timeout, true);
 	}
 	
 	@Override
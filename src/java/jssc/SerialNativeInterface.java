@@ -29,6 +29,7 @@ import java.io.File;
 import java.io.FileOutputStream;
 import java.io.InputStream;
 import java.io.InputStreamReader;
+import java.nio.ByteBuffer;
 
 /**
  *
@@ -348,6 +349,56 @@ public class SerialNativeInterface {
      */
     public native boolean closePort(long handle);
 
+    /**
+     * Cancel the reads and writes blocked on a port, they fail with a
+     * {@link SerialPortException} of type {@link SerialPortException#TYPE_IO_CANCELLED}
+     *
+     * @param handle handle of opened port
+     *
+     * @return true if a read or write was in progress
+     *
+     * @since 2.9.0
+     */
+    public native boolean cancelIO(long handle);
+
+    /**
+     * Get the counters of the reads and writes of a port
+     *
+     * @param handle handle of opened port
+     * @param reset start the counters again from 0
+     *
+     * @return the counters in the order of {@link SerialPortStatistics}, null if the
+     * port is not opened
+     *
+     * @since 2.9.0
+     */
+    public native long[] getStatistics(long handle, boolean reset);
+
+    /**
+     * Start copying the bytes read from and written to a port into a memory-mapped
+     * ring file
+     *
+     * @param handle handle of opened port
+     * @param fileName path of the capture file, created or truncated
+     * @param capacity size of the ring in bytes, rounded up to a power of two
+     *
+     * @return false if the port already has a capture or the file can't be created
+     *
+     * @since 2.9.0
+     */
+    public native boolean captureStart(long handle, String fileName, long capacity);
+
+    /**
+     * Stop the capture of a port and close its file
+     *
+     * @param handle handle of opened port
+     *
+     * @return false if the port had no capture
+     *
+     * @since 2.9.0
+     */
+    public native boolean captureStop(long handle);
+
     /**
      * Set events mask
      *
@@ -377,6 +428,20 @@ public class SerialNativeInterface {
      */
     public native int[][] waitEvents(long handle);
 
+    /**
+     * Same as {@link #waitEvents(long)}, but the event and value of each pair are stored
+     * in <b>buffer</b> at indexes 2 * i and 2 * i + 1, so no array is allocated. The
+     * event types are distinct flags, <code>Integer.bitCount(result)</code> pairs are stored.
+     *
+     * @param handle handle of opened port
+     * @param buffer array to store the pairs in, with room for 11 pairs at least
+     *
+     * @return bitmask of the stored event types, or -1 if the wait failed
+     *
+     * @since 2.9.0
+     */
+    public native int waitEventsInto(long handle, int[] buffer);
+
     /**
      * Change RTS line state
      * 
@@ -397,6 +462,36 @@ public class SerialNativeInterface {
      */
     public native boolean setDTR(long handle, boolean value);
 
+    /**
+     * Change RTS, DTR and break and read the modem lines in one call
+     *
+     * @param handle handle of opened port
+     * @param mask the <b>SerialPort.LINE_RTS</b>, <b>LINE_DTR</b> and <b>LINE_BREAK</b>
+     * bits of the lines to change
+     * @param values the new states of the lines of mask, a set bit is <b>ON</b>
+     *
+     * @return the <b>SerialPort.LINE_*</b> bits of the lines which are <b>ON</b> after the
+     * change, -1 on error
+     *
+     * @since 2.9.0
+     */
+    public native int setLines(long handle, int mask, int values);
+
+    /**
+     * Switch the RS-485 direction control of a port
+     *
+     * @param handle handle of opened port
+     * @param enabled <b>true</b> to switch RTS with the transmitter
+     * @param rtsOnSend <b>true</b> to hold RTS <b>ON</b> while sending, <b>false</b> to hold it <b>OFF</b>
+     * @param delayBeforeSendMillis delay between switching RTS and the first byte
+     * @param delayAfterSendMillis delay between the last byte and switching RTS back
+     *
+     * @return the <b>SerialPort.RS485_MODE_*</b> in use, -1 on error
+     *
+     * @since 2.9.0
+     */
+    public native int setRS485(long handle, boolean enabled, boolean rtsOnSend, int delayBeforeSendMillis, int delayAfterSendMillis);
+
     /**
      * Read data from port
      * 
@@ -422,7 +517,101 @@ public class SerialNativeInterface {
      * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
      * @throws SerialPortException on read error (eg: port closed or other misc errors)
      */
-    public native byte[] readBytes(long handle, int byteCount, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout) 
+    public native byte[] readBytes(long handle, int byteCount, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Read data from port into a region of a caller supplied array. Same behaviour as
+     * {@link #readBytes(long, int, long, long, boolean)}, but no array is allocated.
+     *
+     * @param handle handle of opened port
+     * @param buffer array to store the read bytes in
+     * @param offset index in buffer of the first byte to store
+     * @param byteCount number of bytes to block and wait for. If timeoutMilliseconds is 0,
+     * then immediately returns with at most byteCount bytes (possibly 0).
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
+     * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param pollPeriodMillis how often to check if the thread has been interrupted. Set
+     * to 0 to disable periodic polling of the thread interrupt status.
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException if the timeout expires
+     * before byteCount bytes are read, otherwise return the count of bytes already read.
+     *
+     * @return number of bytes read
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException on read error or if the region is out of the array bounds
+     *
+     * @since 2.9.0
+     */
+    public native int readBytesToArray(long handle, byte[] buffer, int offset, int byteCount, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Read whatever is available in the input buffer of the port into a region of an
+     * existing array, without waiting. The whole backlog, at most <b>maxLength</b> bytes,
+     * is read in a single call.
+     *
+     * @param handle handle of opened port
+     * @param buffer array to store the read bytes in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum number of bytes to read
+     *
+     * @return number of bytes read, possibly 0
+     * @throws SerialPortException on read error or if the region is out of the array bounds
+     *
+     * @since 2.9.0
+     */
+    public native int readAvailable(long handle, byte[] buffer, int offset, int maxLength) throws SerialPortException;
+
+    /**
+     * Read a packet delimited by line idle into a region of an existing array: waits for
+     * the first byte, then returns as soon as no byte has been received for
+     * <b>idleMicros</b> microseconds or maxLength bytes have been read.
+     *
+     * @param handle handle of opened port
+     * @param buffer array to store the read bytes in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum number of bytes to read
+     * @param idleMicros idle time of the line ending a packet, in microseconds. Rounded
+     * up to milliseconds on Windows
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the first byte.
+     * Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param pollPeriodMillis how often to check if the thread has been interrupted
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException on timeout
+     *
+     * @return number of bytes read, 0 on timeout
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException on read error or if the region is out of the array bounds
+     *
+     * @since 2.9.0
+     */
+    public native int readBytesUntilIdle(long handle, byte[] buffer, int offset, int maxLength, long idleMicros,
+            long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Read data from port into a direct {@link ByteBuffer}. Same behaviour as
+     * {@link #readBytesToArray(long, byte[], int, int, long, long, boolean)}, the data
+     * is stored starting at the absolute index <b>position</b>. The position of the buffer
+     * is not changed.
+     *
+     * @param handle handle of opened port
+     * @param buffer direct buffer to store the read bytes in
+     * @param position index in buffer of the first byte to store
+     * @param byteCount number of bytes to block and wait for
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount bytes
+     * @param pollPeriodMillis how often to check if the thread has been interrupted
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException on timeout
+     *
+     * @return number of bytes read
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException on read error or if the buffer is not direct
+     *
+     * @since 2.9.0
+     */
+    public native int readBytesToBuffer(long handle, ByteBuffer buffer, int position, int byteCount, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
             throws InterruptedException, SerialPortTimeoutException, SerialPortException;
 
     /**
@@ -435,6 +624,100 @@ public class SerialNativeInterface {
      */
     public native boolean writeBytes(long handle, byte[] buffer);
 
+    /**
+     * Write data to port from a region of an array. Partial writes are continued until
+     * all of the data has been accepted by the driver, or the timeout expires.
+     *
+     * @param handle handle of opened port
+     * @param buffer array holding the bytes to write
+     * @param offset index in buffer of the first byte to write
+     * @param byteCount number of bytes to write
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the port to
+     * accept the data. Set to 0 to write only what can be written immediately. If negative,
+     * blocks indefinitely.
+     * @param pollPeriodMillis how often to check if the thread has been interrupted. Set
+     * to 0 to disable periodic polling of the thread interrupt status.
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException if the timeout expires
+     * before byteCount bytes are written, otherwise return the count of bytes already written.
+     *
+     * @return number of bytes written, or -1 on error
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException if the region is out of the array bounds
+     *
+     * @since 2.9.0
+     */
+    public native int writeBytesFromArray(long handle, byte[] buffer, int offset, int byteCount, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Write data to port from a direct {@link ByteBuffer}. Same behaviour as
+     * {@link #writeBytesFromArray(long, byte[], int, int, long, long, boolean)}, the data
+     * is taken starting at the absolute index <b>position</b>. The position of the buffer
+     * is not changed.
+     *
+     * @param handle handle of opened port
+     * @param buffer direct buffer holding the bytes to write
+     * @param position index in buffer of the first byte to write
+     * @param byteCount number of bytes to write
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the port to accept the data
+     * @param pollPeriodMillis how often to check if the thread has been interrupted
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException on timeout
+     *
+     * @return number of bytes written, or -1 on error
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException if the buffer is not direct or the region is out of its bounds
+     *
+     * @since 2.9.0
+     */
+    public native int writeBytesFromBuffer(long handle, ByteBuffer buffer, int position, int byteCount, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Write data to port from several buffers in one call. Same behaviour as
+     * {@link #writeBytesFromArray(long, byte[], int, int, long, long, boolean)}, the
+     * regions are written in order as one continuous stream. Each element of
+     * <b>buffers</b> is either a direct {@link ByteBuffer} or a <b>byte[]</b>. On
+     * Linux and Mac OS X the regions are written by a single writev() call, on Windows
+     * they are gathered into one block written by a single WriteFile() call.
+     *
+     * @param handle handle of opened port
+     * @param buffers direct buffers or byte arrays holding the bytes to write, at most 16
+     * @param offsets index in each buffer of the first byte to write
+     * @param counts number of bytes to write from each buffer
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the port to accept the data
+     * @param pollPeriodMillis how often to check if the thread has been interrupted
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException on timeout
+     *
+     * @return total number of bytes written, or -1 on error
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException if an element is of the wrong type or a region is out of its bounds
+     *
+     * @since 2.9.0
+     */
+    public native int writeBytesGather(long handle, Object[] buffers, int[] offsets, int[] counts, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Wait until all of the data written to a port has been sent
+     *
+     * @param handle handle of opened port
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait. Set to 0 to
+     * only check, if negative, blocks indefinitely.
+     * @param pollPeriodMillis how often to check if the thread has been interrupted. Set
+     * to 0 to disable periodic polling of the thread interrupt status.
+     *
+     * @return 1 when the data has been sent, 0 if the timeout expired, -1 on error
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortException if the wait is cancelled
+     *
+     * @since 2.9.0
+     */
+    public native int drainPort(long handle, long timeoutMilliseconds, long pollPeriodMillis)
+            throws InterruptedException, SerialPortException;
+
     /**
      * Get bytes count in buffers of port
      *
@@ -472,9 +755,11 @@ public class SerialNativeInterface {
     public native int getFlowControlMode(long handle);
 
     /**
-     * Get serial port names like an array of String
+     * Get serial port names like an array of String. Since 2.9.0 the names are the
+     * device paths on Linux and Mac OS X, none of the ports is opened.
      *
-     * @return unsorted array of String with port names
+     * @return unsorted array of String with port names, or null if the system has no
+     * native enumeration (the ports are then searched in /dev)
      */
     public native String[] getSerialPortNames();
 
@@ -501,4 +786,371 @@ public class SerialNativeInterface {
      * @since 0.8
      */
     public native boolean sendBreak(long handle, int duration);
+
+    /**
+     * Enable or disable the low latency mode of the port: ASYNC_LOW_LATENCY and the
+     * latency timer of FTDI adapters on Linux, the receive latency on Mac OS X
+     *
+     * @param handle handle of opened port
+     * @param enabled true to enable the low latency mode
+     *
+     * @return combination of {@link SerialPort#LOW_LATENCY_ASYNC_FLAG} and
+     * {@link SerialPort#LOW_LATENCY_TIMER} telling what could be applied
+     *
+     * @since 2.9.0
+     */
+    public native int setLowLatency(long handle, boolean enabled);
+
+    /**
+     * Apply the parameters of {@link #setParams(long, int, int, int, int, boolean, boolean, int)},
+     * the flow control mode and optionally the low latency mode in a single call, leaving
+     * RTS and DTR untouched
+     *
+     * @param handle handle of opened port
+     * @param baudRate data transfer rate
+     * @param dataBits number of data bits
+     * @param stopBits number of stop bits, in the native encoding of setParams
+     * @param parity parity
+     * @param flowControlMask combination of the <b>FLOWCONTROL_</b> values of {@link SerialPort}
+     * @param flags the flags of setParams, plus 4 to enable or 8 to disable the low
+     * latency mode (neither keeps it)
+     *
+     * @return true if the settings have been applied, or if they were already
+     *
+     * @since 2.9.0
+     */
+    public native boolean configure(long handle, int baudRate, int dataBits, int stopBits, int parity, int flowControlMask, int flags);
+
+    /**
+     * Create a native selector, used to wait for many ports in one call
+     *
+     * @return handle of the selector, or -1 if it couldn't be created
+     *
+     * @since 2.9.0
+     */
+    public native long selectorOpen();
+
+    /**
+     * Register a port with a selector, or change the operations of interest of a port
+     * which is already registered
+     *
+     * @param selector handle of the selector
+     * @param handle handle of opened port
+     * @param ops combination of {@link SerialPortSelector#OP_READ} and {@link SerialPortSelector#OP_WRITE}
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean selectorRegister(long selector, long handle, int ops);
+
+    /**
+     * Remove a port from a selector
+     *
+     * @param selector handle of the selector
+     * @param handle handle of the port
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean selectorUnregister(long selector, long handle);
+
+    /**
+     * Wait until at least one of the registered ports is ready, the timeout expires
+     * or {@link #selectorWakeup(long)} is called. The handles of the ready ports are
+     * stored in <b>handles</b>, the ready operations in <b>readyOps</b> and the bytes
+     * count of their input buffers in <b>inputCounts</b>.
+     *
+     * @param selector handle of the selector
+     * @param handles array to store the handles of the ready ports in, its length is
+     * the maximum count of ports reported
+     * @param readyOps array to store the ready operations in
+     * @param inputCounts array to store the input buffer bytes counts in
+     * @param timeoutMilliseconds the maximum time to wait. Set to 0 to return immediately.
+     * If negative, blocks indefinitely.
+     *
+     * @return count of ready ports, or -1 on error
+     *
+     * @since 2.9.0
+     */
+    public native int selectorSelect(long selector, long[] handles, int[] readyOps, int[] inputCounts, long timeoutMilliseconds);
+
+    /**
+     * Unblock a thread waiting in {@link #selectorSelect(long, long[], int[], int[], long)}
+     *
+     * @param selector handle of the selector
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean selectorWakeup(long selector);
+
+    /**
+     * Close a selector. The registered ports are not closed.
+     *
+     * @param selector handle of the selector
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean selectorClose(long selector);
+
+    /**
+     * Create a native event waiter for a port, used by the event thread on Linux,
+     * Solaris and Mac OS X instead of polling {@link #waitEvents(long)}. Only one
+     * waiter may be created for a port.
+     *
+     * @param handle handle of opened port
+     *
+     * @return handle of the waiter, or -1 if it couldn't be created
+     *
+     * @since 2.9.0
+     */
+    public native long eventWaiterOpen(long handle);
+
+    /**
+     * Wait until one of the events of the mask set by {@link #setEventsMask(long, int)}
+     * occurs. The events are stored in <b>buffer</b> as by {@link #waitEventsInto(long, int[])},
+     * with the types and values of {@link SerialPortEvent}.
+     *
+     * @param waiter handle of the waiter
+     * @param buffer array to store the pairs in
+     *
+     * @return bitmask of the stored event types, 0 if the wait has been cancelled, or
+     * -1 if the port can't be waited for anymore
+     *
+     * @since 2.9.0
+     */
+    public native int eventWaiterWait(long waiter, int[] buffer);
+
+    /**
+     * Unblock the thread waiting in {@link #eventWaiterWait(long, int)}. All of the next
+     * waits return immediately.
+     *
+     * @param waiter handle of the waiter
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean eventWaiterCancel(long waiter);
+
+    /**
+     * Destroy an event waiter. No thread may be waiting on it.
+     *
+     * @param waiter handle of the waiter
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean eventWaiterClose(long waiter);
+
+    /**
+     * Enable the buffered mode of a port: a native thread drains the input buffer of the
+     * port continuously into a ring, from which all of the readBytes* functions take the
+     * data. The ring is created by the first call, with at least <b>capacity</b> bytes
+     * (rounded up to a power of two), and kept until the port is closed.
+     *
+     * @param handle handle of opened port
+     * @param capacity requested size of the ring in bytes
+     *
+     * @return If the reader thread is running, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean bufferedReaderStart(long handle, int capacity);
+
+    /**
+     * Disable the buffered mode of a port. The data already in the ring is read before
+     * the input buffer of the port.
+     *
+     * @param handle handle of opened port
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean bufferedReaderStop(long handle);
+
+    /**
+     * Set the scheduling of the reader thread of the buffered mode. The settings are kept
+     * until the port is closed and applied to every reader thread started later.
+     *
+     * @param handle handle of opened port
+     * @param cpuMask CPUs the thread may run on, bit n for CPU n, or 0 for the CPUs of
+     * the process
+     * @param priority realtime priority 1..99 (SCHED_FIFO, THREAD_PRIORITY_TIME_CRITICAL
+     * on Windows) or 0 for the normal scheduling
+     * @param lockMemory true to lock the ring in memory, false to unlock it
+     *
+     * @return combination of {@link SerialPort#SCHEDULING_AFFINITY},
+     * {@link SerialPort#SCHEDULING_PRIORITY} and {@link SerialPort#SCHEDULING_MEMORY_LOCKED}
+     * telling what could be applied at once
+     *
+     * @since 2.9.0
+     */
+    public native int setReaderScheduling(long handle, long cpuMask, int priority, boolean lockMemory);
+
+    /**
+     * Set the scheduling of the calling thread, see {@link #setReaderScheduling(long, long, int, boolean)}
+     *
+     * @param cpuMask CPUs the thread may run on, bit n for CPU n, or 0 for the CPUs of
+     * the process
+     * @param priority realtime priority 1..99 or 0 for the normal scheduling
+     *
+     * @return combination of {@link SerialPort#SCHEDULING_AFFINITY} and
+     * {@link SerialPort#SCHEDULING_PRIORITY} telling what could be applied
+     *
+     * @since 2.9.0
+     */
+    public native int setThreadScheduling(long cpuMask, int priority);
+
+    /**
+     * Read a frame ending with <b>delimiter</b> into a region of an existing array. The
+     * frame is searched in the native input ring of the port, which is created by the
+     * first framed read if the port is not in buffered mode; the bytes received past the
+     * end of the frame are kept there for the next read.
+     *
+     * @param handle handle of opened port
+     * @param delimiter bytes ending a frame, 1 to 64 bytes
+     * @param buffer array to store the frame in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum length of a frame, delimiter included. If no delimiter
+     * is found within maxLength bytes (or the size of the ring), these bytes are
+     * returned as they are
+     * @param checksumType one of the types of {@link SerialChecksum}. If not
+     * {@link SerialChecksum#NONE}, each frame ends with a checksum followed by the
+     * delimiter, and the frames with a wrong checksum are dropped
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for a frame.
+     * Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param pollPeriodMillis how often to check if the thread has been interrupted
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException on timeout
+     *
+     * @return length of the frame, or 0 on timeout. The bytes of an incomplete frame are
+     * kept for the next read
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException on read error or if a parameter is not correct
+     *
+     * @since 2.9.0
+     */
+    public native int readUntil(long handle, byte[] delimiter, byte[] buffer, int offset, int maxLength, int checksumType,
+            long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Read a frame starting with a header which holds the length of the frame data into
+     * a region of an existing array. Same behaviour as
+     * {@link #readUntil(long, byte[], byte[], int, int, int, long, long, boolean)}.
+     *
+     * @param handle handle of opened port
+     * @param buffer array to store the frame in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum length of a frame, header included
+     * @param headerLength length of the header, the length field included
+     * @param lengthFieldOffset index of the length field in the header
+     * @param lengthFieldSize size of the length field, 1 to 4 bytes. The field is the
+     * unsigned count of bytes following the header
+     * @param bigEndian true if the most significant byte of the length field comes first
+     * @param checksumType one of the types of {@link SerialChecksum}. If not
+     * {@link SerialChecksum#NONE}, the last bytes counted by the length field are a
+     * checksum of the rest of the frame, and the frames with a wrong checksum are dropped
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for a frame.
+     * Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param pollPeriodMillis how often to check if the thread has been interrupted
+     * @param exceptionOnTimeout throw a SerialPortTimeoutException on timeout
+     *
+     * @return length of the frame, or 0 on timeout
+     * @throws InterruptedException if the java thread is interrupted while blocking
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * @throws SerialPortException on read error, if a parameter is not correct or if the
+     * header gives a frame longer than maxLength (or the size of the ring) and checksumType
+     * is {@link SerialChecksum#NONE}. The first byte of such a header is dropped either way
+     *
+     * @since 2.9.0
+     */
+    public native int readFrame(long handle, byte[] buffer, int offset, int maxLength, int headerLength, int lengthFieldOffset, int lengthFieldSize, boolean bigEndian,
+            int checksumType, long timeoutMilliseconds, long pollPeriodMillis, boolean exceptionOnTimeout)
+            throws InterruptedException, SerialPortTimeoutException, SerialPortException;
+
+    /**
+     * Compute the checksum of a region of an array
+     *
+     * @param type one of the types of {@link SerialChecksum}, except {@link SerialChecksum#NONE}
+     * @param buffer array holding the bytes
+     * @param offset index in buffer of the first byte
+     * @param length count of bytes
+     *
+     * @return the checksum as an unsigned value
+     * @throws SerialPortException if a parameter is not correct
+     *
+     * @since 2.9.0
+     */
+    public native long checksum(int type, byte[] buffer, int offset, int length) throws SerialPortException;
+
+    /**
+     * Compute the checksum of a region of a direct {@link ByteBuffer}, the data is taken
+     * starting at the absolute index <b>position</b>
+     *
+     * @param type one of the types of {@link SerialChecksum}, except {@link SerialChecksum#NONE}
+     * @param buffer direct buffer holding the bytes
+     * @param position index in buffer of the first byte
+     * @param length count of bytes
+     *
+     * @return the checksum as an unsigned value
+     * @throws SerialPortException if the buffer is not direct or a parameter is not correct
+     *
+     * @since 2.9.0
+     */
+    public native long checksumBuffer(int type, ByteBuffer buffer, int position, int length) throws SerialPortException;
+
+    /**
+     * Open a watcher notified when serial ports are added or removed
+     *
+     * @return handle of the watcher, or -1 if the system has no hot-plug notification
+     *
+     * @since 2.9.0
+     */
+    public native long portWatcherOpen();
+
+    /**
+     * Wait until a serial port is added or removed, the timeout expires or
+     * {@link #portWatcherWakeup(long)} is called. All of the waits on a watcher must be
+     * done by the same thread.
+     *
+     * @param watcher handle of the watcher
+     * @param timeoutMilliseconds the maximum time to wait. Set to 0 to return immediately.
+     * If negative, blocks indefinitely.
+     *
+     * @return 1 if a port may have been added or removed, 0 otherwise, -1 on error
+     *
+     * @since 2.9.0
+     */
+    public native int portWatcherWait(long watcher, long timeoutMilliseconds);
+
+    /**
+     * Make the thread waiting in {@link #portWatcherWait(long, long)} return
+     *
+     * @param watcher handle of the watcher
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean portWatcherWakeup(long watcher);
+
+    /**
+     * Close a watcher, no thread may be waiting on it
+     *
+     * @param watcher handle of the watcher
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @since 2.9.0
+     */
+    public native boolean portWatcherClose(long watcher);
 }
@@ -2,6 +2,7 @@ package jssc;
 
 import java.io.IOException;
 import java.io.OutputStream;
+import java.nio.ByteBuffer;
 
 /**
  * Class that wraps a {@link SerialPort} to provide
@@ -11,6 +12,10 @@ import java.io.OutputStream;
  * instance.  Do not create multiple streams for the 
  * same serial port unless you implement your own
  * synchronization.
+ * <br>
+ * Writes don't wait for the reads of the port, so one thread
+ * may write through this stream while another reads from a
+ * {@link SerialInputStream} of the same port (since 2.9.0).
  * 
  * @author Charles Hache <chalz@member.fsf.org>
  *
@@ -21,7 +26,8 @@ public class SerialOutputStream extends OutputStream {
 
 	/** Instantiates a SerialOutputStream for the given {@link SerialPort}
 	 * Do not create multiple streams for the same serial port
-	 * unless you implement your own synchronization.
+	 * unless you implement your own synchronization, a single
+	 * SerialInputStream may be used alongside it.
 	 * @param sp The serial port to stream.
 	 */
 	public SerialOutputStream(SerialPort sp) {
@@ -45,8 +51,21 @@ public class SerialOutputStream extends OutputStream {
 	
 	@Override
 	public void write(byte[] b, int off, int len) throws IOException {
-		byte[] buffer = new byte[len];
-		System.arraycopy(b, off, buffer, 0, len);
+		try {
+			serialPort.writeBytes(b, off, len);
+		} catch (SerialPortException e) {
+			throw new IOException(e);
+		}
+	}
+
+	/** Writes the remaining bytes of the given buffer to the port.
+	 * Direct buffers are written without being copied into an array first.
+	 * The position of the buffer is advanced by the number of bytes written.
+	 * @param buffer The buffer to write.
+	 * @throws IOException on error.
+	 * @since 2.9.0
+	 */
+	public void write(ByteBuffer buffer) throws IOException {
 		try {
 			serialPort.writeBytes(buffer);
 		} catch (SerialPortException e) {
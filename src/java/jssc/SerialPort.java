@@ -26,6 +26,9 @@ package jssc;
 
 import java.io.UnsupportedEncodingException;
 import java.lang.reflect.Method;
+import java.nio.ByteBuffer;
+import java.util.Arrays;
+import java.util.concurrent.TimeUnit;
 
 /**
  *
@@ -34,13 +37,19 @@ import java.lang.reflect.Method;
 public class SerialPort {
 
     private SerialNativeInterface serialInterface;
-    private SerialPortEventListener eventListener;
-    private long portHandle;
+    private volatile SerialPortEventListener eventListener;
+    private volatile long portHandle;//since 2.9.0 volatile, the state is read by the I/O threads without lock
     private String portName;
-    private boolean portOpened = false;
-    private boolean maskAssigned = false;
-    private boolean eventListenerAdded = false;
-    private int interruptPollingPeriodMillis = 50;	/*How often the blocking native read 
+    private volatile boolean portOpened = false;
+    private volatile boolean maskAssigned = false;
+    private volatile boolean eventListenerAdded = false;
+    private final Object stateLock = new Object();//since 2.9.0 serializes openPort() and closePort()
+    private volatile SerialPortSelector selector = null;//since 2.9.0
+    private volatile boolean bufferedMode = false;//since 2.9.0
+    private volatile boolean inputRingCreated = false;//since 2.9.0, the native ring is kept until the port is closed
+    private volatile int frameChecksumType = SerialChecksum.NONE;//since 2.9.0
+    private volatile int rs485Mode = RS485_MODE_OFF;//since 2.9.0
+    private volatile int interruptPollingPeriodMillis = 50;	/*How often the blocking native read 
     implementation should poll the thread's interrupt status.*/
 
     //since 2.2.0 ->
@@ -112,9 +121,88 @@ public class SerialPort {
     //<- since 0.8
 
     //since 2.6.0 ->
+    /**
+     * Default size of the ring of the buffered mode
+     *
+     * @since 2.9.0
+     */
+    public static final int BUFFERED_MODE_DEFAULT_CAPACITY = 65536;
+
+    /**
+     * Returned by {@link #setLowLatency(boolean)}: the driver low latency flag has been
+     * changed (ASYNC_LOW_LATENCY on Linux, the receive latency on Mac OS X)
+     *
+     * @since 2.9.0
+     */
+    public static final int LOW_LATENCY_ASYNC_FLAG = 1;
+    /**
+     * Returned by {@link #setLowLatency(boolean)}: the latency timer of the USB adapter
+     * has been changed (FTDI adapters on Linux)
+     *
+     * @since 2.9.0
+     */
+    public static final int LOW_LATENCY_TIMER = 2;
+
+    /**
+     * Returned by {@link #setBufferedModeScheduling(long, int, boolean)}: the native
+     * thread has been restricted to the requested CPUs (Linux and Windows only)
+     *
+     * @since 2.9.0
+     */
+    public static final int SCHEDULING_AFFINITY = 1;
+    /**
+     * Returned by {@link #setBufferedModeScheduling(long, int, boolean)}: the priority of
+     * the native thread has been changed
+     *
+     * @since 2.9.0
+     */
+    public static final int SCHEDULING_PRIORITY = 2;
+    /**
+     * Returned by {@link #setBufferedModeScheduling(long, int, boolean)}: the ring of the
+     * buffered mode is locked in memory
+     *
+     * @since 2.9.0
+     */
+    public static final int SCHEDULING_MEMORY_LOCKED = 4;
+    /**
+     * Highest realtime priority accepted by {@link #setBufferedModeScheduling(long, int, boolean)}
+     *
+     * @since 2.9.0
+     */
+    public static final int SCHEDULING_MAX_PRIORITY = 99;
+
+    /**
+     * Lines of {@link #setLines(int, int)}: RTS, DTR and break can be changed, the
+     * others are only reported
+     *
+     * @since 2.9.0
+     */
+    public static final int LINE_RTS = 1;
+    public static final int LINE_DTR = 2;
+    public static final int LINE_BREAK = 4;
+    public static final int LINE_CTS = 8;
+    public static final int LINE_DSR = 16;
+    public static final int LINE_RING = 32;
+    public static final int LINE_RLSD = 64;
+
+    /**
+     * RS-485 direction control of {@link #setRS485Mode(boolean, boolean, int, int)}: off,
+     * done by the driver, or done by the native library around every write
+     *
+     * @since 2.9.0
+     */
+    public static final int RS485_MODE_OFF = 0;
+    public static final int RS485_MODE_DRIVER = 1;
+    public static final int RS485_MODE_SOFTWARE = 2;
+
     private static final int PARAMS_FLAG_IGNPAR = 1;
     private static final int PARAMS_FLAG_PARMRK = 2;
     //<- since 2.6.0
+    private static final int PARAMS_FLAG_LOW_LATENCY_ON = 4;
+    private static final int PARAMS_FLAG_LOW_LATENCY_OFF = 8;
+
+    //Must match WRITE_GATHER_MAX of the native library
+    private static final int WRITE_GATHER_MAX = 16;
 
     public SerialPort(String portName) {
         this.portName = portName;
@@ -150,31 +238,33 @@ public class SerialPort {
      * @throws SerialPortException
      */
     public boolean openPort() throws SerialPortException {
-        if(portOpened){
-            throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PORT_ALREADY_OPENED);
-        }
-        if(portName != null){
-            boolean useTIOCEXCL = (System.getProperty(SerialNativeInterface.PROPERTY_JSSC_NO_TIOCEXCL) == null &&
-                                   System.getProperty(SerialNativeInterface.PROPERTY_JSSC_NO_TIOCEXCL.toLowerCase()) == null);
-            portHandle = serialInterface.openPort(portName, useTIOCEXCL);//since 2.3.0 -> (if JSSC_NO_TIOCEXCL defined, exclusive lock for serial port will be disabled)
-        }
-        else {
-            throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_NULL_NOT_PERMITTED);//since 2.1.0 -> NULL port name fix
-        }
-        if(portHandle == SerialNativeInterface.ERR_PORT_BUSY){
-            throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PORT_BUSY);
-        }
-        else if(portHandle == SerialNativeInterface.ERR_PORT_NOT_FOUND){
-            throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PORT_NOT_FOUND);
-        }
-        else if(portHandle == SerialNativeInterface.ERR_PERMISSION_DENIED){
-            throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PERMISSION_DENIED);
-        }
-        else if(portHandle == SerialNativeInterface.ERR_INCORRECT_SERIAL_PORT){
-            throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_INCORRECT_SERIAL_PORT);
+        synchronized(stateLock) {
+            if(portOpened){
+                throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PORT_ALREADY_OPENED);
+            }
+            if(portName != null){
+                boolean useTIOCEXCL = (System.getProperty(SerialNativeInterface.PROPERTY_JSSC_NO_TIOCEXCL) == null &&
+                                       System.getProperty(SerialNativeInterface.PROPERTY_JSSC_NO_TIOCEXCL.toLowerCase()) == null);
+                portHandle = serialInterface.openPort(portName, useTIOCEXCL);//since 2.3.0 -> (if JSSC_NO_TIOCEXCL defined, exclusive lock for serial port will be disabled)
+            }
+            else {
+                throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_NULL_NOT_PERMITTED);//since 2.1.0 -> NULL port name fix
+            }
+            if(portHandle == SerialNativeInterface.ERR_PORT_BUSY){
+                throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PORT_BUSY);
+            }
+            else if(portHandle == SerialNativeInterface.ERR_PORT_NOT_FOUND){
+                throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PORT_NOT_FOUND);
+            }
+            else if(portHandle == SerialNativeInterface.ERR_PERMISSION_DENIED){
+                throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_PERMISSION_DENIED);
+            }
+            else if(portHandle == SerialNativeInterface.ERR_INCORRECT_SERIAL_PORT){
+                throw new SerialPortException(portName, "openPort()", SerialPortException.TYPE_INCORRECT_SERIAL_PORT);
+            }
+            portOpened = true;
+            return true;
         }
-        portOpened = true;
-        return true;
     }
 
     /**
@@ -196,7 +286,9 @@ public class SerialPort {
     /**
      * Setting the parameters of port
      *
-     * @param baudRate data transfer rate
+     * @param baudRate data transfer rate. Any rate supported by the driver can be used, rates
+     * without a BAUDRATE_* constant are set with termios2 on Linux (since 2.9.0) and
+     * IOSSIOSPEED on Mac OS X
      * @param dataBits number of data bits
      * @param stopBits number of stop bits
      * @param parity parity
@@ -211,12 +303,71 @@ public class SerialPort {
      */
     public boolean setParams(int baudRate, int dataBits, int stopBits, int parity, boolean setRTS, boolean setDTR) throws SerialPortException {
         checkPortOpened("setParams()");
+        return serialInterface.setParams(portHandle, baudRate, dataBits, toNativeStopBits(stopBits), parity, setRTS, setDTR, getParamsFlags());
+    }
+
+    /**
+     * Apply the line parameters and the flow control mode in one native call, keeping the
+     * low latency mode. See {@link #configure(int, int, int, int, int, boolean)}.
+     *
+     * @param baudRate data transfer rate
+     * @param dataBits number of data bits
+     * @param stopBits number of stop bits
+     * @param parity parity
+     * @param flowControlMask combination of the <b>FLOWCONTROL_</b> values
+     *
+     * @return true if the settings are in effect
+     *
+     * @throws SerialPortException if the port is not opened
+     *
+     * @since 2.9.0
+     */
+    public boolean configure(int baudRate, int dataBits, int stopBits, int parity, int flowControlMask) throws SerialPortException {
+        checkPortOpened("configure()");
+        return serialInterface.configure(portHandle, baudRate, dataBits, toNativeStopBits(stopBits), parity, flowControlMask, getParamsFlags());
+    }
+
+    /**
+     * Apply the line parameters, the flow control mode and the low latency mode in one
+     * native call: the same settings as {@link #setParams(int, int, int, int)},
+     * {@link #setFlowControlMode(int)} and {@link #setLowLatency(boolean)}, but applied
+     * by a single tcsetattr() on Linux and Mac OS X (one SetCommState() on Windows), and
+     * skipped altogether when nothing changes. Unlike setParams, RTS and DTR are not
+     * touched. Meant for reconfiguring a live line often, auto baud detection for
+     * instance. The low latency mode is only changed when it differs from the last mode
+     * set through this port, and whether the driver supports it is not reported.
+     *
+     * @param baudRate data transfer rate
+     * @param dataBits number of data bits
+     * @param stopBits number of stop bits
+     * @param parity parity
+     * @param flowControlMask combination of the <b>FLOWCONTROL_</b> values
+     * @param lowLatency true to enable the low latency mode, false to disable it
+     *
+     * @return true if the settings are in effect
+     *
+     * @throws SerialPortException if the port is not opened
+     *
+     * @since 2.9.0
+     */
+    public boolean configure(int baudRate, int dataBits, int stopBits, int parity, int flowControlMask, boolean lowLatency) throws SerialPortException {
+        checkPortOpened("configure()");
+        int flags = getParamsFlags() | (lowLatency ? PARAMS_FLAG_LOW_LATENCY_ON : PARAMS_FLAG_LOW_LATENCY_OFF);
+        return serialInterface.configure(portHandle, baudRate, dataBits, toNativeStopBits(stopBits), parity, flowControlMask, flags);
+    }
+
+    //The native side takes the stop bits as MSDN does: 0 for 1, 1 for 1.5 and 2 for 2
+    private static int toNativeStopBits(int stopBits) {
         if(stopBits == 1){
-            stopBits = 0;
+            return 0;
         }
         else if(stopBits == 3){
-            stopBits = 1;
+            return 1;
         }
+        return stopBits;
+    }
+
+    private static int getParamsFlags() {
         int flags = 0;
         if(System.getProperty(SerialNativeInterface.PROPERTY_JSSC_IGNPAR) != null || System.getProperty(SerialNativeInterface.PROPERTY_JSSC_IGNPAR.toLowerCase()) != null){
             flags |= PARAMS_FLAG_IGNPAR;
@@ -224,7 +375,7 @@ public class SerialPort {
         if(System.getProperty(SerialNativeInterface.PROPERTY_JSSC_PARMRK) != null || System.getProperty(SerialNativeInterface.PROPERTY_JSSC_PARMRK.toLowerCase()) != null){
             flags |= PARAMS_FLAG_PARMRK;
         }
-        return serialInterface.setParams(portHandle, baudRate, dataBits, stopBits, parity, setRTS, setDTR, flags);
+        return flags;
     }
 
     /**
@@ -243,13 +394,6 @@ public class SerialPort {
         return serialInterface.purgePort(portHandle, flags);
     }
 
-    /**
-     * Events mask for Linux OS
-     *
-     * @since 0.8
-     */
-    private int linuxMask;
-
     /**
      * Set events mask. Required flags shall be sent to the input. Variables with prefix 
      * <b>"MASK_"</b>, shall be used as flags, for example <b>"MASK_RXCHAR"</b>. 
@@ -263,18 +407,7 @@ public class SerialPort {
      */
     public boolean setEventsMask(int mask) throws SerialPortException {
         checkPortOpened("setEventsMask()");
-        if(SerialNativeInterface.getOsType() == SerialNativeInterface.OS_LINUX ||
-           SerialNativeInterface.getOsType() == SerialNativeInterface.OS_SOLARIS ||
-           SerialNativeInterface.getOsType() == SerialNativeInterface.OS_MAC_OS_X){//since 0.9.0
-            linuxMask = mask;
-            if(mask > 0){
-                maskAssigned = true;
-            }
-            else {
-                maskAssigned = false;
-            }
-            return true;
-        }
+        //since 2.9.0 the mask is applied by the native library on all of the platforms
         boolean returnValue = serialInterface.setEventsMask(portHandle, mask);
         if(!returnValue){
             throw new SerialPortException(portName, "setEventsMask()", SerialPortException.TYPE_CANT_SET_MASK);
@@ -297,23 +430,9 @@ public class SerialPort {
      */
     public int getEventsMask() throws SerialPortException {
         checkPortOpened("getEventsMask()");
-        if(SerialNativeInterface.getOsType() == SerialNativeInterface.OS_LINUX ||
-           SerialNativeInterface.getOsType() == SerialNativeInterface.OS_SOLARIS ||
-           SerialNativeInterface.getOsType() == SerialNativeInterface.OS_MAC_OS_X){//since 0.9.0
-            return linuxMask;
-        }
         return serialInterface.getEventsMask(portHandle);
     }
 
-    /**
-     * Getting events mask for the port is Linux OS (for internal use)
-     * 
-     * @since 0.8
-     */
-    private int getLinuxMask() {
-        return linuxMask;
-    }
-
     /**
      * Change RTS line state. Set "true" for switching ON and "false" for switching OFF RTS line
      *
@@ -338,6 +457,87 @@ public class SerialPort {
         return serialInterface.setDTR(portHandle, enabled);
     }
 
+    /**
+     * Change RTS, DTR and break and read the modem lines in one call. On Linux and
+     * Mac OS X RTS and DTR change together, on Windows one after the other.
+     * <br><br>
+     * Example: <i>setLines(LINE_RTS | LINE_DTR, LINE_DTR)</i> switches RTS OFF and DTR ON
+     * and leaves break as it is.
+     *
+     * @param mask combination of {@link #LINE_RTS}, {@link #LINE_DTR} and {@link #LINE_BREAK},
+     * the lines to change
+     * @param values the new states of the lines of mask, a set bit is ON
+     *
+     * @return combination of the LINE_* constants of the lines which are ON after the
+     * change. On Windows the state of RTS and DTR is only known for the lines of mask,
+     * and break is never reported
+     *
+     * @throws SerialPortException if mask has other bits, or if the lines couldn't be changed
+     *
+     * @since 2.9.0
+     */
+    public int setLines(int mask, int values) throws SerialPortException {
+        checkPortOpened("setLines()");
+        if((mask & ~(LINE_RTS | LINE_DTR | LINE_BREAK)) != 0){
+            throw new SerialPortException(portName, "setLines()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        int result = serialInterface.setLines(portHandle, mask, values);
+        if(result < 0){
+            throw new SerialPortException(portName, "setLines()", SerialPortException.TYPE_UNKNOWN);
+        }
+        return result;
+    }
+
+    /**
+     * Switch the RS-485 direction control of the port: RTS is switched to the
+     * transmitting level before every write and back once the last byte has been sent.
+     * The RS-485 mode of the driver is used where available (TIOCSRS485 on Linux,
+     * RTS_CONTROL_TOGGLE on Windows when rtsOnSend is set and both delays are 0),
+     * otherwise the native library switches RTS itself around every write and waits
+     * for the transmitter to drain (see {@link #drain(long)}). The software mode turns
+     * around within the write call, but the writes then block until the data has been
+     * sent.
+     * <br><br>
+     * <b>Note: </b>on Windows {@link #setParams(int, int, int, int, boolean, boolean)} and
+     * {@link #setFlowControlMode(int)} rewrite the RTS control of the driver, call this
+     * method after them.
+     *
+     * @param enabled true to switch on the direction control
+     * @param rtsOnSend true to hold RTS ON while sending, false to hold it OFF
+     * @param delayBeforeSendMillis delay in milliseconds between switching RTS and the first byte
+     * @param delayAfterSendMillis delay in milliseconds between the last byte and switching RTS back
+     *
+     * @return {@link #RS485_MODE_DRIVER} or {@link #RS485_MODE_SOFTWARE} for the mode in use,
+     * {@link #RS485_MODE_OFF} when disabling
+     *
+     * @throws SerialPortException if a delay is negative, or if the mode couldn't be changed
+     *
+     * @since 2.9.0
+     */
+    public int setRS485Mode(boolean enabled, boolean rtsOnSend, int delayBeforeSendMillis, int delayAfterSendMillis) throws SerialPortException {
+        checkPortOpened("setRS485Mode()");
+        if(delayBeforeSendMillis < 0 || delayAfterSendMillis < 0){
+            throw new SerialPortException(portName, "setRS485Mode()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        int mode = serialInterface.setRS485(portHandle, enabled, rtsOnSend, delayBeforeSendMillis, delayAfterSendMillis);
+        if(mode < 0){
+            throw new SerialPortException(portName, "setRS485Mode()", SerialPortException.TYPE_UNKNOWN);
+        }
+        rs485Mode = mode;
+        return mode;
+    }
+
+    /**
+     * Get the RS-485 direction control in use
+     *
+     * @return {@link #RS485_MODE_OFF}, {@link #RS485_MODE_DRIVER} or {@link #RS485_MODE_SOFTWARE}
+     *
+     * @since 2.9.0
+     */
+    public int getRS485Mode() {
+        return rs485Mode;
+    }
+
     /**
      * Write byte array to port
      *
@@ -350,6 +550,271 @@ public class SerialPort {
         return serialInterface.writeBytes(portHandle, buffer);
     }
 
+    /**
+     * Write a region of a byte array to port, without copying it first
+     *
+     * @param buffer array holding the bytes to write
+     * @param offset index in buffer of the first byte to write
+     * @param byteCount number of bytes to write
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @throws SerialPortException
+     *
+     * @since 2.9.0
+     */
+    public boolean writeBytes(byte[] buffer, int offset, int byteCount) throws SerialPortException {
+        return writeBytesWithTimeout(buffer, offset, byteCount, -1, false) == byteCount;
+    }
+
+    /**
+     * Write the remaining bytes of a {@link ByteBuffer} to port. The position of the
+     * buffer is advanced by the count of bytes written. Direct buffers are written by
+     * the native library without any intermediate copy.
+     *
+     * @param buffer buffer holding the bytes to write
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @throws SerialPortException
+     *
+     * @since 2.9.0
+     */
+    public boolean writeBytes(ByteBuffer buffer) throws SerialPortException {
+        if(buffer == null){
+            throw new SerialPortException(portName, "writeBytes()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        int byteCount = buffer.remaining();
+        return writeBytesWithTimeout(buffer, -1, false) == byteCount;
+    }
+
+    /**
+     * Low level writing data to the port. Partial writes (for example while the output
+     * is held back by flow control) are continued until all of the data has been
+     * accepted by the driver or the timeout expires.
+     *
+     * @param buffer array holding the bytes to write
+     * @param offset index in buffer of the first byte to write
+     * @param byteCount number of bytes to write
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the port
+     * to accept all of the data. Set to 0 to write only what can be written immediately.
+     * If negative, blocks indefinitely.
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before byteCount bytes are written. If this parameter
+     * is set to false, then upon timeout, this function will return the count of bytes already written.
+     *
+     * @return number of bytes written, or -1 on write error
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     *
+     * @since 2.9.0
+     */
+    public int writeBytesWithTimeout(byte[] buffer, int offset, int byteCount,
+            long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("writeBytesWithTimeout()");
+        if(buffer == null){
+            throw new SerialPortException(portName, "writeBytesWithTimeout()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(offset < 0 || byteCount < 0 || byteCount > buffer.length - offset){
+            throw new SerialPortException(portName, "writeBytesWithTimeout()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(byteCount == 0){
+            return 0;
+        }
+        try {
+            return serialInterface.writeBytesFromArray(portHandle, buffer, offset, byteCount, timeoutMilliseconds, interruptPollingPeriodMillis, exceptionOnTimeout);
+        } catch (InterruptedException e) {
+            throw new SerialPortException(portName, "writeBytesWithTimeout", SerialPortException.TYPE_WRITE_INTERRUPTED);
+        }
+    }
+
+    /**
+     * Low level writing the remaining bytes of a {@link ByteBuffer} to the port, with the
+     * same behaviour as {@link #writeBytesWithTimeout(byte[], int, int, long, boolean)}.
+     * The position of the buffer is advanced by the count of bytes written.
+     *
+     * @param buffer buffer holding the bytes to write
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the port
+     * to accept all of the data. Set to 0 to write only what can be written immediately.
+     * If negative, blocks indefinitely.
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before all the bytes are written.
+     *
+     * @return number of bytes written, or -1 on write error
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     *
+     * @since 2.9.0
+     */
+    public int writeBytesWithTimeout(ByteBuffer buffer, long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("writeBytesWithTimeout()");
+        if(buffer == null){
+            throw new SerialPortException(portName, "writeBytesWithTimeout()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        int position = buffer.position();
+        int byteCount = buffer.remaining();
+        if(byteCount == 0){
+            return 0;
+        }
+        int result;
+        if(buffer.isDirect()){
+            try {
+                result = serialInterface.writeBytesFromBuffer(portHandle, buffer, position, byteCount, timeoutMilliseconds, interruptPollingPeriodMillis, exceptionOnTimeout);
+            } catch (InterruptedException e) {
+                throw new SerialPortException(portName, "writeBytesWithTimeout", SerialPortException.TYPE_WRITE_INTERRUPTED);
+            }
+        }
+        else if(buffer.hasArray()){
+            result = writeBytesWithTimeout(buffer.array(), buffer.arrayOffset() + position, byteCount, timeoutMilliseconds, exceptionOnTimeout);
+        }
+        else {
+            byte[] data = new byte[byteCount];
+            buffer.duplicate().get(data);
+            result = writeBytesWithTimeout(data, 0, byteCount, timeoutMilliseconds, exceptionOnTimeout);
+        }
+        if(result > 0){
+            buffer.position(position + result);
+        }
+        return result;
+    }
+
+    /**
+     * Write the remaining bytes of several {@link ByteBuffer}s to port, in order, as one
+     * continuous stream. Up to 16 buffers are passed to the native library in a single
+     * call, so a header and a payload held in separate buffers are written without
+     * joining them first. The positions of the buffers are advanced by the count of
+     * bytes written from each of them.
+     *
+     * @param buffers buffers holding the bytes to write
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @throws SerialPortException
+     *
+     * @since 2.9.0
+     */
+    public boolean writeBytes(ByteBuffer[] buffers) throws SerialPortException {
+        if(buffers == null){
+            throw new SerialPortException(portName, "writeBytes()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        long byteCount = 0;
+        for(ByteBuffer buffer : buffers){
+            if(buffer == null){
+                throw new SerialPortException(portName, "writeBytes()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+            }
+            byteCount += buffer.remaining();
+        }
+        return writeBytesWithTimeout(buffers, -1, false) == byteCount;
+    }
+
+    /**
+     * Low level writing the remaining bytes of several {@link ByteBuffer}s to the port,
+     * with the same behaviour as {@link #writeBytesWithTimeout(ByteBuffer, long, boolean)}.
+     * The buffers are written in order, the position of each buffer is advanced by the
+     * count of bytes written from it.
+     *
+     * @param buffers buffers holding the bytes to write
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the port
+     * to accept all of the data. Set to 0 to write only what can be written immediately.
+     * If negative, blocks indefinitely.
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before all the bytes are written.
+     *
+     * @return total number of bytes written, or -1 on write error
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     *
+     * @since 2.9.0
+     */
+    public int writeBytesWithTimeout(ByteBuffer[] buffers, long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("writeBytesWithTimeout()");
+        if(buffers == null){
+            throw new SerialPortException(portName, "writeBytesWithTimeout()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        for(ByteBuffer buffer : buffers){
+            if(buffer == null){
+                throw new SerialPortException(portName, "writeBytesWithTimeout()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+            }
+        }
+        long deadline = System.nanoTime() + TimeUnit.MILLISECONDS.toNanos(timeoutMilliseconds);
+        Object[] sources = new Object[Math.min(buffers.length, WRITE_GATHER_MAX)];
+        int[] offsets = new int[sources.length];
+        int[] counts = new int[sources.length];
+        int total = 0;
+        int first = 0;
+        while(first < buffers.length){
+            int sourceCount = Math.min(buffers.length - first, WRITE_GATHER_MAX);
+            int chunkCount = 0;
+            for(int i = 0; i < sourceCount; i++){
+                ByteBuffer buffer = buffers[first + i];
+                counts[i] = buffer.remaining();
+                if(buffer.isDirect()){
+                    sources[i] = buffer;
+                    offsets[i] = buffer.position();
+                }
+                else if(buffer.hasArray()){
+                    sources[i] = buffer.array();
+                    offsets[i] = buffer.arrayOffset() + buffer.position();
+                }
+                else {
+                    byte[] data = new byte[counts[i]];
+                    buffer.duplicate().get(data);
+                    sources[i] = data;
+                    offsets[i] = 0;
+                }
+                if(counts[i] > Integer.MAX_VALUE - total - chunkCount){
+                    //Leave the rest for the next call, the count returned must fit in an int
+                    sourceCount = i;
+                    break;
+                }
+                chunkCount += counts[i];
+            }
+            if(sourceCount == 0){
+                break;
+            }
+            Object[] chunkSources = sources;
+            int[] chunkOffsets = offsets;
+            int[] chunkCounts = counts;
+            if(sourceCount < sources.length){
+                //Shorter chunk, the native library takes every element of the arrays. The full
+                //arrays are kept for the next chunks
+                chunkSources = Arrays.copyOf(sources, sourceCount);
+                chunkOffsets = Arrays.copyOf(offsets, sourceCount);
+                chunkCounts = Arrays.copyOf(counts, sourceCount);
+            }
+            long chunkTimeout = timeoutMilliseconds;
+            if(timeoutMilliseconds > 0){
+                //Rounded up, a chunk must not time out just before the deadline
+                long remains = deadline - System.nanoTime();
+                chunkTimeout = (remains > 0 ? remains / 1000000L + (remains % 1000000L > 0 ? 1 : 0) : 0);
+            }
+            int result = 0;
+            if(chunkCount > 0){
+                try {
+                    result = serialInterface.writeBytesGather(portHandle, chunkSources, chunkOffsets, chunkCounts, chunkTimeout, interruptPollingPeriodMillis, exceptionOnTimeout);
+                } catch (InterruptedException e) {
+                    throw new SerialPortException(portName, "writeBytesWithTimeout", SerialPortException.TYPE_WRITE_INTERRUPTED);
+                }
+            }
+            if(result < 0){
+                return (total > 0 ? total : -1);
+            }
+            total += result;
+            int remains = result;
+            for(int i = 0; i < sourceCount && remains > 0; i++){
+                ByteBuffer buffer = buffers[first + i];
+                int written = Math.min(remains, counts[i]);
+                buffer.position(buffer.position() + written);
+                remains -= written;
+            }
+            if(result < chunkCount){
+                break;//Timeout, the rest of the buffers is left untouched
+            }
+            first += sourceCount;
+        }
+        return total;
+    }
+
     /**
      * Write single byte to port
      *
@@ -501,90 +966,466 @@ public class SerialPort {
      * 
      * @return String array with "byteCount" length and Hexadecimal String values
      *
-     * @throws SerialPortException
+     * @throws SerialPortException
+     *
+     * @since 0.8
+     */
+    public String[] readHexStringArray(int byteCount) throws SerialPortException {
+        return readHexStringArray(byteCount, 0);
+    }
+
+    /**
+     * Read int array from port.
+     * Blocks until all the data is read or an exception occurs.
+     *
+     * @param byteCount count of bytes for reading
+     *
+     * @return int array with values in range from 0 to 255
+     *
+     * @throws SerialPortException
+     *
+     * @since 0.8
+     */
+    public int[] readIntArray(int byteCount) throws SerialPortException {
+        return readIntArray(byteCount, 0);
+    }
+    
+    /**
+     * Low level reading data from the port.
+     * 
+     * @param byteCount number of bytes to block and wait for, or 0 to return immediately
+     * with whatever data is available. If timeoutMilliseconds is 0 and byteCount
+     * is positive, then immediately returns with at most byteCount bytes (possibly 0).
+     *
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
+     * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
+     * This argument is ignored if byteCount is set to 0.
+     *
+     * @param pollPeriodMillis how often to check if the thread has been interrupted. Set
+     * to 0 to disable periodic polling of the thread interrupt status.
+     *
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before byteCount bytes are read. If this parameter
+     * is set to false, then upon timeout, this function will return a (possibly length 0)
+     * array of the bytes already read.
+     * 
+     * @return array of read bytes
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     */
+    public byte[] readBytesWithTimeout(int byteCount, 
+            long timeoutMilliseconds, int interruptPollPeriod, 
+            boolean exceptionOnTimeout) throws SerialPortException {
+        
+        checkPortOpened("readBytesWithTimeout()");
+        try {
+            return serialInterface.readBytes(portHandle, byteCount, timeoutMilliseconds, interruptPollPeriod, exceptionOnTimeout);
+        } catch (InterruptedException e) {
+            throw new SerialPortException(portName, "readBytesWithTimeout", SerialPortException.TYPE_READ_INTERRUPTED);
+        }
+    }
+    
+    /**
+     * Low level reading data from the port.
+     * 
+     * @param byteCount number of bytes to block and wait for, or 0 to return immediately
+     * with whatever data is available. If timeoutMilliseconds is 0 and byteCount
+     * is positive, then immediately returns with at most byteCount bytes (possibly 0).
+     *
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
+     * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
+     * This argument is ignored if byteCount is set to 0.
+     *
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before byteCount bytes are read. If this parameter
+     * is set to false, then upon timeout, this function will return a (possibly length 0)
+     * array of the bytes already read.
+     * 
+     * @return array of read bytes
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     */
+    public byte[] readBytesWithTimeout(int byteCount,
+            long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        return readBytesWithTimeout(byteCount, timeoutMilliseconds, this.interruptPollingPeriodMillis, exceptionOnTimeout);
+    }
+
+    /**
+     * Low level reading data from the port into a region of an existing array. No
+     * intermediate array is allocated, the data is stored directly into <b>buffer</b>.
+     *
+     * @param buffer array to store the read bytes in
+     * @param offset index in buffer of the first byte to store
+     * @param byteCount number of bytes to block and wait for. If timeoutMilliseconds is 0,
+     * then immediately returns with at most byteCount bytes (possibly 0).
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
+     * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before byteCount bytes are read. If this parameter
+     * is set to false, then upon timeout, this function will return the count of bytes already read.
+     *
+     * @return number of bytes stored into buffer
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     *
+     * @since 2.9.0
+     */
+    public int readBytesWithTimeout(byte[] buffer, int offset, int byteCount,
+            long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("readBytesWithTimeout()");
+        if(buffer == null){
+            throw new SerialPortException(portName, "readBytesWithTimeout()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(offset < 0 || byteCount < 0 || byteCount > buffer.length - offset){
+            throw new SerialPortException(portName, "readBytesWithTimeout()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(byteCount == 0){
+            return 0;
+        }
+        try {
+            return serialInterface.readBytesToArray(portHandle, buffer, offset, byteCount, timeoutMilliseconds, interruptPollingPeriodMillis, exceptionOnTimeout);
+        } catch (InterruptedException e) {
+            throw new SerialPortException(portName, "readBytesWithTimeout", SerialPortException.TYPE_READ_INTERRUPTED);
+        }
+    }
+
+    /**
+     * Read whatever is available in the input buffer into a region of an existing array,
+     * without waiting. Unlike {@link #readBytes()}, the whole backlog (at most maxLength
+     * bytes) is read with a single native call and no array is allocated.
+     *
+     * @param buffer array to store the read bytes in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum number of bytes to read
+     *
+     * @return number of bytes stored into buffer, 0 if the input buffer is empty
+     * @throws SerialPortException if the port is not opened or some other error occurred.
+     *
+     * @since 2.9.0
+     */
+    public int readAvailable(byte[] buffer, int offset, int maxLength) throws SerialPortException {
+        checkPortOpened("readAvailable()");
+        if(buffer == null){
+            throw new SerialPortException(portName, "readAvailable()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(offset < 0 || maxLength < 0 || maxLength > buffer.length - offset){
+            throw new SerialPortException(portName, "readAvailable()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(maxLength == 0){
+            return 0;
+        }
+        return serialInterface.readAvailable(portHandle, buffer, offset, maxLength);
+    }
+
+    /**
+     * Read whatever is available in the input buffer into an existing array, without
+     * waiting, see {@link #readAvailable(byte[], int, int)}
+     *
+     * @param buffer array to store the read bytes in, at most buffer.length bytes are read
+     *
+     * @return number of bytes stored into buffer, 0 if the input buffer is empty
+     * @throws SerialPortException if the port is not opened or some other error occurred.
+     *
+     * @since 2.9.0
+     */
+    public int readAvailable(byte[] buffer) throws SerialPortException {
+        if(buffer == null){
+            throw new SerialPortException(portName, "readAvailable()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        return readAvailable(buffer, 0, buffer.length);
+    }
+
+    /**
+     * Read a packet whose end is marked by the line going idle, as in Modbus RTU where
+     * frames are separated by a silence of 3.5 characters. Waits for the first byte,
+     * then returns as soon as no byte has been received for <b>idleMicros</b>
+     * microseconds or maxLength bytes have been read. The silence is timed by the native
+     * library, so a whole packet is read with a single call.
+     * <br>
+     * For 8N1 framing a character lasts 10 bits, 3.5 characters at 19200 baud are
+     * 3.5 * 10 * 1000000 / 19200 = 1823 microseconds.
+     * <br>
+     * <b>Note: </b>on Windows the idle time is rounded up to milliseconds and depends on
+     * the resolution of the system timer.
+     *
+     * @param buffer array to store the packet in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum length of a packet
+     * @param idleMicros idle time of the line ending a packet, in microseconds
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the first
+     * byte. Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and no byte arrived within the timeout, otherwise 0 is returned
+     *
+     * @return length of the packet stored into buffer
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     *
+     * @since 2.9.0
+     */
+    public int readUntilIdle(byte[] buffer, int offset, int maxLength, long idleMicros,
+            long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("readUntilIdle()");
+        if(buffer == null){
+            throw new SerialPortException(portName, "readUntilIdle()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(offset < 0 || maxLength < 0 || idleMicros < 0 || maxLength > buffer.length - offset){
+            throw new SerialPortException(portName, "readUntilIdle()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(maxLength == 0){
+            return 0;
+        }
+        try {
+            return serialInterface.readBytesUntilIdle(portHandle, buffer, offset, maxLength, idleMicros, timeoutMilliseconds, interruptPollingPeriodMillis, exceptionOnTimeout);
+        } catch (InterruptedException e) {
+            throw new SerialPortException(portName, "readUntilIdle", SerialPortException.TYPE_READ_INTERRUPTED);
+        }
+    }
+
+    /**
+     * Low level reading data from the port into a {@link ByteBuffer}. The data is stored
+     * starting at the current position of the buffer, and the position is advanced by the
+     * count of bytes read. Direct buffers are filled by the native library without any
+     * intermediate copy.
+     *
+     * @param buffer buffer to store the read bytes in
+     * @param byteCount number of bytes to block and wait for, must not exceed the bytes
+     * remaining in buffer
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
+     * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before byteCount bytes are read.
+     *
+     * @return number of bytes stored into buffer
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     *
+     * @since 2.9.0
+     */
+    public int readBytesWithTimeout(ByteBuffer buffer, int byteCount,
+            long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("readBytesWithTimeout()");
+        if(buffer == null){
+            throw new SerialPortException(portName, "readBytesWithTimeout()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(buffer.isReadOnly() || byteCount < 0 || byteCount > buffer.remaining()){
+            throw new SerialPortException(portName, "readBytesWithTimeout()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(byteCount == 0){
+            return 0;
+        }
+        int position = buffer.position();
+        int count;
+        if(buffer.isDirect()){
+            try {
+                count = serialInterface.readBytesToBuffer(portHandle, buffer, position, byteCount, timeoutMilliseconds, interruptPollingPeriodMillis, exceptionOnTimeout);
+            } catch (InterruptedException e) {
+                throw new SerialPortException(portName, "readBytesWithTimeout", SerialPortException.TYPE_READ_INTERRUPTED);
+            }
+        }
+        else if(buffer.hasArray()){
+            count = readBytesWithTimeout(buffer.array(), buffer.arrayOffset() + position, byteCount, timeoutMilliseconds, exceptionOnTimeout);
+        }
+        else {
+            throw new SerialPortException(portName, "readBytesWithTimeout()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        buffer.position(position + count);
+        return count;
+    }
+
+    /**
+     * Set the checksum validated by the native library for the frames read with
+     * {@link #readUntil(byte[], byte[], int, int, long, boolean)} and
+     * {@link #readFrame(byte[], int, int, int, int, int, boolean, long, boolean)}. A
+     * frame with a wrong checksum is dropped without being copied to java. The returned
+     * frames still hold their checksum.
+     *
+     * @param checksumType one of the types of {@link SerialChecksum}, {@link SerialChecksum#NONE}
+     * to disable the validation (default)
+     *
+     * @throws SerialPortException if the type is unknown
      *
-     * @since 0.8
+     * @since 2.9.0
      */
-    public String[] readHexStringArray(int byteCount) throws SerialPortException {
-        return readHexStringArray(byteCount, 0);
+    public void setFrameChecksum(int checksumType) throws SerialPortException {
+        if(checksumType != SerialChecksum.NONE && SerialChecksum.getSize(checksumType) == 0){
+            throw new SerialPortException(portName, "setFrameChecksum()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        frameChecksumType = checksumType;
     }
 
     /**
-     * Read int array from port.
-     * Blocks until all the data is read or an exception occurs.
+     * Getting the checksum validated for the framed reads
      *
-     * @param byteCount count of bytes for reading
+     * @return one of the types of {@link SerialChecksum}
      *
-     * @return int array with values in range from 0 to 255
+     * @since 2.9.0
+     */
+    public int getFrameChecksum() {
+        return frameChecksumType;
+    }
+
+    /**
+     * Read a frame ending with <b>delimiter</b> into a region of an existing array, for
+     * line or record oriented protocols. The frame is searched by the native library,
+     * the bytes received past the end of the frame are kept for the next read. If no
+     * complete frame arrives within the timeout, the bytes already received are kept as
+     * well.
+     * <br>
+     * <b>Note: </b>the first framed read creates a native input ring for the port (see
+     * {@link #setBufferedMode(boolean, int)}), with at least maxLength bytes. Frames
+     * can't be longer than this ring. As with the buffered mode, the framed reads of a
+     * port registered with a {@link SerialPortSelector} are refused.
+     * <br>
+     * If a checksum is set with {@link #setFrameChecksum(int)}, each frame ends with the
+     * checksum of its previous bytes followed by the delimiter. The frames with a wrong
+     * checksum are dropped by the native library and never returned.
+     *
+     * @param delimiter bytes ending a frame, 1 to 64 bytes
+     * @param buffer array to store the frame in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum length of a frame, delimiter included. If no delimiter is
+     * found within maxLength bytes, these bytes are returned as they are
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for a frame.
+     * Set to 0 to return immediately. If negative, blocks indefinitely.
+     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
+     * is set to true and the timeout expires before a frame is read, otherwise 0 is returned
      *
-     * @throws SerialPortException
+     * @return length of the frame stored into buffer, delimiter included
+     * @throws SerialPortException if the java thread is interrupted while blocking, the port
+     * is registered with a selector or some other error occurred.
+     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
      *
-     * @since 0.8
+     * @since 2.9.0
      */
-    public int[] readIntArray(int byteCount) throws SerialPortException {
-        return readIntArray(byteCount, 0);
+    public int readUntil(byte[] delimiter, byte[] buffer, int offset, int maxLength,
+            long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("readUntil()");
+        if(delimiter == null || buffer == null){
+            throw new SerialPortException(portName, "readUntil()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(delimiter.length == 0 || offset < 0 || maxLength < delimiter.length || maxLength > buffer.length - offset){
+            throw new SerialPortException(portName, "readUntil()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(selector != null){
+            throw new SerialPortException(portName, "readUntil()", SerialPortException.TYPE_PORT_BUSY);
+        }
+        inputRingCreated = true;
+        try {
+            return serialInterface.readUntil(portHandle, delimiter, buffer, offset, maxLength, frameChecksumType,
+                    timeoutMilliseconds, interruptPollingPeriodMillis, exceptionOnTimeout);
+        } catch (InterruptedException e) {
+            throw new SerialPortException(portName, "readUntil", SerialPortException.TYPE_READ_INTERRUPTED);
+        }
     }
-    
+
     /**
-     * Low level reading data from the port.
-     * 
-     * @param byteCount number of bytes to block and wait for, or 0 to return immediately
-     * with whatever data is available. If timeoutMilliseconds is 0 and byteCount
-     * is positive, then immediately returns with at most byteCount bytes (possibly 0).
+     * Read a frame ending with <b>delimiter</b>, see
+     * {@link #readUntil(byte[], byte[], int, int, long, boolean)}
      *
-     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
-     * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
-     * This argument is ignored if byteCount is set to 0.
+     * @param delimiter bytes ending a frame, 1 to 64 bytes
+     * @param maxLength maximum length of a frame, delimiter included
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for a frame.
+     * Set to 0 to return immediately. If negative, blocks indefinitely.
      *
-     * @param pollPeriodMillis how often to check if the thread has been interrupted. Set
-     * to 0 to disable periodic polling of the thread interrupt status.
+     * @return the frame, delimiter included
+     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * @throws SerialPortTimeoutException if no complete frame arrived within the timeout
      *
+     * @since 2.9.0
+     */
+    public byte[] readUntil(byte[] delimiter, int maxLength, long timeoutMilliseconds) throws SerialPortException {
+        byte[] frame = new byte[maxLength > 0 ? maxLength : 0];
+        int length = readUntil(delimiter, frame, 0, maxLength, timeoutMilliseconds, true);
+        return (length == frame.length ? frame : Arrays.copyOf(frame, length));
+    }
+
+    /**
+     * Read a frame starting with a header which holds the length of the frame data into
+     * a region of an existing array, for binary protocols. The frame is extracted by the
+     * native library as for {@link #readUntil(byte[], byte[], int, int, long, boolean)}.
+     * <br>
+     * If the header gives a frame longer than maxLength, the stream is taken as out of
+     * sync: the first byte of the header is dropped and counted in
+     * {@link SerialPortStatistics#getFramingErrors()}, and the next frame is searched from
+     * the following byte. Without checksum this call then throws an exception, the next
+     * one goes on from there.
+     * <br>
+     * If a checksum is set with {@link #setFrameChecksum(int)}, the last bytes counted by
+     * the length field are the checksum of the previous bytes of the frame, header
+     * included. The frames with a wrong checksum are dropped by the native library and
+     * never returned.
+     *
+     * @param buffer array to store the frame in
+     * @param offset index in buffer of the first byte to store
+     * @param maxLength maximum length of a frame, header included
+     * @param headerLength length of the header, the length field included
+     * @param lengthFieldOffset index of the length field in the header
+     * @param lengthFieldSize size of the length field, 1 to 4 bytes. The field is the
+     * unsigned count of bytes following the header
+     * @param bigEndian true if the most significant byte of the length field comes first
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for a frame.
+     * Set to 0 to return immediately. If negative, blocks indefinitely.
      * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
-     * is set to true and the timeout expires before byteCount bytes are read. If this parameter
-     * is set to false, then upon timeout, this function will return a (possibly length 0)
-     * array of the bytes already read.
-     * 
-     * @return array of read bytes
-     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
+     * is set to true and the timeout expires before a frame is read, otherwise 0 is returned
+     *
+     * @return length of the frame stored into buffer, header included
+     * @throws SerialPortException if the java thread is interrupted while blocking, the frame
+     * is too long and no checksum is set, the port is registered with a selector or some
+     * other error occurred.
      * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     *
+     * @since 2.9.0
      */
-    public byte[] readBytesWithTimeout(int byteCount, 
-            long timeoutMilliseconds, int interruptPollPeriod, 
-            boolean exceptionOnTimeout) throws SerialPortException {
-        
-        checkPortOpened("readBytesWithTimeout()");
+    public int readFrame(byte[] buffer, int offset, int maxLength, int headerLength, int lengthFieldOffset,
+            int lengthFieldSize, boolean bigEndian, long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
+        checkPortOpened("readFrame()");
+        if(buffer == null){
+            throw new SerialPortException(portName, "readFrame()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(lengthFieldSize < 1 || lengthFieldSize > 4 || lengthFieldOffset < 0 || lengthFieldOffset > headerLength - lengthFieldSize ||
+                headerLength > maxLength || offset < 0 || maxLength > buffer.length - offset){
+            throw new SerialPortException(portName, "readFrame()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(selector != null){
+            throw new SerialPortException(portName, "readFrame()", SerialPortException.TYPE_PORT_BUSY);
+        }
+        inputRingCreated = true;
         try {
-            return serialInterface.readBytes(portHandle, byteCount, timeoutMilliseconds, interruptPollPeriod, exceptionOnTimeout);
+            return serialInterface.readFrame(portHandle, buffer, offset, maxLength, headerLength, lengthFieldOffset, lengthFieldSize, bigEndian,
+                    frameChecksumType, timeoutMilliseconds, interruptPollingPeriodMillis, exceptionOnTimeout);
         } catch (InterruptedException e) {
-            throw new SerialPortException(portName, "readBytesWithTimeout", SerialPortException.TYPE_READ_INTERRUPTED);
+            throw new SerialPortException(portName, "readFrame", SerialPortException.TYPE_READ_INTERRUPTED);
         }
     }
-    
+
     /**
-     * Low level reading data from the port.
-     * 
-     * @param byteCount number of bytes to block and wait for, or 0 to return immediately
-     * with whatever data is available. If timeoutMilliseconds is 0 and byteCount
-     * is positive, then immediately returns with at most byteCount bytes (possibly 0).
-     *
-     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
-     * bytes to arrive. Set to 0 to return immediately. If negative, blocks indefinitely.
-     * This argument is ignored if byteCount is set to 0.
-     *
-     * @param exceptionOnTimeout function will throw a SerialPortTimeoutException if this parameter
-     * is set to true and the timeout expires before byteCount bytes are read. If this parameter
-     * is set to false, then upon timeout, this function will return a (possibly length 0)
-     * array of the bytes already read.
-     * 
-     * @return array of read bytes
-     * @throws SerialPortException if the java thread is interrupted while blocking or some other error occurred.
-     * @throws SerialPortTimeoutException if the timeout was reached and exceptionOnTimeout is true
+     * Read a frame starting with a header which holds the length of the frame data, see
+     * {@link #readFrame(byte[], int, int, int, int, int, boolean, long, boolean)}
+     *
+     * @param headerLength length of the header, the length field included
+     * @param lengthFieldOffset index of the length field in the header
+     * @param lengthFieldSize size of the length field, 1 to 4 bytes
+     * @param bigEndian true if the most significant byte of the length field comes first
+     * @param maxLength maximum length of a frame, header included
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for a frame.
+     * Set to 0 to return immediately. If negative, blocks indefinitely.
+     *
+     * @return the frame, header included
+     * @throws SerialPortException if the java thread is interrupted while blocking, the frame
+     * is too long and no checksum is set, the port is registered with a selector or some
+     * other error occurred.
+     * @throws SerialPortTimeoutException if no complete frame arrived within the timeout
+     *
+     * @since 2.9.0
      */
-    public byte[] readBytesWithTimeout(int byteCount,
-            long timeoutMilliseconds, boolean exceptionOnTimeout) throws SerialPortException {
-        return readBytesWithTimeout(byteCount, timeoutMilliseconds, this.interruptPollingPeriodMillis, exceptionOnTimeout);
+    public byte[] readFrame(int headerLength, int lengthFieldOffset, int lengthFieldSize, boolean bigEndian,
+            int maxLength, long timeoutMilliseconds) throws SerialPortException {
+        byte[] frame = new byte[maxLength > 0 ? maxLength : 0];
+        int length = readFrame(frame, 0, maxLength, headerLength, lengthFieldOffset, lengthFieldSize, bigEndian, timeoutMilliseconds, true);
+        return (length == frame.length ? frame : Arrays.copyOf(frame, length));
     }
-    
+
     /**
      * Read a byte array from the port.
      * Blocks until all the data is read, the timeout is hit, or an exception occurs.
@@ -906,6 +1747,51 @@ public class SerialPort {
         return serialInterface.getFlowControlMode(portHandle);
     }
 
+    /**
+     * Wait until all of the data written to the port has been sent, see
+     * {@link #drain(long)}
+     *
+     * @throws SerialPortException if the wait is cancelled or interrupted, or on error
+     *
+     * @since 2.9.0
+     */
+    public void drain() throws SerialPortException {
+        drain(-1);
+    }
+
+    /**
+     * Wait until all of the data written to the port has been sent, down to the last stop
+     * bit where the driver reports it (UARTs on Linux). Request/response protocols can
+     * then turn around at once, without waiting for a TXEMPTY event. The wait can be
+     * stopped by {@link #cancelIO()} and, unless the interrupt polling period is 0, by
+     * {@link Thread#interrupt()}.
+     * <br><br>
+     * <b>Note: </b>USB adapters only report their driver queue, the bytes in the FIFO of
+     * the adapter may still be in transit when this method returns.
+     *
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait. Set to 0 to
+     * only check, if negative, blocks indefinitely.
+     *
+     * @return true once the data has been sent, false if the timeout expired first
+     *
+     * @throws SerialPortException if the wait is cancelled or interrupted, or on error
+     *
+     * @since 2.9.0
+     */
+    public boolean drain(long timeoutMilliseconds) throws SerialPortException {
+        checkPortOpened("drain()");
+        int result;
+        try {
+            result = serialInterface.drainPort(portHandle, timeoutMilliseconds, interruptPollingPeriodMillis);
+        } catch (InterruptedException e) {
+            throw new SerialPortException(portName, "drain()", SerialPortException.TYPE_WRITE_INTERRUPTED);
+        }
+        if(result < 0){
+            throw new SerialPortException(portName, "drain()", SerialPortException.TYPE_UNKNOWN);
+        }
+        return (result > 0);
+    }
+
     /**
      * Send Break singnal for setted duration
      *
@@ -922,8 +1808,190 @@ public class SerialPort {
         return serialInterface.sendBreak(portHandle, duration);
     }
 
-    private int[][] waitEvents() {
-        return serialInterface.waitEvents(portHandle);
+    /**
+     * Enable or disable the low latency mode of the port. The driver is asked to pass
+     * received data on immediately instead of batching it, and on Linux the latency
+     * timer of FTDI adapters is lowered from the default 16 ms to 1 ms (or set back to
+     * 16 ms when disabling). This mostly matters for request/response protocols, where
+     * the round trip time is otherwise dominated by these delays.
+     * <br>
+     * <b>Note: </b>writing the latency timer of an FTDI adapter usually requires root
+     * or a udev rule making <i>/sys/bus/usb-serial/devices/ttyUSBx/latency_timer</i>
+     * writable. On Windows nothing can be changed at run time.
+     *
+     * @param enabled true to enable the low latency mode
+     *
+     * @return combination of {@link #LOW_LATENCY_ASYNC_FLAG} and {@link #LOW_LATENCY_TIMER}
+     * telling what could be applied, 0 if nothing
+     *
+     * @throws SerialPortException if the port is not opened
+     *
+     * @since 2.9.0
+     */
+    public int setLowLatency(boolean enabled) throws SerialPortException {
+        checkPortOpened("setLowLatency()");
+        return serialInterface.setLowLatency(portHandle, enabled);
+    }
+
+    /**
+     * Enable or disable the buffered mode with a ring of
+     * {@link #BUFFERED_MODE_DEFAULT_CAPACITY} bytes
+     *
+     * @param enabled true to enable the buffered mode
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @throws SerialPortException if the port is not opened or is registered with a selector
+     *
+     * @see #setBufferedMode(boolean, int)
+     *
+     * @since 2.9.0
+     */
+    public boolean setBufferedMode(boolean enabled) throws SerialPortException {
+        return setBufferedMode(enabled, BUFFERED_MODE_DEFAULT_CAPACITY);
+    }
+
+    /**
+     * Enable or disable the buffered mode. In buffered mode a native thread drains the input
+     * buffer of the port as soon as data arrives and stores it in a native ring, so the data
+     * is not lost to overruns while no java thread is reading (for example during a garbage
+     * collection). All of the readBytes* methods, {@link SerialInputStream} and
+     * {@link #getInputBufferBytesCount()} then work on the ring. When the ring is full the
+     * port is left alone until some data has been read.
+     * <br><br>
+     * <b>Note: </b>the ring is created when the buffered mode is enabled for the first time
+     * and kept until the port is closed, later calls don't change its capacity. Data left in
+     * the ring when the buffered mode is disabled is read before the input buffer of the port.
+     * A port with a ring can't be registered with a {@link SerialPortSelector}, which only
+     * sees the data the driver holds.
+     *
+     * @param enabled true to enable the buffered mode
+     * @param capacity size of the ring in bytes, rounded up to a power of two
+     *
+     * @return If the operation is successfully completed, the method returns true, otherwise false
+     *
+     * @throws SerialPortException if the port is not opened or is registered with a selector
+     *
+     * @since 2.9.0
+     */
+    public boolean setBufferedMode(boolean enabled, int capacity) throws SerialPortException {
+        checkPortOpened("setBufferedMode()");
+        if(capacity <= 0){
+            throw new SerialPortException(portName, "setBufferedMode()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        if(enabled){
+            if(selector != null){
+                throw new SerialPortException(portName, "setBufferedMode()", SerialPortException.TYPE_PORT_BUSY);
+            }
+            inputRingCreated = true;
+            if(!serialInterface.bufferedReaderStart(portHandle, capacity)){
+                return false;
+            }
+        }
+        else if(!serialInterface.bufferedReaderStop(portHandle)){
+            return false;
+        }
+        bufferedMode = enabled;
+        return true;
+    }
+
+    /**
+     * Getting the buffered mode state
+     *
+     * @return true if the buffered mode is enabled
+     *
+     * @since 2.9.0
+     */
+    public boolean isBufferedMode() {
+        return bufferedMode;
+    }
+
+    /**
+     * Set where and how the reader thread of the buffered mode runs, for lines which
+     * must be drained within a few hundred microseconds to avoid overruns. The thread can
+     * be pinned to some CPUs (an isolated core for instance), given a realtime priority
+     * so the normal threads never delay it, and the ring can be locked in memory so the
+     * thread never waits for a page fault while it stores the received data.
+     * <br><br>
+     * The settings are kept until the port is closed: they are applied at once if the
+     * reader thread is running, and every reader thread started later by
+     * {@link #setBufferedMode(boolean, int)} is created with them. Set before the buffered
+     * mode is enabled, they keep the thread from ever running elsewhere; if the system
+     * refuses them when the thread is created, it starts with the scheduling of the
+     * calling thread.
+     * <br>
+     * <b>Note: </b>on Linux, <b>priority</b> selects SCHED_FIFO with that priority
+     * (clamped to what the system supports) and needs CAP_SYS_NICE or a large enough
+     * RLIMIT_RTPRIO, locking the ring is limited by RLIMIT_MEMLOCK; the CPU mask is ignored
+     * on the other POSIX systems. On Windows any priority above 0 selects
+     * THREAD_PRIORITY_TIME_CRITICAL within the priority class of the process, and the
+     * working set of the process is grown if needed to lock the ring.
+     *
+     * @param cpuMask CPUs the reader thread may run on, bit n for CPU n, or 0 for all of
+     * the CPUs the process may run on (which undoes an earlier mask)
+     * @param priority realtime priority from 1 to {@link #SCHEDULING_MAX_PRIORITY}, or 0
+     * for the normal scheduling
+     * @param lockMemory true to lock the ring in memory, false to let it be paged
+     *
+     * @return combination of {@link #SCHEDULING_AFFINITY}, {@link #SCHEDULING_PRIORITY} and
+     * {@link #SCHEDULING_MEMORY_LOCKED} telling what could be applied at once: 0 for the
+     * thread settings while the buffered mode is disabled, and no
+     * {@link #SCHEDULING_MEMORY_LOCKED} before the ring has been created
+     *
+     * @throws SerialPortException if the port is not opened or the priority is not correct
+     *
+     * @since 2.9.0
+     */
+    public int setBufferedModeScheduling(long cpuMask, int priority, boolean lockMemory) throws SerialPortException {
+        checkPortOpened("setBufferedModeScheduling()");
+        if(priority < 0 || priority > SCHEDULING_MAX_PRIORITY){
+            throw new SerialPortException(portName, "setBufferedModeScheduling()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        return serialInterface.setReaderScheduling(portHandle, cpuMask, priority, lockMemory);
+    }
+
+    //Room for the 11 {event, value} pairs stored by the native library on Linux (since 2.9.0)
+    private static final int EVENTS_BUFFER_LENGTH = 22;
+
+    private int waitEvents(int[] eventBuffer) {
+        return serialInterface.waitEventsInto(portHandle, eventBuffer);
+    }
+
+    /**
+     * Getting the native handle of the port, used by {@link SerialPortSelector}
+     *
+     * @since 2.9.0
+     */
+    long getPortHandle() {
+        return portHandle;
+    }
+
+    /**
+     * Getting whether the native input ring of the buffered mode and of the framed reads
+     * may exist, used by {@link SerialPortSelector}
+     *
+     * @since 2.9.0
+     */
+    boolean hasInputRing() {
+        return inputRingCreated;
+    }
+
+    /**
+     * Getting the selector the port is registered with, or null
+     *
+     * @since 2.9.0
+     */
+    SerialPortSelector getSelector() {
+        return selector;
+    }
+
+    /**
+     * Setting the selector the port is registered with, called by {@link SerialPortSelector}
+     *
+     * @since 2.9.0
+     */
+    void setSelector(SerialPortSelector selector) {
+        this.selector = selector;
     }
 
     /**
@@ -1098,7 +2166,7 @@ public class SerialPort {
      * 
      * @since 0.8
      */
-    private EventThread getNewEventThread() {
+    private EventThread getNewEventThread() throws SerialPortException {
         if(SerialNativeInterface.getOsType() == SerialNativeInterface.OS_LINUX ||
            SerialNativeInterface.getOsType() == SerialNativeInterface.OS_SOLARIS ||
            SerialNativeInterface.getOsType() == SerialNativeInterface.OS_MAC_OS_X){//since 0.9.0
@@ -1138,38 +2206,188 @@ public class SerialPort {
     }
 
     /**
-     * Close port. This method deletes event listener first, then closes the port
+     * Cancel the reads and writes blocked on the port in other threads. They fail at once
+     * with a {@link SerialPortException} of type {@link SerialPortException#TYPE_IO_CANCELLED},
+     * whatever their timeout, while the reads and writes started afterwards are not
+     * affected. {@link #closePort()} cancels them the same way, they then fail with
+     * {@link SerialPortException#TYPE_PORT_NOT_OPENED}.
+     * <br>
+     * Combined with an interrupt polling period of 0 (see
+     * {@link #setInterruptPollingPeriod(int)}), blocking calls without timeout never wake
+     * up until data arrives or they are cancelled.
+     *
+     * @return true if a read or write was in progress
+     *
+     * @throws SerialPortException if the port is not opened
+     *
+     * @since 2.9.0
+     */
+    public boolean cancelIO() throws SerialPortException {
+        checkPortOpened("cancelIO()");
+        return serialInterface.cancelIO(portHandle);
+    }
+
+    /**
+     * Getting a snapshot of the counters of the reads and writes of the port, kept
+     * natively since the port was opened
+     *
+     * @return the statistics of the port
+     *
+     * @throws SerialPortException if the port is not opened
+     *
+     * @since 2.9.0
+     */
+    public SerialPortStatistics getStatistics() throws SerialPortException {
+        return getStatistics(false);
+    }
+
+    /**
+     * Getting a snapshot of the counters of the reads and writes of the port
+     *
+     * @param reset start the counters again from 0 after the snapshot, to measure
+     * intervals
+     *
+     * @return the statistics of the port since it was opened or since the last reset
+     *
+     * @throws SerialPortException if the port is not opened
+     *
+     * @since 2.9.0
+     */
+    public SerialPortStatistics getStatistics(boolean reset) throws SerialPortException {
+        checkPortOpened("getStatistics()");
+        long[] values = serialInterface.getStatistics(portHandle, reset);
+        if(values == null || values.length < SerialPortStatistics.LENGTH){
+            throw new SerialPortException(portName, "getStatistics()", SerialPortException.TYPE_PORT_NOT_OPENED);
+        }
+        return new SerialPortStatistics(portName, values);
+    }
+
+    /**
+     * Start recording the traffic of the port into a file, to inspect it or to replay it
+     * later with the <code>jssc_replay</code> tool. The bytes are copied with a time stamp
+     * into a ring mapped in memory, when it is full the oldest records are overwritten, so
+     * the capture can stay on in production: it costs no system call and a copy per read
+     * or write. The bytes are recorded as they cross the driver, a port in buffered mode
+     * records them when its reader thread receives them. The capture ends with
+     * {@link #stopCapture()} or {@link #closePort()}. The file format is described in
+     * <code>jssc_Capture.h</code>.
+     *
+     * @param fileName path of the capture file, created or truncated
+     * @param capacityBytes size of the ring, rounded up to a power of two between 64 KiB
+     * and 1 GiB
+     *
+     * @return false if the port is already captured or the file can't be created
+     *
+     * @throws SerialPortException if the port is not opened or fileName is null
+     *
+     * @since 2.9.0
+     */
+    public boolean startCapture(String fileName, long capacityBytes) throws SerialPortException {
+        checkPortOpened("startCapture()");
+        if(fileName == null){
+            throw new SerialPortException(portName, "startCapture()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        return serialInterface.captureStart(portHandle, fileName, capacityBytes);
+    }
+
+    /**
+     * Stop the capture started by {@link #startCapture(String, long)}, the file keeps the
+     * records received so far
+     *
+     * @return false if the port wasn't captured
+     *
+     * @throws SerialPortException if the port is not opened
+     *
+     * @since 2.9.0
+     */
+    public boolean stopCapture() throws SerialPortException {
+        checkPortOpened("stopCapture()");
+        return serialInterface.captureStop(portHandle);
+    }
+
+    /**
+     * Set how often the blocking reads and writes check if their thread has been
+     * interrupted, 50 milliseconds by default. Set to 0 to never check: the calls then
+     * don't wake up periodically, and {@link Thread#interrupt()} is not noticed until
+     * they return. Use {@link #cancelIO()} to stop them instead.
+     *
+     * @param periodMillis polling period in milliseconds, 0 to disable polling
+     *
+     * @throws SerialPortException if periodMillis is negative
+     *
+     * @since 2.9.0
+     */
+    public void setInterruptPollingPeriod(int periodMillis) throws SerialPortException {
+        if(periodMillis < 0){
+            throw new SerialPortException(portName, "setInterruptPollingPeriod()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        interruptPollingPeriodMillis = periodMillis;
+    }
+
+    /**
+     * Getting how often the blocking reads and writes check if their thread has been
+     * interrupted
+     *
+     * @return polling period in milliseconds, 0 if polling is disabled
+     *
+     * @since 2.9.0
+     */
+    public int getInterruptPollingPeriod() {
+        return interruptPollingPeriodMillis;
+    }
+
+    /**
+     * Close port. This method deletes event listener first, then closes the port. The
+     * reads and writes in progress in other threads fail with <b>TYPE_PORT_NOT_OPENED</b>,
+     * the port is closed once they have returned (since 2.9.0).
      *
      * @return If the operation is successfully completed, the method returns true, otherwise false
      * 
      * @throws SerialPortException
      */
     public boolean closePort() throws SerialPortException {
-        checkPortOpened("closePort()");
-        if(eventListenerAdded){
-            removeEventListener();
-        }
-        boolean returnValue = serialInterface.closePort(portHandle);
-        if(returnValue){
-            maskAssigned = false;
+        synchronized(stateLock) {
+            checkPortOpened("closePort()");
+            if(eventListenerAdded){
+                removeEventListener();
+            }
+            SerialPortSelector currentSelector = selector;
+            if(currentSelector != null){
+                currentSelector.unregister(this);
+            }
+            //since 2.9.0 the calls starting from now fail, those in progress are cancelled and
+            //waited for by the native close
             portOpened = false;
+            boolean returnValue = serialInterface.closePort(portHandle);
+            if(returnValue){
+                maskAssigned = false;
+                bufferedMode = false;
+                inputRingCreated = false;
+                rs485Mode = RS485_MODE_OFF;
+            }
+            else {
+                portOpened = true;
+            }
+            return returnValue;
         }
-        return returnValue;
     }
 
-    private EventThread eventThread;
+    private volatile EventThread eventThread;
 
     private class EventThread extends Thread {
 
-        private boolean threadTerminated = false;
+        private volatile boolean threadTerminated = false;
         
+        //Reused by every wait (since 2.9.0)
+        final int[] eventBuffer = new int[EVENTS_BUFFER_LENGTH];
+
         @Override
         public void run() {
             while(!threadTerminated){
-                int[][] eventArray = waitEvents();
-                for(int i = 0; i < eventArray.length; i++){
-                    if(eventArray[i][0] > 0 && !threadTerminated){
-                        eventListener.serialEvent(new SerialPortEvent(portName, eventArray[i][0], eventArray[i][1]));
+                int eventsCount = getEventsCount(waitNextEvents());
+                for(int i = 0; i < eventsCount; i++){
+                    if(eventBuffer[i * 2] > 0 && !threadTerminated){
+                        eventListener.serialEvent(new SerialPortEvent(portName, eventBuffer[i * 2], eventBuffer[i * 2 + 1]));
                         //FIXME
                         /*if(methodErrorOccurred != null){
                             try {
@@ -1184,188 +2402,69 @@ public class SerialPort {
             }
         }
 
-        private void terminateThread(){
+        void terminateThread(){
             threadTerminated = true;
         }
+
+        //Store the next events in eventBuffer and return the bitmask of their types
+        int waitNextEvents(){
+            return waitEvents(eventBuffer);
+        }
+
+        //The stored event types are distinct flags, so their count is the count of bits
+        int getEventsCount(int eventsMask){
+            return (eventsMask > 0 ? Integer.bitCount(eventsMask) : 0);
+        }
     }
 
     /**
      * EventListener for Linux OS
      *
+     * Since 2.9.0 the events are detected and filtered by the native event waiter, which
+     * blocks until one of them occurs.
+     *
      * @since 0.8
      */
     private class LinuxEventThread extends EventThread {
 
-        //Essential interruptions for events: BREAK, ERR, TXEMPTY
-        private final int INTERRUPT_BREAK = 512;
-        private final int INTERRUPT_TX = 1024;
-        private final int INTERRUPT_FRAME = 2048;
-        private final int INTERRUPT_OVERRUN = 4096;
-        private final int INTERRUPT_PARITY = 8192;
-
-        //Count of interruptions
-        private int interruptBreak;
-        private int interruptTX;
-        private int interruptFrame;
-        private int interruptOverrun;
-        private int interruptParity;
-
-        //Previous states if lines (then state change event will be generated)
-        private int preCTS;
-        private int preDSR;
-        private int preRLSD;
-        private int preRING;
-
-        //Need to get initial states
-        public LinuxEventThread(){
-            int[][] eventArray = waitEvents();
-            for(int i = 0; i < eventArray.length; i++){
-                int eventType = eventArray[i][0];
-                int eventValue = eventArray[i][1];
-                switch(eventType){
-                    case INTERRUPT_BREAK:
-                        interruptBreak = eventValue;
-                        break;
-                    case INTERRUPT_TX:
-                        interruptTX = eventValue;
-                        break;
-                    case INTERRUPT_FRAME:
-                        interruptFrame = eventValue;
-                        break;
-                    case INTERRUPT_OVERRUN:
-                        interruptOverrun = eventValue;
-                        break;
-                    case INTERRUPT_PARITY:
-                        interruptParity = eventValue;
-                        break;
-                    case MASK_CTS:
-                        preCTS = eventValue;
-                        break;
-                    case MASK_DSR:
-                        preDSR = eventValue;
-                        break;
-                    case MASK_RING:
-                        preRING = eventValue;
-                        break;
-                    case MASK_RLSD:
-                        preRLSD = eventValue;
-                        break;
-                }
+        private final Object waiterLock = new Object();
+        private long waiterHandle;
+
+        public LinuxEventThread() throws SerialPortException {
+            waiterHandle = serialInterface.eventWaiterOpen(portHandle);
+            if(waiterHandle == -1){
+                throw new SerialPortException(portName, "addEventListener()", SerialPortException.TYPE_UNKNOWN);
             }
         }
 
         @Override
         public void run() {
-            while(!super.threadTerminated){
-                int[][] eventArray = waitEvents();
-                int mask = getLinuxMask();
-                boolean interruptTxChanged = false;
-                int errorMask = 0;
-                for(int i = 0; i < eventArray.length; i++){
-                    boolean sendEvent = false;
-                    int eventType = eventArray[i][0];
-                    int eventValue = eventArray[i][1];
-                    if(eventType > 0 && !super.threadTerminated){
-                        switch(eventType){
-                            case INTERRUPT_BREAK:
-                                if(eventValue != interruptBreak){
-                                    interruptBreak = eventValue;
-                                    if((mask & MASK_BREAK) == MASK_BREAK){
-                                        eventType = MASK_BREAK;
-                                        eventValue = 0;
-                                        sendEvent = true;
-                                    }
-                                }
-                                break;
-                            case INTERRUPT_TX:
-                                if(eventValue != interruptTX){
-                                    interruptTX = eventValue;
-                                    interruptTxChanged = true;
-                                }
-                                break;
-                            case INTERRUPT_FRAME:
-                                if(eventValue != interruptFrame){
-                                    interruptFrame = eventValue;
-                                    errorMask |= ERROR_FRAME;
-                                }
-                                break;
-                            case INTERRUPT_OVERRUN:
-                                if(eventValue != interruptOverrun){
-                                    interruptOverrun = eventValue;
-                                    errorMask |= ERROR_OVERRUN;
-                                }
-                                break;
-                            case INTERRUPT_PARITY:
-                                if(eventValue != interruptParity){
-                                    interruptParity = eventValue;
-                                    errorMask |= ERROR_PARITY;
-                                }
-                                if((mask & MASK_ERR) == MASK_ERR && errorMask != 0){
-                                    eventType = MASK_ERR;
-                                    eventValue = errorMask;
-                                    sendEvent = true;
-                                }
-                                break;
-                            case MASK_CTS:
-                                if(eventValue != preCTS){
-                                    preCTS = eventValue;
-                                    if((mask & MASK_CTS) == MASK_CTS){
-                                        sendEvent = true;
-                                    }
-                                }
-                                break;
-                            case MASK_DSR:
-                                if(eventValue != preDSR){
-                                    preDSR = eventValue;
-                                    if((mask & MASK_DSR) == MASK_DSR){
-                                        sendEvent = true;
-                                    }
-                                }
-                                break;
-                            case MASK_RING:
-                                if(eventValue != preRING){
-                                    preRING = eventValue;
-                                    if((mask & MASK_RING) == MASK_RING){
-                                        sendEvent = true;
-                                    }
-                                }
-                                break;
-                            case MASK_RLSD: /*DCD*/
-                                if(eventValue != preRLSD){
-                                    preRLSD = eventValue;
-                                    if((mask & MASK_RLSD) == MASK_RLSD){
-                                        sendEvent = true;
-                                    }
-                                }
-                                break;
-                            case MASK_RXCHAR:
-                                if(((mask & MASK_RXCHAR) == MASK_RXCHAR) && (eventValue > 0)){
-                                    sendEvent = true;
-                                }
-                                break;
-                            /*case MASK_RXFLAG:
-                                //Do nothing at this moment
-                                if(((mask & MASK_RXFLAG) == MASK_RXFLAG) && (eventValue > 0)){
-                                    sendEvent = true;
-                                }
-                                break;*/
-                            case MASK_TXEMPTY:
-                                if(((mask & MASK_TXEMPTY) == MASK_TXEMPTY) && (eventValue == 0) && interruptTxChanged){
-                                    sendEvent = true;
-                                }
-                                break;
-                        }
-                        if(sendEvent){
-                            eventListener.serialEvent(new SerialPortEvent(portName, eventType, eventValue));
-                        }
-                    }
-                }
-                //Need to sleep some time
-                try {
-                    Thread.sleep(0, 100);
+            try {
+                super.run();
+            }
+            finally {
+                synchronized(waiterLock){
+                    serialInterface.eventWaiterClose(waiterHandle);
+                    waiterHandle = -1;
                 }
-                catch (Exception ex) {
-                    //Do nothing
+            }
+        }
+
+        @Override
+        int waitNextEvents(){
+            int eventsMask = serialInterface.eventWaiterWait(waiterHandle, eventBuffer);
+            if(eventsMask == -1){
+                super.terminateThread();//The port has been closed or the device removed
+            }
+            return eventsMask;
+        }
+
+        @Override
+        void terminateThread(){
+            super.terminateThread();
+            synchronized(waiterLock){
+                if(waiterHandle != -1){
+                    serialInterface.eventWaiterCancel(waiterHandle);
                 }
             }
         }
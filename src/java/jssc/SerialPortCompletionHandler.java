@@ -0,0 +1,52 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ */
+package jssc;
+
+/**
+ * Receives the result of an asynchronous read or write started with
+ * {@link SerialPortReactor}. Exactly one of the methods is called per operation,
+ * unless the operation is cancelled.
+ *
+ * @since 2.9.0
+ */
+public interface SerialPortCompletionHandler {
+
+    /**
+     * The operation completed
+     *
+     * @param port port of the operation
+     * @param byteCount number of bytes transferred
+     */
+    public void completed(SerialPort port, int byteCount);
+
+    /**
+     * The operation failed. A {@link SerialPortTimeoutException} is given if the
+     * timeout expired and the operation was started with exceptionOnTimeout set.
+     *
+     * @param port port of the operation
+     * @param exception cause of the failure
+     */
+    public void failed(SerialPort port, SerialPortException exception);
+}
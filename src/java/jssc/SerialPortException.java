@@ -70,6 +70,10 @@ public class SerialPortException extends IOException {
      * @since 2.9.0
      */
     final public static String TYPE_READ_INTERRUPTED = "Thread was interrupted while reading";
+    /**
+     * @since 2.9.0
+     */
+    final public static String TYPE_WRITE_INTERRUPTED = "Thread was interrupted while writing";
     /**
      * @since 2.9.0
      */
@@ -78,6 +82,14 @@ public class SerialPortException extends IOException {
      * @since 2.9.0
      */
     final public static String TYPE_UNKNOWN = "An unknown error occurred";
+    /**
+     * @since 2.9.0
+     */
+    final public static String TYPE_SELECTOR_CLOSED = "Selector closed";
+    /**
+     * @since 2.9.0
+     */
+    final public static String TYPE_IO_CANCELLED = "I/O cancelled";
 
     private String portName;
     private String methodName;
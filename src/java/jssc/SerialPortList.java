@@ -25,8 +25,13 @@
 package jssc;
 
 import java.io.File;
+import java.util.ArrayList;
 import java.util.Comparator;
+import java.util.HashSet;
+import java.util.List;
+import java.util.Set;
 import java.util.TreeSet;
+import java.util.concurrent.CopyOnWriteArrayList;
 import java.util.regex.Pattern;
 
 /**
@@ -39,6 +44,18 @@ public class SerialPortList {
     private static final Pattern PORTNAMES_REGEXP;
     private static final String PORTNAMES_PATH;
 
+    //since 2.9.0 ->
+    //Interval of the rescans when the system has no hot-plug notification
+    private static final long WATCHER_POLL_PERIOD_MILLIS = 1000;
+    //Quiet time waited after a notification, the events of a device come in bursts
+    private static final long WATCHER_SETTLE_MILLIS = 100;
+
+    private static final List<SerialPortListListener> listeners = new CopyOnWriteArrayList<SerialPortListListener>();
+    private static final Object watcherLock = new Object();
+    private static PortListWatcher watcher = null;//Guarded by watcherLock
+    private static volatile String[] cachedPortNames = null;//Native list kept up to date by the watcher
+    //<- since 2.9.0
+
     static {
         serialInterface = new SerialNativeInterface();
         switch (SerialNativeInterface.getOsType()) {
@@ -158,6 +175,12 @@ public class SerialPortList {
     
     /**
      * Get sorted array of serial ports in the system using default settings:<br>
+     * <br>
+     * Since 2.9.0 the ports of the default search path are listed natively on Linux
+     * (from sysfs), Mac OS X (from IOKit) and Windows (from the registry), none of them is
+     * opened. While a {@link SerialPortListListener} is added, the list is cached and kept
+     * up to date by the hot-plug watcher.
+     * <br>
      *
      * <b>Search path</b><br>
      * Windows - ""(always ignored)<br>
@@ -293,6 +316,13 @@ public class SerialPortList {
         if(SerialNativeInterface.getOsType() == SerialNativeInterface.OS_WINDOWS){
             return getWindowsPortNames(pattern, comparator);
         }
+        //since 2.9.0 the ports of the default search path are listed natively where possible
+        if(PORTNAMES_PATH != null && (searchPath.endsWith("/") ? searchPath : searchPath + "/").equals(PORTNAMES_PATH)){
+            String[] portNames = getNativePortNames();
+            if(portNames != null){
+                return filterPortNames(portNames, pattern, comparator);
+            }
+        }
         return getUnixBasedPortNames(searchPath, pattern, comparator);
     }
 
@@ -302,19 +332,234 @@ public class SerialPortList {
      * @since 2.3.0
      */
     private static String[] getWindowsPortNames(Pattern pattern, Comparator<String> comparator) {
-        String[] portNames = serialInterface.getSerialPortNames();
+        String[] portNames = getNativePortNames();
         if(portNames == null){
             return new String[]{};
         }
+        return filterPortNames(portNames, pattern, comparator);
+    }
+
+    /**
+     * Sort the port names whose last path element matches pattern
+     *
+     * @since 2.9.0
+     */
+    private static String[] filterPortNames(String[] portNames, Pattern pattern, Comparator<String> comparator) {
         TreeSet<String> ports = new TreeSet<String>(comparator);
         for(String portName : portNames){
-            if(pattern.matcher(portName).find()){
+            if(pattern.matcher(portName.substring(portName.lastIndexOf('/') + 1)).find()){
                 ports.add(portName);
             }
         }
         return ports.toArray(new String[ports.size()]);
     }
 
+    /**
+     * Native list of the ports, from the cache while the watcher runs. Returns null if
+     * the system has no native enumeration.
+     *
+     * @since 2.9.0
+     */
+    private static String[] getNativePortNames() {
+        String[] portNames = cachedPortNames;
+        return (portNames != null ? portNames : listNativePortNames());
+    }
+
+    /**
+     * @since 2.9.0
+     */
+    private static String[] listNativePortNames() {
+        String[] portNames = serialInterface.getSerialPortNames();
+        if(portNames == null){
+            return null;
+        }
+        //Drop the entries which couldn't be read
+        List<String> names = new ArrayList<String>(portNames.length);
+        for(String portName : portNames){
+            if(portName != null){
+                names.add(portName);
+            }
+        }
+        return names.toArray(new String[names.size()]);
+    }
+
+    /**
+     * Add a listener notified when serial ports are added to or removed from the system.
+     * The first listener starts the watcher thread, which waits for the hot-plug
+     * notifications of the system (kernel uevents on Linux, changes of the device map in
+     * the registry on Windows) or else rescans the ports every second. While it runs,
+     * {@link #getPortNames()} returns the ports from its cache.
+     *
+     * @param listener listener to add
+     *
+     * @since 2.9.0
+     */
+    public static void addPortListListener(SerialPortListListener listener) {
+        if(listener == null){
+            return;
+        }
+        synchronized(watcherLock){
+            listeners.add(listener);
+            if(watcher == null){
+                watcher = new PortListWatcher();
+                watcher.start();
+            }
+        }
+    }
+
+    /**
+     * Remove a listener added by {@link #addPortListListener(SerialPortListListener)}. The
+     * watcher thread stops with the last listener.
+     *
+     * @param listener listener to remove
+     *
+     * @since 2.9.0
+     */
+    public static void removePortListListener(SerialPortListListener listener) {
+        synchronized(watcherLock){
+            listeners.remove(listener);
+            if(listeners.isEmpty() && watcher != null){
+                watcher.terminate();
+                watcher = null;
+                cachedPortNames = null;
+            }
+        }
+    }
+
+    /**
+     * Thread keeping the cached port list up to date and notifying the listeners
+     *
+     * @since 2.9.0
+     */
+    private static class PortListWatcher extends Thread {
+
+        private volatile boolean terminated = false;
+        private long watcherHandle = -1;//Guarded by this, closed by the thread itself
+
+        PortListWatcher() {
+            super("SerialPortListWatcher");
+            setDaemon(true);
+        }
+
+        @Override
+        public void run() {
+            long handle = serialInterface.portWatcherOpen();
+            synchronized(this){
+                watcherHandle = handle;
+            }
+            Set<String> current = scan();
+            while(!terminated){
+                if(!awaitChange()){
+                    continue;
+                }
+                Set<String> next = scan();
+                List<String> added = new ArrayList<String>();
+                List<String> removed = new ArrayList<String>();
+                for(String portName : next){
+                    if(!current.contains(portName)){
+                        added.add(portName);
+                    }
+                }
+                for(String portName : current){
+                    if(!next.contains(portName)){
+                        removed.add(portName);
+                    }
+                }
+                current = next;
+                if(terminated || (added.isEmpty() && removed.isEmpty())){
+                    continue;
+                }
+                String[] addedPorts = added.toArray(new String[added.size()]);
+                String[] removedPorts = removed.toArray(new String[removed.size()]);
+                for(SerialPortListListener listener : listeners){
+                    try {
+                        listener.portListChanged(addedPorts, removedPorts);
+                    }
+                    catch (RuntimeException ex) {
+                        //A failing listener must not stop the others
+                    }
+                }
+            }
+            synchronized(this){
+                if(watcherHandle != -1){
+                    serialInterface.portWatcherClose(watcherHandle);
+                    watcherHandle = -1;
+                }
+            }
+        }
+
+        void terminate() {
+            synchronized(this){
+                terminated = true;
+                if(watcherHandle != -1){
+                    serialInterface.portWatcherWakeup(watcherHandle);
+                }
+                notifyAll();
+            }
+        }
+
+        /**
+         * Wait for a notification followed by quiet time, or for the polling period if
+         * the system has no notification. Returns false if there is nothing to rescan.
+         */
+        private boolean awaitChange() {
+            long handle;
+            synchronized(this){
+                handle = watcherHandle;
+                if(handle == -1){
+                    try {
+                        if(!terminated){
+                            wait(WATCHER_POLL_PERIOD_MILLIS);
+                        }
+                    }
+                    catch (InterruptedException ex) {
+                        terminated = true;
+                    }
+                    return !terminated;
+                }
+            }
+            int result = serialInterface.portWatcherWait(handle, -1);
+            if(result < 0){
+                //Fall back to polling
+                synchronized(this){
+                    serialInterface.portWatcherClose(watcherHandle);
+                    watcherHandle = -1;
+                }
+                return false;
+            }
+            if(result == 0){
+                return false;
+            }
+            while(!terminated && serialInterface.portWatcherWait(handle, WATCHER_SETTLE_MILLIS) > 0){
+                //Wait until the device events are over
+            }
+            return !terminated;
+        }
+
+        /**
+         * List the ports and publish the native list to the cache
+         */
+        private Set<String> scan() {
+            String[] portNames = listNativePortNames();
+            if(portNames == null && SerialNativeInterface.getOsType() == SerialNativeInterface.OS_WINDOWS){
+                portNames = new String[]{};//No SERIALCOMM key, no port
+            }
+            synchronized(watcherLock){
+                if(watcher == this && !terminated){
+                    cachedPortNames = portNames;
+                }
+            }
+            if(portNames == null){
+                portNames = (PORTNAMES_PATH != null ? getUnixBasedPortNames(PORTNAMES_PATH, PORTNAMES_REGEXP, PORTNAMES_COMPARATOR) : new String[]{});
+            }
+            Set<String> names = new HashSet<String>();
+            for(String portName : portNames){
+                names.add(portName);
+            }
+            return names;
+        }
+    }
+
     /**
      * Universal method for getting port names of _nix based systems
      */
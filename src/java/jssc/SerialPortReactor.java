@@ -0,0 +1,632 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ */
+package jssc;
+
+import java.util.ArrayList;
+import java.util.IdentityHashMap;
+import java.util.Iterator;
+import java.util.LinkedList;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.CancellationException;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.Executor;
+import java.util.concurrent.Future;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.TimeoutException;
+
+/**
+ * Asynchronous reads and writes on many serial ports, served by a single thread.
+ * <br>
+ * The reactor thread waits on a {@link SerialPortSelector} (epoll on Linux, kqueue on
+ * Mac OS X, an I/O completion port on Windows) for the ports which have pending
+ * operations, and moves the data with non blocking native calls as soon as a port is
+ * ready. Each operation is given as a region of an array, completed when the whole
+ * region has been transferred, and reported through the returned {@link Future} and
+ * the optional {@link SerialPortCompletionHandler}.
+ * <br>
+ * Typical usage:
+ * <pre>
+ * SerialPortReactor reactor = new SerialPortReactor();
+ * reactor.readAsync(port, frame, 0, frame.length, 1000, true, new SerialPortCompletionHandler(){
+ *     public void completed(SerialPort port, int byteCount){ ... }
+ *     public void failed(SerialPort port, SerialPortException exception){ ... }
+ * });
+ * </pre>
+ * The handlers are called by the reactor thread unless an {@link Executor} is given,
+ * so they must not block. The operations of a port are served in the order they were
+ * started, reads and writes independently of each other.
+ * <br>
+ * <b>Note: </b>a port served by a reactor is registered with its selector, so the
+ * restrictions of {@link SerialPortSelector} apply: the port can't be registered with
+ * another selector, be in buffered mode or (on Windows) have an event listener.
+ *
+ * @since 2.9.0
+ */
+public class SerialPortReactor {
+
+    //How often the ports with operations without timeout are checked for being closed
+    private static final long CHECK_PERIOD_MILLIS = 1000;
+
+    private final SerialPortSelector selector;
+    private final Executor callbackExecutor;
+    private final Thread reactorThread;
+    private final List<Operation> submitted = new ArrayList<Operation>();
+    private volatile boolean closed = false;
+    private volatile int threadScheduling = 0;
+
+    //Only accessed by the reactor thread
+    private final Map<SerialPort, PortOperations> ports = new IdentityHashMap<SerialPort, PortOperations>();
+
+    /**
+     * Create a new reactor and start its thread. The handlers are called by the reactor
+     * thread.
+     *
+     * @throws SerialPortException if the native selector couldn't be created
+     */
+    public SerialPortReactor() throws SerialPortException {
+        this(null);
+    }
+
+    /**
+     * Create a new reactor and start its thread
+     *
+     * @param callbackExecutor executor calling the handlers, or null to call them from
+     * the reactor thread
+     *
+     * @throws SerialPortException if the native selector couldn't be created
+     */
+    public SerialPortReactor(Executor callbackExecutor) throws SerialPortException {
+        this(callbackExecutor, 0, -1);
+    }
+
+    /**
+     * Create a new reactor whose thread runs on some CPUs and/or with a realtime
+     * priority, as {@link SerialPort#setBufferedModeScheduling(long, int, boolean)} does for
+     * the reader thread of a port. The handlers called by the reactor thread run with the
+     * same scheduling, so with a realtime priority they must be short.
+     *
+     * @param callbackExecutor executor calling the handlers, or null to call them from
+     * the reactor thread
+     * @param cpuMask CPUs the reactor thread may run on, bit n for CPU n, or 0 for the
+     * CPUs of the process
+     * @param priority realtime priority from 1 to {@link SerialPort#SCHEDULING_MAX_PRIORITY},
+     * 0 for the normal scheduling, or -1 to change neither the priority nor the affinity
+     *
+     * @throws SerialPortException if the native selector couldn't be created or the
+     * priority is not correct
+     *
+     * @see #getThreadScheduling()
+     *
+     * @since 2.9.0
+     */
+    public SerialPortReactor(Executor callbackExecutor, final long cpuMask, final int priority) throws SerialPortException {
+        if(priority < -1 || priority > SerialPort.SCHEDULING_MAX_PRIORITY){
+            throw new SerialPortException("SerialPortReactor", "SerialPortReactor()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        this.callbackExecutor = callbackExecutor;
+        selector = new SerialPortSelector();
+        final CountDownLatch scheduled = new CountDownLatch(1);
+        reactorThread = new Thread(new Runnable() {
+            public void run() {
+                try {
+                    if(priority >= 0){
+                        threadScheduling = new SerialNativeInterface().setThreadScheduling(cpuMask, priority);
+                    }
+                } finally {
+                    scheduled.countDown();
+                }
+                runReactor();
+            }
+        }, "SerialPortReactor");
+        reactorThread.setDaemon(true);
+        reactorThread.start();
+        boolean interrupted = false;
+        while(true){
+            try {
+                scheduled.await();
+                break;
+            } catch (InterruptedException e) {
+                interrupted = true;
+            }
+        }
+        if(interrupted){
+            Thread.currentThread().interrupt();
+        }
+    }
+
+    /**
+     * Getting what could be applied of the scheduling requested for the reactor thread
+     *
+     * @return combination of {@link SerialPort#SCHEDULING_AFFINITY} and
+     * {@link SerialPort#SCHEDULING_PRIORITY}, 0 if nothing was requested or could be applied
+     *
+     * @since 2.9.0
+     */
+    public int getThreadScheduling() {
+        return threadScheduling;
+    }
+
+    /**
+     * Start reading <b>byteCount</b> bytes from the port into a region of an array
+     *
+     * @param port opened port
+     * @param buffer array to store the read bytes in, must not be used until the
+     * operation is done
+     * @param offset index in buffer of the first byte to store
+     * @param byteCount number of bytes to read
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for byteCount
+     * bytes. If negative, waits indefinitely.
+     * @param exceptionOnTimeout if true the operation fails with a
+     * {@link SerialPortTimeoutException} when the timeout expires, otherwise it completes
+     * with the count of bytes already read
+     * @param handler called when the operation is done, may be null
+     *
+     * @return future giving the number of bytes read
+     *
+     * @throws SerialPortException if the reactor is closed, the port is not opened or a
+     * parameter is not correct
+     */
+    public Future<Integer> readAsync(SerialPort port, byte[] buffer, int offset, int byteCount, long timeoutMilliseconds,
+            boolean exceptionOnTimeout, SerialPortCompletionHandler handler) throws SerialPortException {
+        return submit(port, false, buffer, offset, byteCount, timeoutMilliseconds, exceptionOnTimeout, handler, "readAsync()");
+    }
+
+    /**
+     * Start writing <b>byteCount</b> bytes from a region of an array to the port
+     *
+     * @param port opened port
+     * @param buffer array holding the bytes to write, must not be modified until the
+     * operation is done
+     * @param offset index in buffer of the first byte to write
+     * @param byteCount number of bytes to write
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait for the port
+     * to accept all of the data. If negative, waits indefinitely.
+     * @param exceptionOnTimeout if true the operation fails with a
+     * {@link SerialPortTimeoutException} when the timeout expires, otherwise it completes
+     * with the count of bytes already written
+     * @param handler called when the operation is done, may be null
+     *
+     * @return future giving the number of bytes written
+     *
+     * @throws SerialPortException if the reactor is closed, the port is not opened or a
+     * parameter is not correct
+     */
+    public Future<Integer> writeAsync(SerialPort port, byte[] buffer, int offset, int byteCount, long timeoutMilliseconds,
+            boolean exceptionOnTimeout, SerialPortCompletionHandler handler) throws SerialPortException {
+        return submit(port, true, buffer, offset, byteCount, timeoutMilliseconds, exceptionOnTimeout, handler, "writeAsync()");
+    }
+
+    /**
+     * Getting reactor state
+     *
+     * @return true if the reactor is not closed
+     */
+    public boolean isOpened() {
+        return !closed;
+    }
+
+    /**
+     * Close the reactor. The pending operations fail with a {@link SerialPortException}
+     * of type {@link SerialPortException#TYPE_SELECTOR_CLOSED}, the ports are unregistered
+     * but not closed.
+     */
+    public void close() {
+        synchronized(submitted){
+            if(closed){
+                return;
+            }
+            closed = true;
+        }
+        selector.wakeup();
+        if(Thread.currentThread() != reactorThread){
+            try {
+                reactorThread.join();
+            } catch (InterruptedException e) {
+                Thread.currentThread().interrupt();
+            }
+        }
+    }
+
+    private Future<Integer> submit(SerialPort port, boolean write, byte[] buffer, int offset, int byteCount, long timeoutMilliseconds,
+            boolean exceptionOnTimeout, SerialPortCompletionHandler handler, String methodName) throws SerialPortException {
+        if(port == null || buffer == null){
+            throw new SerialPortException("SerialPortReactor", methodName, SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(!port.isOpened()){
+            throw new SerialPortException(port.getPortName(), methodName, SerialPortException.TYPE_PORT_NOT_OPENED);
+        }
+        if(offset < 0 || byteCount < 0 || byteCount > buffer.length - offset){
+            throw new SerialPortException(port.getPortName(), methodName, SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        long deadline = (timeoutMilliseconds >= 0 ? System.nanoTime() + TimeUnit.MILLISECONDS.toNanos(timeoutMilliseconds) : 0);
+        Operation operation = new Operation(port, write, buffer, offset, byteCount, deadline, timeoutMilliseconds,
+                                            exceptionOnTimeout, handler, methodName);
+        synchronized(submitted){
+            if(closed){
+                throw new SerialPortException("SerialPortReactor", methodName, SerialPortException.TYPE_SELECTOR_CLOSED);
+            }
+            submitted.add(operation);
+        }
+        selector.wakeup();
+        return operation;
+    }
+
+    private void runReactor() {
+        List<Operation> batch = new ArrayList<Operation>();
+        try {
+            while(true){
+                synchronized(submitted){
+                    if(closed){
+                        break;
+                    }
+                    batch.addAll(submitted);
+                    submitted.clear();
+                }
+                for(Operation operation : batch){
+                    accept(operation);
+                }
+                batch.clear();
+                long waitMillis = expire(System.nanoTime());
+                int count = selector.select(waitMillis);
+                for(int i = 0; i < count; i++){
+                    PortOperations operations = ports.get(selector.getSelectedPort(i));
+                    if(operations != null){
+                        operations.serve(selector.getSelectedOps(i));
+                        if(updateInterest(operations)){
+                            ports.remove(operations.port);
+                        }
+                    }
+                }
+            }
+        } catch (SerialPortException e) {
+            //The selector is broken, the operations can't complete any more
+            synchronized(submitted){
+                closed = true;
+            }
+        }
+        SerialPortException exception = new SerialPortException("SerialPortReactor", "close()", SerialPortException.TYPE_SELECTOR_CLOSED);
+        synchronized(submitted){
+            batch.addAll(submitted);
+            submitted.clear();
+        }
+        for(Operation operation : batch){
+            complete(operation, 0, exception);
+        }
+        for(PortOperations operations : ports.values()){
+            operations.failAll(exception);
+        }
+        ports.clear();
+        selector.close();
+    }
+
+    private void accept(Operation operation) {
+        if(operation.length == 0){
+            complete(operation, 0, null);
+            return;
+        }
+        PortOperations operations = ports.get(operation.port);
+        if(operations == null){
+            operations = new PortOperations(operation.port);
+            ports.put(operation.port, operations);
+        }
+        (operation.write ? operations.writes : operations.reads).add(operation);
+        if(updateInterest(operations)){
+            ports.remove(operation.port);
+        }
+    }
+
+    /**
+     * Drop the cancelled operations, fail the expired ones and those of the closed ports.
+     * Returns how long the selector may wait until the next deadline.
+     */
+    private long expire(long now) {
+        long waitMillis = -1;
+        Iterator<PortOperations> iterator = ports.values().iterator();
+        while(iterator.hasNext()){
+            PortOperations operations = iterator.next();
+            if(!operations.port.isOpened()){
+                operations.failAll(new SerialPortException(operations.port.getPortName(), "runReactor()",
+                                                           SerialPortException.TYPE_PORT_NOT_OPENED));
+            }
+            long readWait = expire(operations.reads, now);
+            long writeWait = expire(operations.writes, now);
+            if(updateInterest(operations)){
+                iterator.remove();
+                continue;
+            }
+            waitMillis = earliest(waitMillis, earliest(readWait, writeWait));
+            //Operations without timeout still need the port to be checked for being closed
+            waitMillis = earliest(waitMillis, CHECK_PERIOD_MILLIS);
+        }
+        return waitMillis;
+    }
+
+    private long expire(LinkedList<Operation> queue, long now) {
+        long waitMillis = -1;
+        Iterator<Operation> iterator = queue.iterator();
+        while(iterator.hasNext()){
+            Operation operation = iterator.next();
+            if(operation.isDone()){
+                iterator.remove();
+            }
+            else if(operation.timeoutMilliseconds >= 0 && now - operation.deadline >= 0){
+                iterator.remove();
+                if(operation.exceptionOnTimeout){
+                    complete(operation, 0, new SerialPortTimeoutException(operation.port.getPortName(), operation.methodName,
+                                                                          operation.timeoutMilliseconds));
+                }
+                else {
+                    complete(operation, operation.transferred, null);
+                }
+            }
+            else if(operation.timeoutMilliseconds >= 0){
+                waitMillis = earliest(waitMillis, toMillis(operation.deadline - now));
+            }
+        }
+        return waitMillis;
+    }
+
+    /**
+     * Milliseconds of a positive System.nanoTime() difference, rounded up so that a wait
+     * does not end just before its deadline
+     */
+    private static long toMillis(long nanos) {
+        return nanos / 1000000L + (nanos % 1000000L > 0 ? 1 : 0);
+    }
+
+    private static long earliest(long waitMillis, long otherMillis) {
+        if(waitMillis < 0){
+            return otherMillis;
+        }
+        return (otherMillis < 0 || waitMillis < otherMillis ? waitMillis : otherMillis);
+    }
+
+    /**
+     * Register the port for the operations it has pending, or unregister it if it has
+     * none. Returns true if the port has no operation left, the caller then drops it.
+     */
+    private boolean updateInterest(PortOperations operations) {
+        int ops = (operations.reads.isEmpty() ? 0 : SerialPortSelector.OP_READ) |
+                  (operations.writes.isEmpty() ? 0 : SerialPortSelector.OP_WRITE);
+        if(ops != operations.registeredOps){
+            if(ops == 0){
+                selector.unregister(operations.port);
+            }
+            else {
+                try {
+                    selector.register(operations.port, ops);
+                } catch (SerialPortException e) {
+                    operations.failAll(e);
+                    ops = 0;
+                }
+            }
+            operations.registeredOps = ops;
+        }
+        return (ops == 0);
+    }
+
+    private void complete(final Operation operation, final int byteCount, final SerialPortException exception) {
+        if(!operation.finish(byteCount, exception) || operation.handler == null){
+            return;
+        }
+        Runnable callback = new Runnable() {
+            public void run() {
+                if(exception == null){
+                    operation.handler.completed(operation.port, byteCount);
+                }
+                else {
+                    operation.handler.failed(operation.port, exception);
+                }
+            }
+        };
+        try {
+            if(callbackExecutor != null){
+                callbackExecutor.execute(callback);
+            }
+            else {
+                callback.run();
+            }
+        } catch (RuntimeException e) {
+            //A failing handler must not stop the other ports
+        }
+    }
+
+    /**
+     * Pending operations of a port
+     */
+    private class PortOperations {
+
+        final SerialPort port;
+        final LinkedList<Operation> reads = new LinkedList<Operation>();
+        final LinkedList<Operation> writes = new LinkedList<Operation>();
+        int registeredOps = 0;
+
+        PortOperations(SerialPort port) {
+            this.port = port;
+        }
+
+        /**
+         * Transfer as much as the port allows without blocking
+         */
+        void serve(int readyOps) {
+            if((readyOps & SerialPortSelector.OP_READ) != 0){
+                serve(reads);
+            }
+            if((readyOps & SerialPortSelector.OP_WRITE) != 0){
+                serve(writes);
+            }
+        }
+
+        private void serve(LinkedList<Operation> queue) {
+            while(!queue.isEmpty()){
+                Operation operation = queue.getFirst();
+                if(operation.isDone()){
+                    queue.removeFirst();
+                    continue;
+                }
+                int remains = operation.length - operation.transferred;
+                int count;
+                try {
+                    if(operation.write){
+                        count = port.writeBytesWithTimeout(operation.buffer, operation.offset + operation.transferred, remains, 0, false);
+                        if(count < 0){
+                            throw new SerialPortException(port.getPortName(), operation.methodName, SerialPortException.TYPE_UNKNOWN);
+                        }
+                    }
+                    else {
+                        count = port.readBytesWithTimeout(operation.buffer, operation.offset + operation.transferred, remains, 0, false);
+                    }
+                } catch (SerialPortException e) {
+                    queue.removeFirst();
+                    complete(operation, 0, e);
+                    continue;
+                }
+                operation.transferred += count;
+                if(count < remains){
+                    //Nothing more until the port is ready again
+                    return;
+                }
+                queue.removeFirst();
+                complete(operation, operation.transferred, null);
+            }
+        }
+
+        void failAll(SerialPortException exception) {
+            for(Operation operation : reads){
+                complete(operation, 0, exception);
+            }
+            for(Operation operation : writes){
+                complete(operation, 0, exception);
+            }
+            reads.clear();
+            writes.clear();
+        }
+    }
+
+    /**
+     * An asynchronous read or write, the Future returned to the caller
+     */
+    private class Operation implements Future<Integer> {
+
+        final SerialPort port;
+        final boolean write;
+        final byte[] buffer;
+        final int offset;
+        final int length;
+        final long deadline;            //System.nanoTime() value, unused if the operation has no timeout
+        final long timeoutMilliseconds;
+        final boolean exceptionOnTimeout;
+        final SerialPortCompletionHandler handler;
+        final String methodName;
+        int transferred = 0;            //Only accessed by the reactor thread
+
+        private boolean done = false;
+        private boolean cancelled = false;
+        private int result;
+        private SerialPortException failure;
+
+        Operation(SerialPort port, boolean write, byte[] buffer, int offset, int length, long deadline, long timeoutMilliseconds,
+                boolean exceptionOnTimeout, SerialPortCompletionHandler handler, String methodName) {
+            this.port = port;
+            this.write = write;
+            this.buffer = buffer;
+            this.offset = offset;
+            this.length = length;
+            this.deadline = deadline;
+            this.timeoutMilliseconds = timeoutMilliseconds;
+            this.exceptionOnTimeout = exceptionOnTimeout;
+            this.handler = handler;
+            this.methodName = methodName;
+        }
+
+        synchronized boolean finish(int result, SerialPortException failure) {
+            if(done){
+                return false;
+            }
+            this.result = result;
+            this.failure = failure;
+            done = true;
+            notifyAll();
+            return true;
+        }
+
+        /**
+         * Cancel the operation. The bytes already transferred are not given back, the
+         * handler is not called.
+         */
+        public boolean cancel(boolean mayInterruptIfRunning) {
+            synchronized(this){
+                if(done){
+                    return false;
+                }
+                done = true;
+                cancelled = true;
+                notifyAll();
+            }
+            //Let the reactor thread drop the operation and update the registration
+            selector.wakeup();
+            return true;
+        }
+
+        public synchronized boolean isCancelled() {
+            return cancelled;
+        }
+
+        public synchronized boolean isDone() {
+            return done;
+        }
+
+        public synchronized Integer get() throws InterruptedException, ExecutionException {
+            while(!done){
+                wait();
+            }
+            return getResult();
+        }
+
+        public synchronized Integer get(long timeout, TimeUnit unit) throws InterruptedException, ExecutionException, TimeoutException {
+            long deadline = System.nanoTime() + unit.toNanos(timeout);
+            while(!done){
+                long remains = deadline - System.nanoTime();
+                if(remains <= 0){
+                    throw new TimeoutException();
+                }
+                wait(toMillis(remains));
+            }
+            return getResult();
+        }
+
+        private Integer getResult() throws ExecutionException {
+            if(cancelled){
+                throw new CancellationException();
+            }
+            if(failure != null){
+                throw new ExecutionException(failure);
+            }
+            return Integer.valueOf(result);
+        }
+    }
+}
@@ -0,0 +1,300 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ */
+package jssc;
+
+import java.util.HashMap;
+import java.util.Map;
+
+/**
+ * Waits for data on many serial ports from a single thread. The native library uses
+ * epoll on Linux, kqueue on Mac OS X and an I/O completion port on Windows.
+ * <br>
+ * Typical usage:
+ * <pre>
+ * SerialPortSelector selector = new SerialPortSelector();
+ * selector.register(port1, SerialPortSelector.OP_READ);
+ * selector.register(port2, SerialPortSelector.OP_READ);
+ * while(running){
+ *     int count = selector.select(1000);
+ *     for(int i = 0; i &lt; count; i++){
+ *         SerialPort port = selector.getSelectedPort(i);
+ *         byte[] data = port.readBytes(selector.getSelectedInputCount(i));
+ *     }
+ * }
+ * </pre>
+ * A port can be registered with only one selector at a time. The port is removed
+ * from its selector when it is closed. The selector only sees the data held by the
+ * driver, so the ports with a native input ring can't be registered: those which have
+ * been in buffered mode (see {@link SerialPort#setBufferedMode(boolean, int)}) or read
+ * frames with {@link SerialPort#readUntil(byte[], byte[], int, int, long, boolean)} or
+ * {@link SerialPort#readFrame(byte[], int, int, int, int, int, boolean, long, boolean)}
+ * since they were opened. The framed reads of a registered port are refused likewise.
+ * <br>
+ * <b>Note: </b>on Windows the selector uses the event mask of the registered ports,
+ * so an event listener must not be added to a port while it is registered.
+ *
+ * @since 2.9.0
+ */
+public class SerialPortSelector {
+
+    /**
+     * Port has data in its input buffer
+     */
+    public static final int OP_READ = 1;
+    /**
+     * Port can accept data for writing
+     */
+    public static final int OP_WRITE = 4;
+
+    //Must match SELECTOR_MAX_EVENTS of the native library
+    private static final int MAX_SELECTED = 64;
+
+    private final SerialNativeInterface serialInterface = new SerialNativeInterface();
+    private final Map<Long, SerialPort> registeredPorts = new HashMap<Long, SerialPort>();
+    private final Object selectLock = new Object();
+    private volatile long selectorHandle;
+    private volatile boolean closed = false;
+
+    //Results of the last select(), only accessed while holding selectLock or by the selecting thread
+    private final long[] selectedHandles = new long[MAX_SELECTED];
+    private final int[] selectedOps = new int[MAX_SELECTED];
+    private final int[] selectedInputCounts = new int[MAX_SELECTED];
+    private final SerialPort[] selectedPorts = new SerialPort[MAX_SELECTED];
+    private int selectedCount = 0;
+
+    /**
+     * Create a new selector
+     *
+     * @throws SerialPortException if the native selector couldn't be created
+     */
+    public SerialPortSelector() throws SerialPortException {
+        selectorHandle = serialInterface.selectorOpen();
+        if(selectorHandle == -1){
+            throw new SerialPortException("SerialPortSelector", "SerialPortSelector()", SerialPortException.TYPE_UNKNOWN);
+        }
+    }
+
+    /**
+     * Register a port, or change the operations of interest of a port which is already
+     * registered with this selector
+     *
+     * @param port opened port
+     * @param ops combination of {@link #OP_READ} and {@link #OP_WRITE}
+     *
+     * @throws SerialPortException if the port is not opened, is registered with another
+     * selector, has a native input ring or the operation failed
+     */
+    public void register(SerialPort port, int ops) throws SerialPortException {
+        if(port == null){
+            throw new SerialPortException("SerialPortSelector", "register()", SerialPortException.TYPE_NULL_NOT_PERMITTED);
+        }
+        if(!port.isOpened()){
+            throw new SerialPortException(port.getPortName(), "register()", SerialPortException.TYPE_PORT_NOT_OPENED);
+        }
+        if(ops == 0 || (ops & ~(OP_READ | OP_WRITE)) != 0){
+            throw new SerialPortException(port.getPortName(), "register()", SerialPortException.TYPE_PARAMETER_IS_NOT_CORRECT);
+        }
+        synchronized(registeredPorts){
+            checkOpened("register()");
+            SerialPortSelector current = port.getSelector();
+            if((current != null && current != this) || port.hasInputRing()){
+                throw new SerialPortException(port.getPortName(), "register()", SerialPortException.TYPE_PORT_BUSY);
+            }
+            if(!serialInterface.selectorRegister(selectorHandle, port.getPortHandle(), ops)){
+                throw new SerialPortException(port.getPortName(), "register()", SerialPortException.TYPE_UNKNOWN);
+            }
+            registeredPorts.put(Long.valueOf(port.getPortHandle()), port);
+            port.setSelector(this);
+        }
+    }
+
+    /**
+     * Remove a port from this selector. Does nothing if the port is not registered.
+     *
+     * @param port registered port
+     */
+    public void unregister(SerialPort port) {
+        if(port == null){
+            return;
+        }
+        synchronized(registeredPorts){
+            Long key = Long.valueOf(port.getPortHandle());
+            if(registeredPorts.get(key) != port){
+                return;
+            }
+            registeredPorts.remove(key);
+            port.setSelector(null);
+            serialInterface.selectorUnregister(selectorHandle, port.getPortHandle());
+        }
+    }
+
+    /**
+     * Wait until at least one of the registered ports is ready for the operations it is
+     * registered for, the timeout expires or {@link #wakeup()} is called. The ready ports
+     * can then be retrieved with {@link #getSelectedPort(int)}.
+     *
+     * @param timeoutMilliseconds the maximum number of milliseconds to wait. Set to 0 to
+     * return immediately. If negative, blocks indefinitely.
+     *
+     * @return count of ready ports, 0 on timeout or wakeup
+     *
+     * @throws SerialPortException if the selector is closed or the operation failed
+     */
+    public int select(long timeoutMilliseconds) throws SerialPortException {
+        synchronized(selectLock){
+            checkOpened("select()");
+            int count = serialInterface.selectorSelect(selectorHandle, selectedHandles, selectedOps, selectedInputCounts, timeoutMilliseconds);
+            if(count < 0){
+                selectedCount = 0;
+                throw new SerialPortException("SerialPortSelector", "select()", SerialPortException.TYPE_UNKNOWN);
+            }
+            //Drop the ports which have been unregistered meanwhile
+            int selected = 0;
+            synchronized(registeredPorts){
+                for(int i = 0; i < count; i++){
+                    SerialPort port = registeredPorts.get(Long.valueOf(selectedHandles[i]));
+                    if(port != null){
+                        selectedPorts[selected] = port;
+                        selectedOps[selected] = selectedOps[i];
+                        selectedInputCounts[selected] = selectedInputCounts[i];
+                        selected++;
+                    }
+                }
+            }
+            for(int i = selected; i < selectedCount; i++){
+                selectedPorts[i] = null;
+            }
+            selectedCount = selected;
+            return selected;
+        }
+    }
+
+    /**
+     * Same as {@link #select(long)} with a timeout of 0
+     *
+     * @return count of ready ports
+     *
+     * @throws SerialPortException if the selector is closed or the operation failed
+     */
+    public int selectNow() throws SerialPortException {
+        return select(0);
+    }
+
+    /**
+     * Getting a port reported by the last {@link #select(long)}
+     *
+     * @param index index of the port, from 0 to the value returned by select() - 1
+     *
+     * @return the ready port
+     */
+    public SerialPort getSelectedPort(int index) {
+        checkIndex(index);
+        return selectedPorts[index];
+    }
+
+    /**
+     * Getting the ready operations of a port reported by the last {@link #select(long)}
+     *
+     * @param index index of the port, from 0 to the value returned by select() - 1
+     *
+     * @return combination of {@link #OP_READ} and {@link #OP_WRITE}
+     */
+    public int getSelectedOps(int index) {
+        checkIndex(index);
+        return selectedOps[index];
+    }
+
+    /**
+     * Getting the count of bytes in the input buffer of a port reported by the last
+     * {@link #select(long)}, sampled when the port became ready
+     *
+     * @param index index of the port, from 0 to the value returned by select() - 1
+     *
+     * @return bytes count, may be 0 if the port is only ready for writing
+     */
+    public int getSelectedInputCount(int index) {
+        checkIndex(index);
+        return selectedInputCounts[index];
+    }
+
+    /**
+     * Unblock the thread waiting in {@link #select(long)}. If no thread is waiting, the
+     * next call to select() returns immediately.
+     */
+    public void wakeup() {
+        synchronized(registeredPorts){
+            if(selectorHandle != 0){
+                serialInterface.selectorWakeup(selectorHandle);
+            }
+        }
+    }
+
+    /**
+     * Getting selector state
+     *
+     * @return true if the selector is not closed
+     */
+    public boolean isOpened() {
+        return !closed;
+    }
+
+    /**
+     * Close the selector. All of the ports are unregistered, but not closed.
+     */
+    public void close() {
+        synchronized(registeredPorts){
+            if(closed){
+                return;
+            }
+            closed = true;
+            for(SerialPort port : registeredPorts.values()){
+                port.setSelector(null);
+            }
+            registeredPorts.clear();
+        }
+        wakeup();
+        synchronized(selectLock){
+            long handle;
+            synchronized(registeredPorts){
+                handle = selectorHandle;
+                selectorHandle = 0;
+            }
+            serialInterface.selectorClose(handle);
+            selectedCount = 0;
+        }
+    }
+
+    private void checkOpened(String methodName) throws SerialPortException {
+        if(closed){
+            throw new SerialPortException("SerialPortSelector", methodName, SerialPortException.TYPE_SELECTOR_CLOSED);
+        }
+    }
+
+    private void checkIndex(int index) {
+        if(index < 0 || index >= selectedCount){
+            throw new IndexOutOfBoundsException("Index: " + index + ", Selected: " + selectedCount);
+        }
+    }
+}
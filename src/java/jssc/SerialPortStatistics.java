@@ -0,0 +1,235 @@
+/* jSSC (Java Simple Serial Connector) - serial port communication library.
+ * © Alexey Sokolov (scream3r), 2010-2014.
+ *
+ * This file is part of jSSC.
+ *
+ * jSSC is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * jSSC is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with jSSC.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * If you use jSSC in public project you can inform me about this by e-mail,
+ * of course if you want it.
+ *
+ * e-mail: scream3r.org@gmail.com
+ * web-site: http://scream3r.org | http://code.google.com/p/java-simple-serial-connector/
+ */
+package jssc;
+
+/**
+ * Snapshot of the counters kept natively for the reads and writes of a port, see
+ * {@link SerialPort#getStatistics()}. The counters are updated once per native call, so
+ * taking a snapshot costs a single native call and never blocks the I/O threads.
+ * <br>
+ * The read latency is measured from the first wakeup of a read by incoming data to the
+ * return of the read, a read waiting for more bytes than available therefore includes
+ * the time waiting for the rest. The error counters come from TIOCGICOUNT on Linux and
+ * from the ClearCommError() calls of the library on Windows; they are always 0 where
+ * the driver doesn't count errors.
+ *
+ * @since 2.9.0
+ */
+public final class SerialPortStatistics {
+
+    /**
+     * Count of buckets of the latency histogram, see {@link #getReadLatencyHistogram()}
+     */
+    public static final int LATENCY_BUCKETS = 32;
+
+    //Indexes of the native array
+    private static final int BYTES_READ = 0;
+    private static final int BYTES_WRITTEN = 1;
+    private static final int READ_CALLS = 2;
+    private static final int WRITE_CALLS = 3;
+    private static final int WAKEUPS = 4;
+    private static final int TIMEOUTS = 5;
+    private static final int PARTIAL_WRITES = 6;
+    private static final int LATENCY_COUNT = 7;
+    private static final int LATENCY_TOTAL = 8;
+    private static final int LATENCY_MAX = 9;
+    private static final int OVERRUNS = 10;
+    private static final int BUFFER_OVERRUNS = 11;
+    private static final int FRAMING_ERRORS = 12;
+    private static final int PARITY_ERRORS = 13;
+    private static final int BREAKS = 14;
+    private static final int COUNTERS = 15;
+
+    static final int LENGTH = COUNTERS + LATENCY_BUCKETS;
+
+    private final String portName;
+    private final long[] values;
+
+    SerialPortStatistics(String portName, long[] values) {
+        this.portName = portName;
+        this.values = values;
+    }
+
+    /**
+     * Getting the name of the port
+     *
+     * @return name of the port of the statistics
+     */
+    public String getPortName() {
+        return portName;
+    }
+
+    /**
+     * @return bytes returned by the reads
+     */
+    public long getBytesRead() {
+        return values[BYTES_READ];
+    }
+
+    /**
+     * @return bytes accepted by the driver from the writes
+     */
+    public long getBytesWritten() {
+        return values[BYTES_WRITTEN];
+    }
+
+    /**
+     * @return system calls reading the port, or reads from the input ring in buffered mode
+     */
+    public long getReadCalls() {
+        return values[READ_CALLS];
+    }
+
+    /**
+     * @return system calls writing the port
+     */
+    public long getWriteCalls() {
+        return values[WRITE_CALLS];
+    }
+
+    /**
+     * @return wakeups of the blocked reads and writes by the port becoming ready
+     */
+    public long getWakeups() {
+        return values[WAKEUPS];
+    }
+
+    /**
+     * @return reads and writes ended by their timeout before completion
+     */
+    public long getTimeouts() {
+        return values[TIMEOUTS];
+    }
+
+    /**
+     * @return writes whose data the driver accepted only in part at once
+     */
+    public long getPartialWrites() {
+        return values[PARTIAL_WRITES];
+    }
+
+    /**
+     * @return hardware overruns of the receiver
+     */
+    public long getOverruns() {
+        return values[OVERRUNS];
+    }
+
+    /**
+     * @return overruns of the input buffer of the driver
+     */
+    public long getBufferOverruns() {
+        return values[BUFFER_OVERRUNS];
+    }
+
+    /**
+     * @return framing errors, including the frame headers with a wrong length skipped by
+     * {@link SerialPort#readFrame(byte[], int, int, int, int, int, boolean, long, boolean)}
+     */
+    public long getFramingErrors() {
+        return values[FRAMING_ERRORS];
+    }
+
+    /**
+     * @return parity errors
+     */
+    public long getParityErrors() {
+        return values[PARITY_ERRORS];
+    }
+
+    /**
+     * @return breaks received
+     */
+    public long getBreaks() {
+        return values[BREAKS];
+    }
+
+    /**
+     * @return count of reads in the latency measures
+     */
+    public long getReadLatencyCount() {
+        return values[LATENCY_COUNT];
+    }
+
+    /**
+     * @return mean read latency in microseconds, 0 without measure
+     */
+    public long getReadLatencyMeanMicros() {
+        return (values[LATENCY_COUNT] != 0 ? values[LATENCY_TOTAL] / values[LATENCY_COUNT] : 0);
+    }
+
+    /**
+     * @return maximum read latency in microseconds
+     */
+    public long getReadLatencyMaxMicros() {
+        return values[LATENCY_MAX];
+    }
+
+    /**
+     * Getting the histogram of the read latencies. Bucket 0 counts the latencies below
+     * 1 microsecond, bucket i the latencies from 2^(i-1) to 2^i - 1 microseconds, the last
+     * bucket also counts all of the longer ones.
+     *
+     * @return array of {@link #LATENCY_BUCKETS} counts
+     */
+    public long[] getReadLatencyHistogram() {
+        long[] histogram = new long[LATENCY_BUCKETS];
+        System.arraycopy(values, COUNTERS, histogram, 0, LATENCY_BUCKETS);
+        return histogram;
+    }
+
+    /**
+     * Getting an upper bound of a percentile of the read latency from the histogram
+     *
+     * @param percentile percentile between 0 and 100
+     *
+     * @return upper bound in microseconds of the bucket holding the percentile, 0 without
+     * measure
+     */
+    public long getReadLatencyPercentileMicros(double percentile) {
+        long count = values[LATENCY_COUNT];
+        if(count == 0){
+            return 0;
+        }
+        long rank = (long)Math.ceil(count * Math.min(Math.max(percentile, 0), 100) / 100);
+        long seen = 0;
+        for(int i = 0; i < LATENCY_BUCKETS - 1; i++){
+            seen += values[COUNTERS + i];
+            if(seen >= rank && seen > 0){
+                return (1L << i) - 1;
+            }
+        }
+        return values[LATENCY_MAX];
+    }
+
+    @Override
+    public String toString() {
+        return portName + ": read " + getBytesRead() + " bytes in " + getReadCalls() + " calls, wrote " + getBytesWritten() +
+               " bytes in " + getWriteCalls() + " calls (" + getPartialWrites() + " partial), " + getWakeups() + " wakeups, " +
+               getTimeouts() + " timeouts, read latency mean " + getReadLatencyMeanMicros() + " us max " + getReadLatencyMaxMicros() +
+               " us, errors: " + getOverruns() + " overruns, " + getBufferOverruns() + " buffer overruns, " + getFramingErrors() +
+               " framing, " + getParityErrors() + " parity, " + getBreaks() + " breaks";
+    }
+}